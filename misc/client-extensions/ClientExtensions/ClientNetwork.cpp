@@ -2,6 +2,8 @@
 #include "ClientDetours.h"
 
 #include "CustomPacketBuffer.h"
+#include "CustomPacketBatch.h"
+#include "CustomPacketState.h"
 #include "Logger.h"
 #include "ClientLua.h"
 
@@ -117,6 +119,9 @@ CustomPacketRead* curRead = nullptr;
 
 std::map < opcode_t, std::vector<std::function<void(CustomPacketRead*)>>> cppListeners;
 
+// replicated state channels by owner and channel, kept across ui reloads
+std::map<std::pair<CustomPacketStateOwner, uint32_t>, CustomPacketState> states;
+
 class ClientMessageBuffer : public CustomPacketBuffer {
 public:
     ClientMessageBuffer()
@@ -124,6 +129,57 @@ public:
     {}
 
     virtual void OnPacket(CustomPacketRead* value) override final
+    {
+        if (value->Opcode() == BATCH_OPCODE)
+        {
+            bool valid = CustomPacketBatch::Unpack(value, [this](CustomPacketRead* read) {
+                Dispatch(read);
+            });
+            if (!valid)
+            {
+                LOG_ERROR << "Received malformed custom packet batch";
+            }
+            return;
+        }
+        if (value->Opcode() == STATE_OPCODE)
+        {
+            ApplyState(value);
+            return;
+        }
+        Dispatch(value);
+    }
+
+    virtual void OnError(CustomPacketResult error) override final
+    {
+        LOG_ERROR << "Packet reading error " << uint32_t(error);
+    }
+private:
+    void ApplyState(CustomPacketRead* value)
+    {
+        CustomPacketStateOwner owner;
+        uint32_t channel;
+        if (!CustomPacketState::ReadChannel(value, owner, channel))
+        {
+            LOG_ERROR << "Received malformed replicated state";
+            return;
+        }
+
+        std::string changed = "";
+        bool valid = states[{ owner, channel }].Apply(value, [&](uint32_t field) {
+            changed += std::to_string(field) + ",";
+        });
+        if (!valid)
+        {
+            LOG_ERROR << "Received malformed replicated state on channel " << channel;
+        }
+
+        ClientLua::DoString(
+              ("__FireReplicatedState(" + std::to_string(uint32_t(owner)) + "," + std::to_string(channel) + ",{" + changed + "})").c_str()
+            , ClientLua::State()
+        );
+    }
+
+    void Dispatch(CustomPacketRead* value)
     {
         LOG_DEBUG << "Client receive full packet with opcode" << value->Opcode();
         curRead = value;
@@ -141,11 +197,6 @@ public:
             }
         }
     }
-
-    virtual void OnError(CustomPacketResult error) override final
-    {
-        LOG_ERROR << "Packet reading error " << uint32_t(error);
-    }
 };
 
 int ClientNetwork::OnCustomPacket(
@@ -229,8 +280,21 @@ enum class LuaNetworkOpcode {
     MAKE_CUSTOM_PACKET  = 24,
     SEND_CUSTOM_PACKET  = 25,
     RESET_CUSTOM_PACKET = 26,
+    READ_STATE_NUMBER   = 27,
+    READ_STATE_STRING   = 28,
+    READ_STATE_HAS      = 29,
 };
 
+// _CLIENT_NETWORK(opcode, owner, channel, ...)
+static CustomPacketState* GetState(lua_State* L)
+{
+    auto itr = states.find({
+          CustomPacketStateOwner(uint8_t(ClientLua::GetNumber(L, 2, 0)))
+        , uint32_t(ClientLua::GetNumber(L, 3, 0))
+    });
+    return itr == states.end() ? nullptr : &itr->second;
+}
+
 void ClientNetwork::initialize()
 {
     ClientLua::AddFunction(
@@ -352,6 +416,26 @@ void ClientNetwork::initialize()
                 curRead->Reset();
                 return 0;
             }
+            case LuaNetworkOpcode::READ_STATE_NUMBER: {
+                CustomPacketState* state = GetState(L);
+                uint32_t field = uint32_t(ClientLua::GetNumber(L, 4, 0));
+                double def = ClientLua::GetNumber(L, 5, 0);
+                ClientLua::PushNumber(L, state ? state->GetNumber(field, def) : def);
+                return 1;
+            }
+            case LuaNetworkOpcode::READ_STATE_STRING: {
+                CustomPacketState* state = GetState(L);
+                uint32_t field = uint32_t(ClientLua::GetNumber(L, 4, 0));
+                std::string def = ClientLua::GetString(L, 5, "");
+                ClientLua::PushString(L, (state ? state->GetString(field, def) : def).c_str());
+                return 1;
+            }
+            case LuaNetworkOpcode::READ_STATE_HAS: {
+                CustomPacketState* state = GetState(L);
+                uint32_t field = uint32_t(ClientLua::GetNumber(L, 4, 0));
+                ClientLua::PushNumber(L, state && state->Has(field) ? 1 : 0);
+                return 1;
+            }
             default: {
                 LOG_ERROR << "Received invalid LuaNetworkOpcode: " << int(opcode);
                 break;
@@ -27,6 +27,9 @@ local LuaNetworkOpcode = {
     ["MAKE_CUSTOM_PACKET"]  = 24,
     ["SEND_CUSTOM_PACKET"]  = 25,
     ["RESET_CUSTOM_PACKET"] = 26,
+    ["READ_STATE_NUMBER"]   = 27,
+    ["READ_STATE_STRING"]   = 28,
+    ["READ_STATE_HAS"]      = 29,
 };
 
 function CreateCustomPacket(opcode,size)
@@ -104,3 +107,37 @@ function __FireCustomPacket(opcode)
         _CLIENT_NETWORK(LuaNetworkOpcode.RESET_CUSTOM_PACKET)
     end
 end
+
+-- Replicated state channels (see CustomPacketState.h)
+-- The fields are stored in c++, these just read them.
+
+-- A channel can have both a player state and a map state
+ReplicatedStateOwner = {
+    PLAYER = 0,
+    MAP    = 1,
+}
+
+function GetReplicatedState(channel,owner)
+    local state = { channel = channel, owner = owner or ReplicatedStateOwner.PLAYER }
+    function state:GetNumber(field,def) return _CLIENT_NETWORK(LuaNetworkOpcode.READ_STATE_NUMBER,self.owner,self.channel,field,def or 0) end
+    function state:GetString(field,def) return _CLIENT_NETWORK(LuaNetworkOpcode.READ_STATE_STRING,self.owner,self.channel,field,def or "") end
+    function state:Has(field) return _CLIENT_NETWORK(LuaNetworkOpcode.READ_STATE_HAS,self.owner,self.channel,field) == 1 end
+    return state
+end
+
+-- cb(state,fields) for changes to either owner, see state.owner
+__stateCallbacks = {}
+function OnReplicatedState(channel,cb)
+    if(__stateCallbacks[channel] == nil) then
+        __stateCallbacks[channel] = {}
+    end
+    table.insert(__stateCallbacks[channel],cb)
+end
+
+function __FireReplicatedState(owner,channel,fields)
+    if(__stateCallbacks[channel] == nil) then return end
+    local state = GetReplicatedState(channel,owner)
+    for _,v in pairs(__stateCallbacks[channel]) do
+        v(state,fields)
+    end
+end
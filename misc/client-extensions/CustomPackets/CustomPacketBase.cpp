@@ -1,5 +1,6 @@
 #include "CustomPacketBase.h"
 
+#include <cmath>
 #include <string>
 #include <stdexcept>
 
@@ -69,7 +70,6 @@ void CustomPacketBase::Reset()
     m_chunk = 0;
     m_idx = 0;
     m_global_idx = 0;
-    m_size = 0;
 }
 
 void CustomPacketBase::Destroy()
@@ -79,6 +79,7 @@ void CustomPacketBase::Destroy()
         chunk.Destroy();
     }
     m_chunks.clear();
+    m_size = 0;
     Reset();
 }
 
@@ -95,6 +96,12 @@ totalSize_t CustomPacketBase::Size()
 }
 
 
+totalSize_t CustomPacketBase::Remaining()
+{
+    return m_size - m_global_idx;
+}
+
+
 CustomPacketChunk* CustomPacketBase::Chunk(chunkCount_t index)
 {
     return &m_chunks[index];
@@ -223,6 +230,7 @@ void CustomPacketBase::WriteBytes(totalSize_t size, char const* bytes)
         }
         else
         {
+            m_global_idx += written;
             m_idx = 0;
             ++m_chunk;
         }
@@ -253,6 +261,7 @@ void CustomPacketBase::ReadBytes(totalSize_t size, char* bytes)
         }
         else
         {
+            m_global_idx += read;
             m_idx = 0;
             ++m_chunk;
         }
@@ -273,6 +282,7 @@ char* CustomPacketBase::ReadBytes(totalSize_t size, bool padStr)
 void CustomPacketBase::Clear()
 {
     m_chunks.clear();
+    m_size = 0;
     Reset();
 }
 
@@ -18,12 +18,15 @@ public:
     );
     std::vector<CustomPacketChunk> & buildMessages();
 
+    // moves the read head back to the start of the message
     void Reset();
     void Destroy();
     void Clear();
 
     void Push(CustomPacketChunk& chnk);
     totalSize_t Size();
+    // bytes left to read
+    totalSize_t Remaining();
     CustomPacketChunk* Chunk(chunkCount_t index);
     chunkSize_t ChunkSize(chunkCount_t index);
     chunkCount_t ChunkCount();
@@ -77,4 +80,5 @@ private:
     opcode_t m_opcode;
 
     friend class CustomPacketBuffer;
+    friend class CustomPacketBatch;
 };
@@ -0,0 +1,69 @@
+#include "CustomPacketBatch.h"
+
+CustomPacketBatch::CustomPacketBatch()
+    : m_container(BATCH_OPCODE, MAX_FRAGMENT_SIZE, 0)
+    , m_count(0)
+{}
+
+bool CustomPacketBatch::Fits(totalSize_t size)
+{
+    return size <= Capacity()
+        && EntrySize(size) <= Capacity() - m_container.Size();
+}
+
+bool CustomPacketBatch::Add(CustomPacketBase& message)
+{
+    if (!Fits(message.Size()))
+    {
+        return false;
+    }
+
+    m_container.Write<opcode_t>(message.Opcode());
+    m_container.Write<totalSize_t>(message.Size());
+    for (chunkCount_t i = 0; i < message.ChunkCount(); ++i)
+    {
+        m_container.WriteBytes(message.ChunkSize(i), message.Chunk(i)->Offset(0));
+    }
+    ++m_count;
+    return true;
+}
+
+totalSize_t CustomPacketBatch::Count()
+{
+    return m_count;
+}
+
+CustomPacketWrite& CustomPacketBatch::Container()
+{
+    return m_container;
+}
+
+bool CustomPacketBatch::Unpack(
+      CustomPacketRead* container
+    , std::function<void(CustomPacketRead*)> callback
+) {
+    while (container->Remaining() > 0)
+    {
+        totalSize_t remaining = container->Remaining();
+        if (remaining < EntrySize(0))
+        {
+            return false;
+        }
+
+        opcode_t opcode = container->Read<opcode_t>(0);
+        totalSize_t size = container->Read<totalSize_t>(0);
+        if (size > remaining - EntrySize(0) || size > Capacity())
+        {
+            return false;
+        }
+
+        // entries are never bigger than a fragment, so one chunk is enough
+        CustomPacketChunk chunk = CustomPacketChunk(chunkSize_t(size));
+        container->CustomPacketBase::ReadBytes(size, chunk.Offset(0));
+        CustomPacketRead read(opcode, MAX_FRAGMENT_SIZE);
+        read.Push(chunk);
+        callback(&read);
+        read.Destroy();
+    }
+    return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "CustomPacketDefines.h"
+#include "CustomPacketRead.h"
+#include "CustomPacketWrite.h"
+
+#include <functional>
+
+// Packs several small messages into a single container message
+// (opcode BATCH_OPCODE) that always fits in one fragment.
+//
+// Container layout, repeated until the end of the payload:
+//   [opcode_t opcode][totalSize_t size][size bytes of payload]
+class CUSTOM_PACKET_API CustomPacketBatch {
+public:
+    CustomPacketBatch();
+
+    // The largest payload that can be stored in a single container
+    static constexpr totalSize_t Capacity()
+    {
+        return totalSize_t(MAX_FRAGMENT_SIZE - CustomHeaderSize);
+    }
+
+    // The container space needed to store a message of "size" bytes
+    static constexpr totalSize_t EntrySize(totalSize_t size)
+    {
+        return totalSize_t(sizeof(opcode_t) + sizeof(totalSize_t)) + size;
+    }
+
+    // Returns false without writing anything if the message does not fit
+    bool Add(CustomPacketBase& message);
+    bool Fits(totalSize_t size);
+    totalSize_t Count();
+    CustomPacketWrite& Container();
+
+    // Calls "callback" once for every message stored in "container".
+    // Returns false if the container is malformed, messages before the
+    // malformed entry have already been passed to the callback.
+    static bool Unpack(
+          CustomPacketRead* container
+        , std::function<void(CustomPacketRead*)> callback
+    );
+private:
+    CustomPacketWrite m_container;
+    totalSize_t m_count;
+};
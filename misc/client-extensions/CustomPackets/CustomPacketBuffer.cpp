@@ -37,7 +37,8 @@ CustomPacketResult CustomPacketBuffer::ReceivePacket(chunkSize_t size, char* dat
         return _onError(CustomPacketResult::OUT_OF_SPACE, data);
     }
 
-    CustomPacketChunk chnk(size, data);
+    // "size" includes the header
+    CustomPacketChunk chnk(size - CustomHeaderSize, data);
     CustomPacketHeader* hdr = chnk.Header();
 
     switch (hdr->totalFrags)
@@ -108,7 +109,8 @@ CustomPacketResult CustomPacketBuffer::_onSuccess()
     OnPacket(&m_cur);
 
     // destroy all but the last fragment, since it's not a copy
-    for (chunkCount_t i = 0; i < m_cur.m_chunks.size() - 1; ++i)
+    // (no fragments are left if OnPacket detached the message)
+    for (size_t i = 0; i + 1 < m_cur.m_chunks.size(); ++i)
     {
         m_cur.m_chunks[i].Destroy();
     }
@@ -116,6 +118,18 @@ CustomPacketResult CustomPacketBuffer::_onSuccess()
     return CustomPacketResult::HANDLED_MESSAGE;
 }
 
+CustomPacketRead* CustomPacketBuffer::DetachMessage()
+{
+    CustomPacketRead* read = new CustomPacketRead(m_cur);
+    // earlier fragments are already copies, the last one points into the socket buffer
+    if (read->m_chunks.size() > 0)
+    {
+        read->m_chunks.back().Copy();
+    }
+    m_cur.Clear();
+    return read;
+}
+
 void CustomPacketBuffer::AppendFragment(CustomPacketChunk & chunk, bool isLast)
 {
     // buffer entries need to be made persistent
@@ -35,10 +35,14 @@ public:
         , totalSize_t quota
         , chunkSize_t bufferSize
         );
-    ~CustomPacketBuffer();
+    virtual ~CustomPacketBuffer();
     CustomPacketResult ReceivePacket(chunkSize_t size, char* data);
     totalSize_t Size();
 protected:
+    // Takes ownership of the message currently passed to OnPacket,
+    // so it can be handled after OnPacket returns (for example on another thread).
+    // Only valid inside OnPacket, the caller must Destroy and delete the result.
+    CustomPacketRead* DetachMessage();
     virtual void OnPacket(CustomPacketRead * value) {}
     virtual void OnError(CustomPacketResult error) {}
 private:
@@ -1,5 +1,6 @@
 #include "CustomPacketChunk.h"
 
+#include <cstring>
 #include <string>
 
 CustomPacketChunk::CustomPacketChunk(CustomPacketChunk const& other)
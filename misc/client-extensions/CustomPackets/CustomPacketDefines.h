@@ -22,6 +22,14 @@ constexpr chunkSize_t MIN_FRAGMENT_SIZE = 25000;
 // default: ~8mb
 constexpr totalSize_t BUFFER_QUOTA = 8000000;
 
+// Reserved custom opcode for containers of several small packets,
+// see CustomPacketBatch.h. Do not register listeners for this opcode.
+constexpr opcode_t BATCH_OPCODE = UINT16_MAX;
+
+// Reserved custom opcode for replicated state deltas,
+// see CustomPacketState.h. Do not register listeners for this opcode.
+constexpr opcode_t STATE_OPCODE = UINT16_MAX - 1;
+
 #define CustomHeaderSize chunkSize_t(sizeof(CustomPacketHeader))
 
 // These are the _base_ opcodes, not to be confused with custom packet opcode.
@@ -0,0 +1,118 @@
+#include "CustomPacketLog.h"
+
+#include <algorithm>
+
+static constexpr char LOG_MAGIC[4] = { 'T','S','P','L' };
+static constexpr uint8_t LOG_VERSION = 1;
+
+CustomPacketLogWriter::CustomPacketLogWriter(std::ostream& stream)
+    : m_stream(stream)
+{
+    m_stream.write(LOG_MAGIC, sizeof(LOG_MAGIC));
+    m_stream.put(char(LOG_VERSION));
+    m_bytes += sizeof(LOG_MAGIC) + 1;
+}
+
+void CustomPacketLogWriter::WriteVarint(uint64_t value)
+{
+    do
+    {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        m_stream.put(char(value ? byte | 0x80 : byte));
+        m_bytes++;
+    } while (value);
+}
+
+void CustomPacketLogWriter::Write(CustomPacketLogRecord const& record)
+{
+    WriteVarint(record.m_tick - m_tick);
+    m_tick = record.m_tick;
+    m_stream.put(char(record.m_kind));
+    m_bytes++;
+    WriteVarint(record.m_session);
+    WriteVarint(record.m_opcode);
+    WriteVarint(record.m_data.size());
+    m_stream.write(record.m_data.data(), record.m_data.size());
+    m_bytes += record.m_data.size();
+}
+
+uint64_t CustomPacketLogWriter::BytesWritten()
+{
+    return m_bytes;
+}
+
+CustomPacketLogReader::CustomPacketLogReader(std::istream& stream)
+    : m_stream(stream)
+{
+    char magic[sizeof(LOG_MAGIC)];
+    m_stream.read(magic, sizeof(magic));
+    int version = m_stream.get();
+    m_valid = m_stream.good()
+        && std::equal(magic, magic + sizeof(magic), LOG_MAGIC)
+        && version == LOG_VERSION;
+}
+
+bool CustomPacketLogReader::IsValid()
+{
+    return m_valid;
+}
+
+bool CustomPacketLogReader::ReadVarint(uint64_t& value)
+{
+    value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7)
+    {
+        int byte = m_stream.get();
+        if (byte == EOF)
+        {
+            return false;
+        }
+        value |= uint64_t(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CustomPacketLogReader::Next(CustomPacketLogRecord& record)
+{
+    if (!m_valid)
+    {
+        return false;
+    }
+
+    uint64_t delta, session, opcode, size;
+    if (!ReadVarint(delta))
+    {
+        return false;
+    }
+    int kind = m_stream.get();
+    if (
+           kind == EOF
+        || kind > int(CustomPacketLogKind::EVENT)
+        || !ReadVarint(session)
+        || !ReadVarint(opcode)
+        || !ReadVarint(size)
+        // no single message can be larger than this
+        || size > BUFFER_QUOTA
+    ) {
+        return false;
+    }
+
+    record.m_data.resize(size);
+    m_stream.read(record.m_data.data(), size);
+    if (uint64_t(m_stream.gcount()) != size)
+    {
+        return false;
+    }
+
+    m_tick += delta;
+    record.m_tick = m_tick;
+    record.m_kind = CustomPacketLogKind(kind);
+    record.m_session = session;
+    record.m_opcode = uint32_t(opcode);
+    return true;
+}
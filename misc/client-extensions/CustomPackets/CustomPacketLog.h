@@ -0,0 +1,55 @@
+#pragma once
+
+#include "CustomPacketDefines.h"
+
+#include <iostream>
+#include <string>
+
+// Compact binary log of the traffic a server has seen,
+// written by the packet recorder and read back by replay drivers.
+//
+// File layout:
+//   "TSPL" [uint8 version] records...
+// Record layout (all integers are varints):
+//   [tick delta][uint8 kind][session][opcode][size][size bytes]
+enum class CUSTOM_PACKET_API CustomPacketLogKind : uint8_t {
+    TICK          = 0, // opcode holds the world update diff
+    WORLD_PACKET  = 1,
+    CUSTOM_PACKET = 2,
+    EVENT         = 3, // data holds the event name, opcode the id of id events
+};
+
+struct CUSTOM_PACKET_API CustomPacketLogRecord {
+    uint64_t m_tick = 0;
+    CustomPacketLogKind m_kind = CustomPacketLogKind::TICK;
+    uint64_t m_session = 0;
+    uint32_t m_opcode = 0;
+    std::string m_data;
+};
+
+class CUSTOM_PACKET_API CustomPacketLogWriter {
+public:
+    CustomPacketLogWriter(std::ostream& stream);
+    // ticks must never decrease
+    void Write(CustomPacketLogRecord const& record);
+    uint64_t BytesWritten();
+private:
+    void WriteVarint(uint64_t value);
+    std::ostream& m_stream;
+    uint64_t m_tick = 0;
+    uint64_t m_bytes = 0;
+};
+
+class CUSTOM_PACKET_API CustomPacketLogReader {
+public:
+    CustomPacketLogReader(std::istream& stream);
+    // false if the stream is not a packet log
+    bool IsValid();
+    // false at the end of the log or on a truncated record
+    bool Next(CustomPacketLogRecord& record);
+private:
+    bool ReadVarint(uint64_t& value);
+    std::istream& m_stream;
+    uint64_t m_tick = 0;
+    bool m_valid = false;
+};
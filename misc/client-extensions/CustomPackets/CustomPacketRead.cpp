@@ -27,6 +27,25 @@ std::string CustomPacketRead::ReadString(std::string const& def)
     return str;
 }
 
+uint64_t CustomPacketRead::ReadVarint(uint64_t def)
+{
+    uint64_t value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7)
+    {
+        if (Remaining() == 0)
+        {
+            return def;
+        }
+        uint8_t byte = Read<uint8_t>(0);
+        value |= uint64_t(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return value;
+        }
+    }
+    return def;
+}
+
 char* CustomPacketRead::ReadBytes(totalSize_t size, bool padStr)
 {
     return CustomPacketBase::ReadBytes(size, padStr);
@@ -13,6 +13,8 @@ public:
     CustomPacketRead* operator->();
 
     std::string ReadString(std::string const& def = "");
+    // returns "def" if the packet ends before the varint does
+    uint64_t ReadVarint(uint64_t def);
 
     template<typename T>
     T Read(T def)
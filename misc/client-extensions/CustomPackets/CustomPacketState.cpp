@@ -0,0 +1,329 @@
+#include "CustomPacketState.h"
+
+#include <cmath>
+
+static uint64_t zigzag(int64_t value)
+{
+    return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+// integers beyond 2^53 can't round-trip through a double anyway
+static bool isIntegral(double value)
+{
+    return std::floor(value) == value && std::fabs(value) < 9007199254740992.0;
+}
+
+CustomPacketState::CustomPacketState()
+{}
+
+CustomPacketState::Field* CustomPacketState::GetField(uint32_t field, bool create)
+{
+    if (field >= MAX_STATE_FIELDS)
+    {
+        return nullptr;
+    }
+
+    if (field >= m_fields.size())
+    {
+        if (!create)
+        {
+            return nullptr;
+        }
+        m_fields.resize(size_t(field) + 1);
+    }
+    return &m_fields[field];
+}
+
+void CustomPacketState::MarkDirty(uint32_t field, Field& value)
+{
+    if (!value.m_dirty)
+    {
+        value.m_dirty = true;
+        m_dirty.push_back(field);
+    }
+}
+
+bool CustomPacketState::SetNumber(uint32_t field, double value)
+{
+    Field* f = GetField(field, true);
+    if (f == nullptr)
+    {
+        return false;
+    }
+
+    if (f->m_type == CustomPacketStateType::DOUBLE && f->m_number == value)
+    {
+        return true;
+    }
+    f->m_type = CustomPacketStateType::DOUBLE;
+    f->m_number = value;
+    f->m_string.clear();
+    MarkDirty(field, *f);
+    return true;
+}
+
+bool CustomPacketState::SetString(uint32_t field, std::string const& value)
+{
+    Field* f = GetField(field, true);
+    if (f == nullptr)
+    {
+        return false;
+    }
+
+    if (f->m_type == CustomPacketStateType::STRING && f->m_string == value)
+    {
+        return true;
+    }
+    f->m_type = CustomPacketStateType::STRING;
+    f->m_number = 0;
+    f->m_string = value;
+    MarkDirty(field, *f);
+    return true;
+}
+
+bool CustomPacketState::Remove(uint32_t field)
+{
+    Field* f = GetField(field, false);
+    if (f == nullptr)
+    {
+        return field < MAX_STATE_FIELDS;
+    }
+
+    if (f->m_type == CustomPacketStateType::NONE)
+    {
+        return true;
+    }
+    f->m_type = CustomPacketStateType::NONE;
+    f->m_number = 0;
+    f->m_string.clear();
+    MarkDirty(field, *f);
+    return true;
+}
+
+bool CustomPacketState::Has(uint32_t field)
+{
+    return Type(field) != CustomPacketStateType::NONE;
+}
+
+CustomPacketStateType CustomPacketState::Type(uint32_t field)
+{
+    Field* f = GetField(field, false);
+    return f == nullptr ? CustomPacketStateType::NONE : f->m_type;
+}
+
+double CustomPacketState::GetNumber(uint32_t field, double def)
+{
+    Field* f = GetField(field, false);
+    return f == nullptr || f->m_type != CustomPacketStateType::DOUBLE
+        ? def
+        : f->m_number;
+}
+
+std::string CustomPacketState::GetString(uint32_t field, std::string const& def)
+{
+    Field* f = GetField(field, false);
+    return f == nullptr || f->m_type != CustomPacketStateType::STRING
+        ? def
+        : f->m_string;
+}
+
+bool CustomPacketState::IsDirty()
+{
+    return m_dirty.size() > 0;
+}
+
+void CustomPacketState::ClearDirty()
+{
+    for (uint32_t field : m_dirty)
+    {
+        m_fields[field].m_dirty = false;
+    }
+    m_dirty.clear();
+}
+
+void CustomPacketState::WriteField(CustomPacketWrite& write, uint32_t field, Field& value)
+{
+    write.WriteVarint(field);
+    switch (value.m_type)
+    {
+    case CustomPacketStateType::DOUBLE:
+        if (isIntegral(value.m_number))
+        {
+            write.Write<uint8_t>(uint8_t(CustomPacketStateType::INTEGER));
+            write.WriteVarint(zigzag(int64_t(value.m_number)));
+        }
+        else
+        {
+            write.Write<uint8_t>(uint8_t(CustomPacketStateType::DOUBLE));
+            write.Write<double>(value.m_number);
+        }
+        break;
+    case CustomPacketStateType::STRING:
+        write.Write<uint8_t>(uint8_t(CustomPacketStateType::STRING));
+        write.WriteVarint(value.m_string.size());
+        write.WriteBytes(totalSize_t(value.m_string.size()), value.m_string.c_str());
+        break;
+    default:
+        write.Write<uint8_t>(uint8_t(CustomPacketStateType::NONE));
+        break;
+    }
+}
+
+static void WriteHeader(CustomPacketWrite& write, CustomPacketStateOwner owner, uint32_t channel)
+{
+    write.Write<uint8_t>(uint8_t(owner));
+    write.WriteVarint(channel);
+}
+
+void CustomPacketState::WriteDelta(CustomPacketWrite& write, CustomPacketStateOwner owner, uint32_t channel)
+{
+    WriteHeader(write, owner, channel);
+    write.Write<uint8_t>(0);
+    write.WriteVarint(m_dirty.size());
+    for (uint32_t field : m_dirty)
+    {
+        WriteField(write, field, m_fields[field]);
+    }
+}
+
+void CustomPacketState::WriteSnapshot(CustomPacketWrite& write, CustomPacketStateOwner owner, uint32_t channel)
+{
+    uint64_t count = 0;
+    for (Field& field : m_fields)
+    {
+        if (field.m_type != CustomPacketStateType::NONE)
+        {
+            ++count;
+        }
+    }
+
+    WriteHeader(write, owner, channel);
+    write.Write<uint8_t>(1);
+    write.WriteVarint(count);
+    for (uint32_t i = 0; i < m_fields.size(); ++i)
+    {
+        if (m_fields[i].m_type != CustomPacketStateType::NONE)
+        {
+            WriteField(write, i, m_fields[i]);
+        }
+    }
+}
+
+void CustomPacketState::WriteClear(CustomPacketWrite& write, CustomPacketStateOwner owner, uint32_t channel)
+{
+    WriteHeader(write, owner, channel);
+    write.Write<uint8_t>(1);
+    write.WriteVarint(0);
+}
+
+bool CustomPacketState::ReadChannel(CustomPacketRead* read, CustomPacketStateOwner& owner, uint32_t& channel)
+{
+    if (read->Remaining() == 0)
+    {
+        return false;
+    }
+    uint8_t ownerValue = read->Read<uint8_t>(0);
+    if (ownerValue > uint8_t(CustomPacketStateOwner::MAP))
+    {
+        return false;
+    }
+    owner = CustomPacketStateOwner(ownerValue);
+    uint64_t value = read->ReadVarint(UINT64_MAX);
+    if (value > UINT32_MAX)
+    {
+        return false;
+    }
+    channel = uint32_t(value);
+    return true;
+}
+
+bool CustomPacketState::Apply(
+      CustomPacketRead* read
+    , std::function<void(uint32_t)> onChange
+) {
+    if (read->Remaining() == 0)
+    {
+        return false;
+    }
+
+    if (read->Read<uint8_t>(0))
+    {
+        for (uint32_t i = 0; i < m_fields.size(); ++i)
+        {
+            if (m_fields[i].m_type != CustomPacketStateType::NONE)
+            {
+                Remove(i);
+                if (onChange) onChange(i);
+            }
+        }
+    }
+
+    uint64_t count = read->ReadVarint(UINT64_MAX);
+    if (count == UINT64_MAX)
+    {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint64_t field = read->ReadVarint(UINT64_MAX);
+        if (field >= MAX_STATE_FIELDS || read->Remaining() == 0)
+        {
+            return false;
+        }
+
+        switch (CustomPacketStateType(read->Read<uint8_t>(0)))
+        {
+        case CustomPacketStateType::NONE:
+            Remove(uint32_t(field));
+            break;
+        case CustomPacketStateType::DOUBLE:
+            if (read->Remaining() < sizeof(double))
+            {
+                return false;
+            }
+            SetNumber(uint32_t(field), read->Read<double>(0));
+            break;
+        case CustomPacketStateType::INTEGER:
+        {
+            uint64_t value = read->ReadVarint(UINT64_MAX);
+            if (value == UINT64_MAX)
+            {
+                return false;
+            }
+            SetNumber(uint32_t(field), double(unzigzag(value)));
+            break;
+        }
+        case CustomPacketStateType::STRING:
+        {
+            uint64_t size = read->ReadVarint(UINT64_MAX);
+            if (size > read->Remaining())
+            {
+                return false;
+            }
+            std::string str(size_t(size), '\0');
+            if (size > 0)
+            {
+                char* bytes = read->ReadBytes(totalSize_t(size));
+                str.assign(bytes, size_t(size));
+                delete[] bytes;
+            }
+            SetString(uint32_t(field), str);
+            break;
+        }
+        default:
+            return false;
+        }
+
+        if (onChange) onChange(uint32_t(field));
+    }
+
+    // the receiving side never sends its copy back
+    ClearDirty();
+    return true;
+}
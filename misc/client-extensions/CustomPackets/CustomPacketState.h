@@ -0,0 +1,84 @@
+#pragma once
+
+#include "CustomPacketDefines.h"
+#include "CustomPacketRead.h"
+#include "CustomPacketWrite.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Field ids are stored densely, so keep them small.
+constexpr uint32_t MAX_STATE_FIELDS = 4096;
+
+enum class CUSTOM_PACKET_API CustomPacketStateType : uint8_t {
+    NONE    = 0,
+    DOUBLE  = 1,
+    INTEGER = 2, // zigzag varint, used for integral numbers
+    STRING  = 3,
+};
+
+// What a state is attached to on the server. A channel can be used by a
+// player state and a map state at once, they are kept apart by this.
+enum class CUSTOM_PACKET_API CustomPacketStateOwner : uint8_t {
+    PLAYER = 0,
+    MAP    = 1,
+};
+
+// A set of numbered fields replicated from the server to the client over
+// STATE_OPCODE messages. The server side only sends fields that changed
+// since the last delta, new subscribers get a full snapshot instead.
+//
+// Message layout:
+//   [uint8 owner][varint channel][uint8 snapshot][varint count]
+//   count * [varint field][uint8 type][value]
+class CUSTOM_PACKET_API CustomPacketState {
+public:
+    CustomPacketState();
+
+    // Setters return false if the field id is out of range.
+    // Setting a field to its current value does not mark it as changed.
+    bool SetNumber(uint32_t field, double value);
+    bool SetString(uint32_t field, std::string const& value);
+    bool Remove(uint32_t field);
+
+    bool Has(uint32_t field);
+    CustomPacketStateType Type(uint32_t field);
+    double GetNumber(uint32_t field, double def = 0);
+    std::string GetString(uint32_t field, std::string const& def = "");
+
+    bool IsDirty();
+    void ClearDirty();
+
+    // Encodes the fields changed since the last ClearDirty
+    void WriteDelta(CustomPacketWrite& write, CustomPacketStateOwner owner, uint32_t channel);
+    // Encodes every field, the receiver clears its copy before applying it
+    void WriteSnapshot(CustomPacketWrite& write, CustomPacketStateOwner owner, uint32_t channel);
+    // Encodes an empty snapshot, for receivers that no longer see a state
+    static void WriteClear(CustomPacketWrite& write, CustomPacketStateOwner owner, uint32_t channel);
+
+    // Reads the owner and channel of a STATE_OPCODE message,
+    // call Apply on the matching state afterwards.
+    static bool ReadChannel(CustomPacketRead* read, CustomPacketStateOwner& owner, uint32_t& channel);
+
+    // Applies a delta or snapshot. "onChange" is called for every field
+    // that was written. Returns false if the message is malformed,
+    // fields before the malformed entry have already been applied.
+    bool Apply(
+          CustomPacketRead* read
+        , std::function<void(uint32_t)> onChange = nullptr
+    );
+private:
+    struct Field {
+        CustomPacketStateType m_type = CustomPacketStateType::NONE;
+        bool m_dirty = false;
+        double m_number = 0;
+        std::string m_string;
+    };
+    Field* GetField(uint32_t field, bool create);
+    void MarkDirty(uint32_t field, Field& value);
+    void WriteField(CustomPacketWrite& write, uint32_t field, Field& value);
+
+    std::vector<Field> m_fields;
+    std::vector<uint32_t> m_dirty;
+};
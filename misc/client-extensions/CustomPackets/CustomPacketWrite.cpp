@@ -1,5 +1,7 @@
 #include "CustomPacketWrite.h"
 
+#include <cstring>
+
 CustomPacketWrite::CustomPacketWrite(
       opcode_t opcode
     , chunkSize_t chunkSize
@@ -70,6 +72,17 @@ CustomPacketWrite* CustomPacketWrite::WriteStringNullTerm(
     return WriteStringNullTerm(chr, strlen(chr));
 }
 
+CustomPacketWrite* CustomPacketWrite::WriteVarint(uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        Write<uint8_t>(uint8_t(value) | 0x80);
+        value >>= 7;
+    }
+    Write<uint8_t>(uint8_t(value));
+    return this;
+}
+
 CustomPacketWrite* CustomPacketWrite::WriteBytes(totalSize_t size, char const* bytes)
 {
     CustomPacketBase::WriteBytes(size, bytes);
@@ -50,6 +50,9 @@ public:
         , totalSize_t length
     );
 
+    // LEB128, 1 byte for values < 128
+    CustomPacketWrite* WriteVarint(uint64_t value);
+
     template <typename T>
     CustomPacketWrite* Write(T value)
     {
@@ -0,0 +1,451 @@
+// Standalone microbenchmarks for the CustomPackets library.
+//
+// Emits one JSON object per line (JSON Lines) to stdout so results can be
+// collected by scripts and compared between builds:
+//
+//   {"suite":"fields","name":"uint32","iterations":...,"ns_per_op":...,...}
+//
+// Usage: benchmarks [--filter <substring>] [--min-time-ms <ms>]
+
+#include "CustomPacketWrite.h"
+#include "CustomPacketRead.h"
+#include "CustomPacketBase.h"
+#include "CustomPacketBuffer.h"
+#include "CustomPacketBatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Values written per iteration in the field benchmarks
+#define FIELD_COUNT 4096
+#define DEFAULT_MIN_TIME_MS 200
+
+static std::string filter = "";
+static uint64_t minTimeNs = uint64_t(DEFAULT_MIN_TIME_MS) * 1000000;
+
+// keeps the optimizer from removing reads
+static volatile uint64_t sink = 0;
+
+struct BenchmarkResult {
+    uint64_t iterations = 0;
+    uint64_t totalNs = 0;
+    // payload bytes moved by a single iteration
+    uint64_t bytes = 0;
+    // fields/messages processed by a single iteration
+    uint64_t ops = 0;
+    // anything the benchmark wants reported that isn't timing
+    std::vector<std::pair<std::string, uint64_t>> counters;
+};
+
+static uint64_t nowNs()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count());
+}
+
+static void report(
+      std::string const& suite
+    , std::string const& name
+    , BenchmarkResult const& res
+) {
+    double seconds = double(res.totalNs) / 1e9;
+    double totalOps = double(res.iterations) * double(res.ops);
+    double totalBytes = double(res.iterations) * double(res.bytes);
+    std::cout
+        << "{\"suite\":\"" << suite << "\""
+        << ",\"name\":\"" << name << "\""
+        << ",\"iterations\":" << res.iterations
+        << ",\"ops_per_iteration\":" << res.ops
+        << ",\"bytes_per_iteration\":" << res.bytes
+        << ",\"ns_per_iteration\":" << (double(res.totalNs) / double(res.iterations))
+        << ",\"ns_per_op\":" << (double(res.totalNs) / totalOps)
+        << ",\"mb_per_s\":" << (totalBytes / (1024.0 * 1024.0) / seconds);
+    for (auto const& [key, value] : res.counters)
+    {
+        std::cout << ",\"" << key << "\":" << value;
+    }
+    std::cout << "}\n" << std::flush;
+}
+
+/**
+ * Runs "iteration" until at least minTimeNs has elapsed.
+ * "iteration" returns the number of nanoseconds it wants counted, so
+ * benchmarks can exclude setup/teardown from the measurement.
+ */
+static void run(
+      std::string const& suite
+    , std::string const& name
+    , uint64_t bytes
+    , uint64_t ops
+    , std::function<uint64_t()> iteration
+    , std::function<void(BenchmarkResult&)> finish = nullptr
+) {
+    std::string full = suite + "/" + name;
+    if (filter.size() > 0 && full.find(filter) == std::string::npos)
+    {
+        return;
+    }
+
+    // warmup
+    iteration();
+
+    BenchmarkResult res;
+    res.bytes = bytes;
+    res.ops = ops;
+    uint64_t start = nowNs();
+    while (nowNs() - start < minTimeNs)
+    {
+        res.totalNs += iteration();
+        ++res.iterations;
+    }
+    if (finish)
+    {
+        finish(res);
+    }
+    report(suite, name, res);
+}
+
+// - Field read/write throughput -
+
+template <typename T>
+static void benchField(std::string const& name)
+{
+    run("fields", "write_" + name, FIELD_COUNT * sizeof(T), FIELD_COUNT, []() {
+        CustomPacketWrite write(0, MAX_FRAGMENT_SIZE, 0);
+        uint64_t start = nowNs();
+        for (uint32_t i = 0; i < FIELD_COUNT; ++i)
+        {
+            write.Write<T>(T(i));
+        }
+        uint64_t time = nowNs() - start;
+        sink += write.Size();
+        write.Destroy();
+        return time;
+    });
+
+    CustomPacketWrite source(0, MAX_FRAGMENT_SIZE, 0);
+    for (uint32_t i = 0; i < FIELD_COUNT; ++i)
+    {
+        source.Write<T>(T(i));
+    }
+    run("fields", "read_" + name, FIELD_COUNT * sizeof(T), FIELD_COUNT, [&]() {
+        CustomPacketRead read(source);
+        uint64_t start = nowNs();
+        for (uint32_t i = 0; i < FIELD_COUNT; ++i)
+        {
+            sink += uint64_t(read.Read<T>(T(0)));
+        }
+        return nowNs() - start;
+    });
+    source.Destroy();
+}
+
+static void benchStrings(std::string const& name, size_t length)
+{
+    std::string str(length, 'a');
+    uint64_t bytes = FIELD_COUNT * (length + sizeof(totalSize_t));
+    run("fields", "write_" + name, bytes, FIELD_COUNT, [&]() {
+        CustomPacketWrite write(0, MAX_FRAGMENT_SIZE, 0);
+        uint64_t start = nowNs();
+        for (uint32_t i = 0; i < FIELD_COUNT; ++i)
+        {
+            write.WriteString(str);
+        }
+        uint64_t time = nowNs() - start;
+        sink += write.Size();
+        write.Destroy();
+        return time;
+    });
+
+    CustomPacketWrite source(0, MAX_FRAGMENT_SIZE, 0);
+    for (uint32_t i = 0; i < FIELD_COUNT; ++i)
+    {
+        source.WriteString(str);
+    }
+    run("fields", "read_" + name, bytes, FIELD_COUNT, [&]() {
+        CustomPacketRead read(source);
+        uint64_t start = nowNs();
+        for (uint32_t i = 0; i < FIELD_COUNT; ++i)
+        {
+            sink += read.ReadString().size();
+        }
+        return nowNs() - start;
+    });
+    source.Destroy();
+}
+
+// - Fragmentation and reassembly -
+
+class CountingBuffer : public CustomPacketBuffer {
+public:
+    CountingBuffer()
+        : CustomPacketBuffer(MIN_FRAGMENT_SIZE, BUFFER_QUOTA, MAX_FRAGMENT_SIZE)
+    {}
+    uint64_t m_messages = 0;
+    uint64_t m_errors = 0;
+protected:
+    void OnPacket(CustomPacketRead* value) override
+    {
+        sink += value->Size();
+        ++m_messages;
+    }
+
+    void OnError(CustomPacketResult) override
+    {
+        ++m_errors;
+    }
+};
+
+static void fillPayload(CustomPacketWrite& write, totalSize_t size)
+{
+    static std::vector<char> payload;
+    if (payload.size() < size)
+    {
+        payload.resize(size, 'x');
+    }
+    write.WriteBytes(size, payload.data());
+}
+
+static void benchFragmentation(std::string const& name, totalSize_t size)
+{
+    // writing the payload and splitting it into fragments
+    run("fragmentation", "build_" + name, size, 1, [=]() {
+        uint64_t start = nowNs();
+        CustomPacketWrite write(1, MAX_FRAGMENT_SIZE, 0);
+        fillPayload(write, size);
+        sink += write.buildMessages().size();
+        uint64_t time = nowNs() - start;
+        write.Destroy();
+        return time;
+    });
+
+    // receiving the fragments and handing the complete message out
+    CountingBuffer buffer;
+    run("fragmentation", "reassemble_" + name, size, 1, [&]() {
+        CustomPacketWrite write(1, MAX_FRAGMENT_SIZE, 0);
+        fillPayload(write, size);
+        std::vector<CustomPacketChunk>& chunks = write.buildMessages();
+        uint64_t start = nowNs();
+        for (CustomPacketChunk& chunk : chunks)
+        {
+            buffer.ReceivePacket(chunk.FullSize(), chunk.Data());
+        }
+        uint64_t time = nowNs() - start;
+        // the buffer only frees the fragments it copied
+        write.Destroy();
+        return time;
+    }, [&](BenchmarkResult& res) {
+        CustomPacketWrite write(1, MAX_FRAGMENT_SIZE, 0);
+        fillPayload(write, size);
+        res.counters.push_back({ "fragments", write.buildMessages().size() });
+        res.counters.push_back({ "errors", buffer.m_errors });
+        write.Destroy();
+    });
+}
+
+// - Multi-opcode reassembly -
+
+// Size of a message that needs one full fragment plus a single byte,
+// the worst ratio of reassembly bookkeeping to payload.
+constexpr totalSize_t WORST_CASE_MESSAGE = totalSize_t(MAX_FRAGMENT_SIZE - CustomHeaderSize) + 1;
+constexpr uint32_t OPCODE_COUNT = 64;
+
+static std::vector<CustomPacketWrite> buildOpcodeMessages()
+{
+    std::vector<CustomPacketWrite> writes;
+    writes.reserve(OPCODE_COUNT);
+    for (opcode_t opcode = 0; opcode < OPCODE_COUNT; ++opcode)
+    {
+        writes.emplace_back(opcode, MAX_FRAGMENT_SIZE, 0);
+        fillPayload(writes.back(), WORST_CASE_MESSAGE);
+        writes.back().buildMessages();
+    }
+    return writes;
+}
+
+static void benchMultiOpcode()
+{
+    uint64_t bytes = uint64_t(OPCODE_COUNT) * WORST_CASE_MESSAGE;
+
+    // every message arrives in order, one opcode after another
+    CountingBuffer sequential;
+    run("multi_opcode", "sequential", bytes, OPCODE_COUNT, [&]() {
+        std::vector<CustomPacketWrite> writes = buildOpcodeMessages();
+        uint64_t start = nowNs();
+        for (CustomPacketWrite& write : writes)
+        {
+            for (chunkCount_t i = 0; i < write.ChunkCount(); ++i)
+            {
+                CustomPacketChunk* chunk = write.Chunk(i);
+                sequential.ReceivePacket(chunk->FullSize(), chunk->Data());
+            }
+        }
+        uint64_t time = nowNs() - start;
+        for (CustomPacketWrite& write : writes)
+        {
+            write.Destroy();
+        }
+        return time;
+    }, [&](BenchmarkResult& res) {
+        res.counters.push_back({ "messages", sequential.m_messages });
+        res.counters.push_back({ "errors", sequential.m_errors });
+    });
+
+    // fragments of all opcodes arrive round-robin. A buffer only reassembles
+    // one message at a time, so every opcode gets its own buffer, which is
+    // the worst case for the cache: each fragment lands in a different one.
+    std::vector<CountingBuffer> interleaved(OPCODE_COUNT);
+    run("multi_opcode", "interleaved", bytes, OPCODE_COUNT, [&]() {
+        std::vector<CustomPacketWrite> writes = buildOpcodeMessages();
+        chunkCount_t maxChunks = 0;
+        for (CustomPacketWrite& write : writes)
+        {
+            maxChunks = std::max(maxChunks, write.ChunkCount());
+        }
+
+        uint64_t start = nowNs();
+        for (chunkCount_t i = 0; i < maxChunks; ++i)
+        {
+            for (uint32_t opcode = 0; opcode < OPCODE_COUNT; ++opcode)
+            {
+                CustomPacketWrite& write = writes[opcode];
+                if (i >= write.ChunkCount())
+                {
+                    continue;
+                }
+                CustomPacketChunk* chunk = write.Chunk(i);
+                interleaved[opcode].ReceivePacket(chunk->FullSize(), chunk->Data());
+            }
+        }
+        uint64_t time = nowNs() - start;
+        for (CustomPacketWrite& write : writes)
+        {
+            write.Destroy();
+        }
+        return time;
+    }, [&](BenchmarkResult& res) {
+        uint64_t messages = 0;
+        uint64_t errors = 0;
+        for (CountingBuffer const& buffer : interleaved)
+        {
+            messages += buffer.m_messages;
+            errors += buffer.m_errors;
+        }
+        res.counters.push_back({ "messages", messages });
+        res.counters.push_back({ "errors", errors });
+    });
+}
+
+// - Send batching -
+
+static void benchBatching(std::string const& name, uint32_t count, totalSize_t size)
+{
+    std::vector<CustomPacketWrite> writes;
+    writes.reserve(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        writes.emplace_back(opcode_t(i), MAX_FRAGMENT_SIZE, 0);
+        fillPayload(writes.back(), size);
+    }
+
+    run("batching", "pack_" + name, uint64_t(count) * size, count, [&]() {
+        uint64_t start = nowNs();
+        CustomPacketBatch batch;
+        for (CustomPacketWrite& write : writes)
+        {
+            if (!batch.Add(write))
+            {
+                batch.Container().Destroy();
+                batch = CustomPacketBatch();
+                batch.Add(write);
+            }
+        }
+        sink += batch.Container().buildMessages().size();
+        uint64_t time = nowNs() - start;
+        batch.Container().Destroy();
+        return time;
+    });
+
+    CustomPacketBatch batch;
+    for (CustomPacketWrite& write : writes)
+    {
+        batch.Add(write);
+    }
+    CountingBuffer buffer;
+    run("batching", "receive_" + name, uint64_t(count) * size, count, [&]() {
+        std::vector<CustomPacketChunk>& chunks = batch.Container().buildMessages();
+        uint64_t start = nowNs();
+        for (CustomPacketChunk& chunk : chunks)
+        {
+            buffer.ReceivePacket(chunk.FullSize(), chunk.Data());
+        }
+        return nowNs() - start;
+    });
+
+    // unpacking happens in the client OnPacket handler
+    run("batching", "unpack_" + name, uint64_t(count) * size, count, [&]() {
+        CustomPacketRead read(batch.Container());
+        uint64_t start = nowNs();
+        CustomPacketBatch::Unpack(&read, [](CustomPacketRead* inner) {
+            sink += inner->Size();
+        });
+        return nowNs() - start;
+    }, [&](BenchmarkResult& res) {
+        res.counters.push_back({ "messages", batch.Count() });
+        res.counters.push_back({ "container_bytes", batch.Container().Size() });
+    });
+
+    batch.Container().Destroy();
+    for (CustomPacketWrite& write : writes)
+    {
+        write.Destroy();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else if (arg == "--min-time-ms" && i + 1 < argc)
+        {
+            minTimeNs = std::strtoull(argv[++i], nullptr, 10) * 1000000;
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--filter <substring>] [--min-time-ms <ms>]\n";
+            return 1;
+        }
+    }
+
+    benchField<uint8_t>("uint8");
+    benchField<uint16_t>("uint16");
+    benchField<uint32_t>("uint32");
+    benchField<uint64_t>("uint64");
+    benchField<float>("float");
+    benchField<double>("double");
+    benchStrings("string16", 16);
+    benchStrings("string256", 256);
+
+    benchFragmentation("1kb", 1024);
+    benchFragmentation("30kb", 30 * 1024);
+    benchFragmentation("1mb", 1024 * 1024);
+
+    benchMultiOpcode();
+
+    benchBatching("64x32b", 64, 32);
+    benchBatching("16x1kb", 16, 1024);
+    return 0;
+}
@@ -0,0 +1,155 @@
+// Headless replay of packet logs written by the server packet recorder
+// (see CustomPacketLog.h).
+//
+// Custom packets are fragmented the same way the server sends them and fed
+// back through CustomPacketBuffer, so reassembly cost and correctness can be
+// checked without a running server. Nothing is dispatched to handlers or
+// events here, handler timings against real scripts come from the
+// server-side replay (ReplayPacketCapture).
+//
+// Emits one JSON object per line:
+//   {"kind":"custom","opcode":...,"count":...,"bytes":...,"ns":...}
+//   {"kind":"summary","ticks":...,"world_packets":...,"events":...,"errors":...}
+//
+// Usage: packet-replay <log file>
+
+#include "CustomPacketLog.h"
+#include "CustomPacketBuffer.h"
+#include "CustomPacketWrite.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+
+struct OpcodeTiming {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+    uint64_t ns = 0;
+};
+
+class ReplayBuffer : public CustomPacketBuffer {
+public:
+    ReplayBuffer()
+        : CustomPacketBuffer(MIN_FRAGMENT_SIZE, BUFFER_QUOTA, MAX_FRAGMENT_SIZE)
+    {}
+    std::string m_expected;
+    uint64_t m_messages = 0;
+    uint64_t m_errors = 0;
+protected:
+    void OnPacket(CustomPacketRead* value) override
+    {
+        m_messages++;
+        totalSize_t size = value->Size();
+        char* bytes = value->ReadBytes(size);
+        if (size != m_expected.size() || (size > 0 && (!bytes || memcmp(bytes, m_expected.data(), size) != 0)))
+        {
+            m_errors++;
+        }
+        delete[] bytes;
+    }
+
+    void OnError(CustomPacketResult) override
+    {
+        m_errors++;
+    }
+};
+
+static uint64_t nowNs()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count());
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: packet-replay <log file>\n";
+        return 1;
+    }
+
+    std::ifstream file(argv[1], std::ios::binary);
+    CustomPacketLogReader reader(file);
+    if (!reader.IsValid())
+    {
+        std::cerr << argv[1] << " is not a packet log\n";
+        return 1;
+    }
+
+    std::map<uint64_t, std::unique_ptr<ReplayBuffer>> sessions;
+    std::map<uint32_t, OpcodeTiming> timings;
+    uint64_t ticks = 0;
+    uint64_t worldPackets = 0;
+    uint64_t events = 0;
+
+    CustomPacketLogRecord record;
+    while (reader.Next(record))
+    {
+        switch (record.m_kind)
+        {
+        case CustomPacketLogKind::TICK:
+            ticks++;
+            break;
+        case CustomPacketLogKind::WORLD_PACKET:
+            worldPackets++;
+            break;
+        case CustomPacketLogKind::EVENT:
+            events++;
+            break;
+        case CustomPacketLogKind::CUSTOM_PACKET: {
+            std::unique_ptr<ReplayBuffer>& buffer = sessions[record.m_session];
+            if (!buffer)
+            {
+                buffer = std::make_unique<ReplayBuffer>();
+            }
+            buffer->m_expected = record.m_data;
+
+            CustomPacketWrite write(opcode_t(record.m_opcode), MAX_FRAGMENT_SIZE, 0);
+            write.WriteBytes(totalSize_t(record.m_data.size()), record.m_data.data());
+            std::vector<CustomPacketChunk>& chunks = write.buildMessages();
+
+            uint64_t start = nowNs();
+            for (CustomPacketChunk& chunk : chunks)
+            {
+                buffer->ReceivePacket(chunk.FullSize(), chunk.Data());
+            }
+            OpcodeTiming& timing = timings[record.m_opcode];
+            timing.ns += nowNs() - start;
+            timing.count++;
+            timing.bytes += record.m_data.size();
+            write.Destroy();
+            break;
+        }
+        }
+    }
+
+    uint64_t errors = 0;
+    for (auto const& [session, buffer] : sessions)
+    {
+        errors += buffer->m_errors;
+    }
+
+    for (auto const& [opcode, timing] : timings)
+    {
+        std::cout
+            << "{\"kind\":\"custom\""
+            << ",\"opcode\":" << opcode
+            << ",\"count\":" << timing.count
+            << ",\"bytes\":" << timing.bytes
+            << ",\"ns\":" << timing.ns
+            << "}\n";
+    }
+    std::cout
+        << "{\"kind\":\"summary\""
+        << ",\"ticks\":" << ticks
+        << ",\"world_packets\":" << worldPackets
+        << ",\"events\":" << events
+        << ",\"sessions\":" << sessions.size()
+        << ",\"errors\":" << errors
+        << "}\n";
+    return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,822 @@
+// Standalone microbenchmarks for the core-independent parts of tswow-core.
+//
+// Emits one JSON object per line (JSON Lines) to stdout, like benchmarks:
+//
+//   {"suite":"los","name":"1024/pool","threads":...,"ns_per_op":...,...}
+//   {"suite":"mailbox","name":"mpsc/4","threads":...,"messages_per_sec":...,...}
+//   {"suite":"luaalloc","name":"pooled","ns_per_op":...,...}
+//   {"suite":"luauserdata","name":"cached","ns_per_op":...,"gc_ns_per_op":...,...}
+//   {"suite":"luajson","name":"decode/direct","ns_per_op":...,"bytes_per_op":...,...}
+//
+// Usage: server-benchmarks [--filter <substring>] [--min-time-ms <ms>] [--threads <n>]
+
+#include "TSWorkerPool.h"
+#include "TSBitset.h"
+#include "TSMPSCQueue.h"
+#include "TSLuaAllocator.h"
+
+extern "C" {
+#include "lua.h"
+#include "lauxlib.h"
+#include "lualib.h"
+}
+
+#include "TSLuaJson.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define DEFAULT_MIN_TIME_MS 200
+
+static std::string filter = "";
+static uint64_t minTimeNs = uint64_t(DEFAULT_MIN_TIME_MS) * 1000000;
+static uint32_t threads = 0;
+
+static uint64_t nowNs()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count());
+}
+
+static bool matches(std::string const& suite, std::string const& name)
+{
+    return filter.size() == 0 || (suite + "/" + name).find(filter) != std::string::npos;
+}
+
+// deterministic generator so every run uses the same geometry
+struct Lcg
+{
+    uint32_t m_state;
+    float Range(float min, float max)
+    {
+        m_state = m_state * 1664525u + 1013904223u;
+        return min + (max - min) * float(m_state >> 8) / float(1 << 24);
+    }
+};
+
+struct Box
+{
+    float min[3];
+    float max[3];
+};
+
+struct Ray
+{
+    float from[3];
+    float to[3];
+};
+
+// Synthetic stand-in for vmap geometry: a field of boxes that
+// rays are tested against one by one, roughly the cost of a vmap ray.
+struct SyntheticGeometry
+{
+    std::vector<Box> m_boxes;
+
+    SyntheticGeometry(uint32_t count, Lcg& rng)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            float x = rng.Range(0, 1000);
+            float y = rng.Range(0, 1000);
+            float size = rng.Range(2, 20);
+            m_boxes.push_back({ { x, y, 0 }, { x + size, y + size, rng.Range(2, 30) } });
+        }
+    }
+
+    // slab test of the segment against every box
+    bool IsInLineOfSight(Ray const& ray) const
+    {
+        float dir[3] = { ray.to[0] - ray.from[0], ray.to[1] - ray.from[1], ray.to[2] - ray.from[2] };
+        for (Box const& box : m_boxes)
+        {
+            float tmin = 0;
+            float tmax = 1;
+            bool miss = false;
+            for (int axis = 0; axis < 3 && !miss; ++axis)
+            {
+                if (dir[axis] == 0)
+                {
+                    miss = ray.from[axis] < box.min[axis] || ray.from[axis] > box.max[axis];
+                    continue;
+                }
+                float t1 = (box.min[axis] - ray.from[axis]) / dir[axis];
+                float t2 = (box.max[axis] - ray.from[axis]) / dir[axis];
+                tmin = std::max(tmin, std::min(t1, t2));
+                tmax = std::min(tmax, std::max(t1, t2));
+                miss = tmin > tmax;
+            }
+            if (!miss)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+static void reportLos(std::string const& name, uint32_t rays, uint32_t poolThreads, uint64_t iterations, uint64_t totalNs, uint32_t visible, uint32_t mismatches)
+{
+    std::cout
+        << "{\"suite\":\"los\""
+        << ",\"name\":\"" << name << "\""
+        << ",\"threads\":" << poolThreads
+        << ",\"iterations\":" << iterations
+        << ",\"ops_per_iteration\":" << rays
+        << ",\"ns_per_iteration\":" << (double(totalNs) / double(iterations))
+        << ",\"ns_per_op\":" << (double(totalNs) / double(iterations) / double(rays))
+        << ",\"visible\":" << visible
+        << ",\"mismatches\":" << mismatches
+        << "}\n" << std::flush;
+}
+
+// Same rays evaluated one by one on the calling thread and as a batch on
+// the pool, the way TSMap::IsInLineOfSightBatch uses ParallelBitset.
+static void benchLineOfSight(uint32_t rayCount)
+{
+    Lcg rng{ 42 };
+    SyntheticGeometry geometry(512, rng);
+    std::vector<Ray> rays;
+    for (uint32_t i = 0; i < rayCount; ++i)
+    {
+        float x = rng.Range(0, 1000);
+        float y = rng.Range(0, 1000);
+        rays.push_back({ { x, y, 2 }, { x + rng.Range(-60, 60), y + rng.Range(-60, 60), rng.Range(0, 10) } });
+    }
+    auto predicate = [&](uint32_t i) { return geometry.IsInLineOfSight(rays[i]); };
+
+    TSWorkerPool serial(0);
+    TSBitset expected = ParallelBitset(serial, rayCount, predicate);
+
+    TSWorkerPool pool(threads);
+    for (TSWorkerPool* target : { &serial, &pool })
+    {
+        std::string name = std::to_string(rayCount) + (target == &serial ? "/serial" : "/pool");
+        if (!matches("los", name))
+        {
+            continue;
+        }
+        uint64_t iterations = 0;
+        uint64_t totalNs = 0;
+        uint32_t mismatches = 0;
+        TSBitset result;
+        while (totalNs < minTimeNs)
+        {
+            uint64_t start = nowNs();
+            result = ParallelBitset(*target, rayCount, predicate);
+            totalNs += nowNs() - start;
+            ++iterations;
+        }
+        for (uint32_t i = 0; i < rayCount; ++i)
+        {
+            mismatches += result.Get(i) != expected.Get(i);
+        }
+        reportLos(name, rayCount, target->GetThreadCount(), iterations, totalNs, result.Count(), mismatches);
+    }
+}
+
+// The mutex + vector pair map delay queues used to be, drained by swapping
+struct LockedQueue
+{
+    std::mutex m_lock;
+    std::vector<std::function<void(uint64_t&)>> m_items;
+
+    void Push(std::function<void(uint64_t&)> value)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_items.push_back(std::move(value));
+    }
+
+    template <typename F>
+    size_t Drain(F callback)
+    {
+        std::vector<std::function<void(uint64_t&)>> items;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            items.swap(m_items);
+        }
+        for (auto& item : items)
+        {
+            callback(std::move(item));
+        }
+        return items.size();
+    }
+};
+
+// `producers` threads post closures to one consumer thread that drains
+// while they post, like map threads posting to the world thread.
+template <typename Queue>
+static void benchMailbox(std::string const& type, uint32_t producers)
+{
+    std::string name = type + "/" + std::to_string(producers);
+    if (!matches("mailbox", name))
+    {
+        return;
+    }
+    uint32_t const perProducer = 16384;
+    uint64_t const total = uint64_t(perProducer) * producers;
+    uint64_t iterations = 0;
+    uint64_t totalNs = 0;
+    uint64_t lost = 0;
+    while (totalNs < minTimeNs)
+    {
+        Queue queue;
+        uint64_t sum = 0;
+        uint64_t start = nowNs();
+        std::vector<std::thread> threads;
+        for (uint32_t p = 0; p < producers; ++p)
+        {
+            threads.emplace_back([&queue, p, perProducer]() {
+                for (uint32_t i = 0; i < perProducer; ++i)
+                {
+                    uint64_t value = uint64_t(p) * perProducer + i;
+                    queue.Push([value](uint64_t& out) { out += value; });
+                }
+            });
+        }
+        uint64_t received = 0;
+        while (received < total)
+        {
+            size_t count = queue.Drain([&](std::function<void(uint64_t&)>&& callback) { callback(sum); });
+            if (count == 0)
+            {
+                std::this_thread::yield();
+            }
+            received += count;
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        totalNs += nowNs() - start;
+        ++iterations;
+        lost += sum != total * (total - 1) / 2;
+    }
+
+    std::cout
+        << "{\"suite\":\"mailbox\""
+        << ",\"name\":\"" << name << "\""
+        << ",\"threads\":" << producers
+        << ",\"iterations\":" << iterations
+        << ",\"ops_per_iteration\":" << total
+        << ",\"ns_per_iteration\":" << (double(totalNs) / double(iterations))
+        << ",\"ns_per_op\":" << (double(totalNs) / double(iterations) / double(total))
+        << ",\"messages_per_sec\":" << (double(total) * double(iterations) * 1e9 / double(totalNs))
+        << ",\"mismatches\":" << lost
+        << "}\n" << std::flush;
+}
+
+// Table and string churn, like event callbacks building small tables.
+// "default" is lua's own allocator, "tracked" only adds module accounting.
+static void benchLuaAlloc(std::string const& name)
+{
+    if (!matches("luaalloc", name))
+    {
+        return;
+    }
+    uint32_t const tables = 100000;
+    TSLuaAllocator allocator(name == "pooled");
+    lua_State* L = name == "default"
+        ? luaL_newstate()
+        : lua_newstate(TSLuaAllocator::Alloc, &allocator);
+    luaL_openlibs(L);
+    TSLuaMemory::SetCurrentModule(TSLuaMemory::ModuleId("bench"));
+    luaL_loadstring(L,
+        "local n = ...\n"
+        "local keep = {}\n"
+        "for i = 1, n do\n"
+        "  local t = { i, i * 2, name = 'x' .. (i % 64) }\n"
+        "  if i % 16 == 0 then keep[#keep + 1] = t end\n"
+        "end\n"
+    );
+    int chunk = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    uint64_t iterations = 0;
+    uint64_t totalNs = 0;
+    uint64_t errors = 0;
+    while (totalNs < minTimeNs)
+    {
+        lua_rawgeti(L, LUA_REGISTRYINDEX, chunk);
+        lua_pushinteger(L, tables);
+        uint64_t start = nowNs();
+        errors += lua_pcall(L, 1, 0, 0) != 0;
+        lua_gc(L, LUA_GCCOLLECT, 0);
+        totalNs += nowNs() - start;
+        lua_settop(L, 0);
+        ++iterations;
+    }
+    lua_close(L);
+    TSLuaMemory::SetCurrentModule(0);
+
+    std::cout
+        << "{\"suite\":\"luaalloc\""
+        << ",\"name\":\"" << name << "\""
+        << ",\"threads\":1"
+        << ",\"iterations\":" << iterations
+        << ",\"ops_per_iteration\":" << tables
+        << ",\"ns_per_iteration\":" << (double(totalNs) / double(iterations))
+        << ",\"ns_per_op\":" << (double(totalNs) / double(iterations) / double(tables))
+        << ",\"mismatches\":" << errors
+        << "}\n" << std::flush;
+}
+
+// A combat storm: every event passes an attacker, a victim and a mutable
+// damage number to lua, like Unit.OnDamage. "fresh" makes new userdata for
+// every argument, "cached" reuses one userdata per entity and recycles the
+// damage userdata once the callback returns, like TSLuaUserdata.h.
+// The gc is stopped and a full cycle is run (and timed separately) every tick.
+static void benchLuaUserdata(std::string const& name)
+{
+    if (!matches("luauserdata", name))
+    {
+        return;
+    }
+    uint32_t const entities = 256;
+    uint32_t const eventsPerTick = 4096;
+    bool const cached = name == "cached";
+
+    lua_State* L = luaL_newstate();
+    luaL_openlibs(L);
+    lua_gc(L, LUA_GCSTOP, 0);
+    luaL_newmetatable(L, "Wrapper");
+    lua_pushcfunction(L, [](lua_State* L) {
+        lua_pushinteger(L, lua_Integer(**static_cast<uint64_t**>(lua_touserdata(L, 1))));
+        return 1;
+    });
+    lua_setfield(L, -2, "__len");
+    lua_pop(L, 1);
+    luaL_loadstring(L,
+        "return function(attacker, victim, damage)\n"
+        "  return #attacker + #victim + #damage\n"
+        "end\n"
+    );
+    lua_call(L, 0, 1);
+    int handler = luaL_ref(L, LUA_REGISTRYINDEX);
+
+    std::vector<uint64_t> ids(entities);
+    for (uint32_t i = 0; i < entities; ++i)
+    {
+        ids[i] = i;
+    }
+    std::vector<int> entityRefs(entities, LUA_NOREF);
+    std::vector<std::pair<int, uint64_t**>> freeDamage;
+    std::vector<std::pair<int, uint64_t**>> usedDamage;
+
+    auto pushNew = [&](uint64_t* value) {
+        uint64_t** data = static_cast<uint64_t**>(lua_newuserdata(L, sizeof(uint64_t*)));
+        *data = value;
+        luaL_getmetatable(L, "Wrapper");
+        lua_setmetatable(L, -2);
+        return data;
+    };
+    auto pushEntity = [&](uint32_t index) {
+        if (!cached)
+        {
+            pushNew(&ids[index]);
+            return;
+        }
+        if (entityRefs[index] != LUA_NOREF)
+        {
+            lua_rawgeti(L, LUA_REGISTRYINDEX, entityRefs[index]);
+            return;
+        }
+        pushNew(&ids[index]);
+        lua_pushvalue(L, -1);
+        entityRefs[index] = luaL_ref(L, LUA_REGISTRYINDEX);
+    };
+    auto pushDamage = [&](uint64_t* damage) {
+        if (!cached)
+        {
+            pushNew(damage);
+            return;
+        }
+        if (!freeDamage.empty())
+        {
+            auto entry = freeDamage.back();
+            freeDamage.pop_back();
+            *entry.second = damage;
+            usedDamage.push_back(entry);
+            lua_rawgeti(L, LUA_REGISTRYINDEX, entry.first);
+            return;
+        }
+        uint64_t** data = pushNew(damage);
+        lua_pushvalue(L, -1);
+        usedDamage.push_back({ luaL_ref(L, LUA_REGISTRYINDEX), data });
+    };
+
+    uint64_t iterations = 0;
+    uint64_t totalNs = 0;
+    uint64_t gcNs = 0;
+    uint64_t errors = 0;
+    uint64_t expected = 0;
+    uint64_t sum = 0;
+    uint32_t seed = 1;
+    while (totalNs < minTimeNs)
+    {
+        uint64_t start = nowNs();
+        for (uint32_t i = 0; i < eventsPerTick; ++i)
+        {
+            seed = seed * 1664525 + 1013904223;
+            uint32_t attacker = (seed >> 8) % entities;
+            uint32_t victim = (seed >> 16) % entities;
+            uint64_t damage = seed & 0xff;
+            lua_rawgeti(L, LUA_REGISTRYINDEX, handler);
+            pushEntity(attacker);
+            pushEntity(victim);
+            pushDamage(&damage);
+            if (lua_pcall(L, 3, 1, 0) != 0)
+            {
+                ++errors;
+            }
+            else
+            {
+                sum += uint64_t(lua_tointeger(L, -1));
+            }
+            lua_pop(L, 1);
+            expected += attacker + victim + damage;
+            // the outermost callback returned
+            freeDamage.insert(freeDamage.end(), usedDamage.begin(), usedDamage.end());
+            usedDamage.clear();
+        }
+        uint64_t gcStart = nowNs();
+        lua_gc(L, LUA_GCCOLLECT, 0);
+        uint64_t end = nowNs();
+        // a full cycle restarts the collector
+        lua_gc(L, LUA_GCSTOP, 0);
+        gcNs += end - gcStart;
+        totalNs += end - start;
+        ++iterations;
+    }
+    lua_close(L);
+
+    double ops = double(iterations) * double(eventsPerTick);
+    std::cout
+        << "{\"suite\":\"luauserdata\""
+        << ",\"name\":\"" << name << "\""
+        << ",\"threads\":1"
+        << ",\"iterations\":" << iterations
+        << ",\"ops_per_iteration\":" << eventsPerTick
+        << ",\"ns_per_iteration\":" << (double(totalNs) / double(iterations))
+        << ",\"ns_per_op\":" << (double(totalNs) / ops)
+        << ",\"gc_ns_per_op\":" << (double(gcNs) / ops)
+        << ",\"mismatches\":" << (errors + (sum != expected))
+        << "}\n" << std::flush;
+}
+
+// Stand-in for the TSJsonObject/TSJsonArray tree: shared maps and
+// vectors of tagged values, that json is read into and lua tables are
+// built from (and the other way around) one field at a time.
+struct JsonTree
+{
+    enum Type { NUL, BOOL, NUMBER, STRING, OBJECT, ARRAY } m_type = NUL;
+    bool m_bool = false;
+    double m_number = 0;
+    std::string m_string;
+    std::shared_ptr<std::map<std::string, JsonTree>> m_object;
+    std::shared_ptr<std::vector<JsonTree>> m_array;
+};
+
+struct JsonTreeHandler
+{
+    std::vector<JsonTree*> m_stack;
+    std::vector<std::string> m_keys;
+    JsonTree m_root;
+
+    JsonTree& Next()
+    {
+        if (m_stack.empty())
+        {
+            return m_root;
+        }
+        JsonTree& parent = *m_stack.back();
+        if (parent.m_type == JsonTree::ARRAY)
+        {
+            parent.m_array->emplace_back();
+            return parent.m_array->back();
+        }
+        JsonTree& value = (*parent.m_object)[m_keys.back()];
+        m_keys.pop_back();
+        return value;
+    }
+
+    bool Null() { Next(); return true; }
+    bool Bool(bool value) { JsonTree& v = Next(); v.m_type = JsonTree::BOOL; v.m_bool = value; return true; }
+    bool Integer(int64_t value) { return Number(double(value)); }
+    bool Number(double value) { JsonTree& v = Next(); v.m_type = JsonTree::NUMBER; v.m_number = value; return true; }
+    bool String(char const* str, size_t length)
+    {
+        JsonTree& v = Next();
+        v.m_type = JsonTree::STRING;
+        v.m_string.assign(str, length);
+        return true;
+    }
+    bool Key(char const* str, size_t length) { m_keys.emplace_back(str, length); return true; }
+    bool BeginObject()
+    {
+        JsonTree& v = Next();
+        v.m_type = JsonTree::OBJECT;
+        v.m_object = std::make_shared<std::map<std::string, JsonTree>>();
+        m_stack.push_back(&v);
+        return true;
+    }
+    bool BeginArray()
+    {
+        JsonTree& v = Next();
+        v.m_type = JsonTree::ARRAY;
+        v.m_array = std::make_shared<std::vector<JsonTree>>();
+        m_stack.push_back(&v);
+        return true;
+    }
+    bool EndObject() { m_stack.pop_back(); return true; }
+    bool EndArray() { m_stack.pop_back(); return true; }
+};
+
+static void pushJsonTree(lua_State* L, JsonTree const& tree)
+{
+    switch (tree.m_type)
+    {
+    case JsonTree::BOOL: lua_pushboolean(L, tree.m_bool); break;
+    case JsonTree::NUMBER: lua_pushnumber(L, tree.m_number); break;
+    case JsonTree::STRING: lua_pushlstring(L, tree.m_string.c_str(), tree.m_string.size()); break;
+    case JsonTree::OBJECT:
+        lua_newtable(L);
+        for (auto const& [key, value] : *tree.m_object)
+        {
+            pushJsonTree(L, value);
+            lua_setfield(L, -2, key.c_str());
+        }
+        break;
+    case JsonTree::ARRAY:
+        lua_newtable(L);
+        for (size_t i = 0; i < tree.m_array->size(); ++i)
+        {
+            pushJsonTree(L, (*tree.m_array)[i]);
+            lua_rawseti(L, -2, int(i + 1));
+        }
+        break;
+    default: lua_pushnil(L); break;
+    }
+}
+
+// like the old lua_to_json, every table becomes an object
+static JsonTree readJsonTree(lua_State* L, int index)
+{
+    JsonTree tree;
+    switch (lua_type(L, index))
+    {
+    case LUA_TBOOLEAN: tree.m_type = JsonTree::BOOL; tree.m_bool = lua_toboolean(L, index); break;
+    case LUA_TNUMBER: tree.m_type = JsonTree::NUMBER; tree.m_number = lua_tonumber(L, index); break;
+    case LUA_TSTRING: tree.m_type = JsonTree::STRING; tree.m_string = lua_tostring(L, index); break;
+    case LUA_TTABLE:
+        tree.m_type = JsonTree::OBJECT;
+        tree.m_object = std::make_shared<std::map<std::string, JsonTree>>();
+        lua_pushnil(L);
+        while (lua_next(L, index))
+        {
+            std::string key;
+            if (lua_type(L, -2) == LUA_TNUMBER)
+            {
+                key = std::to_string(int64_t(lua_tonumber(L, -2)));
+            }
+            else
+            {
+                key = lua_tostring(L, -2);
+            }
+            (*tree.m_object)[key] = readJsonTree(L, lua_gettop(L));
+            lua_pop(L, 1);
+        }
+        break;
+    default: break;
+    }
+    return tree;
+}
+
+static void writeJsonTree(JsonTree const& tree, std::string& out)
+{
+    switch (tree.m_type)
+    {
+    case JsonTree::BOOL: out += tree.m_bool ? "true" : "false"; break;
+    case JsonTree::NUMBER:
+    {
+        char buffer[32];
+        int length = std::floor(tree.m_number) == tree.m_number
+            ? snprintf(buffer, sizeof(buffer), "%lld", (long long)tree.m_number)
+            : snprintf(buffer, sizeof(buffer), "%.17g", tree.m_number);
+        out.append(buffer, size_t(length));
+        break;
+    }
+    case JsonTree::STRING:
+        out += '"';
+        for (char c : tree.m_string)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+            }
+            out += c;
+        }
+        out += '"';
+        break;
+    case JsonTree::OBJECT:
+    {
+        out += '{';
+        bool first = true;
+        for (auto const& [key, value] : *tree.m_object)
+        {
+            if (!first)
+            {
+                out += ',';
+            }
+            first = false;
+            out += '"';
+            out += key;
+            out += "\":";
+            writeJsonTree(value, out);
+        }
+        out += '}';
+        break;
+    }
+    default: out += "null"; break;
+    }
+}
+
+// A character save document (stats, an inventory of objects, a few
+// strings with escapes) decoded into lua tables and encoded back.
+// "tree" goes through an intermediate document like TSJsonObject,
+// "direct" is TSLuaJson.h. Arrays are encoded as objects by both, the
+// tree path can't tell them apart, so both produce the same bytes.
+static void benchLuaJson(std::string const& name)
+{
+    if (!matches("luajson", name))
+    {
+        return;
+    }
+    bool const decode = name.rfind("decode", 0) == 0;
+    bool const direct = name.find("direct") != std::string::npos;
+    uint32_t const docsPerIteration = 64;
+
+    std::string json = "{\"name\":\"Thrall \\\"Go'el\\\"\",\"level\":80,\"gold\":123456789,"
+        "\"pos\":{\"map\":1,\"x\":1629.5,\"y\":-4373.25,\"z\":31.125,\"o\":3.5},"
+        "\"stats\":{\"str\":120,\"agi\":85,\"sta\":210,\"int\":64,\"spi\":71},\"items\":{";
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+        json += (i ? ",\"" : "\"") + std::to_string(i + 1) + "\":{\"entry\":" + std::to_string(19019 + i * 7)
+            + ",\"count\":" + std::to_string(1 + i % 20)
+            + ",\"durability\":" + std::to_string(i % 5 * 25) + ".5"
+            + ",\"soulbound\":" + (i % 3 ? "true" : "false")
+            + ",\"text\":\"item \\\\" + std::to_string(i) + "\"}";
+    }
+    json += "}}";
+
+    lua_State* L = luaL_newstate();
+    luaL_openlibs(L);
+
+    auto decodeTree = [&]() {
+        JsonTreeHandler handler;
+        TSJsonReader<JsonTreeHandler> reader(handler, json.c_str(), json.size());
+        reader.Read();
+        pushJsonTree(L, handler.m_root);
+    };
+    auto decodeDirect = [&]() {
+        std::string error;
+        TSLuaJson::Decode(L, json.c_str(), json.size(), error);
+    };
+    std::string out;
+    auto encodeTree = [&]() {
+        out.clear();
+        writeJsonTree(readJsonTree(L, 1), out);
+    };
+    auto encodeDirect = [&]() {
+        out.clear();
+        std::string error;
+        TSLuaJson::Encode(L, 1, out, error);
+    };
+
+    // both paths must produce the same document
+    uint64_t mismatches = 0;
+    decodeDirect();
+    encodeDirect();
+    std::string reference = out;
+    lua_settop(L, 0);
+    decodeTree();
+    encodeTree();
+    mismatches += out.size() != reference.size() || out.size() != json.size();
+    if (!decode)
+    {
+        // the document to encode stays on the stack
+        lua_settop(L, 0);
+        decodeDirect();
+    }
+
+    uint64_t iterations = 0;
+    uint64_t totalNs = 0;
+    size_t bytes = 0;
+    while (totalNs < minTimeNs)
+    {
+        uint64_t start = nowNs();
+        for (uint32_t i = 0; i < docsPerIteration; ++i)
+        {
+            if (decode)
+            {
+                direct ? decodeDirect() : decodeTree();
+                bytes += lua_type(L, -1) == LUA_TTABLE;
+                lua_settop(L, 0);
+            }
+            else
+            {
+                direct ? encodeDirect() : encodeTree();
+                bytes += out.size();
+            }
+        }
+        totalNs += nowNs() - start;
+        ++iterations;
+    }
+    lua_close(L);
+    if (decode)
+    {
+        mismatches += bytes != iterations * docsPerIteration;
+    }
+    else
+    {
+        mismatches += bytes != iterations * docsPerIteration * reference.size();
+    }
+
+    double ops = double(iterations) * double(docsPerIteration);
+    std::cout
+        << "{\"suite\":\"luajson\""
+        << ",\"name\":\"" << name << "\""
+        << ",\"threads\":1"
+        << ",\"iterations\":" << iterations
+        << ",\"ops_per_iteration\":" << docsPerIteration
+        << ",\"ns_per_iteration\":" << (double(totalNs) / double(iterations))
+        << ",\"ns_per_op\":" << (double(totalNs) / ops)
+        << ",\"bytes_per_op\":" << json.size()
+        << ",\"mismatches\":" << mismatches
+        << "}\n" << std::flush;
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else if (arg == "--min-time-ms" && i + 1 < argc)
+        {
+            minTimeNs = std::strtoull(argv[++i], nullptr, 10) * 1000000;
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            threads = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--filter <substring>] [--min-time-ms <ms>] [--threads <n>]\n";
+            return 1;
+        }
+    }
+
+    if (threads == 0)
+    {
+        // same default as "TSWoW.WorkerThreads"
+        uint32_t hardware = std::thread::hardware_concurrency();
+        threads = hardware > 1 ? hardware - 1 : 1;
+    }
+
+    benchLineOfSight(64);
+    benchLineOfSight(1024);
+    benchLineOfSight(16384);
+    std::vector<uint32_t> producerCounts = { 1, 4 };
+    if (threads > 4)
+    {
+        producerCounts.push_back(threads);
+    }
+    for (uint32_t producers : producerCounts)
+    {
+        benchMailbox<LockedQueue>("locked", producers);
+        benchMailbox<TSMPSCQueue<std::function<void(uint64_t&)>>>("mpsc", producers);
+    }
+    benchLuaAlloc("default");
+    benchLuaAlloc("tracked");
+    benchLuaAlloc("pooled");
+    benchLuaUserdata("fresh");
+    benchLuaUserdata("cached");
+    benchLuaJson("decode/tree");
+    benchLuaJson("decode/direct");
+    benchLuaJson("encode/tree");
+    benchLuaJson("encode/direct");
+    return 0;
+}
@@ -0,0 +1,284 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_all.hpp>
+
+#include "TSAsyncScheduler.h"
+
+extern "C" {
+#include "lua.h"
+#include "lauxlib.h"
+#include "lualib.h"
+}
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("[AsyncScheduler] sleeps wake in time order") {
+    TSAsyncScheduler scheduler;
+    std::vector<std::string> log;
+    uint64_t clock = 1000;
+    scheduler.Sleep(clock, 300, [&](bool cancelled) { log.push_back(cancelled ? "c:300" : "300"); });
+    scheduler.Sleep(clock, 100, [&](bool cancelled) { log.push_back(cancelled ? "c:100a" : "100a"); });
+    scheduler.Sleep(clock, 100, [&](bool cancelled) { log.push_back(cancelled ? "c:100b" : "100b"); });
+    REQUIRE(scheduler.GetSleeping() == 3);
+
+    uint64_t next = 0;
+    REQUIRE(scheduler.GetNextWake(next));
+    REQUIRE(next == 1100);
+
+    clock = 1099;
+    REQUIRE(scheduler.Tick(clock) == 0);
+    REQUIRE(log.empty());
+
+    clock = 1250;
+    REQUIRE(scheduler.Tick(clock) == 2);
+    REQUIRE(log == std::vector<std::string>{ "100a", "100b" });
+
+    clock = 5000;
+    REQUIRE(scheduler.Tick(clock) == 1);
+    REQUIRE(log == std::vector<std::string>{ "100a", "100b", "300" });
+    REQUIRE(scheduler.GetSleeping() == 0);
+    REQUIRE_FALSE(scheduler.GetNextWake(next));
+}
+
+TEST_CASE("[AsyncScheduler] waits added while ticking wait for the next tick") {
+    TSAsyncScheduler scheduler;
+    uint64_t clock = 0;
+    uint32_t wakes = 0;
+    std::function<void(bool)> again = [&](bool) {
+        ++wakes;
+        scheduler.Sleep(clock, 0, again);
+    };
+    scheduler.Sleep(clock, 0, again);
+
+    REQUIRE(scheduler.Tick(clock) == 1);
+    REQUIRE(wakes == 1);
+    REQUIRE(scheduler.Tick(clock) == 1);
+    REQUIRE(wakes == 2);
+    scheduler.Clear();
+}
+
+TEST_CASE("[AsyncScheduler] waits are cancelled once their owner is gone") {
+    TSAsyncScheduler scheduler;
+    std::shared_ptr<char> alive = std::make_shared<char>();
+    std::shared_ptr<char> despawned = std::make_shared<char>();
+    std::vector<std::string> log;
+    scheduler.Sleep(0, 10, [&](bool cancelled) { log.push_back(cancelled ? "c:alive" : "alive"); }, alive);
+    scheduler.Sleep(0, 10, [&](bool cancelled) { log.push_back(cancelled ? "c:despawned" : "despawned"); }, despawned);
+    uint64_t query = scheduler.Suspend([&](bool cancelled) { log.push_back(cancelled ? "c:query" : "query"); }, despawned);
+
+    despawned.reset();
+    scheduler.Complete(query);
+    REQUIRE(scheduler.Tick(10) == 3);
+    REQUIRE(log == std::vector<std::string>{ "c:query", "alive", "c:despawned" });
+}
+
+TEST_CASE("[AsyncScheduler] suspended tasks resume after being completed") {
+    TSAsyncScheduler scheduler;
+    uint32_t resumed = 0;
+    uint32_t cancelled = 0;
+    auto resume = [&](bool wasCancelled) { wasCancelled ? ++cancelled : ++resumed; };
+
+    std::vector<uint64_t> ids;
+    for (int i = 0; i < 64; ++i)
+    {
+        ids.push_back(scheduler.Suspend(resume));
+    }
+    REQUIRE(scheduler.GetSuspended() == 64);
+    REQUIRE(scheduler.Tick(0) == 0);
+
+    // like database callbacks finishing on other threads
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            for (int i = t; i < 64; i += 4)
+            {
+                scheduler.Complete(ids[i]);
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    // a cancel before the tick wins, completing twice does nothing
+    REQUIRE(scheduler.Cancel(ids[0]));
+    REQUIRE(scheduler.Tick(0) == 63);
+    scheduler.Complete(ids[1]);
+    REQUIRE(scheduler.Tick(0) == 0);
+    REQUIRE(resumed == 63);
+    REQUIRE(cancelled == 1);
+    REQUIRE(scheduler.GetSuspended() == 0);
+}
+
+TEST_CASE("[AsyncScheduler] cancel and clear") {
+    TSAsyncScheduler scheduler;
+    std::vector<std::string> log;
+    uint64_t sleep = scheduler.Sleep(0, 10, [&](bool cancelled) { log.push_back(cancelled ? "c:sleep" : "sleep"); });
+    uint64_t query = scheduler.Suspend([&](bool cancelled) { log.push_back(cancelled ? "c:query" : "query"); });
+    scheduler.Sleep(0, 20, [&](bool cancelled) { log.push_back(cancelled ? "c:other" : "other"); });
+
+    REQUIRE(scheduler.Cancel(sleep));
+    REQUIRE_FALSE(scheduler.Cancel(sleep));
+    REQUIRE(log == std::vector<std::string>{ "c:sleep" });
+
+    scheduler.Complete(query);
+    scheduler.Clear();
+    REQUIRE(log == std::vector<std::string>{ "c:sleep", "c:other", "c:query" });
+    REQUIRE(scheduler.Tick(100) == 0);
+    REQUIRE(scheduler.GetSleeping() == 0);
+    REQUIRE(scheduler.GetSuspended() == 0);
+}
+
+// A minimal version of the lua glue: Async(fn) runs fn as a coroutine,
+// Sleep(ms) yields it until the scheduler wakes it up.
+namespace
+{
+    struct LuaAsync
+    {
+        lua_State* L;
+        TSAsyncScheduler scheduler;
+        uint64_t clock = 0;
+        std::shared_ptr<char> owner = std::make_shared<char>();
+        uint32_t finished = 0;
+        uint32_t dropped = 0;
+
+        static LuaAsync* Get(lua_State* L)
+        {
+            lua_getfield(L, LUA_REGISTRYINDEX, "LuaAsync");
+            LuaAsync* async = static_cast<LuaAsync*>(lua_touserdata(L, -1));
+            lua_pop(L, 1);
+            return async;
+        }
+
+        void Resume(int ref, int nargs)
+        {
+            lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+            lua_State* co = lua_tothread(L, -1);
+            lua_pop(L, 1);
+            int status = lua_resume(co, nargs);
+            if (status == LUA_YIELD)
+            {
+                return;
+            }
+            REQUIRE(status == 0);
+            ++finished;
+            luaL_unref(L, LUA_REGISTRYINDEX, ref);
+        }
+    };
+
+    int LAsync(lua_State* L)
+    {
+        LuaAsync* async = LuaAsync::Get(L);
+        lua_State* co = lua_newthread(L);
+        int ref = luaL_ref(L, LUA_REGISTRYINDEX);
+        lua_pushvalue(L, 1);
+        lua_xmove(L, co, 1);
+        async->Resume(ref, 0);
+        return 0;
+    }
+
+    int LSleep(lua_State* L)
+    {
+        LuaAsync* async = LuaAsync::Get(L);
+        lua_Integer ms = luaL_checkinteger(L, 1);
+        bool owned = lua_toboolean(L, 2);
+        // the coroutine keeps itself alive while it waits
+        lua_pushthread(L);
+        int ref = luaL_ref(L, LUA_REGISTRYINDEX);
+        auto resume = [async, ref](bool cancelled) {
+            if (cancelled)
+            {
+                ++async->dropped;
+                luaL_unref(async->L, LUA_REGISTRYINDEX, ref);
+                return;
+            }
+            lua_rawgeti(async->L, LUA_REGISTRYINDEX, ref);
+            lua_State* co = lua_tothread(async->L, -1);
+            lua_pop(async->L, 1);
+            lua_pushinteger(co, lua_Integer(async->clock));
+            async->Resume(ref, 1);
+        };
+        if (owned)
+        {
+            async->scheduler.Sleep(async->clock, uint64_t(ms), resume, async->owner);
+        }
+        else
+        {
+            async->scheduler.Sleep(async->clock, uint64_t(ms), resume);
+        }
+        return lua_yield(L, 0);
+    }
+}
+
+TEST_CASE("[AsyncScheduler] lua coroutines with a synthetic clock") {
+    LuaAsync async;
+    async.L = luaL_newstate();
+    lua_State* L = async.L;
+    luaL_openlibs(L);
+    lua_pushlightuserdata(L, &async);
+    lua_setfield(L, LUA_REGISTRYINDEX, "LuaAsync");
+    lua_register(L, "Async", LAsync);
+    lua_register(L, "Sleep", LSleep);
+
+    REQUIRE(luaL_dostring(L,
+        "log = {}\n"
+        "Async(function()\n"
+        "  log[#log + 1] = 'a start'\n"
+        "  local t = Sleep(100)\n"
+        "  log[#log + 1] = 'a ' .. t\n"
+        "  t = Sleep(50)\n"
+        "  log[#log + 1] = 'a ' .. t\n"
+        "end)\n"
+        "Async(function()\n"
+        "  local t = Sleep(120)\n"
+        "  log[#log + 1] = 'b ' .. t\n"
+        "end)\n"
+        "Async(function()\n"
+        "  Sleep(10, true)\n"
+        "  log[#log + 1] = 'owned'\n"
+        "  Sleep(10, true)\n"
+        "  log[#log + 1] = 'never'\n"
+        "end)\n"
+    ) == 0);
+
+    auto log = [&]() {
+        std::vector<std::string> out;
+        lua_getglobal(L, "log");
+        for (int i = 1; ; ++i)
+        {
+            lua_rawgeti(L, -1, i);
+            if (lua_isnil(L, -1))
+            {
+                lua_pop(L, 1);
+                break;
+            }
+            out.push_back(lua_tostring(L, -1));
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);
+        return out;
+    };
+
+    REQUIRE(log() == std::vector<std::string>{ "a start" });
+    for (uint64_t t = 0; t <= 200; t += 16)
+    {
+        async.clock = t;
+        async.scheduler.Tick(t);
+        if (t == 16)
+        {
+            // despawned while the third task sleeps
+            async.owner.reset();
+        }
+    }
+    REQUIRE(log() == std::vector<std::string>{ "a start", "owned", "a 112", "b 128", "a 176" });
+    REQUIRE(async.finished == 2);
+    REQUIRE(async.dropped == 1);
+    REQUIRE(async.scheduler.GetSleeping() == 0);
+
+    // nothing is left in the registry once every task is done or dropped
+    lua_close(L);
+}
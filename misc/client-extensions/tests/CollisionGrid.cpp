@@ -0,0 +1,209 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_all.hpp>
+
+#include "TSCollisionGrid.h"
+
+#include <cstdint>
+#include <set>
+#include <vector>
+
+// deterministic generator so failures reproduce
+struct Lcg
+{
+    uint32_t m_state;
+    uint32_t Next()
+    {
+        m_state = m_state * 1664525u + 1013904223u;
+        return m_state >> 8;
+    }
+    float Range(float min, float max)
+    {
+        return min + (max - min) * (Next() % 100000) / 100000.0f;
+    }
+};
+
+struct SyntheticUnit
+{
+    uint64_t m_guid;
+    float x;
+    float y;
+    float z;
+};
+
+static std::vector<SyntheticUnit> makeUnits(Lcg& rng, uint32_t count)
+{
+    std::vector<SyntheticUnit> units;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        units.push_back({ 1000 + i, rng.Range(-200, 200), rng.Range(-200, 200), rng.Range(-10, 10) });
+    }
+    return units;
+}
+
+static std::set<uint64_t> bruteForce(std::vector<SyntheticUnit> const& units, float x, float y, float z, float range)
+{
+    std::set<uint64_t> result;
+    for (auto const& unit : units)
+    {
+        float dx = unit.x - x;
+        float dy = unit.y - y;
+        float dz = unit.z - z;
+        if (dx * dx + dy * dy + dz * dz <= range * range)
+        {
+            result.insert(unit.m_guid);
+        }
+    }
+    return result;
+}
+
+TEST_CASE("[CollisionGrid] matches brute force") {
+    Lcg rng{ 1 };
+    std::vector<SyntheticUnit> units = makeUnits(rng, 2000);
+    TSCollisionGrid<uint64_t> grid(8.0f);
+    for (auto const& unit : units)
+    {
+        grid.Insert(unit.m_guid, unit.x, unit.y, unit.z);
+    }
+    REQUIRE(grid.Size() == units.size());
+
+    for (uint32_t i = 0; i < 500; ++i)
+    {
+        float x = rng.Range(-220, 220);
+        float y = rng.Range(-220, 220);
+        float z = rng.Range(-10, 10);
+        float range = rng.Range(0, 40);
+        std::set<uint64_t> found;
+        grid.Query(x, y, z, range, [&](uint64_t guid) {
+            REQUIRE(found.insert(guid).second);
+        });
+        REQUIRE(found == bruteForce(units, x, y, z, range));
+    }
+}
+
+TEST_CASE("[CollisionGrid] negative coordinates and cell borders") {
+    TSCollisionGrid<uint64_t> grid(8.0f);
+    grid.Insert(1, -8.0f, -8.0f, 0);
+    grid.Insert(2, 0, 0, 0);
+    grid.Insert(3, 7.99f, 0, 0);
+    grid.Insert(4, 8.0f, 0, 0);
+
+    std::set<uint64_t> found;
+    grid.Query(0, 0, 0, 8.0f, [&](uint64_t guid) { found.insert(guid); });
+    REQUIRE(found == std::set<uint64_t>{ 2, 3, 4 });
+
+    found.clear();
+    grid.Query(-4, -4, 0, 5.7f, [&](uint64_t guid) { found.insert(guid); });
+    REQUIRE(found == std::set<uint64_t>{ 1, 2 });
+
+    grid.Clear();
+    REQUIRE(grid.Size() == 0);
+    grid.Query(0, 0, 0, 100.0f, [&](uint64_t) { FAIL("cleared grid returned a value"); });
+}
+
+// Many collision volumes against units walking through them,
+// the way TSCollisionEntry uses the grid and hit tracker every tick.
+static uint64_t simulateTicks(uint32_t seed)
+{
+    Lcg rng{ seed };
+    std::vector<SyntheticUnit> units = makeUnits(rng, 500);
+
+    struct Volume
+    {
+        float x;
+        float y;
+        float range;
+        std::set<uint64_t> hitmap;
+        TSCollisionHitTracker tracker;
+    };
+    std::vector<Volume> volumes;
+    for (uint32_t i = 0; i < 200; ++i)
+    {
+        volumes.push_back({ rng.Range(-200, 200), rng.Range(-200, 200), rng.Range(2, 15) });
+    }
+
+    uint64_t const cap = 16;
+    uint64_t hits = 0;
+    TSCollisionGrid<uint64_t> grid(8.0f);
+    for (uint64_t tick = 0; tick < 100; ++tick)
+    {
+        for (auto& unit : units)
+        {
+            unit.x += rng.Range(-3, 3);
+            unit.y += rng.Range(-3, 3);
+        }
+        grid.Clear();
+        for (auto const& unit : units)
+        {
+            grid.Insert(unit.m_guid, unit.x, unit.y, unit.z);
+        }
+
+        for (auto& volume : volumes)
+        {
+            std::set<uint64_t> found;
+            grid.Query(volume.x, volume.y, 0, volume.range, [&](uint64_t guid) {
+                found.insert(guid);
+            });
+            REQUIRE(found == bruteForce(units, volume.x, volume.y, 0, volume.range));
+
+            uint64_t now = tick * 100;
+            for (uint64_t guid : found)
+            {
+                volume.hitmap.insert(guid);
+                volume.tracker.Touch(guid, now);
+                ++hits;
+            }
+            volume.tracker.Prune(now, 1000, cap, [&](uint64_t guid) {
+                REQUIRE(volume.hitmap.erase(guid) == 1);
+            });
+            REQUIRE(volume.tracker.Size() <= cap);
+            REQUIRE(volume.hitmap.size() == volume.tracker.Size());
+        }
+    }
+    return hits;
+}
+
+TEST_CASE("[CollisionGrid] simulated ticks with capped hitmaps") {
+    uint64_t hits = simulateTicks(7);
+    REQUIRE(hits > 0);
+    REQUIRE(simulateTicks(7) == hits);
+}
+
+TEST_CASE("[CollisionGrid] hit tracker expiry and cap") {
+    TSCollisionHitTracker tracker;
+    std::vector<uint64_t> dropped;
+    auto onDrop = [&](uint64_t key) { dropped.push_back(key); };
+
+    for (uint64_t key = 0; key < 8; ++key)
+    {
+        tracker.Touch(key, key * 10);
+    }
+
+    // nothing expired, no cap
+    tracker.Prune(70, 1000, 0, onDrop);
+    REQUIRE(dropped.empty());
+    REQUIRE(tracker.Size() == 8);
+
+    // keys last seen more than 30ms ago expire
+    tracker.Prune(70, 30, 0, onDrop);
+    std::set<uint64_t> expired(dropped.begin(), dropped.end());
+    REQUIRE(expired == std::set<uint64_t>{ 0, 1, 2, 3 });
+    REQUIRE(tracker.Size() == 4);
+
+    // above the cap drops the least recently seen down to 3/4 of the cap
+    dropped.clear();
+    for (uint64_t key = 100; key < 104; ++key)
+    {
+        tracker.Touch(key, 70);
+    }
+    tracker.Prune(70, 0, 4, onDrop);
+    REQUIRE(dropped == std::vector<uint64_t>{ 4, 5, 6, 7, 100 });
+    REQUIRE(tracker.Size() == 3);
+
+    // touching again keeps a key alive
+    dropped.clear();
+    tracker.Touch(101, 500);
+    tracker.Prune(520, 100, 0, onDrop);
+    std::set<uint64_t> left(dropped.begin(), dropped.end());
+    REQUIRE(left == std::set<uint64_t>{ 102, 103 });
+    REQUIRE(tracker.Size() == 1);
+}
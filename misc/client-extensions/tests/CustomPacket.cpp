@@ -1,5 +1,5 @@
 #include <catch2/catch_test_macros.hpp>
-#include <catch2/matchers/catch_matchers_all.hpp >
+#include <catch2/matchers/catch_matchers_all.hpp>
 
 #include "CustomPacketWrite.h"
 #include "CustomPacketRead.h"
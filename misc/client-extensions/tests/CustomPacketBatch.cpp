@@ -0,0 +1,82 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_all.hpp>
+
+#include "CustomPacketDefines.h"
+#include "CustomPacketBatch.h"
+#include "CustomPacketBuffer.h"
+
+#include <vector>
+
+TEST_CASE("[MessageBatch] pack/unpack") {
+    CustomPacketWrite a(5, MAX_FRAGMENT_SIZE, 0);
+    a.Write<uint32_t>(1768);
+    a.WriteString("abcd");
+    CustomPacketWrite b(7, MAX_FRAGMENT_SIZE, 0);
+    CustomPacketWrite c(9, MAX_FRAGMENT_SIZE, 0);
+    c.Write<uint8_t>(3);
+
+    CustomPacketBatch batch;
+    REQUIRE(batch.Add(a));
+    REQUIRE(batch.Add(b));
+    REQUIRE(batch.Add(c));
+    REQUIRE(batch.Count() == 3);
+    REQUIRE(batch.Container().Opcode() == BATCH_OPCODE);
+    REQUIRE(batch.Container().ChunkCount() == 1);
+
+    CustomPacketRead container(batch.Container());
+    std::vector<opcode_t> opcodes;
+    REQUIRE(CustomPacketBatch::Unpack(&container, [&](CustomPacketRead* read) {
+        opcodes.push_back(read->Opcode());
+        switch (read->Opcode())
+        {
+        case 5:
+            REQUIRE(read->Read<uint32_t>(0) == 1768);
+            REQUIRE_THAT(read->ReadString(), Catch::Matchers::Equals("abcd"));
+            break;
+        case 7:
+            REQUIRE(read->Size() == 0);
+            break;
+        case 9:
+            REQUIRE(read->Read<uint8_t>(0) == 3);
+            break;
+        }
+    }));
+    REQUIRE(opcodes == std::vector<opcode_t>{ 5, 7, 9 });
+
+    a.Destroy();
+    b.Destroy();
+    c.Destroy();
+    batch.Container().Destroy();
+}
+
+TEST_CASE("[MessageBatch] capacity") {
+    SECTION("rejects messages bigger than a fragment") {
+        CustomPacketWrite big(1, MAX_FRAGMENT_SIZE, CustomPacketBatch::Capacity());
+        CustomPacketBatch batch;
+        REQUIRE(!batch.Add(big));
+        REQUIRE(batch.Count() == 0);
+        big.Destroy();
+    }
+
+    SECTION("rejects messages that do not fit in the remaining space") {
+        totalSize_t half = CustomPacketBatch::Capacity() / 2;
+        CustomPacketWrite msg(1, MAX_FRAGMENT_SIZE, half);
+        CustomPacketBatch batch;
+        REQUIRE(batch.Add(msg));
+        REQUIRE(!batch.Add(msg));
+        REQUIRE(batch.Container().ChunkCount() == 1);
+        msg.Destroy();
+        batch.Container().Destroy();
+    }
+}
+
+TEST_CASE("[MessageBatch] malformed containers") {
+    CustomPacketWrite write(BATCH_OPCODE, MAX_FRAGMENT_SIZE, 0);
+    write.Write<opcode_t>(1);
+    write.Write<totalSize_t>(100); // no payload follows
+    CustomPacketRead read(write);
+    size_t calls = 0;
+    REQUIRE(!CustomPacketBatch::Unpack(&read, [&](CustomPacketRead*) { ++calls; }));
+    REQUIRE(calls == 0);
+    write.Destroy();
+}
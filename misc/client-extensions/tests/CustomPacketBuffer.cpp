@@ -159,3 +159,114 @@ TEST_CASE("[MessageBuffer] Quota") {
         b.ReceivePacket(g[g.size() - 1].FullSize(), g[g.size() - 1].Data());
     }
 }
+
+class DetachingBuffer : public CustomPacketBuffer
+{
+public:
+    DetachingBuffer()
+        : CustomPacketBuffer(0, 1000 + CustomHeaderSize * 10, 4 + CustomHeaderSize)
+    {}
+    std::vector<CustomPacketRead*> m_messages;
+protected:
+    void OnPacket(CustomPacketRead* value) override
+    {
+        m_messages.push_back(DetachMessage());
+    }
+};
+
+TEST_CASE("[MessageBuffer] DetachMessage") {
+    DetachingBuffer b;
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        CustomPacketWrite write(opcode_t(i), 4 + CustomHeaderSize, 8);
+        write.Write<uint32_t>(i);
+        write.Write<uint32_t>(i * 10);
+        // the socket buffer is gone before the message is read
+        for (auto& chunk : write.buildMessages())
+        {
+            b.ReceivePacket(chunk.FullSize(), chunk.Data());
+        }
+        write.Destroy();
+        REQUIRE(b.Size() == 0);
+    }
+
+    REQUIRE(b.m_messages.size() == 3);
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        CustomPacketRead* read = b.m_messages[i];
+        REQUIRE(read->Opcode() == i);
+        REQUIRE(read->Read<uint32_t>(UINT32_MAX) == i);
+        REQUIRE(read->Read<uint32_t>(UINT32_MAX) == i * 10);
+        read->Destroy();
+        delete read;
+    }
+}
+
+TEST_CASE("[MessageBuffer] Reset rereads the message") {
+    CustomPacketWrite write(0, MAX_FRAGMENT_SIZE, 0);
+    write.Write<uint32_t>(1234);
+    CustomPacketRead read(write);
+    REQUIRE(read.Read<uint32_t>(0) == 1234);
+    read.Reset();
+    REQUIRE(read.Read<uint32_t>(0) == 1234);
+    write.Destroy();
+}
+
+TEST_CASE("[MessageBuffer] Remaining across fragments") {
+    CustomPacketWrite write(0, 4 + CustomHeaderSize, 12);
+    write.Write<uint32_t>(1);
+    write.Write<uint32_t>(2);
+    write.Write<uint32_t>(3);
+    CustomPacketRead read(write);
+    char* bytes = read.ReadBytes(6);
+    REQUIRE(read.Remaining() == 6);
+    delete[] bytes;
+    bytes = read.ReadBytes(6);
+    REQUIRE(bytes != nullptr);
+    REQUIRE(read.Remaining() == 0);
+    delete[] bytes;
+    write.Destroy();
+}
+
+class RereadingBuffer : public CustomPacketBuffer
+{
+public:
+    RereadingBuffer()
+        : CustomPacketBuffer(0, 1000 + CustomHeaderSize * 10, 4 + CustomHeaderSize)
+    {}
+    std::vector<totalSize_t> m_sizes;
+    std::vector<uint32_t> m_values;
+protected:
+    void OnPacket(CustomPacketRead* value) override
+    {
+        // every listener reads the message from the start
+        for (int listener = 0; listener < 2; ++listener)
+        {
+            m_sizes.push_back(value->Size());
+            m_values.push_back(value->Read<uint32_t>(UINT32_MAX));
+            m_values.push_back(value->Read<uint32_t>(UINT32_MAX));
+            m_values.push_back(value->Read<uint32_t>(UINT32_MAX));
+            value->Reset();
+        }
+    }
+};
+
+// received fragments used to count their header as payload,
+// and Reset used to clear the size so later listeners read nothing
+TEST_CASE("[MessageBuffer] received messages keep their size across Reset") {
+    RereadingBuffer b;
+    CustomPacketWrite write(0, 4 + CustomHeaderSize, 12);
+    write.Write<uint32_t>(7);
+    write.Write<uint32_t>(8);
+    write.Write<uint32_t>(9);
+    auto& chunks = write.buildMessages();
+    REQUIRE(chunks.size() == 3);
+    for (auto& chunk : chunks)
+    {
+        b.ReceivePacket(chunk.FullSize(), chunk.Data());
+    }
+    write.Destroy();
+
+    REQUIRE(b.m_sizes == std::vector<totalSize_t>{ 12, 12 });
+    REQUIRE(b.m_values == std::vector<uint32_t>{ 7, 8, 9, 7, 8, 9 });
+}
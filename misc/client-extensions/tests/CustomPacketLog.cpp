@@ -0,0 +1,84 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_all.hpp>
+
+#include "CustomPacketLog.h"
+
+#include <sstream>
+#include <vector>
+
+static std::vector<CustomPacketLogRecord> makeRecords()
+{
+    std::vector<CustomPacketLogRecord> records;
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        CustomPacketLogRecord record;
+        record.m_tick = i / 10;
+        record.m_kind = CustomPacketLogKind(i % 4);
+        record.m_session = 1000 + i % 3;
+        record.m_opcode = i * 7;
+        record.m_data = std::string(i, char('a' + i % 26));
+        records.push_back(record);
+    }
+    return records;
+}
+
+TEST_CASE("[CustomPacketLog] roundtrip") {
+    std::stringstream stream;
+    std::vector<CustomPacketLogRecord> records = makeRecords();
+    CustomPacketLogWriter writer(stream);
+    for (auto const& record : records)
+    {
+        writer.Write(record);
+    }
+    REQUIRE(writer.BytesWritten() == stream.str().size());
+
+    CustomPacketLogReader reader(stream);
+    REQUIRE(reader.IsValid());
+    CustomPacketLogRecord record;
+    for (auto const& expected : records)
+    {
+        REQUIRE(reader.Next(record));
+        REQUIRE(record.m_tick == expected.m_tick);
+        REQUIRE(record.m_kind == expected.m_kind);
+        REQUIRE(record.m_session == expected.m_session);
+        REQUIRE(record.m_opcode == expected.m_opcode);
+        REQUIRE(record.m_data == expected.m_data);
+    }
+    REQUIRE(!reader.Next(record));
+}
+
+TEST_CASE("[CustomPacketLog] small records stay small") {
+    std::stringstream stream;
+    CustomPacketLogWriter writer(stream);
+    uint64_t start = writer.BytesWritten();
+    CustomPacketLogRecord record;
+    record.m_tick = 5;
+    record.m_kind = CustomPacketLogKind::CUSTOM_PACKET;
+    record.m_session = 1;
+    record.m_opcode = 12;
+    record.m_data = "ab";
+    writer.Write(record);
+    // tick, kind, session, opcode, size, 2 bytes
+    REQUIRE(writer.BytesWritten() - start == 7);
+}
+
+TEST_CASE("[CustomPacketLog] rejects bad input") {
+    SECTION("wrong magic") {
+        std::stringstream stream("XXXX\x01");
+        CustomPacketLogReader reader(stream);
+        REQUIRE(!reader.IsValid());
+    }
+
+    SECTION("truncated record") {
+        std::stringstream stream;
+        CustomPacketLogWriter writer(stream);
+        CustomPacketLogRecord record;
+        record.m_data = "abcdef";
+        writer.Write(record);
+        std::string data = stream.str();
+        std::stringstream truncated(data.substr(0, data.size() - 2));
+        CustomPacketLogReader reader(truncated);
+        REQUIRE(reader.IsValid());
+        REQUIRE(!reader.Next(record));
+    }
+}
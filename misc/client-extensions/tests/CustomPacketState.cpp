@@ -0,0 +1,264 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_all.hpp>
+
+#include "CustomPacketDefines.h"
+#include "CustomPacketState.h"
+#include "CustomPacketBuffer.h"
+
+#include <cstdlib>
+#include <map>
+#include <string>
+
+#define MUTATIONS 20000
+#define FIELDS 64
+#define FLUSH_EVERY 50
+#define SEED 1007688
+
+// Plays the client: reassembles STATE_OPCODE messages and applies them
+class StateClient : public CustomPacketBuffer {
+public:
+    StateClient()
+        : CustomPacketBuffer(MIN_FRAGMENT_SIZE, BUFFER_QUOTA, MAX_FRAGMENT_SIZE)
+    {}
+    CustomPacketState m_state;
+    CustomPacketStateOwner m_owner = CustomPacketStateOwner::PLAYER;
+    uint32_t m_channel = UINT32_MAX;
+    bool m_valid = true;
+protected:
+    void OnPacket(CustomPacketRead* read) override
+    {
+        m_valid = m_valid
+            && read->Opcode() == STATE_OPCODE
+            && CustomPacketState::ReadChannel(read, m_owner, m_channel)
+            && m_state.Apply(read);
+    }
+
+    void OnError(CustomPacketResult) override
+    {
+        m_valid = false;
+    }
+};
+
+// Sends the message to the client, returns the bytes that went over the wire
+static size_t transmit(CustomPacketWrite& write, StateClient& client)
+{
+    size_t bytes = 0;
+    for (CustomPacketChunk& chunk : write.buildMessages())
+    {
+        bytes += chunk.FullSize();
+        client.ReceivePacket(chunk.FullSize(), chunk.Data());
+    }
+    write.Destroy();
+    return bytes;
+}
+
+static void requireConverged(CustomPacketState& server, CustomPacketState& client)
+{
+    for (uint32_t i = 0; i < FIELDS; ++i)
+    {
+        REQUIRE(server.Type(i) == client.Type(i));
+        REQUIRE(server.GetNumber(i) == client.GetNumber(i));
+        REQUIRE(server.GetString(i) == client.GetString(i));
+    }
+}
+
+TEST_CASE("[MessageState] encoding") {
+    CustomPacketState server;
+    server.SetNumber(0, 5);
+    server.SetNumber(1, -1.5);
+    server.SetNumber(2, -123456789);
+    server.SetString(3, "abcd");
+    server.SetString(4, "");
+
+    StateClient client;
+    CustomPacketWrite write(STATE_OPCODE, MAX_FRAGMENT_SIZE, 0);
+    server.WriteDelta(write, CustomPacketStateOwner::MAP, 7);
+    server.ClearDirty();
+    transmit(write, client);
+
+    REQUIRE(client.m_valid);
+    REQUIRE(client.m_owner == CustomPacketStateOwner::MAP);
+    REQUIRE(client.m_channel == 7);
+    requireConverged(server, client.m_state);
+    REQUIRE(client.m_state.Has(4));
+    REQUIRE(!client.m_state.Has(5));
+    REQUIRE(!client.m_state.IsDirty());
+}
+
+TEST_CASE("[MessageState] only changed fields are sent") {
+    CustomPacketState server;
+    for (uint32_t i = 0; i < FIELDS; ++i)
+    {
+        server.SetNumber(i, i);
+    }
+    server.ClearDirty();
+
+    server.SetNumber(3, 3); // same value
+    REQUIRE(!server.IsDirty());
+
+    server.SetNumber(4, 100);
+    CustomPacketWrite write(STATE_OPCODE, MAX_FRAGMENT_SIZE, 0);
+    server.WriteDelta(write, CustomPacketStateOwner::PLAYER, 0);
+    // owner, channel, snapshot flag, count, field, type, 2-byte varint
+    REQUIRE(write.Size() == 8);
+    write.Destroy();
+}
+
+TEST_CASE("[MessageState] field ids") {
+    CustomPacketState state;
+    REQUIRE(!state.SetNumber(MAX_STATE_FIELDS, 1));
+    REQUIRE(state.SetNumber(MAX_STATE_FIELDS - 1, 1));
+}
+
+TEST_CASE("[MessageState] malformed messages") {
+    CustomPacketState state;
+    CustomPacketWrite write(STATE_OPCODE, MAX_FRAGMENT_SIZE, 0);
+    write.Write<uint8_t>(uint8_t(CustomPacketStateOwner::PLAYER));
+    write.WriteVarint(0);
+    write.Write<uint8_t>(0);
+    write.WriteVarint(1);
+    write.WriteVarint(2);
+    write.Write<uint8_t>(uint8_t(CustomPacketStateType::STRING));
+    write.WriteVarint(100); // no string follows
+    CustomPacketRead read(write);
+    CustomPacketStateOwner owner;
+    uint32_t channel;
+    REQUIRE(CustomPacketState::ReadChannel(&read, owner, channel));
+    REQUIRE(!state.Apply(&read));
+    write.Destroy();
+
+    CustomPacketWrite badOwner(STATE_OPCODE, MAX_FRAGMENT_SIZE, 0);
+    badOwner.Write<uint8_t>(2);
+    badOwner.WriteVarint(0);
+    CustomPacketRead badRead(badOwner);
+    REQUIRE(!CustomPacketState::ReadChannel(&badRead, owner, channel));
+    badOwner.Destroy();
+}
+
+// Keeps states apart by owner and channel, like the client extensions
+class OwnedStateClient : public CustomPacketBuffer {
+public:
+    OwnedStateClient()
+        : CustomPacketBuffer(MIN_FRAGMENT_SIZE, BUFFER_QUOTA, MAX_FRAGMENT_SIZE)
+    {}
+    std::map<std::pair<CustomPacketStateOwner, uint32_t>, CustomPacketState> m_states;
+    bool m_valid = true;
+protected:
+    void OnPacket(CustomPacketRead* read) override
+    {
+        CustomPacketStateOwner owner;
+        uint32_t channel;
+        m_valid = m_valid
+            && CustomPacketState::ReadChannel(read, owner, channel)
+            && m_states[{ owner, channel }].Apply(read);
+    }
+
+    void OnError(CustomPacketResult) override
+    {
+        m_valid = false;
+    }
+};
+
+TEST_CASE("[MessageState] player and map states share a channel") {
+    CustomPacketState player;
+    player.SetNumber(0, 1);
+    CustomPacketState map;
+    map.SetNumber(1, 2);
+
+    OwnedStateClient client;
+    CustomPacketWrite write(STATE_OPCODE, MAX_FRAGMENT_SIZE, 0);
+    player.WriteSnapshot(write, CustomPacketStateOwner::PLAYER, 3);
+    for (CustomPacketChunk& chunk : write.buildMessages())
+    {
+        client.ReceivePacket(chunk.FullSize(), chunk.Data());
+    }
+    write.Destroy();
+
+    CustomPacketWrite mapWrite(STATE_OPCODE, MAX_FRAGMENT_SIZE, 0);
+    map.WriteSnapshot(mapWrite, CustomPacketStateOwner::MAP, 3);
+    for (CustomPacketChunk& chunk : mapWrite.buildMessages())
+    {
+        client.ReceivePacket(chunk.FullSize(), chunk.Data());
+    }
+    mapWrite.Destroy();
+
+    REQUIRE(client.m_valid);
+    CustomPacketState& playerCopy = client.m_states[{ CustomPacketStateOwner::PLAYER, 3 }];
+    CustomPacketState& mapCopy = client.m_states[{ CustomPacketStateOwner::MAP, 3 }];
+    REQUIRE(playerCopy.GetNumber(0) == 1);
+    REQUIRE(!playerCopy.Has(1));
+    REQUIRE(mapCopy.GetNumber(1) == 2);
+    REQUIRE(!mapCopy.Has(0));
+
+    // a player leaving the map
+    CustomPacketWrite clear(STATE_OPCODE, MAX_FRAGMENT_SIZE, 0);
+    CustomPacketState::WriteClear(clear, CustomPacketStateOwner::MAP, 3);
+    for (CustomPacketChunk& chunk : clear.buildMessages())
+    {
+        client.ReceivePacket(chunk.FullSize(), chunk.Data());
+    }
+    clear.Destroy();
+
+    REQUIRE(client.m_valid);
+    REQUIRE(!mapCopy.Has(1));
+    REQUIRE(playerCopy.GetNumber(0) == 1);
+}
+
+TEST_CASE("[MessageState] mutation stream replay") {
+    srand(SEED);
+    CustomPacketState server;
+    StateClient client;
+    size_t deltaBytes = 0;
+    size_t snapshotBytes = 0;
+
+    // late subscriber, only receives the snapshot at the end
+    StateClient late;
+
+    for (uint32_t i = 1; i <= MUTATIONS; ++i)
+    {
+        uint32_t field = rand() % FIELDS;
+        switch (rand() % 4)
+        {
+        case 0:
+            server.SetNumber(field, rand() % 100);
+            break;
+        case 1:
+            server.SetNumber(field, (rand() % 10000) / 7.0);
+            break;
+        case 2:
+            server.SetString(field, std::string(rand() % 16, char('a' + rand() % 26)));
+            break;
+        case 3:
+            server.Remove(field);
+            break;
+        }
+
+        if (i % FLUSH_EVERY == 0)
+        {
+            if (server.IsDirty())
+            {
+                CustomPacketWrite delta(STATE_OPCODE, MAX_FRAGMENT_SIZE, 0);
+                server.WriteDelta(delta, CustomPacketStateOwner::PLAYER, 1);
+                server.ClearDirty();
+                deltaBytes += transmit(delta, client);
+            }
+
+            // what re-sending the whole state every flush would have cost
+            CustomPacketWrite snapshot(STATE_OPCODE, MAX_FRAGMENT_SIZE, 0);
+            server.WriteSnapshot(snapshot, CustomPacketStateOwner::PLAYER, 1);
+            snapshotBytes += snapshot.buildMessages().size() * CustomHeaderSize + snapshot.Size();
+            snapshot.Destroy();
+
+            REQUIRE(client.m_valid);
+            requireConverged(server, client.m_state);
+        }
+    }
+
+    CustomPacketWrite snapshot(STATE_OPCODE, MAX_FRAGMENT_SIZE, 0);
+    server.WriteSnapshot(snapshot, CustomPacketStateOwner::PLAYER, 1);
+    transmit(snapshot, late);
+    REQUIRE(late.m_valid);
+    requireConverged(server, late.m_state);
+
+    REQUIRE(deltaBytes < snapshotBytes);
+}
@@ -0,0 +1,136 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_all.hpp>
+
+#include "TSDenseHandleSet.h"
+
+#include <cstdint>
+#include <set>
+#include <vector>
+
+static std::set<uint64_t> Handles(TSDenseHandleSet<uint32_t>& set)
+{
+    std::set<uint64_t> handles;
+    set.ForEach([&](uint64_t handle, uint32_t) { handles.insert(handle); });
+    return handles;
+}
+
+TEST_CASE("[DenseHandleSet] add and swap remove") {
+    TSDenseHandleSet<uint32_t> set;
+    for (uint64_t i = 1; i <= 10; ++i)
+    {
+        REQUIRE(set.Add(i, uint32_t(i * 10)));
+    }
+    REQUIRE_FALSE(set.Add(5, 0));
+    REQUIRE_FALSE(set.Add(0, 0));
+    REQUIRE(set.Size() == 10);
+
+    REQUIRE(set.Remove(3));
+    REQUIRE_FALSE(set.Remove(3));
+    REQUIRE(set.Remove(10));
+    REQUIRE(set.Remove(1));
+    REQUIRE(set.Size() == 7);
+    REQUIRE(set.SlotCount() == 7);
+    REQUIRE(Handles(set) == std::set<uint64_t>{ 2, 4, 5, 6, 7, 8, 9 });
+
+    set.ForEach([](uint64_t handle, uint32_t value) {
+        REQUIRE(value == handle * 10);
+    });
+    REQUIRE(set.Contains(9));
+    REQUIRE_FALSE(set.Contains(10));
+}
+
+TEST_CASE("[DenseHandleSet] removal and insertion while iterating") {
+    TSDenseHandleSet<uint32_t> set;
+    for (uint64_t i = 1; i <= 100; ++i)
+    {
+        set.Add(i, uint32_t(i));
+    }
+
+    size_t visited = 0;
+    set.ForEach([&](uint64_t handle, uint32_t) {
+        ++visited;
+        // remove the entry itself, one not yet visited and add a new one
+        set.Remove(handle);
+        set.Remove(101 - handle);
+        set.Add(handle + 1000, 0);
+    });
+    // each visit removes its mirror, so only the first half is visited
+    REQUIRE(visited == 50);
+    REQUIRE(set.Size() == 50);
+    REQUIRE(set.SlotCount() == 50);
+    for (size_t i = 0; i < set.SlotCount(); ++i)
+    {
+        REQUIRE(set.HandleAt(i) > 1000);
+    }
+}
+
+TEST_CASE("[DenseHandleSet] filter and clear inside iteration") {
+    TSDenseHandleSet<uint32_t> set;
+    for (uint64_t i = 1; i <= 64; ++i)
+    {
+        set.Add(i, uint32_t(i));
+    }
+    set.Filter([](uint64_t, uint32_t value) { return value % 3 == 0; });
+    REQUIRE(set.Size() == 21);
+    REQUIRE(set.SlotCount() == 21);
+
+    size_t visited = 0;
+    set.ForEach([&](uint64_t handle, uint32_t) {
+        ++visited;
+        set.Clear();
+        set.Add(handle + 100, 0);
+    });
+    REQUIRE(visited == 1);
+    REQUIRE(set.Size() == 1);
+    REQUIRE(set.SlotCount() == 1);
+    REQUIRE(set.HandleAt(0) > 100);
+}
+
+TEST_CASE("[DenseHandleSet] removal during guarded slot iteration") {
+    TSDenseHandleSet<uint32_t> set;
+    for (uint64_t i = 1; i <= 10; ++i)
+    {
+        set.Add(i, uint32_t(i));
+    }
+
+    std::set<uint64_t> visited;
+    {
+        TSDenseHandleSet<uint32_t>::IterationGuard guard(set);
+        for (size_t slot = 0; slot < set.SlotCount(); ++slot)
+        {
+            uint64_t handle = set.HandleAt(slot);
+            if (handle == 0)
+            {
+                continue;
+            }
+            visited.insert(handle);
+            // without the guard this would swap the last entry into this slot
+            set.Remove(handle);
+        }
+        REQUIRE(set.SlotCount() == 10);
+    }
+    REQUIRE(visited.size() == 10);
+    REQUIRE(set.Size() == 0);
+    REQUIRE(set.SlotCount() == 0);
+}
+
+TEST_CASE("[DenseHandleSet] random operations match std::set") {
+    TSDenseHandleSet<uint32_t> set;
+    std::set<uint64_t> expected;
+    uint32_t state = 7;
+    auto next = [&]() { state = state * 1664525u + 1013904223u; return state >> 8; };
+    for (int i = 0; i < 20000; ++i)
+    {
+        uint64_t handle = next() % 512 + 1;
+        if (next() % 3 == 0)
+        {
+            REQUIRE(set.Remove(handle) == (expected.erase(handle) == 1));
+        }
+        else
+        {
+            REQUIRE(set.Add(handle, uint32_t(handle)) == expected.insert(handle).second);
+        }
+    }
+    REQUIRE(set.Size() == expected.size());
+    REQUIRE(Handles(set) == expected);
+}
@@ -0,0 +1,109 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_all.hpp>
+
+#include "TSLuaAllocator.h"
+
+extern "C" {
+#include "lua.h"
+#include "lauxlib.h"
+#include "lualib.h"
+}
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+static void RunScript(lua_State* L, char const* script)
+{
+    REQUIRE(luaL_dostring(L, script) == 0);
+}
+
+TEST_CASE("[LuaAllocator] attributes memory to the running module") {
+    for (bool pooled : { false, true })
+    {
+        uint32_t a = TSLuaMemory::ModuleId(pooled ? "alloc-a-pooled" : "alloc-a");
+        uint32_t b = TSLuaMemory::ModuleId(pooled ? "alloc-b-pooled" : "alloc-b");
+        REQUIRE(a != 0);
+        REQUIRE(b != a);
+        REQUIRE(TSLuaMemory::ModuleId(pooled ? "alloc-a-pooled" : "alloc-a") == a);
+        REQUIRE(TSLuaMemory::ModuleId("") == 0);
+
+        TSLuaAllocator allocator(pooled);
+        lua_State* L = lua_newstate(TSLuaAllocator::Alloc, &allocator);
+        luaL_openlibs(L);
+
+        TSLuaMemory::SetCurrentModule(a);
+        RunScript(L, "kept = {} for i = 1, 1000 do kept[i] = { i, tostring(i) } end");
+        int64_t aLive = TSLuaMemory::Module(a).m_live;
+        REQUIRE(aLive > 1000 * 16);
+
+        // b only makes garbage
+        TSLuaMemory::SetCurrentModule(b);
+        RunScript(L, "for i = 1, 1000 do local t = { i } end collectgarbage()");
+        REQUIRE(TSLuaMemory::Module(b).m_allocated > 1000 * 16);
+        REQUIRE(TSLuaMemory::Module(b).m_peak > TSLuaMemory::Module(b).m_live);
+        // frees are credited to the owner, even from another module
+        REQUIRE(TSLuaMemory::Module(a).m_live <= aLive);
+        REQUIRE(TSLuaMemory::Module(a).m_live > aLive / 2);
+
+        TSLuaMemory::SetCurrentModule(a);
+        RunScript(L, "kept = nil collectgarbage()");
+        REQUIRE(TSLuaMemory::Module(a).m_live < aLive / 10);
+
+        TSLuaMemory::SetCurrentModule(0);
+        lua_close(L);
+        REQUIRE(TSLuaMemory::Module(a).m_live == 0);
+        REQUIRE(TSLuaMemory::Module(b).m_live == 0);
+        REQUIRE(TSLuaMemory::Module(a).m_peak >= aLive);
+    }
+}
+
+TEST_CASE("[LuaAllocator] resizing moves ownership") {
+    uint32_t a = TSLuaMemory::ModuleId("resize-a");
+    uint32_t b = TSLuaMemory::ModuleId("resize-b");
+    TSLuaAllocator allocator(true);
+
+    TSLuaMemory::SetCurrentModule(a);
+    void* small = TSLuaAllocator::Alloc(&allocator, nullptr, 0, 24);
+    std::memset(small, 7, 24);
+    REQUIRE(TSLuaMemory::Module(a).m_live == 24);
+
+    // grows past the pooled sizes, keeping the contents
+    TSLuaMemory::SetCurrentModule(b);
+    void* large = TSLuaAllocator::Alloc(&allocator, small, 24, 4096);
+    REQUIRE(static_cast<unsigned char*>(large)[23] == 7);
+    REQUIRE(TSLuaMemory::Module(a).m_live == 0);
+    REQUIRE(TSLuaMemory::Module(b).m_live == 4096);
+
+    // and back into the pool
+    void* again = TSLuaAllocator::Alloc(&allocator, large, 4096, 8);
+    REQUIRE(static_cast<unsigned char*>(again)[7] == 7);
+    REQUIRE(TSLuaMemory::Module(b).m_live == 8);
+    REQUIRE(TSLuaAllocator::Alloc(&allocator, again, 8, 0) == nullptr);
+    REQUIRE(TSLuaMemory::Module(b).m_live == 0);
+    TSLuaMemory::SetCurrentModule(0);
+}
+
+TEST_CASE("[LuaAllocator] pooled blocks are reused") {
+    TSLuaAllocator allocator(true);
+    std::vector<void*> blocks;
+    size_t slabs = 0;
+    for (int round = 0; round < 4; ++round)
+    {
+        for (int i = 0; i < 10000; ++i)
+        {
+            blocks.push_back(TSLuaAllocator::Alloc(&allocator, nullptr, 0, 40));
+            REQUIRE(reinterpret_cast<uintptr_t>(blocks.back()) % 16 == 0);
+        }
+        if (round == 0)
+        {
+            slabs = allocator.GetSlabBytes();
+        }
+        REQUIRE(allocator.GetSlabBytes() == slabs);
+        for (void* block : blocks)
+        {
+            TSLuaAllocator::Alloc(&allocator, block, 40, 0);
+        }
+        blocks.clear();
+    }
+}
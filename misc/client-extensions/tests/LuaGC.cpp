@@ -0,0 +1,72 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_all.hpp>
+
+#include "TSLuaGC.h"
+
+extern "C" {
+#include "lua.h"
+#include "lauxlib.h"
+#include "lualib.h"
+}
+
+// lua 5.1 restarts the collector after a step, the server's lua does not
+static bool Step(lua_State* L, int kb)
+{
+    bool finished = lua_gc(L, LUA_GCSTEP, kb) == 1;
+    lua_gc(L, LUA_GCSTOP, 0);
+    return finished;
+}
+
+static void Churn(lua_State* L)
+{
+    REQUIRE(luaL_dostring(L, "for i = 1, 2000 do local t = { i, tostring(i) } end") == 0);
+}
+
+TEST_CASE("[LuaGC] stepping keeps up with allocation") {
+    lua_State* L = luaL_newstate();
+    luaL_openlibs(L);
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    lua_gc(L, LUA_GCSTOP, 0);
+    int baseKb = lua_gc(L, LUA_GCCOUNT, 0);
+
+    TSLuaGCStepper stepper;
+    uint32_t cycles = 0;
+    int maxKb = 0;
+    for (int tick = 0; tick < 200; ++tick)
+    {
+        int before = lua_gc(L, LUA_GCCOUNT, 0);
+        Churn(L);
+        uint64_t allocatedKb = uint64_t(lua_gc(L, LUA_GCCOUNT, 0) - before);
+        auto result = stepper.Tick(1000000000, allocatedKb, [&](int kb) { return Step(L, kb); });
+        REQUIRE(result.m_steps >= 1);
+        cycles += result.m_finishedCycle;
+        maxKb = std::max(maxKb, lua_gc(L, LUA_GCCOUNT, 0));
+    }
+    REQUIRE(cycles > 0);
+    REQUIRE(stepper.GetNsPerKb() > 0);
+    // without stepping 200 ticks of garbage would be far above this
+    REQUIRE(maxKb < baseKb + 2000);
+    lua_close(L);
+}
+
+TEST_CASE("[LuaGC] work that misses the budget is carried over") {
+    TSLuaGCStepper stepper;
+    uint32_t calls = 0;
+    auto slow = [&](int) { ++calls; return false; };
+
+    // a budget of 0 still makes one step
+    auto result = stepper.Tick(0, 100, slow);
+    REQUIRE(result.m_steps == 1);
+    REQUIRE(result.m_stepKb == 1);
+    REQUIRE(stepper.GetDebtKb() == 199);
+
+    // with time to spare the debt is paid off
+    result = stepper.Tick(1000000000, 0, slow);
+    REQUIRE(stepper.GetDebtKb() == 0);
+    REQUIRE(result.m_stepKb == 199);
+
+    // finishing a cycle clears the debt
+    result = stepper.Tick(0, 1000, [](int) { return true; });
+    REQUIRE(result.m_finishedCycle);
+    REQUIRE(stepper.GetDebtKb() == 0);
+}
@@ -0,0 +1,175 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_all.hpp>
+
+extern "C" {
+#include "lua.h"
+#include "lauxlib.h"
+#include "lualib.h"
+}
+
+#include "TSLuaJson.h"
+
+#include <string>
+
+static lua_State* NewState()
+{
+    lua_State* L = luaL_newstate();
+    luaL_openlibs(L);
+    return L;
+}
+
+// luaL_dostring drops the results in this lua version
+static void Eval(lua_State* L, std::string const& code)
+{
+    REQUIRE(luaL_loadstring(L, code.c_str()) == 0);
+    REQUIRE(lua_pcall(L, 0, 1, 0) == 0);
+}
+
+static bool Decode(lua_State* L, std::string const& json, std::string& error)
+{
+    return TSLuaJson::Decode(L, json.c_str(), json.size(), error);
+}
+
+// decodes `json` into the global `v`
+static void DecodeGlobal(lua_State* L, std::string const& json)
+{
+    std::string error;
+    REQUIRE(Decode(L, json, error));
+    REQUIRE(error.empty());
+    lua_setglobal(L, "v");
+}
+
+static bool Check(lua_State* L, char const* expression)
+{
+    Eval(L, std::string("return ") + expression);
+    bool result = lua_toboolean(L, -1) != 0;
+    lua_pop(L, 1);
+    return result;
+}
+
+static std::string Encode(lua_State* L, char const* expression)
+{
+    Eval(L, std::string("return ") + expression);
+    std::string out;
+    std::string error;
+    REQUIRE(TSLuaJson::Encode(L, -1, out, error));
+    lua_pop(L, 1);
+    return out;
+}
+
+TEST_CASE("[LuaJson] decodes objects and arrays into tables") {
+    lua_State* L = NewState();
+    DecodeGlobal(L, R"( { "a": 1, "b": [true, false, "x", 2.5], "c": { "d": -3e2 }, "e": [] } )");
+    REQUIRE(Check(L, "v.a == 1"));
+    REQUIRE(Check(L, "#v.b == 4 and v.b[1] == true and v.b[2] == false"));
+    REQUIRE(Check(L, "v.b[3] == 'x' and v.b[4] == 2.5"));
+    REQUIRE(Check(L, "v.c.d == -300"));
+    REQUIRE(Check(L, "type(v.e) == 'table' and next(v.e) == nil"));
+    REQUIRE(lua_gettop(L) == 0);
+    lua_close(L);
+}
+
+TEST_CASE("[LuaJson] null is dropped from objects and leaves holes in arrays") {
+    lua_State* L = NewState();
+    DecodeGlobal(L, R"({"a": null, "b": [1, null, 3]})");
+    REQUIRE(Check(L, "v.a == nil and next(v) == 'b' and next(v, 'b') == nil"));
+    REQUIRE(Check(L, "v.b[1] == 1 and v.b[2] == nil and v.b[3] == 3"));
+    DecodeGlobal(L, "null");
+    REQUIRE(Check(L, "v == nil"));
+    lua_close(L);
+}
+
+TEST_CASE("[LuaJson] decodes string escapes") {
+    lua_State* L = NewState();
+    DecodeGlobal(L, R"(["a\"b\\c\/\n\t", "\u0041\u00e9\u20ac", "\ud83d\ude00", "plain"])");
+    REQUIRE(Check(L, "v[1] == 'a\"b\\\\c/\\n\\t'"));
+    REQUIRE(Check(L, "v[2] == 'A\\195\\169\\226\\130\\172'"));
+    REQUIRE(Check(L, "v[3] == '\\240\\159\\152\\128'"));
+    REQUIRE(Check(L, "v[4] == 'plain'"));
+    lua_close(L);
+}
+
+TEST_CASE("[LuaJson] rejects invalid json and leaves the stack alone") {
+    lua_State* L = NewState();
+    char const* invalid[] = {
+        "", "{", "[1,]", "{\"a\" 1}", "{a: 1}", "[1] 2", "tru", "01x", "-",
+        "1.", "\"abc", "\"\\x\"", "\"\\ud800\"", "\"a\nb\"", "{\"a\":1,}",
+    };
+    for (char const* json : invalid)
+    {
+        std::string error;
+        INFO(json);
+        REQUIRE_FALSE(Decode(L, json, error));
+        REQUIRE_FALSE(error.empty());
+        REQUIRE(lua_gettop(L) == 0);
+    }
+
+    std::string error;
+    REQUIRE_FALSE(Decode(L, "[1, 2, }", error));
+    REQUIRE(error.find("offset 7") != std::string::npos);
+
+    std::string deep(300, '[');
+    REQUIRE_FALSE(Decode(L, deep + std::string(300, ']'), error));
+    REQUIRE(error.find("nested too deeply") != std::string::npos);
+    REQUIRE(lua_gettop(L) == 0);
+    lua_close(L);
+}
+
+TEST_CASE("[LuaJson] encodes tables") {
+    lua_State* L = NewState();
+    REQUIRE(Encode(L, "{1, 2.5, 'a', true}") == R"([1,2.5,"a",true])");
+    REQUIRE(Encode(L, "{a = {b = {}}}") == R"({"a":{"b":{}}})");
+    REQUIRE(Encode(L, "{[1] = 'a', [3] = 'c'}").size() == std::string(R"({"1":"a","3":"c"})").size());
+    REQUIRE(Encode(L, "{[2.5] = 1}") == R"({"2.5":1})");
+    REQUIRE(Encode(L, "'q\"\\\\\\n\\1'") == R"("q\"\\\n\u0001")");
+    REQUIRE(Encode(L, "{f = print, x = 1}") == R"({"x":1})");
+    REQUIRE(Encode(L, "{1, print, 3}") == "[1,null,3]");
+    REQUIRE(Encode(L, "-12345678901") == "-12345678901");
+    REQUIRE(Encode(L, "nil") == "null");
+    REQUIRE(lua_gettop(L) == 0);
+    lua_close(L);
+}
+
+TEST_CASE("[LuaJson] encoding fails on cycles and invalid numbers") {
+    lua_State* L = NewState();
+    Eval(L, "local t = {} t.self = t return t");
+    std::string out = "prefix";
+    std::string error;
+    REQUIRE_FALSE(TSLuaJson::Encode(L, -1, out, error));
+    REQUIRE(error.find("cycle") != std::string::npos);
+    REQUIRE(out == "prefix");
+    REQUIRE(lua_gettop(L) == 1);
+    lua_pop(L, 1);
+
+    Eval(L, "return {x = 0/0}");
+    REQUIRE_FALSE(TSLuaJson::Encode(L, -1, out, error));
+    REQUIRE(out == "prefix");
+    Eval(L, "return {[{}] = 1}");
+    REQUIRE_FALSE(TSLuaJson::Encode(L, -1, out, error));
+    REQUIRE(lua_gettop(L) == 2);
+    lua_close(L);
+}
+
+TEST_CASE("[LuaJson] round trips") {
+    lua_State* L = NewState();
+    std::string json = R"({"name":"Thrall \"Go'el\"","level":80,"pos":[1.5,-2.25,1e+20],"flags":{"pvp":true,"afk":false},"items":[{"id":19019,"count":1},{"id":6948,"count":2}]})";
+    DecodeGlobal(L, json);
+    lua_getglobal(L, "v");
+    std::string once;
+    std::string error;
+    REQUIRE(TSLuaJson::Encode(L, -1, once, error));
+    lua_pop(L, 1);
+
+    DecodeGlobal(L, once);
+    lua_getglobal(L, "v");
+    std::string twice;
+    REQUIRE(TSLuaJson::Encode(L, -1, twice, error));
+    lua_pop(L, 1);
+    // key order depends on the table, but the content does not change
+    REQUIRE(once.size() == json.size());
+    REQUIRE(twice.size() == json.size());
+    REQUIRE(Check(L, "v.name == 'Thrall \"Go\\'el\"' and v.level == 80"));
+    REQUIRE(Check(L, "v.pos[3] == 1e20 and v.items[2].id == 6948"));
+    REQUIRE(Check(L, "v.flags.pvp == true and v.flags.afk == false"));
+    lua_close(L);
+}
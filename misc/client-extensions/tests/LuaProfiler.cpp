@@ -0,0 +1,74 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_all.hpp>
+
+#include "TSSourceMap.h"
+#include "TSStackProfile.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+TEST_CASE("[SourceMap] decodes lines") {
+    // line 1: source 0 line 1
+    // line 2: source 0 line 2 (+1)
+    // line 3: no segments
+    // line 4: generated column only, then source 0 line 4 (+2)
+    // line 5: source 1 line 1 (+1 source, -3 line), second segment ignored
+    // line 6: multi-digit vlq, line 1 + 16 = 17
+    TSSourceMap map;
+    REQUIRE(map.Parse(
+        "{\"version\":3,\"file\":\"a.lua\",\"sources\":[\"a.ts\", \"dir\\/b.ts\"],"
+        "\"names\":[],\"mappings\":\"AAAA;AACA;;C,AAEA;ACHA,AAAE;AAgBA\"}"
+    ));
+    REQUIRE(map.GetSources() == std::vector<std::string>{ "a.ts", "dir/b.ts" });
+    REQUIRE(map.GetLineCount() == 6);
+
+    std::string source;
+    uint32_t line;
+    REQUIRE(map.Lookup(1, source, line));
+    REQUIRE((source == "a.ts" && line == 1));
+    REQUIRE(map.Lookup(2, source, line));
+    REQUIRE((source == "a.ts" && line == 2));
+    REQUIRE_FALSE(map.Lookup(3, source, line));
+    REQUIRE(map.Lookup(4, source, line));
+    REQUIRE((source == "a.ts" && line == 4));
+    REQUIRE(map.Lookup(5, source, line));
+    REQUIRE((source == "dir/b.ts" && line == 1));
+    REQUIRE(map.Lookup(6, source, line));
+    REQUIRE((source == "dir/b.ts" && line == 17));
+    REQUIRE_FALSE(map.Lookup(0, source, line));
+    REQUIRE_FALSE(map.Lookup(7, source, line));
+}
+
+TEST_CASE("[SourceMap] rejects documents without mappings") {
+    TSSourceMap map;
+    REQUIRE_FALSE(map.Parse("{\"version\":3,\"sources\":[\"a.ts\"]}"));
+    REQUIRE_FALSE(map.Parse(""));
+}
+
+TEST_CASE("[StackProfile] collapses stacks root first") {
+    TSStackProfile profile;
+    std::string a = "@a.lua";
+    std::string aCopy = "@a.lua";
+    std::string b = "@b lua";
+    uint32_t sa = profile.InternSource(a.c_str());
+    uint32_t sb = profile.InternSource(b.c_str());
+    REQUIRE(profile.InternSource(aCopy.c_str()) == sa);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        profile.AddSample({ { sb, 7 }, { sa, 2 } });
+    }
+    profile.AddSample({ { sa, 2 } });
+    REQUIRE(profile.GetSampleCount() == 4);
+    REQUIRE(profile.GetStackCount() == 2);
+
+    std::stringstream out;
+    profile.WriteCollapsed(out, [](std::string const& source, int32_t line) {
+        return source.substr(1) + ":" + std::to_string(line);
+    });
+    REQUIRE(out.str() == "a.lua:2 1\na.lua:2;b_lua:7 3\n");
+
+    profile.Clear();
+    REQUIRE(profile.GetSampleCount() == 0);
+}
@@ -0,0 +1,192 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_all.hpp>
+
+extern "C" {
+#include "lua.h"
+#include "lauxlib.h"
+#include "lualib.h"
+}
+
+#include "TSLuaTasks.h"
+#include "TSMPSCQueue.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Async and AwaitWorld the way TSAsync.cpp builds them, with the
+// world mailbox drained by the test instead of the world update.
+namespace
+{
+    class TestTasks : public TSLuaTasks
+    {
+    public:
+        std::vector<std::string> errors;
+    protected:
+        void OnError(lua_State* co, int status) override
+        {
+            errors.push_back(status == LUA_YIELD ? "yield" : lua_tostring(co, -1));
+        }
+    };
+
+    TestTasks tasks;
+    TSMailbox<uint32_t> world;
+
+    int LAsync(lua_State* L)
+    {
+        tasks.Start(L);
+        return 0;
+    }
+
+    void StartAwaitWorld(lua_State* L)
+    {
+        world.Post([wake = std::make_shared<TSTaskWake>(tasks, tasks.Find(L))](uint32_t tick) {
+            wake->Resume([&](lua_State* co) {
+                lua_pushinteger(co, lua_Integer(tick));
+                return 1;
+            });
+        });
+    }
+
+    int LAwaitWorld(lua_State* L)
+    {
+        TSLuaTasks::Task* task = tasks.BeginWait(L, "AwaitWorld");
+        StartAwaitWorld(L);
+        return TSLuaTasks::Yield(L, task);
+    }
+
+    struct LuaTasksFixture
+    {
+        lua_State* L;
+
+        LuaTasksFixture()
+        {
+            L = luaL_newstate();
+            luaL_openlibs(L);
+            lua_register(L, "Async", LAsync);
+            lua_register(L, "AwaitWorld", LAwaitWorld);
+            lua_newtable(L);
+            lua_setglobal(L, "log");
+        }
+
+        ~LuaTasksFixture()
+        {
+            world.Clear();
+            tasks.Clear();
+            tasks.errors.clear();
+            lua_close(L);
+        }
+
+        int Refs()
+        {
+            // live registry references, freed refs are reused from a list
+            int count = 0;
+            lua_pushnil(L);
+            while (lua_next(L, LUA_REGISTRYINDEX))
+            {
+                count += lua_type(L, -1) == LUA_TTHREAD;
+                lua_pop(L, 1);
+            }
+            return count;
+        }
+
+        std::vector<std::string> Log()
+        {
+            std::vector<std::string> out;
+            lua_getglobal(L, "log");
+            for (int i = 1; ; ++i)
+            {
+                lua_rawgeti(L, -1, i);
+                if (lua_isnil(L, -1))
+                {
+                    lua_pop(L, 1);
+                    break;
+                }
+                out.push_back(lua_tostring(L, -1));
+                lua_pop(L, 1);
+            }
+            lua_pop(L, 1);
+            return out;
+        }
+    };
+}
+
+TEST_CASE_METHOD(LuaTasksFixture, "[LuaTasks] AwaitWorld resumes when the world mailbox drains") {
+    REQUIRE(luaL_dostring(L,
+        "Async(function(name)\n"
+        "  log[#log + 1] = name\n"
+        "  local t = AwaitWorld()\n"
+        "  log[#log + 1] = name .. ' ' .. t\n"
+        "  t = AwaitWorld()\n"
+        "  log[#log + 1] = name .. ' ' .. t\n"
+        "end, 'a')\n"
+    ) == 0);
+    REQUIRE(Log() == std::vector<std::string>{ "a" });
+    REQUIRE(tasks.Count() == 1);
+    REQUIRE(world.Size() == 1);
+
+    // the second wait is posted while draining and waits for the next drain
+    REQUIRE(world.Drain(1) == 1);
+    REQUIRE(Log() == std::vector<std::string>{ "a", "a 1" });
+    REQUIRE(world.Size() == 1);
+
+    REQUIRE(world.Drain(2) == 1);
+    REQUIRE(Log() == std::vector<std::string>{ "a", "a 1", "a 2" });
+    REQUIRE(tasks.Count() == 0);
+    REQUIRE(world.Size() == 0);
+    REQUIRE(Refs() == 0);
+    REQUIRE(tasks.errors.empty());
+}
+
+TEST_CASE_METHOD(LuaTasksFixture, "[LuaTasks] dropped waits end their task") {
+    REQUIRE(luaL_dostring(L,
+        "Async(function()\n"
+        "  AwaitWorld()\n"
+        "  log[#log + 1] = 'never'\n"
+        "end)\n"
+    ) == 0);
+    REQUIRE(tasks.Count() == 1);
+    REQUIRE(Refs() == 1);
+
+    // like TSClearMailboxes before a reload
+    world.Clear();
+    REQUIRE(tasks.Count() == 0);
+    REQUIRE(Refs() == 0);
+    REQUIRE(world.Drain(1) == 0);
+    REQUIRE(Log().empty());
+}
+
+TEST_CASE_METHOD(LuaTasksFixture, "[LuaTasks] waits from before a clear are never resumed") {
+    REQUIRE(luaL_dostring(L,
+        "Async(function()\n"
+        "  AwaitWorld()\n"
+        "  log[#log + 1] = 'never'\n"
+        "end)\n"
+    ) == 0);
+    tasks.Clear();
+    REQUIRE(tasks.Count() == 0);
+    REQUIRE(world.Drain(1) == 1);
+    REQUIRE(Log().empty());
+}
+
+TEST_CASE_METHOD(LuaTasksFixture, "[LuaTasks] errors and bare yields end the task") {
+    REQUIRE(luaL_dostring(L,
+        "Async(function()\n"
+        "  AwaitWorld()\n"
+        "  error('after wait', 0)\n"
+        "end)\n"
+        "Async(function()\n"
+        "  coroutine.yield()\n"
+        "end)\n"
+    ) == 0);
+    REQUIRE(tasks.errors == std::vector<std::string>{ "yield" });
+    REQUIRE(world.Drain(1) == 1);
+    REQUIRE(tasks.errors == std::vector<std::string>{ "yield", "after wait" });
+    REQUIRE(tasks.Count() == 0);
+    REQUIRE(Refs() == 0);
+
+    // outside of a task the wait raises instead of yielding
+    REQUIRE(luaL_dostring(L, "AwaitWorld()") != 0);
+    REQUIRE(std::string(lua_tostring(L, -1)).find("can only be called inside Async") != std::string::npos);
+    lua_pop(L, 1);
+}
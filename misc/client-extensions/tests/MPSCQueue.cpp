@@ -0,0 +1,87 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_all.hpp>
+
+#include "TSMPSCQueue.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+TEST_CASE("[MPSCQueue] single thread order") {
+    TSMPSCQueue<uint32_t> queue;
+    uint32_t value;
+    REQUIRE_FALSE(queue.Pop(value));
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        queue.Push(i);
+    }
+    REQUIRE(queue.Size() == 100);
+    REQUIRE(queue.Drain([](uint32_t) {}, 10) == 10);
+    uint32_t expected = 10;
+    queue.Drain([&](uint32_t v) { REQUIRE(v == expected++); });
+    REQUIRE(expected == 100);
+    REQUIRE(queue.Size() == 0);
+}
+
+TEST_CASE("[MPSCQueue] destroys unconsumed values") {
+    auto counter = std::make_shared<int>(0);
+    std::shared_ptr<int> value;
+    {
+        TSMPSCQueue<std::shared_ptr<int>> queue;
+        for (int i = 0; i < 10; ++i)
+        {
+            queue.Push(counter);
+        }
+        REQUIRE(queue.Pop(value));
+        REQUIRE(counter.use_count() == 11);
+    }
+    REQUIRE(counter.use_count() == 2);
+}
+
+TEST_CASE("[MPSCQueue] concurrent producers keep per-producer order") {
+    uint32_t const producers = 8;
+    uint32_t const perProducer = 50000;
+    TSMPSCQueue<uint64_t> queue;
+    std::atomic<bool> go { false };
+    std::vector<std::thread> threads;
+    for (uint32_t p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p]() {
+            while (!go.load()) { std::this_thread::yield(); }
+            for (uint32_t i = 0; i < perProducer; ++i)
+            {
+                queue.Push((uint64_t(p) << 32) | i);
+            }
+        });
+    }
+    go.store(true);
+
+    // consumer drains while producers are still pushing
+    std::vector<uint32_t> next(producers, 0);
+    uint64_t received = 0;
+    uint32_t outOfOrder = 0;
+    while (received < uint64_t(producers) * perProducer)
+    {
+        received += queue.Drain([&](uint64_t value) {
+            uint32_t producer = uint32_t(value >> 32);
+            uint32_t seq = uint32_t(value);
+            outOfOrder += seq != next[producer];
+            next[producer] = seq + 1;
+        });
+        std::this_thread::yield();
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    REQUIRE(outOfOrder == 0);
+    for (uint32_t p = 0; p < producers; ++p)
+    {
+        REQUIRE(next[p] == perProducer);
+    }
+    uint64_t value;
+    REQUIRE_FALSE(queue.Pop(value));
+    REQUIRE(queue.Size() == 0);
+}
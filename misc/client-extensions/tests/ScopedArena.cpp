@@ -0,0 +1,108 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_all.hpp>
+
+#include "TSScopedArena.h"
+
+#include <cstdint>
+#include <cstring>
+
+TEST_CASE("[ScopedArena] scopes free their own allocations") {
+    TSScopedArena arena(256);
+    void* outside = arena.Allocate(16);
+    std::memset(outside, 1, 16);
+    {
+        TSArenaScope outer(arena);
+        void* a = arena.Allocate(24);
+        size_t afterA = arena.GetUsed();
+        {
+            TSArenaScope inner(arena);
+            for (int i = 0; i < 100; ++i)
+            {
+                arena.Allocate(40);
+            }
+            REQUIRE(arena.GetUsed() > 1000);
+        }
+        REQUIRE(arena.GetUsed() == afterA);
+        // the next allocation reuses the inner scope's memory
+        void* b = arena.Allocate(8);
+        REQUIRE(static_cast<char*>(b) > static_cast<char*>(a));
+        REQUIRE(static_cast<char*>(b) - static_cast<char*>(a) < 64);
+    }
+    // allocations outside of scopes are kept
+    REQUIRE(arena.GetUsed() == 16);
+    REQUIRE(static_cast<unsigned char*>(outside)[15] == 1);
+    arena.Clear();
+    REQUIRE(arena.GetUsed() == 0);
+}
+
+TEST_CASE("[ScopedArena] memory stays flat across scopes") {
+    TSScopedArena arena(1024);
+    size_t reserved = 0;
+    for (int round = 0; round < 1000; ++round)
+    {
+        TSArenaScope scope(arena);
+        for (int i = 0; i < 50; ++i)
+        {
+            void* ptr = arena.Allocate(8 + i % 24);
+            REQUIRE(reinterpret_cast<uintptr_t>(ptr) % alignof(std::max_align_t) == 0);
+        }
+        // larger than a page
+        arena.Allocate(4096);
+        if (round == 0)
+        {
+            reserved = arena.GetReserved();
+        }
+        REQUIRE(arena.GetReserved() == reserved);
+    }
+    REQUIRE(arena.GetUsed() == 0);
+    REQUIRE(arena.GetReserved() < reserved);
+    REQUIRE(arena.GetTotal() > 1000 * 4096);
+}
+
+TEST_CASE("[ScopedArena] debug mode catches writes after a scope ends") {
+    TSScopedArena arena(256);
+    arena.SetDebug(true);
+    REQUIRE(arena.IsDebug());
+    void* escaped = nullptr;
+    size_t reported = 0;
+    arena.SetEscapeHandler([&](void*, size_t size) { reported += size; });
+    {
+        TSArenaScope scope(arena);
+        escaped = arena.Allocate(16);
+        std::memset(escaped, 0, 16);
+    }
+    {
+        TSArenaScope scope(arena);
+        arena.Allocate(16);
+        REQUIRE(arena.GetEscapes() == 0);
+    }
+
+    // under asan these are reported by asan itself
+#ifndef TS_ARENA_ASAN
+    // freed memory reads back as poison
+    REQUIRE(static_cast<unsigned char*>(escaped)[0] == TSScopedArena::POISON);
+    static_cast<char*>(escaped)[3] = 7;
+    {
+        TSArenaScope scope(arena);
+        arena.Allocate(16);
+    }
+    REQUIRE(arena.GetEscapes() == 1);
+    REQUIRE(reported == 16);
+#endif
+}
+
+TEST_CASE("[ScopedArena] debug mode switches when empty") {
+    TSScopedArena arena(256);
+    {
+        TSArenaScope scope(arena);
+        arena.Allocate(16);
+        arena.SetDebug(true);
+        REQUIRE_FALSE(arena.IsDebug());
+    }
+    REQUIRE(arena.IsDebug());
+    arena.Allocate(16);
+    arena.SetDebug(false);
+    REQUIRE(arena.IsDebug());
+    arena.Clear();
+    REQUIRE_FALSE(arena.IsDebug());
+}
@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "TSAsync.h"
+#include "TSAsyncScheduler.h"
+#include "TSDatabase.h"
+#include "TSEvent.h"
+#include "TSEventStats.h"
+#include "TSLuaTasks.h"
+#include "TSMainThreadContext.h"
+#include "TSMap.h"
+#include "TSMapMailbox.h"
+#include "TSTimer.h"
+#include "TSWorldObject.h"
+
+#include "Map.h"
+#include "MapManager.h"
+#include "Object.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * Tasks resumed by the server, timed as "Lua.Async" and
+ * with their errors reported like any other lua callback.
+ */
+class TSServerTasks : public TSLuaTasks
+{
+public:
+    void Resume(std::shared_ptr<Task> const& task, int nargs) override
+    {
+        // shows as "Lua.Async [tswow]" in .tswow perf
+        TS_CALLBACK_ZONE(TSGetSystemStats("Lua", "Async"))
+        TSLuaTasks::Resume(task, nargs);
+    }
+protected:
+    void OnError(lua_State* co, int status) override
+    {
+        if (status == LUA_YIELD)
+        {
+            TS_LOG_ERROR("tswow.lua", "Async tasks can only yield through Sleep or an Await function, the task was ended");
+            return;
+        }
+        luaL_traceback(co, co, lua_tostring(co, -1), 0);
+        TSLua::handle_error(sol::protected_function_result(co, -1, 1, 2, sol::call_status(status)));
+    }
+};
+
+// lua on map threads can start waits, resumed tasks start new ones while
+// the scheduler ticks
+static std::recursive_mutex schedulerLock;
+static TSAsyncScheduler scheduler;
+static TSServerTasks tasks;
+
+static std::shared_ptr<TSTaskWake> MakeWake(lua_State* L)
+{
+    return std::make_shared<TSTaskWake>(tasks, tasks.Find(L));
+}
+
+template <typename T>
+static void ResumeWith(TSTaskWake& wake, T const& value)
+{
+    wake.Resume([&](lua_State* co) {
+        return sol::stack::push(co, value);
+    });
+}
+
+static TSAsyncScheduler::Resume WakeResume(std::shared_ptr<TSTaskWake> wake)
+{
+    return [wake](bool cancelled) {
+        if (!cancelled)
+        {
+            wake->Resume();
+        }
+    };
+}
+
+void TSAsyncTick()
+{
+    std::scoped_lock lock(schedulerLock);
+    scheduler.Tick(now());
+}
+
+void TSClearAsync()
+{
+    {
+        std::scoped_lock lock(schedulerLock);
+        scheduler.Clear();
+    }
+    // the lua state is replaced next, taking the coroutines with it
+    tasks.Clear();
+}
+
+TSNumber<uint32> GetAsyncTaskCount()
+{
+    return tasks.Count();
+}
+
+int LAsync(lua_State* L)
+{
+    tasks.Start(L);
+    return 0;
+}
+
+static void StartSleep(lua_State* L)
+{
+    // arguments first, they can raise lua errors
+    uint64 delay = uint64(std::max<lua_Integer>(luaL_checkinteger(L, 1), 0));
+    bool owned = !lua_isnoneornil(L, 2);
+    TSWorldObject owner = owned ? sol::stack::get<TSWorldObject>(L, 2) : TSWorldObject(nullptr);
+
+    std::shared_ptr<TSTaskWake> wake = MakeWake(L);
+    std::scoped_lock lock(schedulerLock);
+    if (!owned)
+    {
+        scheduler.Sleep(now(), delay, WakeResume(wake));
+        return;
+    }
+    if (!owner || !owner->obj->IsInWorld())
+    {
+        // already gone, ends the task next update
+        scheduler.Sleep(now(), 0, WakeResume(wake), std::weak_ptr<void>());
+        return;
+    }
+    scheduler.Sleep(now(), delay, [owner, wake](bool cancelled) {
+        // not cancelled means the owner still exists, but it might have despawned
+        if (!cancelled && owner.obj->IsInWorld())
+        {
+            wake->Resume();
+        }
+    }, owner.obj->m_tsEntity.m_lifetime.Get());
+}
+
+int LSleep(lua_State* L)
+{
+    TSLuaTasks::Task* task = tasks.BeginWait(L, "Sleep");
+    StartSleep(L);
+    return TSLuaTasks::Yield(L, task);
+}
+
+static void StartAwaitWorld(lua_State* L)
+{
+    PostToWorld([wake = MakeWake(L)](TSMainThreadContext ctx) {
+        ResumeWith(*wake, ctx);
+    });
+}
+
+int LAwaitWorld(lua_State* L)
+{
+    TSLuaTasks::Task* task = tasks.BeginWait(L, "AwaitWorld");
+    StartAwaitWorld(L);
+    return TSLuaTasks::Yield(L, task);
+}
+
+static bool StartAwaitMap(lua_State* L)
+{
+    uint32 mapId = uint32(luaL_checkinteger(L, 1));
+    uint32 instanceId = uint32(luaL_optinteger(L, 2, 0));
+    std::shared_ptr<TSTaskWake> wake = MakeWake(L);
+    if (PostToMap(mapId, instanceId, [wake](TSMap map) {
+        ResumeWith(*wake, map);
+    }))
+    {
+        return true;
+    }
+
+    // map mailboxes are only open once the core drains them, until then
+    // the task continues on the world thread while no map is updating
+    if (!sMapMgr->FindMap(mapId, instanceId))
+    {
+        // the task keeps running
+        wake->Cancel();
+        return false;
+    }
+    PostToWorld([wake, mapId, instanceId](TSMainThreadContext) {
+        if (Map* map = sMapMgr->FindMap(mapId, instanceId))
+        {
+            ResumeWith(*wake, TSMap(map));
+        }
+        else
+        {
+            ResumeWith(*wake, sol::lua_nil);
+        }
+    });
+    return true;
+}
+
+int LAwaitMap(lua_State* L)
+{
+    TSLuaTasks::Task* task = tasks.BeginWait(L, "AwaitMap");
+    if (!StartAwaitMap(L))
+    {
+        lua_pushnil(L);
+        return 1;
+    }
+    return TSLuaTasks::Yield(L, task);
+}
+
+template <void (*Query)(std::string const&, std::function<void(std::shared_ptr<TSDatabaseResult>)>)>
+static void StartAwaitQuery(lua_State* L)
+{
+    char const* query = luaL_checkstring(L, 1);
+    std::string sql = query;
+    auto result = std::make_shared<std::shared_ptr<TSDatabaseResult>>();
+    uint64 id;
+    {
+        std::scoped_lock lock(schedulerLock);
+        id = scheduler.Suspend([result, wake = MakeWake(L)](bool cancelled) {
+            if (!cancelled)
+            {
+                ResumeWith(*wake, *result);
+            }
+        });
+    }
+    Query(sql, [id, result](std::shared_ptr<TSDatabaseResult> res) {
+        *result = res;
+        scheduler.Complete(id);
+    });
+}
+
+int LAwaitQueryWorld(lua_State* L)
+{
+    TSLuaTasks::Task* task = tasks.BeginWait(L, "AwaitQueryWorld");
+    StartAwaitQuery<QueryWorldAsync>(L);
+    return TSLuaTasks::Yield(L, task);
+}
+
+int LAwaitQueryCharacters(lua_State* L)
+{
+    TSLuaTasks::Task* task = tasks.BeginWait(L, "AwaitQueryCharacters");
+    StartAwaitQuery<QueryCharactersAsync>(L);
+    return TSLuaTasks::Yield(L, task);
+}
+
+int LAwaitQueryAuth(lua_State* L)
+{
+    TSLuaTasks::Task* task = tasks.BeginWait(L, "AwaitQueryAuth");
+    StartAwaitQuery<QueryAuthAsync>(L);
+    return TSLuaTasks::Yield(L, task);
+}
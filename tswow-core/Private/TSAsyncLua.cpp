@@ -0,0 +1,14 @@
+#include "TSLua.h"
+#include "TSAsync.h"
+
+void TSLua::load_async_functions(sol::state& state)
+{
+    state.set_function("Async", LAsync);
+    state.set_function("Sleep", LSleep);
+    state.set_function("AwaitWorld", LAwaitWorld);
+    state.set_function("AwaitMap", LAwaitMap);
+    state.set_function("AwaitQueryWorld", LAwaitQueryWorld);
+    state.set_function("AwaitQueryCharacters", LAwaitQueryCharacters);
+    state.set_function("AwaitQueryAuth", LAwaitQueryAuth);
+    state.set_function("GetAsyncTaskCount", GetAsyncTaskCount);
+}
@@ -225,3 +225,26 @@ TSLua::Array<TSNumber<uint32>> TSAuctionHouseObject::LGetKeys()
 {
     return sol::as_table(*GetKeys().vec);
 }
+
+TSLua::Iterator<TSNumber<uint32>> TSAuctionHouseObject::LIterateKeys()
+{
+    // the loop body can remove any auction, so keys are checked
+    // again every step
+    std::vector<uint32> keys;
+    keys.reserve(obj->Getcount());
+    for (auto itr = obj->GetAuctionsBegin(); itr != obj->GetAuctionsEnd(); ++itr)
+    {
+        keys.push_back(itr->first);
+    }
+    return TSLua::CallbackIterator<TSNumber<uint32>>([obj = obj, keys = std::move(keys), index = size_t(0)]() mutable -> sol::optional<TSNumber<uint32>> {
+        while (index < keys.size())
+        {
+            uint32 key = keys[index++];
+            if (obj->GetAuction(key))
+            {
+                return key;
+            }
+        }
+        return sol::nullopt;
+    });
+}
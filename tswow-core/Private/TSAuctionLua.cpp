@@ -34,6 +34,7 @@ void TSLua::load_auction_methods(sol::state& state)
 
     auto ts_auctionhouseobject = state.new_usertype<TSAuctionHouseObject>("TSAuctionHouseObject");
     ts_auctionhouseobject.set_function("GetKeys", &TSAuctionHouseObject::LGetKeys);
+    ts_auctionhouseobject.set_function("IterateKeys", &TSAuctionHouseObject::LIterateKeys);
     LUA_FIELD(ts_auctionhouseobject, TSAuctionHouseObject, GetEntry);
     LUA_FIELD(ts_auctionhouseobject, TSAuctionHouseObject, GetCount);
     LUA_FIELD(ts_auctionhouseobject, TSAuctionHouseObject, AddAuction);
@@ -650,6 +650,28 @@ TSArray<TSBattlegroundPlayer> TSBattleground::GetBGPlayers()
     return players;
 }
 
+TSLua::Iterator<TSBattlegroundPlayer> TSBattleground::LIterateBGPlayers()
+{
+    // looks up the next guid every step, so players can leave during the loop
+    return TSLua::CallbackIterator<TSBattlegroundPlayer>([bg = *this, last = sol::optional<ObjectGuid>()]() mutable -> sol::optional<TSBattlegroundPlayer> {
+        auto const& players = bg.bg->GetPlayers();
+        auto itr = last ? players.upper_bound(*last) : players.begin();
+        if (itr == players.end())
+        {
+            return sol::nullopt;
+        }
+        last = itr->first;
+        return TSBattlegroundPlayer(
+              bg
+            , itr->first.GetRawValue()
+#if TRINITY
+            , itr->second.Team
+            , itr->second.OfflineRemoveTime
+#endif
+        );
+    });
+}
+
 TSBattlegroundScore TSBattleground::GetScore(TSGUID guid)
 {
     auto itr = bg->PlayerScores.find(guid.GetCounter());
@@ -86,6 +86,7 @@ void TSLua::load_battleground_methods(sol::state& state)
     LUA_FIELD(ts_battleground, TSBattleground, GetStatus);
     LUA_FIELD(ts_battleground, TSBattleground, IsRandom);
     LUA_FIELD(ts_battleground, TSBattleground, GetBGPlayers);
+    ts_battleground.set_function("IterateBGPlayers", &TSBattleground::LIterateBGPlayers);
     LUA_FIELD(ts_battleground, TSBattleground, SetStartPosition);
     LUA_FIELD(ts_battleground, TSBattleground, GetStartX);
     LUA_FIELD(ts_battleground, TSBattleground, GetStartY);
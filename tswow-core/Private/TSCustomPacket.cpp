@@ -3,11 +3,22 @@
 #include "TSEvents.h"
 #include "WorldPacket.h"
 #include "CustomPacketChunk.h"
+#include "CustomPacketBatch.h"
 #include "Player.h"
+#include "ObjectAccessor.h"
 
 #include "TSMap.h"
 #include "Map.h"
 #include "TSBattleground.h"
+#include "TSPacketRecorder.h"
+
+#include "Timer.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 
 TSPacketWrite::TSPacketWrite(CustomPacketWrite* write)
 	: write(write)
@@ -17,8 +28,106 @@ TSPacketRead::TSPacketRead(CustomPacketRead* read)
 	: read(read)
 {}
 
+static std::atomic<bool> batching = false;
+static std::atomic<totalSize_t> batchThreshold = 0;
+static std::mutex batchLock;
+// player guid -> containers queued this tick
+static std::unordered_map<uint64, std::vector<CustomPacketBatch>> batches;
+
+static bool CanBatch(CustomPacketWrite* write)
+{
+	return batching
+		&& write->ChunkCount() == 1
+		&& write->Size() <= batchThreshold;
+}
+
+static void QueueBatched(Player* player, CustomPacketWrite* write)
+{
+	std::scoped_lock lock(batchLock);
+	std::vector<CustomPacketBatch>& queue = batches[player->GetGUID().GetRawValue()];
+	if (queue.empty() || !queue.back().Add(*write))
+	{
+		queue.emplace_back();
+		queue.back().Add(*write);
+	}
+}
+
+void SetCustomPacketBatching(bool enabled, totalSize_t threshold)
+{
+	// a single message must always fit in an empty container
+	totalSize_t max = CustomPacketBatch::Capacity() - CustomPacketBatch::EntrySize(0);
+	batchThreshold = std::min(threshold, max);
+	batching = enabled;
+}
+
+bool IsCustomPacketBatching()
+{
+	return batching;
+}
+
+static void SendBatches(Player* player, std::vector<CustomPacketBatch>& queue)
+{
+	for (CustomPacketBatch& batch : queue)
+	{
+		if (player)
+		{
+			for (auto& chunk : batch.Container().buildMessages())
+			{
+				WorldPacket packet(SERVER_TO_CLIENT_OPCODE, chunk.FullSize());
+				packet.append((uint8_t*)chunk.Data(), chunk.FullSize());
+				player->SendDirectMessage(&packet);
+			}
+		}
+		batch.Container().Destroy();
+	}
+}
+
+void FlushCustomPacketBatches()
+{
+	std::unordered_map<uint64, std::vector<CustomPacketBatch>> flushing;
+	{
+		std::scoped_lock lock(batchLock);
+		flushing.swap(batches);
+	}
+
+	for (auto& [guid, queue] : flushing)
+	{
+		SendBatches(ObjectAccessor::FindConnectedPlayer(ObjectGuid(guid)), queue);
+	}
+}
+
+// Sends what is queued for a player before anything unbatched,
+// so they receive messages in the order they were sent.
+static void FlushBatch(Player* player)
+{
+	if (!batching)
+	{
+		return;
+	}
+	std::vector<CustomPacketBatch> queue;
+	{
+		std::scoped_lock lock(batchLock);
+		auto itr = batches.find(player->GetGUID().GetRawValue());
+		if (itr == batches.end())
+		{
+			return;
+		}
+		queue.swap(itr->second);
+		batches.erase(itr);
+	}
+	SendBatches(player, queue);
+}
+
 void TSPacketWrite::SendToPlayer(TSPlayer player)
 {
+	if (CanBatch(write))
+	{
+		QueueBatched(player.player, write);
+		write->Destroy();
+		return;
+	}
+
+	FlushBatch(player.player);
 	auto & arr = write->buildMessages();
 	for (auto & chunk : arr)
 	{
@@ -32,6 +141,30 @@ void TSPacketWrite::SendToPlayer(TSPlayer player)
 
 void TSPacketWrite::BroadcastMap(TSMap map, uint32_t teamOnly)
 {
+	if (CanBatch(write))
+	{
+		for (auto const& ref : map.map->GetPlayers())
+		{
+			Player* player = ref.GetSource();
+#if TRINITY
+			if (teamOnly == 0 || player->GetTeam() == teamOnly)
+#endif
+			{
+				QueueBatched(player, write);
+			}
+		}
+		write->Destroy();
+		return;
+	}
+
+	if (batching)
+	{
+		for (auto const& ref : map.map->GetPlayers())
+		{
+			FlushBatch(ref.GetSource());
+		}
+	}
+
 	auto& arr = write->buildMessages();
 	for (auto& chunk : arr)
 	{
@@ -54,6 +187,20 @@ void TSPacketWrite::BroadcastMap(TSMap map, uint32_t teamOnly)
 
 void TSPacketWrite::BroadcastAround(TSWorldObject obj, float range, bool self)
 {
+	if (batching && obj.obj->IsInWorld())
+	{
+		// every player the message can reach is within range in 2d,
+		// flushing a few more than that is harmless
+		for (auto const& ref : obj.obj->GetMap()->GetPlayers())
+		{
+			Player* player = ref.GetSource();
+			if (player->GetExactDist2d(obj.obj) <= range)
+			{
+				FlushBatch(player);
+			}
+		}
+	}
+
 	auto& arr = write->buildMessages();
 	for (auto& chunk : arr)
 	{
@@ -65,58 +212,319 @@ void TSPacketWrite::BroadcastAround(TSWorldObject obj, float range, bool self)
 	write->Destroy();
 }
 
-TSServerBuffer::TSServerBuffer(TSPlayer player)
+struct RateLimit
+{
+	float m_rate = 0;
+	float m_burst = 0;
+};
+
+static std::shared_mutex rateLimitLock;
+static std::unordered_map<opcode_t, RateLimit> rateLimits;
+static RateLimit defaultRateLimit;
+
+struct PacketSchema
+{
+	totalSize_t m_minSize = 0;
+	totalSize_t m_maxSize = 0;
+	std::function<bool(CustomPacketRead*)> m_validator;
+};
+
+static std::shared_mutex schemaLock;
+static std::unordered_map<opcode_t, PacketSchema> schemas;
+
+// player guid -> counters of their current session
+static std::mutex sessionStatsLock;
+static std::unordered_map<uint64, std::weak_ptr<TSCustomPacketSessionStats>> sessionStats;
+
+void SetCustomPacketRateLimit(opcode_t opcode, float rate, float burst)
+{
+	std::unique_lock lock(rateLimitLock);
+	rateLimits[opcode] = { rate, std::max(burst, 1.0f) };
+}
+
+void SetDefaultCustomPacketRateLimit(float rate, float burst)
+{
+	std::unique_lock lock(rateLimitLock);
+	defaultRateLimit = { rate, std::max(burst, 1.0f) };
+}
+
+void SetCustomPacketSchema(opcode_t opcode, totalSize_t minSize, totalSize_t maxSize)
+{
+	std::unique_lock lock(schemaLock);
+	schemas[opcode].m_minSize = minSize;
+	schemas[opcode].m_maxSize = maxSize;
+}
+
+void SetCustomPacketValidator(opcode_t opcode, std::function<bool(CustomPacketRead*)> validator)
+{
+	std::unique_lock lock(schemaLock);
+	schemas[opcode].m_validator = validator;
+}
+
+static RateLimit GetRateLimit(opcode_t opcode)
+{
+	std::shared_lock lock(rateLimitLock);
+	auto itr = rateLimits.find(opcode);
+	return itr == rateLimits.end() ? defaultRateLimit : itr->second;
+}
+
+bool GetCustomPacketStats(
+	  uint64 playerGuid
+	, std::map<opcode_t, TSCustomPacketOpcodeStats>& out
+) {
+	std::shared_ptr<TSCustomPacketSessionStats> stats;
+	{
+		std::scoped_lock lock(sessionStatsLock);
+		auto itr = sessionStats.find(playerGuid);
+		if (itr == sessionStats.end())
+		{
+			return false;
+		}
+		stats = itr->second.lock();
+	}
+
+	if (!stats)
+	{
+		return false;
+	}
+	std::scoped_lock lock(stats->m_lock);
+	out = stats->m_opcodes;
+	return true;
+}
+
+TSServerBuffer::TSServerBuffer(TSPlayer player, bool replay)
 	: CustomPacketBuffer(
 		  MIN_FRAGMENT_SIZE
 		, BUFFER_QUOTA
 		, MAX_FRAGMENT_SIZE
 	)
 	, m_player(player)
+	, m_stats(std::make_shared<TSCustomPacketSessionStats>())
+	, m_replay(replay)
+{
+}
+
+TSServerBuffer::~TSServerBuffer()
 {
+	if (m_guid)
+	{
+		std::scoped_lock lock(sessionStatsLock);
+		auto itr = sessionStats.find(m_guid);
+		// a new session may already have replaced us
+		if (itr != sessionStats.end() && itr->second.lock() == m_stats)
+		{
+			sessionStats.erase(itr);
+		}
+	}
+}
+
+bool TSServerBuffer::Account(opcode_t opcode, totalSize_t size)
+{
+	if (!m_guid && !m_replay)
+	{
+		// the player is not guaranteed to be set up in the constructor
+		m_guid = m_player.player->GetGUID().GetRawValue();
+		std::scoped_lock lock(sessionStatsLock);
+		sessionStats[m_guid] = m_stats;
+	}
+
+	RateLimit limit = GetRateLimit(opcode);
+	bool limited = false;
+	{
+		std::scoped_lock lock(m_stats->m_lock);
+		TSCustomPacketOpcodeStats& stats = m_stats->m_opcodes[opcode];
+		stats.m_packets++;
+		stats.m_bytes += size;
+		if (limit.m_rate > 0)
+		{
+			uint32 now = getMSTime();
+			if (stats.m_tokens < 0)
+			{
+				stats.m_tokens = limit.m_burst;
+			}
+			else
+			{
+				stats.m_tokens = std::min<double>(
+					  limit.m_burst
+					, stats.m_tokens + getMSTimeDiff(stats.m_lastRefill, now) * limit.m_rate / 1000.0
+				);
+			}
+			stats.m_lastRefill = now;
+
+			if (stats.m_tokens < 1)
+			{
+				limited = true;
+			}
+			else
+			{
+				stats.m_tokens -= 1;
+			}
+		}
+	}
+
+	if (!limited)
+	{
+		return true;
+	}
+
+	bool drop = true;
+	FIRE_ID(
+		  opcode
+		, CustomPacket,OnRateLimited
+		, TSNumber<uint32>(opcode)
+		, m_player
+		, TSMutable<bool,bool>(&drop)
+	)
+	if (drop)
+	{
+		std::scoped_lock lock(m_stats->m_lock);
+		m_stats->m_opcodes[opcode].m_dropped++;
+	}
+	return !drop;
+}
+
+bool TSServerBuffer::Validate(CustomPacketRead* value)
+{
+	bool valid = true;
+	{
+		std::shared_lock lock(schemaLock);
+		auto itr = schemas.find(value->Opcode());
+		if (itr != schemas.end())
+		{
+			PacketSchema const& schema = itr->second;
+			if (schema.m_maxSize > 0)
+			{
+				valid = value->Size() >= schema.m_minSize && value->Size() <= schema.m_maxSize;
+			}
+			if (valid && schema.m_validator)
+			{
+				valid = schema.m_validator(value);
+				value->Reset();
+			}
+		}
+	}
+
+	if (!valid)
+	{
+		std::scoped_lock lock(m_stats->m_lock);
+		m_stats->m_opcodes[value->Opcode()].m_invalid++;
+	}
+	return valid;
 }
 
 void TSServerBuffer::OnPacket(CustomPacketRead* value)
 {
+	if (!Validate(value))
+	{
+		return;
+	}
+	Dispatch(value);
+}
+
+void TSServerBuffer::Dispatch(CustomPacketRead* value)
+{
+	opcode_t opcode = value->Opcode();
+	if (!m_replay)
+	{
+		CaptureCustomPacket(value, m_player.player->GetGUID().GetRawValue());
+	}
+	if (!Account(opcode, value->Size()))
+	{
+		return;
+	}
+	auto start = std::chrono::steady_clock::now();
+
 	// Expanded FIRE_ID macro because we need to reset the packet
 	// reading head between every invocation.
 	// Please do not change this to some auto-resetting macro abuse,
 	// it would NOT be guaranteed to work in the long term.
+	ZoneScopedN("CustomPacket.OnReceive");
 
 	TSPacketRead read(value);
-	opcode_t opcode = value->Opcode();
 
 	auto& cbs = ts_events.CustomPacket.OnReceive_callbacks;
-	for (auto const& cb : cbs.m_cxx_callbacks)
+	for (size_t i = 0; i < cbs.m_cxx_callbacks.size(); ++i)
 	{
+		auto cb = cbs.m_cxx_callbacks[i];
+		{
+			TS_CALLBACK_ZONE(cbs.stats_at(cbs.m_cxx_stats, i))
 			cb(opcode, read, m_player);
+		}
+		value->Reset();
 	}
 
-	for (auto const& cb : cbs.m_lua_callbacks)
+	for (size_t i = 0; i < cbs.m_lua_callbacks.size(); ++i)
 	{
-			cb(opcode, read, m_player);
-			value->Reset();
+		auto cb = cbs.m_lua_callbacks[i];
+		TSCallbackStats* stats = cbs.stats_at(cbs.m_lua_stats, i);
+		TS_SKIP_DISABLED(stats)
+		{
+			// lua callbacks always get a frame, which scopes their arena temporaries
+			TS_CALLBACK_ZONE(stats)
+			TSLua::handle_error(cb(opcode, read, m_player));
+		}
+		value->Reset();
 	}
 
 	if (opcode < cbs.m_id_cxx_callbacks.size())
 	{
-			for (auto const& cb : cbs.m_id_cxx_callbacks[opcode])
+		auto id_cbs = cbs.m_id_cxx_callbacks[opcode];
+		for (size_t i = 0; i < id_cbs.size(); ++i)
+		{
 			{
-					cb(opcode, read, m_player);
-					value->Reset();
+				TS_CALLBACK_ZONE(cbs.id_stats_at(cbs.m_id_cxx_stats, opcode, i))
+				id_cbs[i](opcode, read, m_player);
 			}
+			value->Reset();
+		}
 	}
 
 	if (opcode < cbs.m_id_lua_callbacks.size())
 	{
-			for (auto const& cb : cbs.m_id_lua_callbacks[opcode])
+		auto id_cbs = cbs.m_id_lua_callbacks[opcode];
+		for (size_t i = 0; i < id_cbs.size(); ++i)
+		{
+			TSCallbackStats* stats = cbs.id_stats_at(cbs.m_id_lua_stats, opcode, i);
+			TS_SKIP_DISABLED(stats)
 			{
-					cb(opcode, read, m_player);
-					value->Reset();
+				TS_CALLBACK_ZONE(stats)
+				TSLua::handle_error(id_cbs[i](opcode, read, m_player));
 			}
+			value->Reset();
+		}
 	}
+
+	uint64 elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - start
+	).count();
+	std::scoped_lock lock(m_stats->m_lock);
+	m_stats->m_opcodes[opcode].m_handlerMicroseconds += elapsed;
 }
 
 void TSServerBuffer::OnError(CustomPacketResult error)
+{
+	if (m_replay)
+	{
+		return;
+	}
+	Kick(error);
+}
+
+void TSServerBuffer::CopyStats(std::map<opcode_t, TSCustomPacketOpcodeStats>& out)
+{
+	std::scoped_lock lock(m_stats->m_lock);
+	for (auto const& [opcode, stats] : m_stats->m_opcodes)
+	{
+		TSCustomPacketOpcodeStats& total = out[opcode];
+		total.m_packets += stats.m_packets;
+		total.m_bytes += stats.m_bytes;
+		total.m_dropped += stats.m_dropped;
+		total.m_invalid += stats.m_invalid;
+		total.m_handlerMicroseconds += stats.m_handlerMicroseconds;
+	}
+}
+
+void TSServerBuffer::Kick(CustomPacketResult error)
 {
 	m_player.player->GetSession()->KickPlayer("Custom packet error: "+std::to_string(uint32_t(error)));
 }
@@ -39,4 +39,6 @@ void TSLua::load_packet_methods(sol::state& state)
     LUA_FIELD_OVERLOAD_RET_0_1(ts_packetread, TSPacketRead, ReadString, std::string const&);
     LUA_FIELD(ts_packetread, TSPacketRead, Size);
     state.set_function("CreateCustomPacket", CreateCustomPacket);
+    state.set_function("SetCustomPacketRateLimit", SetCustomPacketRateLimit);
+    state.set_function("SetCustomPacketSchema", SetCustomPacketSchema);
 }
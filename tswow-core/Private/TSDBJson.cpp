@@ -2,89 +2,11 @@
 
 #include "CharacterDatabase.h"
 
-#include <nlohmann/json.hpp>
-
 TSDBJson::TSDBJson(DBJsonEntityType type, uint32 id)
     : m_id(id), m_type(type)
 {
 }
 
-static nlohmann::json lua_to_json(sol::table table)
-{
-    nlohmann::json json;
-    for (auto& [key, value] : table)
-    {
-        std::string s_key;
-        switch (key.get_type())
-        {
-        case sol::type::number: {
-            s_key = std::to_string(key.as<double>());
-            break;
-        }
-        case sol::type::string: {
-            s_key = key.as<std::string>();
-            break;
-        }
-        case sol::type::boolean: {
-            s_key = key.as<bool>();
-            break;
-        }
-        default:
-            break;
-        }
-
-        switch (value.get_type())
-        {
-        case sol::type::boolean: {
-            json[s_key] = value.as<bool>();
-            break;
-        }
-        case sol::type::number: {
-            json[s_key] = value.as<double>();
-            break;
-        }
-        case sol::type::string: {
-            json[s_key] = value.as<std::string>();
-            break;
-        }
-        case sol::type::table: {
-            json[s_key] = lua_to_json(value.as<sol::table>());
-            break;
-        }
-        default:
-            break;
-        }
-    }
-    return json;
-}
-
-static sol::table json_to_lua(nlohmann::json json)
-{
-    sol::table table = TSLua::GetState().create_table();
-    for (auto& [key,value] : json.items())
-    {
-        switch (value.type())
-        {
-        case nlohmann::detail::value_t::boolean:
-            table[key] = value.get<bool>();
-            break;
-        case nlohmann::detail::value_t::number_float:
-        case nlohmann::detail::value_t::number_integer:
-        case nlohmann::detail::value_t::number_unsigned:
-            table[key] = value.get<float>();
-            break;
-        case nlohmann::detail::value_t::string:
-            table[key] = value.get<std::string>();
-            break;
-        case nlohmann::detail::value_t::object:
-            table[key] = json_to_lua(value);
-            break;
-        }
-    }
-
-    return table;
-}
-
 void TSDBJson::Save()
 {
     if (m_json.get_length() > 0 || m_dirty_deleted)
@@ -126,12 +48,6 @@ void TSDBJson::Load()
                 m_json.Parse(field[1].GetString());
                 break;
             }
-            /*
-            case DBJsonTableType::LUA: {
-                m_lua = json_to_lua(nlohmann::json::parse(field[1].GetString()));
-                break;
-            }
-            */
             }
         } while (result->NextRow());
     }
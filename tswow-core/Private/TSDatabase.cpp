@@ -23,8 +23,13 @@
 #include "LoginDatabase.h"
 #include "CharacterDatabase.h"
 #include "QueryResult.h"
+#include "QueryCallback.h"
+#include "QueryCallbackProcessor.h"
 #include <memory>
 #include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 class TC_GAME_API TSDatabaseImpl final : public TSDatabaseResult {
     Field* field = nullptr;
@@ -569,3 +574,73 @@ TC_GAME_API void QueryAuthAsync(std::string const& query)
 {
     LoginDatabase.AsyncQuery(query.c_str());
 }
+
+// queries can be started from map threads, so they're handed
+// to the processor by the world thread
+static std::mutex asyncQueriesLock;
+static std::vector<QueryCallback> newAsyncQueries;
+static QueryCallbackProcessor asyncQueries;
+// only touched by the world thread, cleared on reload
+// so no script callback outlives its script
+static uint64 nextAsyncQuery = 0;
+static std::unordered_map<uint64, std::function<void(std::shared_ptr<TSDatabaseResult>)>> asyncQueryCallbacks;
+static std::vector<std::pair<uint64, std::function<void(std::shared_ptr<TSDatabaseResult>)>>> newAsyncQueryCallbacks;
+
+static void AddAsyncQuery(QueryCallback&& query, std::function<void(std::shared_ptr<TSDatabaseResult>)> callback)
+{
+    std::scoped_lock lock(asyncQueriesLock);
+    uint64 id = ++nextAsyncQuery;
+    newAsyncQueryCallbacks.push_back({ id, std::move(callback) });
+    newAsyncQueries.push_back(std::move(query.WithCallback([id](QueryResult result) {
+        auto itr = asyncQueryCallbacks.find(id);
+        if (itr == asyncQueryCallbacks.end())
+        {
+            return;
+        }
+        auto callback = std::move(itr->second);
+        asyncQueryCallbacks.erase(itr);
+        callback(std::make_shared<TSDatabaseImpl>(result));
+    })));
+}
+
+TC_GAME_API void QueryWorldAsync(std::string const& query, std::function<void(std::shared_ptr<TSDatabaseResult>)> callback)
+{
+    AddAsyncQuery(WorldDatabase.AsyncQuery(query.c_str()), std::move(callback));
+}
+
+TC_GAME_API void QueryCharactersAsync(std::string const& query, std::function<void(std::shared_ptr<TSDatabaseResult>)> callback)
+{
+    AddAsyncQuery(CharacterDatabase.AsyncQuery(query.c_str()), std::move(callback));
+}
+
+TC_GAME_API void QueryAuthAsync(std::string const& query, std::function<void(std::shared_ptr<TSDatabaseResult>)> callback)
+{
+    AddAsyncQuery(LoginDatabase.AsyncQuery(query.c_str()), std::move(callback));
+}
+
+TC_GAME_API void TSProcessAsyncQueries()
+{
+    {
+        std::scoped_lock lock(asyncQueriesLock);
+        for (QueryCallback& query : newAsyncQueries)
+        {
+            asyncQueries.AddCallback(std::move(query));
+        }
+        newAsyncQueries.clear();
+        for (auto& [id, callback] : newAsyncQueryCallbacks)
+        {
+            asyncQueryCallbacks.emplace(id, std::move(callback));
+        }
+        newAsyncQueryCallbacks.clear();
+    }
+    // callbacks starting new queries add them for the next update
+    asyncQueries.ProcessReadyCallbacks();
+}
+
+TC_GAME_API void TSClearAsyncQueries()
+{
+    std::scoped_lock lock(asyncQueriesLock);
+    // the queries still finish, but nothing is called when they do
+    newAsyncQueryCallbacks.clear();
+    asyncQueryCallbacks.clear();
+}
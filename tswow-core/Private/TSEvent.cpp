@@ -8,6 +8,7 @@ void ts_clear_events()
     {
         evt->clear();
     }
+    TSClearCallbackStats();
 }
 
 void __ts_add_event(TSEvent<void*>* evt)
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "TSEventStats.h"
+#include "TSLuaAllocator.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+
+// callbacks are registered on the main thread while scripts load,
+// but stats are read by commands at any time.
+static std::mutex statsLock;
+static std::map<std::tuple<std::string, std::string, std::string, bool>, std::unique_ptr<TSCallbackStats>> stats;
+// stats of older generations were registered before the last reload
+static uint32_t generation = 1;
+static std::string currentModule;
+
+static TSCallbackStats* GetStats(std::string const& category, std::string const& event, std::string const& module, bool lua, bool runsLua)
+{
+    std::unique_lock<std::mutex> lock(statsLock);
+    auto& entry = stats[std::make_tuple(category, event, module, lua)];
+    if (!entry)
+    {
+        entry = std::make_unique<TSCallbackStats>();
+        entry->m_category = category;
+        entry->m_event = event;
+        entry->m_module = module;
+        entry->m_lua = lua;
+        entry->m_runsLua = runsLua;
+        entry->m_zoneName = category + "." + event + " [" + module + (lua ? " lua]" : "]");
+        entry->m_luaModule = lua ? TSLuaMemory::ModuleId(module) : 0;
+    }
+    if (entry->m_generation != generation)
+    {
+        // registered again after a reload, starts over
+        entry->m_generation = generation;
+        entry->m_calls.store(0, std::memory_order_relaxed);
+        entry->m_totalNs.store(0, std::memory_order_relaxed);
+        entry->m_maxNs.store(0, std::memory_order_relaxed);
+        entry->m_violations.store(0, std::memory_order_relaxed);
+        entry->m_disabled.store(false, std::memory_order_relaxed);
+    }
+    return entry.get();
+}
+
+TSCallbackStats* TSGetCallbackStats(char const* categoryIn, char const* event, bool lua)
+{
+    std::string category(categoryIn);
+    // "PlayerEvents" -> "Player"
+    size_t suffix = category.rfind("Events");
+    if (suffix != std::string::npos && suffix > 0 && suffix + 6 == category.size())
+    {
+        category = category.substr(0, suffix);
+    }
+    return GetStats(category, event, currentModule.size() > 0 ? currentModule : "<unknown>", lua, lua);
+}
+
+TSCallbackStats* TSGetSystemStats(char const* category, char const* name)
+{
+    return GetStats(category, name, "tswow", false, true);
+}
+
+void TSSetEventModule(std::string const& module)
+{
+    currentModule = module;
+    // lua memory allocated while a module loads belongs to it
+    TSLuaMemory::SetCurrentModule(TSLuaMemory::ModuleId(module));
+}
+
+std::vector<TSCallbackStats*> TSGetAllCallbackStats()
+{
+    std::unique_lock<std::mutex> lock(statsLock);
+    std::vector<TSCallbackStats*> all;
+    all.reserve(stats.size());
+    for (auto& [_, entry] : stats)
+    {
+        if (entry->m_generation == generation)
+        {
+            all.push_back(entry.get());
+        }
+    }
+    return all;
+}
+
+void TSResetCallbackStats()
+{
+    std::unique_lock<std::mutex> lock(statsLock);
+    for (auto& [_, entry] : stats)
+    {
+        entry->m_calls.store(0, std::memory_order_relaxed);
+        entry->m_totalNs.store(0, std::memory_order_relaxed);
+        entry->m_maxNs.store(0, std::memory_order_relaxed);
+    }
+}
+
+void TSClearCallbackStats()
+{
+    std::unique_lock<std::mutex> lock(statsLock);
+    // callbacks running during the reload still point at them
+    ++generation;
+}
@@ -396,10 +396,13 @@ void TSLua::load_events(sol::state& state)
 
     auto custompacket_events = state.new_usertype<TSEvents::CustomPacketEvents>("CustomPacketEvents");
     LUA_MAPPED_HANDLE(custompacket_events, CustomPacketEvents, OnReceive);
+    LUA_MAPPED_HANDLE(custompacket_events, CustomPacketEvents, OnRateLimited);
 
     auto worldpacket_events = state.new_usertype<TSEvents::WorldPacketEvents>("WorldPacketEvents");
     LUA_MAPPED_HANDLE(worldpacket_events, WorldPacketEvents, OnReceive);
     LUA_MAPPED_HANDLE(worldpacket_events, WorldPacketEvents, OnSend);
+    LUA_MAPPED_HANDLE(worldpacket_events, WorldPacketEvents, OnReceiveView);
+    LUA_MAPPED_HANDLE(worldpacket_events, WorldPacketEvents, OnSendView);
 
     lua_events["World"] = &TSEvents::World;
     lua_events["Unit"] = &TSEvents::Unit;
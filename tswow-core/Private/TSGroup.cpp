@@ -22,6 +22,7 @@
 #include "TSIncludes.h"
 #include "TSGroup.h"
 #include "Player.h"
+#include "ObjectAccessor.h"
 #include "TSGUID.h"
 
 TSGroup::TSGroup(Group *group)
@@ -407,6 +408,28 @@ TSLua::Array<TSPlayer> TSGroup::LGetMembers()
     return sol::as_table(*GetMembers().vec);
 }
 
+TSLua::Iterator<TSPlayer> TSGroup::LIterateMembers()
+{
+    // the loop body can remove members or disband the group,
+    // so members are looked up again by guid every step
+    std::vector<ObjectGuid> guids;
+    for (auto const& slot : group->GetMemberSlots())
+    {
+        guids.push_back(slot.guid);
+    }
+    return TSLua::CallbackIterator<TSPlayer>([guids = std::move(guids), index = size_t(0)]() mutable -> sol::optional<TSPlayer> {
+        while (index < guids.size())
+        {
+            Player* member = ObjectAccessor::FindConnectedPlayer(guids[index++]);
+            if (member && member->GetSession())
+            {
+                return TSPlayer(member);
+            }
+        }
+        return sol::nullopt;
+    });
+}
+
 bool TSGroup::LIsLeader0(TSGUID guid)
 {
     return IsLeader(guid);
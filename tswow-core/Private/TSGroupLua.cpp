@@ -38,4 +38,5 @@ void TSLua::load_group_methods(sol::state& state)
         [](TSGroup& group, std::shared_ptr<TSWorldPacket> data, bool ignorePlayersInBg, TSGUID ignore) { group.SendPacket(data, ignorePlayersInBg, ignore);}
     ));
     ts_group.set_function("GetMembers", &TSGroup::LGetMembers);
+    ts_group.set_function("IterateMembers", &TSGroup::LIterateMembers);
 }
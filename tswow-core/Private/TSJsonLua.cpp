@@ -2,9 +2,50 @@
 #include "TSLuaVarargs.h"
 #include "TSJson.h"
 #include "TSJsonLua.h"
+#include "TSLuaJson.h"
+
+// Lua API calls can longjmp out of these without running destructors,
+// so the error strings live outside of their stack frames.
+
+// JsonDecode(text) -> value | nil, error
+static int LJsonDecode(lua_State* L)
+{
+    size_t length;
+    char const* text = luaL_checklstring(L, 1, &length);
+    thread_local std::string error;
+    error.clear();
+    if (!TSLuaJson::Decode(L, text, length, error))
+    {
+        lua_pushnil(L);
+        lua_pushlstring(L, error.c_str(), error.size());
+        return 2;
+    }
+    return 1;
+}
+
+// JsonEncode(value) -> string | nil, error
+static int LJsonEncode(lua_State* L)
+{
+    // reused, most encoded values are about the same size
+    thread_local std::string buffer;
+    buffer.clear();
+    thread_local std::string error;
+    error.clear();
+    if (!TSLuaJson::Encode(L, 1, buffer, error))
+    {
+        lua_pushnil(L);
+        lua_pushlstring(L, error.c_str(), error.size());
+        return 2;
+    }
+    lua_pushlstring(L, buffer.c_str(), buffer.size());
+    return 1;
+}
 
 void TSLua::load_json_methods(sol::state& state)
 {
+    state.set_function("JsonDecode", LJsonDecode);
+    state.set_function("JsonEncode", LJsonEncode);
+
     auto ts_jsonobject = state.new_usertype<TSJsonObject>("TSJsonObject");
     load_json_methods_t<TSJsonObject,TSJsonObject>(state, ts_jsonobject, "JsonObject");
 
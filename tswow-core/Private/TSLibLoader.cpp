@@ -1,8 +1,12 @@
 #include "TSLibLoader.h"
+#include "TSScriptMgrEvents.h"
 
 #include "TSLua.h"
 #include "TSLivescripts.h"
 #include "TSEvents.h"
+#include "TSMapMailbox.h"
+#include "TSAsync.h"
+#include "TSDatabase.h"
 
 #include "Config.h"
 #include "MapManager.h"
@@ -27,8 +31,6 @@ struct DataRemover {
         obj->m_tsEntity.m_lua_tables.clear();
         obj->m_tsWorldEntity.clear();
         obj->m_tsCollisions.callbacks.clear();
-        obj->m_delayedLuaCallbacks.clear();
-        obj->m_delayedCallbacks.clear();
     }
     void Visit(std::unordered_map<ObjectGuid, Creature*>& creatureMap)
     {
@@ -51,8 +53,6 @@ struct DataRemover {
             map->m_tsWorldEntity.clear();
             map->m_tsEntity.m_compiledClasses.clear();
             map->m_tsEntity.m_lua_tables.clear();
-            map->m_delayLuaCallbacks.clear();
-            map->m_delayCallbacks.clear();
             DataRemover worker;
             TypeContainerVisitor<DataRemover, MapStoredObjectTypesContainer> visitor(worker);
             visitor.Visit(map->GetObjectsStore());
@@ -69,6 +69,10 @@ void LoadTSLibraries()
 {
     TS_LOG_INFO("tswow.livescripts", "Reloading livescripts");
     ts_clear_events();
+    TSLoadBuiltinEvents();
+    TSClearMailboxes();
+    TSClearAsync();
+    TSClearAsyncQueries();
     DataRemover::Run();
     if (sConfigMgr->GetBoolDefault("TSWoW.EnableLua", true))
     {
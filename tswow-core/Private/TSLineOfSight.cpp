@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "TSLineOfSight.h"
+#include "TSWorldObject.h"
+
+#include "Object.h"
+#include "Player.h"
+
+#include <mutex>
+
+TSLineOfSightBatch::TSLineOfSightBatch()
+    : m_rays(std::make_shared<std::vector<TSLineOfSightRay>>())
+{}
+
+TSNumber<uint32> TSLineOfSightBatch::Add(float x1, float y1, float z1, float x2, float y2, float z2)
+{
+    m_rays->push_back({ x1, y1, z1, x2, y2, z2, true });
+    return uint32(m_rays->size() - 1);
+}
+
+TSNumber<uint32> TSLineOfSightBatch::AddObjects(TSWorldObject fromIn, TSWorldObject toIn)
+{
+    WorldObject* from = fromIn.obj;
+    WorldObject* to = toIn.obj;
+    TSLineOfSightRay ray = { 0, 0, 0, 0, 0, 0, false };
+#if TRINITY
+    if (from && to && from->IsInMap(to))
+    {
+        // same endpoints as WorldObject::IsWithinLOSInMap
+        if (to->GetTypeId() == TYPEID_PLAYER)
+        {
+            to->GetPosition(ray.x2, ray.y2, ray.z2);
+            ray.z2 += from->GetCollisionHeight();
+        }
+        else
+        {
+            to->GetHitSpherePointFor({ from->GetPositionX(), from->GetPositionY(), from->GetPositionZ() + from->GetCollisionHeight() }, ray.x2, ray.y2, ray.z2);
+        }
+
+        if (from->GetTypeId() == TYPEID_PLAYER)
+        {
+            from->GetPosition(ray.x1, ray.y1, ray.z1);
+            ray.z1 += from->GetCollisionHeight();
+        }
+        else
+        {
+            from->GetHitSpherePointFor({ to->GetPositionX(), to->GetPositionY(), to->GetPositionZ() + to->GetCollisionHeight() }, ray.x1, ray.y1, ray.z1);
+        }
+        ray.m_valid = true;
+    }
+#endif
+    m_rays->push_back(ray);
+    return uint32(m_rays->size() - 1);
+}
+
+void TSLineOfSightBatch::Clear()
+{
+    m_rays->clear();
+}
+
+TSNumber<uint32> TSLineOfSightBatch::GetSize()
+{
+    return uint32(m_rays->size());
+}
+
+TSLineOfSightBatch CreateLineOfSightBatch()
+{
+    return TSLineOfSightBatch();
+}
+
+static std::mutex workerPoolMutex;
+static std::shared_ptr<TSWorkerPool> workerPool;
+static uint32 workerThreads = 0;
+
+void SetWorkerThreads(uint32 threads)
+{
+    std::unique_lock<std::mutex> lock(workerPoolMutex);
+    if (workerPool && workerThreads == threads)
+    {
+        return;
+    }
+    workerThreads = threads;
+    // recreated with the new size on next use,
+    // jobs still running keep the old pool alive
+    workerPool.reset();
+}
+
+std::shared_ptr<TSWorkerPool> GetWorkerPool()
+{
+    std::unique_lock<std::mutex> lock(workerPoolMutex);
+    if (!workerPool)
+    {
+        uint32 threads = workerThreads;
+        if (threads == 0)
+        {
+            uint32 hardware = std::thread::hardware_concurrency();
+            threads = hardware > 1 ? hardware - 1 : 1;
+        }
+        workerPool = std::make_shared<TSWorkerPool>(threads);
+    }
+    return workerPool;
+}
@@ -80,6 +80,8 @@ void TSLivescripts::Load()
             continue;
         }
         TS_LOG_INFO("tswow.livescripts", "Loaded livescript {}", modName.c_str());
+        TSSetEventModule(modName);
         ptr(&ts_events);
+        TSSetEventModule("");
     }
 }
@@ -2,12 +2,17 @@
 #include "Config.h"
 #include "TSWorldObject.h"
 #include "TSGlobal.h"
+#include "TSSourceMap.h"
+#include "TSLuaProfiler.h"
+#include "TSLuaAllocator.h"
+#include "TSLuaGC.h"
+#include "TSEvent.h"
 #include <regex>
-#if 0
-#include "document.hpp"
-#endif
 #include <fstream>
+#include <sstream>
 #include <memory>
+#include <mutex>
+#include <atomic>
 #include <array>
     
 static std::map<std::filesystem::path, sol::table> modules;
@@ -15,7 +20,14 @@ static std::vector<std::filesystem::path> file_stack;
 static std::filesystem::path cur_module;
 static std::filesystem::path cur_directory;
 static bool already_errored = false;
+// declared before the state so it outlives it
+static std::unique_ptr<TSLuaAllocator> allocator;
 static sol::state state;
+static uint64 gc_budget_ns = 0;
+static TSLuaGCStepper gc_stepper;
+static uint64 gc_last_allocated = 0;
+static std::mutex source_maps_lock;
+static std::map<std::filesystem::path, std::shared_ptr<TSSourceMap>> source_maps;
 
 sol::state& TSLua::GetState()
 {
@@ -96,6 +108,7 @@ void TSLua::load_bindings(sol::state& ztate)
     load_corpse_methods(state);
     load_packet_methods(state);
     load_world_packet_methods(state);
+    load_replicated_state_methods(state);
     load_damage_metods(state);
     load_group_methods(state);
     load_guild_methods(state);
@@ -118,6 +131,7 @@ void TSLua::load_bindings(sol::state& ztate)
     load_faction_template_methods(state);
     load_db_json_methods(state);
     load_main_thread_context_methods(state);
+    load_async_functions(state);
     load_global_functions(state);
     load_mutex_functions(state);
     load_events(state);
@@ -188,42 +202,73 @@ void TSLua::handle_error(sol::protected_function_result const& res)
         for (int i = matches.size() - 1; i >= 0; --i)
         {
             Match const& match = matches[i];
-            std::filesystem::path map = lua_path / (match.filename + ".map");
-            if (!std::filesystem::exists(map))
+            std::shared_ptr<TSSourceMap> map = GetSourceMap(lua_path / match.filename);
+            std::string source;
+            uint32_t srcLine;
+            if (!map || !map->Lookup(match.lineNo, source, srcLine))
             {
                 continue;
             }
+            std::string replacement = match.spaces + source + ":" + std::to_string(srcLine) + ":";
+            what.replace(match.start, match.len, replacement);
+        }
+    }
+    TS_LOG_ERROR("tswow.lua", "{}", what.c_str());
+}
 
-            std::ifstream mapfile(map.string());
-            std::stringstream buffer;
-            buffer << mapfile.rdbuf();
-            std::string str = buffer.str();
+void TSLua::SetGCBudget(uint32 us)
+{
+    uint64 budget = uint64(us) * 1000;
+    if ((budget > 0) != (gc_budget_ns > 0))
+    {
+        lua_gc(state.lua_state(), budget > 0 ? LUA_GCSTOP : LUA_GCRESTART, 0);
+        gc_last_allocated = TSLuaMemory::TotalAllocated();
+    }
+    gc_budget_ns = budget;
+}
 
-            // todo: sourcemap corrupts the heap, fix that before enabling this.
-#if 0
-            if (str.size() > 0)
-            {
-                SourceMap::SrcMapDoc doc(str);
-                if (doc.map->getRowCount() < match.lineNo)
-                {
-                    continue;
-                }
+void TSLua::GCTick()
+{
+    if (gc_budget_ns == 0)
+    {
+        return;
+    }
+    // shows as "Lua.GC [tswow]" in .tswow perf, with one call per tick
+    TS_CALLBACK_ZONE(TSGetSystemStats("Lua", "GC"))
+    uint64 allocated = TSLuaMemory::TotalAllocated();
+    uint64 allocatedKb = (allocated - gc_last_allocated) / 1024;
+    // the remainder is counted next tick
+    gc_last_allocated += allocatedKb * 1024;
+    lua_State* L = state.lua_state();
+    gc_stepper.Tick(gc_budget_ns, allocatedKb, [L](int kb) {
+        return lua_gc(L, LUA_GCSTEP, kb) == 1;
+    });
+}
 
-                auto line = doc.map->getLineMap(match.lineNo - 1);
-                if (line->getEntryCount() == 0)
-                {
-                    continue;
-                }
-                auto entry = line->entries[0];
-                size_t srcLine = entry->src_line;
-                std::string srcFile = match.filename.substr(0, match.filename.size() - 4) + ".ts";
-                std::string replacement = match.spaces + srcFile + ":" + std::to_string(srcLine);
-                what.replace(match.start, match.len, replacement);
-            }
-#endif
+std::shared_ptr<TSSourceMap> TSLua::GetSourceMap(std::filesystem::path const& luaFile)
+{
+    std::unique_lock<std::mutex> lock(source_maps_lock);
+    auto itr = source_maps.find(luaFile);
+    if (itr != source_maps.end())
+    {
+        return itr->second;
+    }
+
+    std::shared_ptr<TSSourceMap> map;
+    std::ifstream mapfile(luaFile.string() + ".map");
+    if (mapfile)
+    {
+        std::stringstream buffer;
+        buffer << mapfile.rdbuf();
+        map = std::make_shared<TSSourceMap>();
+        if (!map->Parse(buffer.str()))
+        {
+            map = nullptr;
         }
     }
-    TS_LOG_ERROR("tswow.lua", "{}", what.c_str());
+    // also caches files without a map
+    source_maps[luaFile] = map;
+    return map;
 }
 
 void TSLua::execute_file(std::filesystem::path file)
@@ -322,13 +367,40 @@ void TSLua::Load()
     }
 
     modules.clear();
-    state = sol::state();
+    // temporaries made by lua outside of callbacks while the last state loaded
+    if (TSLuaArena().GetDepth() == 0)
+    {
+        TSLuaArena().Clear();
+    }
+    {
+        // the old state is closed by the assignment, while its allocator is still alive
+        auto new_allocator = std::make_unique<TSLuaAllocator>(
+#if TRINITY
+            sConfigMgr->GetBoolDefault("TSWoW.LuaPoolAllocator", false)
+#else
+            false
+#endif
+        );
+        // before the old state closes, so destroyed entities stop touching its userdata
+        TSLuaUserdata::OnLoad();
+        state = sol::state(sol::default_at_panic, TSLuaAllocator::Alloc, new_allocator.get());
+        allocator = std::move(new_allocator);
+    }
+    if (gc_budget_ns > 0)
+    {
+        lua_gc(state.lua_state(), LUA_GCSTOP, 0);
+    }
     already_errored = false;
+    {
+        std::unique_lock<std::mutex> lock(source_maps_lock);
+        source_maps.clear();
+    }
 
     state.set_function("require", [=](std::string const& name) {
         return TSLua::require(name);
     });
     load_bindings(state);
+    TSLuaInstallHooks();
     state["HAS_TAG"] = L_HAS_TAG;
     state["BROADCAST_PHASE_ID"] = BROADCAST_PHASE_ID;
     state["TSClass"] = state.script(
@@ -348,6 +420,7 @@ void TSLua::Load()
         {
             continue;
         }
+        TSSetEventModule(entry.path().filename().string());
 
         for (auto const& file : std::filesystem::recursive_directory_iterator(entry.path()))
         {
@@ -376,8 +449,13 @@ void TSLua::Load()
         }
     }
 
-    for (auto& [_,table] : modules)
+    for (auto& [path,table] : modules)
     {
+        // callbacks registered by this file are attributed
+        // to the top directory under the lua root
+        std::filesystem::path relative = path.lexically_relative(LuaRoot());
+        TSSetEventModule(relative.empty() ? path.string() : relative.begin()->string());
+
         auto main = table["Main"];
         if (main.get_type() == sol::type::function)
         {
@@ -413,42 +491,42 @@ void TSLua::Load()
             }
         }
     }
+    TSSetEventModule("");
 }
 
-// the ugliest hack in in the history of emulation
-static constexpr size_t lua_garbage_page_size = 8192;
-using lua_garbage_page_type = std::array<char, lua_garbage_page_size>;
-size_t lua_garbage_page = 0;
-size_t lua_garbage_offset = lua_garbage_page_size; // saves an extra if statement below
-size_t lua_garbage_total = 0;
-static std::vector<std::unique_ptr<lua_garbage_page_type>> lua_garbage_stack;
+static std::atomic<bool> lua_arena_debug { false };
 
-void* add_lua_garbage(size_t size)
+TSScopedArena& TSLuaArena()
 {
-    lua_garbage_total += size;
-    if (lua_garbage_offset + size >= lua_garbage_page_size)
+    static thread_local TSScopedArena arena;
+    static thread_local bool initialized = false;
+    if (!initialized)
+    {
+        initialized = true;
+        arena.SetEscapeHandler([](void* ptr, size_t size) {
+            TS_LOG_ERROR("tswow.lua", "Lua temporary at {} ({} bytes) was written after its callback returned", ptr, size);
+        });
+    }
+    bool debug = lua_arena_debug.load(std::memory_order_relaxed);
+    if (arena.IsDebug() != debug)
     {
-        lua_garbage_stack.push_back(std::make_unique<lua_garbage_page_type>());
-        lua_garbage_offset = 0;
+        // takes effect once the arena is empty
+        arena.SetDebug(debug);
     }
-    char* c = lua_garbage_stack[lua_garbage_stack.size() - 1]->data() + lua_garbage_offset;
-    lua_garbage_offset += size;
-    return c;
+    return arena;
 }
 
-void clear_lua_garbage()
+void SetLuaArenaDebug(bool debug)
 {
-    lua_garbage_stack.clear();
-    lua_garbage_page = 0;
-    lua_garbage_offset = lua_garbage_page_size;
+    lua_arena_debug.store(debug, std::memory_order_relaxed);
 }
 
 size_t GetLuaGarbageCur()
 {
-    return lua_garbage_page * lua_garbage_page_size + lua_garbage_offset;
+    return TSLuaArena().GetUsed();
 }
 
 size_t GetLuaGarbageTotal()
 {
-    return lua_garbage_total;
+    return TSLuaArena().GetTotal();
 }
\ No newline at end of file
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "TSLuaProfiler.h"
+#include "TSLua.h"
+#include "TSSourceMap.h"
+#include "TSStackProfile.h"
+#include "TSWatchdog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+// stacks deeper than this are cut off at the root
+static constexpr int MAX_SAMPLE_DEPTH = 64;
+
+static std::mutex profilerLock;
+static TSStackProfile profile;
+static std::atomic<bool> running { false };
+static uint32 sampleInterval = 0;
+
+static uint32 hookInterval = 0;
+static uint32 sinceSample = 0;
+
+static void Sample(lua_State* L)
+{
+    std::vector<TSStackProfile::Frame> frames;
+    lua_Debug ar;
+    std::unique_lock<std::mutex> lock(profilerLock);
+    for (int level = 0; level < MAX_SAMPLE_DEPTH && lua_getstack(L, level, &ar); ++level)
+    {
+        lua_getinfo(L, "Sl", &ar);
+        frames.push_back({ profile.InternSource(ar.source), ar.currentline });
+    }
+    if (frames.size() > 0)
+    {
+        profile.AddSample(frames);
+    }
+}
+
+// shared by the profiler and the callback budget, lua only has one hook per state
+static void CountHook(lua_State* L, lua_Debug*)
+{
+    if (running)
+    {
+        sinceSample += hookInterval;
+        if (sinceSample >= sampleInterval)
+        {
+            sinceSample = 0;
+            Sample(L);
+        }
+    }
+    // may not return, so nothing with a destructor may be alive here
+    TSLuaBudgetCheck(L, hookInterval);
+}
+
+static void InstallHook()
+{
+    lua_State* L = TSLua::GetState().lua_state();
+    uint32 budgetInterval = TSLuaBudgetInterval();
+    if (running && budgetInterval > 0)
+    {
+        hookInterval = std::min(sampleInterval, budgetInterval);
+    }
+    else
+    {
+        hookInterval = running ? sampleInterval : budgetInterval;
+    }
+    sinceSample = 0;
+
+    if (hookInterval > 0)
+    {
+        lua_sethook(L, CountHook, LUA_MASKCOUNT, int(hookInterval));
+    }
+    else
+    {
+        lua_sethook(L, nullptr, 0, 0);
+    }
+}
+
+// "@<lua root>/mod/file.lua" -> "../mod/file.ts:12"
+static std::string FrameName(std::string const& source, int32_t line)
+{
+    if (source.size() == 0 || source[0] != '@')
+    {
+        // "=[C]" and chunks loaded from strings
+        return source.size() > 0 && source[0] == '=' ? source.substr(1) : source;
+    }
+
+    std::filesystem::path file = source.substr(1);
+    std::shared_ptr<TSSourceMap> map = TSLua::GetSourceMap(file);
+    std::string original;
+    uint32 originalLine;
+    if (map && line > 0 && map->Lookup(uint32(line), original, originalLine))
+    {
+        return original + ":" + std::to_string(originalLine);
+    }
+    std::filesystem::path relative = file.lexically_relative(TSLua::LuaRoot());
+    return (relative.empty() ? file : relative).generic_string() + ":" + std::to_string(line);
+}
+
+bool StartLuaProfiler(uint32 interval)
+{
+    std::unique_lock<std::mutex> lock(profilerLock);
+    if (running)
+    {
+        return false;
+    }
+    profile.Clear();
+    sampleInterval = interval > 0 ? interval : 1;
+    running = true;
+    InstallHook();
+    return true;
+}
+
+bool StopLuaProfiler(std::string const& file)
+{
+    TSStackProfile samples;
+    {
+        std::unique_lock<std::mutex> lock(profilerLock);
+        if (!running)
+        {
+            return false;
+        }
+        running = false;
+        InstallHook();
+        std::swap(samples, profile);
+    }
+
+    // source maps are resolved here rather than while sampling
+    std::ofstream out(file);
+    if (!out)
+    {
+        return false;
+    }
+    samples.WriteCollapsed(out, FrameName);
+    return bool(out);
+}
+
+bool IsLuaProfilerRunning()
+{
+    return running;
+}
+
+uint64 GetLuaProfilerSamples()
+{
+    std::unique_lock<std::mutex> lock(profilerLock);
+    return profile.GetSampleCount();
+}
+
+void TSLuaInstallHooks()
+{
+    std::unique_lock<std::mutex> lock(profilerLock);
+    InstallHook();
+}
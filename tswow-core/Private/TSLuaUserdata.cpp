@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "TSLuaUserdata.h"
+#include "TSLua.h"
+
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+static std::atomic<uint32> generation = 1;
+
+// entities can be destroyed on any thread, but refs can only be dropped
+// while nothing else uses the state
+static std::mutex pendingMutex;
+static std::vector<std::pair<uint32, int>> pendingRefs;
+
+static thread_local std::vector<void (*)()> recyclers;
+
+static std::atomic<uint32> nextEpoch = 1;
+static thread_local uint32 epoch = nextEpoch.fetch_add(1, std::memory_order_relaxed);
+
+TSLuaUserdataCache::~TSLuaUserdataCache()
+{
+    TSLuaUserdata::Invalidate(*this);
+}
+
+uint32 TSLuaUserdata::Generation()
+{
+    return generation.load(std::memory_order_relaxed);
+}
+
+void TSLuaUserdata::OnLoad()
+{
+    generation++;
+    std::scoped_lock lock(pendingMutex);
+    pendingRefs.clear();
+}
+
+void TSLuaUserdata::Invalidate(TSLuaUserdataCache& cache)
+{
+    if (cache.m_entries.empty() || cache.m_generation != Generation())
+    {
+        return;
+    }
+
+    std::scoped_lock lock(pendingMutex);
+    for (TSLuaUserdataCache::Entry const& entry : cache.m_entries)
+    {
+        // scripts holding on to the userdata now see a null object
+        // instead of a dangling pointer
+        entry.m_invalidate(entry.m_value);
+        pendingRefs.push_back({ cache.m_generation, entry.m_ref });
+    }
+    cache.m_entries.clear();
+}
+
+void TSLuaUserdata::ReleaseRefs()
+{
+    std::vector<std::pair<uint32, int>> refs;
+    {
+        std::scoped_lock lock(pendingMutex);
+        if (pendingRefs.empty())
+        {
+            return;
+        }
+        refs.swap(pendingRefs);
+    }
+
+    lua_State* L = TSLua::GetState().lua_state();
+    uint32 current = Generation();
+    for (auto const& [refGeneration, ref] : refs)
+    {
+        if (refGeneration == current)
+        {
+            luaL_unref(L, LUA_REGISTRYINDEX, ref);
+        }
+    }
+}
+
+void TSLuaUserdata::AddRecycler(void (*recycle)())
+{
+    recyclers.push_back(recycle);
+}
+
+uint32 TSLuaUserdata::Epoch()
+{
+    return epoch;
+}
+
+void TSLuaUserdata::Recycle()
+{
+    epoch = nextEpoch.fetch_add(1, std::memory_order_relaxed);
+    for (auto recycle : recyclers)
+    {
+        recycle();
+    }
+}
@@ -16,6 +16,9 @@
  */
 #include "TSIncludes.h"
 #include "TSMap.h"
+#include "TSMapEntryIndex.h"
+#include "TSSpatialQuery.h"
+#include "TSLineOfSight.h"
 #include "TSPlayer.h"
 #include "TSWorldObject.h"
 #include "TSGameObject.h"
@@ -25,6 +28,8 @@
 #include "TSInstance.h"
 #include "TSGUID.h"
 #include "TSWeather.h"
+#include "TSMapMailbox.h"
+#include "TSMainThreadContext.h"
 
 #include "ObjectMgr.h"
 #include "CreatureData.h"
@@ -39,6 +44,8 @@
 #include "WeatherMgr.h"
 #include "MapReference.h"
 #include "Player.h"
+#include "ObjectAccessor.h"
+#include "MapManager.h"
 
 #include <memory.h>
 
@@ -360,6 +367,18 @@ TSArray<TSUnit> TSMap::GetUnits()
 TSArray<TSGameObject> TSMap::GetGameObjects(uint32 entry)
 {
     TSArray<TSGameObject> gameobjects;
+    if (entry != 0 && IsMapEntryIndexEnabled())
+    {
+        std::vector<GameObject*> matches;
+        GetMapEntryIndex(map)->GetGameObjects(entry, matches);
+        gameobjects.vec->reserve(matches.size());
+        for (GameObject* go : matches)
+        {
+            gameobjects.push(TSGameObject(go));
+        }
+        return gameobjects;
+    }
+
     if (entry == 0)
     {
         gameobjects.vec->reserve(map->GetGameObjectBySpawnIdStore().size());
@@ -377,6 +396,18 @@ TSArray<TSGameObject> TSMap::GetGameObjects(uint32 entry)
 TSArray<TSCreature> TSMap::GetCreatures(uint32 entry)
 {
     TSArray<TSCreature> creatures;
+    if (entry != 0 && IsMapEntryIndexEnabled())
+    {
+        std::vector<Creature*> matches;
+        GetMapEntryIndex(map)->GetCreatures(entry, matches);
+        creatures.vec->reserve(matches.size());
+        for (Creature* creature : matches)
+        {
+            creatures.push(TSCreature(creature));
+        }
+        return creatures;
+    }
+
     if (entry == 0)
     {
         creatures.vec->reserve(map->GetCreatureBySpawnIdStore().size());
@@ -391,6 +422,11 @@ TSArray<TSCreature> TSMap::GetCreatures(uint32 entry)
     return creatures;
 }
 
+void TSMap::QueryInRange(TSSpatialQuery query)
+{
+    RunSpatialQuery(map, *query.GetData());
+}
+
 TSCreature TSMap::GetCreatureByDBGUID(uint32 dbGuid)
 {
 #if TRINITY
@@ -450,7 +486,15 @@ TSInstance TSMap::ToInstance()
 void TSMap::DoDelayed(std::function<void(TSMap, TSMainThreadContext)> callback)
 {
 #if TRINITY
-    map->m_delayCallbacks.push_back(callback);
+    uint32 mapId = map->GetId();
+    uint32 instanceId = map->GetInstanceId();
+    PostToWorld([=](TSMainThreadContext ctx) {
+        // the map can unload before the world drains its mailbox
+        if (Map* target = sMapMgr->FindMap(mapId, instanceId))
+        {
+            callback(TSMap(target), ctx);
+        }
+    });
 #endif
 }
 
@@ -489,11 +533,31 @@ bool TSMap::IsInLineOfSight(float x1,float y1,float z1, float x2, float y2, floa
     return map->isInLineOfSight( x1,  y1,  z1,  x2,  y2,  z2,  phasemask, static_cast<LineOfSightChecks>(checks), static_cast<VMAP::ModelIgnoreFlags>(ignoreFlags));
 }
 
+TSBitset TSMap::IsInLineOfSightBatch(TSLineOfSightBatch batch, uint32 phasemask, uint32 checks, uint32 ignoreFlags)
+{
+    std::vector<TSLineOfSightRay> const& rays = batch.GetRays();
+    std::shared_ptr<TSWorkerPool> pool = GetWorkerPool();
+    // this map thread is blocked until every ray is done, so nothing
+    // modifies the vmap or dynamic tree of this map while workers read them.
+    return ParallelBitset(*pool, uint32(rays.size()), [&](uint32 i) {
+        TSLineOfSightRay const& ray = rays[i];
+        return ray.m_valid && map->isInLineOfSight(
+              ray.x1, ray.y1, ray.z1
+            , ray.x2, ray.y2, ray.z2
+            , phasemask
+            , static_cast<LineOfSightChecks>(checks)
+            , static_cast<VMAP::ModelIgnoreFlags>(ignoreFlags)
+        );
+    });
+}
+
 void TSMap::LDoDelayed(sol::function callback)
 {
-#if TRINITY
-    map->m_delayLuaCallbacks.push_back(callback);
-#endif
+    sol::protected_function cb = callback;
+    DoDelayed([cb](TSMap map, TSMainThreadContext ctx) {
+        TSArenaScope scope(TSLuaArena());
+        TSLua::handle_error(cb(map, ctx));
+    });
 }
 
 TSLua::Array<TSPlayer> TSMap::LGetPlayers0(uint32 team)
@@ -505,6 +569,43 @@ TSLua::Array<TSPlayer> TSMap::LGetPlayers1()
     return sol::as_table(*GetPlayers().vec);
 }
 
+TSLua::Iterator<TSPlayer> TSMap::LIteratePlayers0(uint32 team)
+{
+    // the loop body can move any player off the map, so players are
+    // looked up again by guid every step
+    Map::PlayerList const& players = map->GetPlayers();
+    std::vector<ObjectGuid> guids;
+    guids.reserve(players.getSize());
+    for (Map::PlayerList::const_iterator itr = players.begin(); itr != players.end(); ++itr)
+    {
+#if defined TRINITY
+        Player* player = itr->GetSource();
+#else
+        Player* player = itr->getSource();
+#endif
+        if (player)
+        {
+            guids.push_back(player->GetGUID());
+        }
+    }
+    return TSLua::CallbackIterator<TSPlayer>([map = map, guids = std::move(guids), index = size_t(0), team]() mutable -> sol::optional<TSPlayer> {
+        while (index < guids.size())
+        {
+            Player* player = ObjectAccessor::GetPlayer(map, guids[index++]);
+            if (player && player->GetSession() && (team >= TEAM_NEUTRAL || player->GetTeamId() == team))
+            {
+                return TSPlayer(player);
+            }
+        }
+        return sol::nullopt;
+    });
+}
+
+TSLua::Iterator<TSPlayer> TSMap::LIteratePlayers1()
+{
+    return LIteratePlayers0(TEAM_NEUTRAL);
+}
+
 TSLua::Array<TSUnit> TSMap::LGetUnits()
 {
     return sol::as_table(*GetUnits().vec);
@@ -0,0 +1,188 @@
+/*
+ * This file is part of tswow (https://github.com/tswow/).
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "TSMapEntryIndex.h"
+#include "TSEntity.h"
+
+#include "Map.h"
+#include "Creature.h"
+#include "GameObject.h"
+
+#include <atomic>
+
+// stored with the maps other compiled classes, so reloading
+// scripts drops it and the next lookup rebuilds it.
+static const std::string ENTRY_INDEX_KEY = "__tswow_entry_index";
+static std::atomic<bool> enabled = false;
+
+void TSEnableMapEntryIndex()
+{
+    enabled = true;
+}
+
+bool IsMapEntryIndexEnabled()
+{
+    return enabled;
+}
+
+TSMapEntryIndex::TSMapEntryIndex(Map* map)
+    : m_map(map)
+{
+    for (auto& val : map->GetCreatureBySpawnIdStore())
+    {
+        AddCreature(val.second);
+    }
+
+    for (auto& val : map->GetGameObjectBySpawnIdStore())
+    {
+        AddGameObject(val.second);
+    }
+}
+
+// Whether another object still uses the spawn id of "obj"
+template <typename Store, typename T>
+static bool HasOtherSpawn(Store const& store, T* obj)
+{
+    auto range = store.equal_range(obj->GetSpawnId());
+    for (auto itr = range.first; itr != range.second; ++itr)
+    {
+        if (itr->second != obj)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename Store, typename T>
+static void Resolve(Store const& store, std::vector<ObjectGuid::LowType> const* spawnIds, uint32 entry, std::vector<T*>& out)
+{
+    if (!spawnIds)
+    {
+        return;
+    }
+    for (ObjectGuid::LowType spawnId : *spawnIds)
+    {
+        auto range = store.equal_range(spawnId);
+        for (auto itr = range.first; itr != range.second; ++itr)
+        {
+            if (itr->second->GetEntry() == entry)
+            {
+                out.push_back(itr->second);
+            }
+        }
+    }
+}
+
+void TSMapEntryIndex::AddCreature(Creature* creature)
+{
+    m_creatures.Add(creature->GetSpawnId(), creature->GetEntry());
+}
+
+void TSMapEntryIndex::RemoveCreature(Creature* creature)
+{
+    if (!HasOtherSpawn(m_map->GetCreatureBySpawnIdStore(), creature))
+    {
+        m_creatures.Remove(creature->GetSpawnId());
+    }
+}
+
+void TSMapEntryIndex::AddGameObject(GameObject* go)
+{
+    m_gameObjects.Add(go->GetSpawnId(), go->GetEntry());
+}
+
+void TSMapEntryIndex::RemoveGameObject(GameObject* go)
+{
+    if (!HasOtherSpawn(m_map->GetGameObjectBySpawnIdStore(), go))
+    {
+        m_gameObjects.Remove(go->GetSpawnId());
+    }
+}
+
+void TSMapEntryIndex::GetCreatures(uint32 entry, std::vector<Creature*>& out) const
+{
+    Resolve(m_map->GetCreatureBySpawnIdStore(), m_creatures.Get(entry), entry, out);
+}
+
+void TSMapEntryIndex::GetGameObjects(uint32 entry, std::vector<GameObject*>& out) const
+{
+    Resolve(m_map->GetGameObjectBySpawnIdStore(), m_gameObjects.Get(entry), entry, out);
+}
+
+TSMapEntryIndex* GetMapEntryIndex(Map* map)
+{
+    return map->m_tsEntity.m_compiledClasses.GetObject<TSMapEntryIndex>(ENTRY_INDEX_KEY, [=]() {
+        return std::make_shared<TSMapEntryIndex>(map);
+    }).get();
+}
+
+static TSMapEntryIndex* FindMapEntryIndex(WorldObject* obj)
+{
+    if (!obj->FindMap() || !obj->GetMap()->m_tsEntity.m_compiledClasses.HasObject(ENTRY_INDEX_KEY))
+    {
+        return nullptr;
+    }
+    return GetMapEntryIndex(obj->GetMap());
+}
+
+void TSMapEntryIndexAddCreature(Creature* creature)
+{
+    if (!creature->GetSpawnId())
+    {
+        return;
+    }
+    if (TSMapEntryIndex* index = FindMapEntryIndex(creature))
+    {
+        index->AddCreature(creature);
+    }
+}
+
+void TSMapEntryIndexRemoveCreature(Creature* creature)
+{
+    if (!creature->GetSpawnId())
+    {
+        return;
+    }
+    if (TSMapEntryIndex* index = FindMapEntryIndex(creature))
+    {
+        index->RemoveCreature(creature);
+    }
+}
+
+void TSMapEntryIndexAddGameObject(GameObject* go)
+{
+    if (!go->GetSpawnId())
+    {
+        return;
+    }
+    if (TSMapEntryIndex* index = FindMapEntryIndex(go))
+    {
+        index->AddGameObject(go);
+    }
+}
+
+void TSMapEntryIndexRemoveGameObject(GameObject* go)
+{
+    if (!go->GetSpawnId())
+    {
+        return;
+    }
+    if (TSMapEntryIndex* index = FindMapEntryIndex(go))
+    {
+        index->RemoveGameObject(go);
+    }
+}
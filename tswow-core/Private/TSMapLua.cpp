@@ -10,6 +10,11 @@
 #include "TSBattleground.h"
 #include "TSInstance.h"
 #include "TSGUID.h"
+#include "TSSpatialQuery.h"
+#include "TSLineOfSight.h"
+#include "TSMapMailbox.h"
+#include "TSJson.h"
+#include "TSLuaVarargs.h"
 
 void TSLua::load_map_methods(sol::state& state)
 {
@@ -33,6 +38,8 @@ void TSLua::load_map_methods(sol::state& state)
     ts_map.set_function("GetGameObject", sol::overload(&TSMap::LGetGameObject0,&TSMap::LGetGameObject1));
     ts_map.set_function("GetPlayer", sol::overload(&TSMap::LGetPlayer0,&TSMap::LGetPlayer1));
     LUA_FIELD(ts_map, TSMap, IsInLineOfSight);
+    LUA_FIELD(ts_map, TSMap, QueryInRange);
+    LUA_FIELD(ts_map, TSMap, IsInLineOfSightBatch);
     LUA_FIELD(ts_map, TSMap, GetCreatureByDBGUID);
     LUA_FIELD(ts_map, TSMap, GetGameObjectByDBGUID);
     LUA_FIELD(ts_map, TSMap, SpawnCreature);
@@ -48,6 +55,10 @@ void TSLua::load_map_methods(sol::state& state)
         &TSMap::LGetPlayers0
         , &TSMap::LGetPlayers1
     ));
+    ts_map.set_function("IteratePlayers", sol::overload(
+        &TSMap::LIteratePlayers0
+        , &TSMap::LIteratePlayers1
+    ));
     ts_map.set_function("GetGameObjects", sol::overload(
         &TSMap::LGetGameObjects0
         , &TSMap::LGetGameObjects1
@@ -59,4 +70,31 @@ void TSLua::load_map_methods(sol::state& state)
 
     state.set_function("ToBattleground", &ToBattleground);
     state.set_function("ToInstance", &ToInstance);
+
+    auto ts_spatial_query = state.new_usertype<TSSpatialQuery>("TSSpatialQuery");
+    LUA_FIELD_OVERLOAD_RET_2_4(ts_spatial_query, TSSpatialQuery, Add, TSWorldObject, float, uint32, uint32, uint32, uint32);
+    LUA_FIELD(ts_spatial_query, TSSpatialQuery, Clear);
+    LUA_FIELD(ts_spatial_query, TSSpatialQuery, GetSearchCount);
+    LUA_FIELD(ts_spatial_query, TSSpatialQuery, GetCount);
+    LUA_FIELD(ts_spatial_query, TSSpatialQuery, Get);
+    state.set_function("CreateSpatialQuery", CreateSpatialQuery);
+
+    auto ts_los_batch = state.new_usertype<TSLineOfSightBatch>("TSLineOfSightBatch");
+    LUA_FIELD(ts_los_batch, TSLineOfSightBatch, Add);
+    LUA_FIELD(ts_los_batch, TSLineOfSightBatch, AddObjects);
+    LUA_FIELD(ts_los_batch, TSLineOfSightBatch, Clear);
+    LUA_FIELD(ts_los_batch, TSLineOfSightBatch, GetSize);
+    state.set_function("CreateLineOfSightBatch", CreateLineOfSightBatch);
+
+    auto ts_bitset = state.new_usertype<TSBitset>("TSBitset");
+    LUA_FIELD(ts_bitset, TSBitset, Get);
+    LUA_FIELD(ts_bitset, TSBitset, Set);
+    LUA_FIELD(ts_bitset, TSBitset, GetSize);
+    LUA_FIELD(ts_bitset, TSBitset, Count);
+
+    state.set_function("PostToMap", LPostToMap);
+    state.set_function("PostToWorld", LPostToWorld);
+    state.set_function("PostMapMessage", PostMapMessage);
+    state.set_function("OnMapMessage", LOnMapMessage);
+    state.set_function("GetMapMailboxSize", GetMapMailboxSize);
 }
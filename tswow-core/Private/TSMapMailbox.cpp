@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "TSMapMailbox.h"
+#include "TSMPSCQueue.h"
+#include "TSMap.h"
+#include "TSJson.h"
+#include "TSMainThreadContext.h"
+#include "TSEntity.h"
+
+#include "Map.h"
+#include "MapManager.h"
+
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using TSMapMailbox = TSMailbox<TSMap>;
+
+// owned by the map, so it closes when the map unloads
+static const std::string MAILBOX_KEY = "__tswow_map_mailbox";
+static std::shared_mutex mailboxLock;
+static std::unordered_map<uint64, std::weak_ptr<TSMapMailbox>> mailboxes;
+static TSMailbox<TSMainThreadContext> worldMailbox;
+
+// only written while scripts are loaded, when no map is updating
+static std::unordered_map<uint32, std::vector<std::function<void(TSMap, TSJsonObject)>>> messageHandlers;
+
+static uint64 MailboxKey(uint32 mapId, uint32 instanceId)
+{
+    return (uint64(mapId) << 32) | instanceId;
+}
+
+static std::shared_ptr<TSMapMailbox> FindMailbox(uint32 mapId, uint32 instanceId)
+{
+    std::shared_lock<std::shared_mutex> lock(mailboxLock);
+    auto itr = mailboxes.find(MailboxKey(mapId, instanceId));
+    return itr == mailboxes.end() ? nullptr : itr->second.lock();
+}
+
+static std::shared_ptr<TSMapMailbox> OpenMailbox(Map* map)
+{
+    return map->m_tsEntity.m_compiledClasses.GetObject<TSMapMailbox>(MAILBOX_KEY, [map]() {
+        auto mailbox = std::make_shared<TSMapMailbox>();
+        std::unique_lock<std::shared_mutex> lock(mailboxLock);
+        // maps unloaded since the last one opened
+        for (auto itr = mailboxes.begin(); itr != mailboxes.end();)
+        {
+            itr = itr->second.expired() ? mailboxes.erase(itr) : std::next(itr);
+        }
+        mailboxes[MailboxKey(map->GetId(), map->GetInstanceId())] = mailbox;
+        return mailbox;
+    });
+}
+
+bool PostToMap(uint32 mapId, uint32 instanceId, std::function<void(TSMap)> callback)
+{
+    std::shared_ptr<TSMapMailbox> mailbox = FindMailbox(mapId, instanceId);
+    if (!mailbox)
+    {
+        return false;
+    }
+    mailbox->Post(std::move(callback));
+    return true;
+}
+
+void PostToWorld(std::function<void(TSMainThreadContext)> callback)
+{
+    worldMailbox.Post(std::move(callback));
+}
+
+bool PostMapMessage(uint32 mapId, uint32 instanceId, uint32 type, TSJsonObject data)
+{
+    // json objects share their storage between copies,
+    // so the receiver gets its own parsed copy
+    std::string json = data.toString();
+    return PostToMap(mapId, instanceId, [type, json](TSMap map) {
+        auto itr = messageHandlers.find(type);
+        if (itr == messageHandlers.end())
+        {
+            return;
+        }
+        for (auto& handler : itr->second)
+        {
+            TSJsonObject obj;
+            obj.Parse(json);
+            handler(map, obj);
+        }
+    });
+}
+
+void OnMapMessage(uint32 type, std::function<void(TSMap, TSJsonObject)> callback)
+{
+    messageHandlers[type].push_back(callback);
+}
+
+TSNumber<uint32> GetMapMailboxSize(uint32 mapId, uint32 instanceId)
+{
+    std::shared_ptr<TSMapMailbox> mailbox = FindMailbox(mapId, instanceId);
+    return mailbox ? uint32(mailbox->Size()) : 0;
+}
+
+void TSMapMailboxOpen(Map* map)
+{
+    OpenMailbox(map);
+}
+
+void TSMapMailboxDrain(Map* map)
+{
+    // reloading drops the mailbox with the maps other data, so this reopens it
+    std::shared_ptr<TSMapMailbox> mailbox = OpenMailbox(map);
+    // messages posted by the handlers wait for the next update
+    mailbox->Drain(TSMap(map));
+}
+
+void TSWorldMailboxDrain()
+{
+    // messages posted by the callbacks wait for the next update
+    worldMailbox.Drain(TSMainThreadContext());
+}
+
+void TSClearMailboxes()
+{
+    messageHandlers.clear();
+    worldMailbox.Clear();
+    std::shared_lock<std::shared_mutex> lock(mailboxLock);
+    for (auto& [_, weak] : mailboxes)
+    {
+        if (std::shared_ptr<TSMapMailbox> mailbox = weak.lock())
+        {
+            mailbox->Clear();
+        }
+    }
+}
+
+bool LPostToMap(uint32 mapId, uint32 instanceId, sol::protected_function callback)
+{
+    return PostToMap(mapId, instanceId, [callback](TSMap map) {
+        TSArenaScope scope(TSLuaArena());
+        TSLua::handle_error(callback(map));
+    });
+}
+
+void LPostToWorld(sol::protected_function callback)
+{
+    PostToWorld([callback](TSMainThreadContext ctx) {
+        TSArenaScope scope(TSLuaArena());
+        TSLua::handle_error(callback(ctx));
+    });
+}
+
+void LOnMapMessage(uint32 type, sol::protected_function callback)
+{
+    OnMapMessage(type, [callback](TSMap map, TSJsonObject data) {
+        TSArenaScope scope(TSLuaArena());
+        TSLua::handle_error(callback(map, data));
+    });
+}
@@ -0,0 +1,316 @@
+#include "TSPacketRecorder.h"
+#include "TSEvents.h"
+#include "TSPlayer.h"
+#include "TSWorldPacket.h"
+#include "TSMainThreadContext.h"
+#include "CustomPacketLog.h"
+#include "WorldPacket.h"
+#include "Player.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+static std::atomic<bool> capturing = false;
+static std::mutex captureLock;
+static std::unique_ptr<std::ofstream> captureFile;
+static std::unique_ptr<CustomPacketLogWriter> captureWriter;
+static uint64 captureTick = 0;
+
+static void Capture(
+      CustomPacketLogKind kind
+    , uint64 session
+    , uint32 opcode
+    , char const* data
+    , size_t size
+) {
+    std::scoped_lock lock(captureLock);
+    if (!captureWriter)
+    {
+        return;
+    }
+    CustomPacketLogRecord record;
+    record.m_tick = captureTick;
+    record.m_kind = kind;
+    record.m_session = session;
+    record.m_opcode = opcode;
+    record.m_data.assign(data, size);
+    captureWriter->Write(record);
+}
+
+bool StartPacketCapture(std::string const& file)
+{
+    std::scoped_lock lock(captureLock);
+    auto stream = std::make_unique<std::ofstream>(file, std::ios::binary | std::ios::trunc);
+    if (!stream->is_open())
+    {
+        return false;
+    }
+    captureWriter.reset();
+    captureFile = std::move(stream);
+    captureWriter = std::make_unique<CustomPacketLogWriter>(*captureFile);
+    captureTick = 0;
+    capturing = true;
+    return true;
+}
+
+void StopPacketCapture()
+{
+    std::scoped_lock lock(captureLock);
+    capturing = false;
+    captureWriter.reset();
+    captureFile.reset();
+}
+
+bool IsPacketCapturing()
+{
+    return capturing;
+}
+
+void CaptureTick(uint32 diff)
+{
+    if (!capturing)
+    {
+        return;
+    }
+    {
+        std::scoped_lock lock(captureLock);
+        captureTick++;
+    }
+    Capture(CustomPacketLogKind::TICK, 0, diff, nullptr, 0);
+}
+
+void CaptureWorldPacket(WorldPacket const* packet, Player* player)
+{
+    if (!capturing)
+    {
+        return;
+    }
+    Capture(
+          CustomPacketLogKind::WORLD_PACKET
+        , player ? player->GetGUID().GetRawValue() : 0
+        , packet->GetOpcode()
+        , (char const*)packet->contents()
+        , packet->size()
+    );
+}
+
+void CaptureCustomPacket(CustomPacketRead* packet, uint64 session)
+{
+    if (!capturing)
+    {
+        return;
+    }
+    totalSize_t size = packet->Size();
+    char* bytes = packet->ReadBytes(size);
+    packet->Reset();
+    Capture(CustomPacketLogKind::CUSTOM_PACKET, session, packet->Opcode(), bytes, bytes ? size : 0);
+    delete[] bytes;
+}
+
+void CaptureEvent(std::string const& name, uint64 session)
+{
+    if (!capturing)
+    {
+        return;
+    }
+    Capture(CustomPacketLogKind::EVENT, session, 0, name.c_str(), name.size());
+}
+
+void CaptureEventFired(char const* name, uint32_t id)
+{
+    if (!capturing.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    Capture(CustomPacketLogKind::EVENT, 0, id, name, strlen(name));
+}
+
+struct HandlerTiming
+{
+    uint64 m_calls = 0;
+    uint64 m_ns = 0;
+    uint64 m_maxNs = 0;
+};
+
+using ReplayReport = std::map<std::string, HandlerTiming>;
+
+template <typename... Args>
+static void Invoke(sol::protected_function const& cb, Args&... args)
+{
+    TSLua::handle_error(cb(args...));
+}
+
+template <typename F, typename... Args>
+static void Invoke(F const& cb, Args&... args)
+{
+    cb(args...);
+}
+
+// Fires every callback of an event one at a time, timing each of them.
+// "reset" runs after every callback so the next one sees the same packet.
+template <typename E, typename... Args>
+static void TimedFire(
+      ReplayReport& report
+    , std::string const& name
+    , E& evt
+    , uint32 id
+    , std::function<void()> reset
+    , Args... args
+) {
+    auto run = [&](auto const& cbs, std::string const& key) {
+        for (size_t i = 0; i < cbs.size(); ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            Invoke(cbs[i], args...);
+            uint64 ns = uint64(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start
+            ).count());
+            HandlerTiming& timing = report[key + " #" + std::to_string(i)];
+            timing.m_calls++;
+            timing.m_ns += ns;
+            timing.m_maxNs = std::max(timing.m_maxNs, ns);
+            reset();
+        }
+    };
+
+    run(evt.m_cxx_callbacks, name + " (c++)");
+    run(evt.m_lua_callbacks, name + " (lua)");
+    std::string idName = name + "[" + std::to_string(id) + "]";
+    if (id < evt.m_id_cxx_callbacks.size())
+    {
+        run(evt.m_id_cxx_callbacks[id], idName + " (c++)");
+    }
+    if (id < evt.m_id_lua_callbacks.size())
+    {
+        run(evt.m_id_lua_callbacks[id], idName + " (lua)");
+    }
+}
+
+std::string ReplayPacketCapture(std::string const& file, TSPlayer target)
+{
+    std::ifstream stream(file, std::ios::binary);
+    CustomPacketLogReader reader(stream);
+    if (!reader.IsValid())
+    {
+        return "";
+    }
+
+    ReplayReport report;
+    std::map<uint64, std::unique_ptr<TSServerBuffer>> buffers;
+    std::map<std::string, uint64> events;
+    uint64 records = 0;
+    uint64 errors = 0;
+    CustomPacketLogRecord record;
+    while (reader.Next(record))
+    {
+        records++;
+        switch (record.m_kind)
+        {
+        case CustomPacketLogKind::TICK:
+            TimedFire(
+                  report
+                , "World.OnUpdate"
+                , ts_events.World.OnUpdate_callbacks
+                , 0
+                , [] {}
+                , TSNumber<uint32>(record.m_opcode)
+                , TSMainThreadContext()
+            );
+            break;
+        case CustomPacketLogKind::WORLD_PACKET: {
+            WorldPacket packet(uint16(record.m_opcode), record.m_data.size());
+            packet.append((uint8 const*)record.m_data.data(), record.m_data.size());
+            TimedFire(
+                  report
+                , "WorldPacket.OnReceiveView"
+                , ts_events.WorldPacket.OnReceiveView_callbacks
+                , record.m_opcode
+                , [] {}
+                , TSNumber<uint32>(record.m_opcode)
+                , TSWorldPacketView(&packet)
+                , target
+            );
+            TimedFire(
+                  report
+                , "WorldPacket.OnReceive"
+                , ts_events.WorldPacket.OnReceive_callbacks
+                , record.m_opcode
+                , [&] { packet.rpos(0); }
+                , TSNumber<uint32>(record.m_opcode)
+                , TSWorldPacket(&packet)
+                , target
+            );
+            break;
+        }
+        case CustomPacketLogKind::CUSTOM_PACKET: {
+            // through a buffer per recorded session, so messages are
+            // reassembled, validated and rate limited like live ones
+            std::unique_ptr<TSServerBuffer>& buffer = buffers[record.m_session];
+            if (!buffer)
+            {
+                buffer = std::make_unique<TSServerBuffer>(target, true);
+            }
+            CustomPacketWrite write(opcode_t(record.m_opcode), MAX_FRAGMENT_SIZE, 0);
+            write.WriteBytes(totalSize_t(record.m_data.size()), record.m_data.data());
+            for (CustomPacketChunk& chunk : write.buildMessages())
+            {
+                CustomPacketResult result = buffer->ReceivePacket(chunk.FullSize(), chunk.Data());
+                if (result != CustomPacketResult::HANDLED_FRAGMENT
+                    && result != CustomPacketResult::HANDLED_MESSAGE
+                ) {
+                    errors++;
+                }
+            }
+            write.Destroy();
+            break;
+        }
+        case CustomPacketLogKind::EVENT:
+            // not replayed, their handlers depend on state we can't recreate
+            events[record.m_data]++;
+            break;
+        }
+    }
+
+    std::map<opcode_t, TSCustomPacketOpcodeStats> opcodes;
+    for (auto const& [session, buffer] : buffers)
+    {
+        buffer->CopyStats(opcodes);
+    }
+
+    std::stringstream out;
+    out << "Replayed " << records << " records from " << file << "\n";
+    out << "handler: calls / total ms / avg us / max us\n";
+    for (auto const& [name, timing] : report)
+    {
+        out << name << ": "
+            << timing.m_calls << " / "
+            << (timing.m_ns / 1e6) << " / "
+            << (timing.m_ns / 1e3 / timing.m_calls) << " / "
+            << (timing.m_maxNs / 1e3) << "\n";
+    }
+    out << "custom packet opcode: packets / dropped / invalid / handler ms\n";
+    for (auto const& [opcode, stats] : opcodes)
+    {
+        out << opcode << ": "
+            << stats.m_packets << " / "
+            << stats.m_dropped << " / "
+            << stats.m_invalid << " / "
+            << (stats.m_handlerMicroseconds / 1e3) << "\n";
+    }
+    if (errors > 0)
+    {
+        out << errors << " custom packet fragments were rejected by the buffer\n";
+    }
+    out << "recorded events: fired\n";
+    for (auto const& [name, count] : events)
+    {
+        out << name << ": " << count << "\n";
+    }
+    return out.str();
+}
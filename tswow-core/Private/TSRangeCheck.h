@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "TSMain.h"
+#include "Object.h"
+
+struct FactionTemplateEntry;
+
+// (From ElunaUtil.h/cpp)
+// Doesn't get self
+class WorldObjectInRangeCheck
+{
+public:
+    WorldObjectInRangeCheck(bool nearest, WorldObject const* obj, float range,
+        uint16 typeMask = 0, uint32 entry = 0, uint32 hostile = 0, uint32 dead = 0);
+    WorldObject const& GetFocusObject() const;
+    bool operator()(WorldObject* u);
+
+    WorldObject const* const i_obj;
+    Unit const* i_obj_unit;
+    FactionTemplateEntry const* i_obj_fact;
+    uint32 const i_hostile; // 0 both, 1 hostile, 2 friendly
+    uint32 const i_entry;
+    float i_range;
+    uint16 const i_typeMask;
+    uint32 const i_dead; // 0 both, 1 alive, 2 dead
+    bool const i_nearest;
+};
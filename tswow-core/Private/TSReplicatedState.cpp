@@ -0,0 +1,272 @@
+#include "TSReplicatedState.h"
+#include "TSPlayer.h"
+#include "TSMap.h"
+#include "CustomPacketState.h"
+#include "WorldPacket.h"
+#include "Player.h"
+#include "ObjectAccessor.h"
+#include "Map.h"
+#include "MapManager.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <tuple>
+
+struct TSReplicatedStateEntry
+{
+    std::mutex m_lock;
+    CustomPacketState m_state;
+    // players that have received a snapshot of this state
+    std::set<uint64> m_synced;
+};
+
+// owner type, player guid or (mapId << 32 | instanceId), channel
+using StateKey = std::tuple<CustomPacketStateOwner, uint64, uint32>;
+
+static std::mutex statesLock;
+static std::map<StateKey, std::shared_ptr<TSReplicatedStateEntry>> states;
+static std::atomic<uint32> stateInterval = 100;
+static uint32 stateTimer = 0;
+
+static std::shared_ptr<TSReplicatedStateEntry> GetEntry(StateKey const& key)
+{
+    std::scoped_lock lock(statesLock);
+    auto itr = states.find(key);
+    if (itr != states.end())
+    {
+        return itr->second;
+    }
+    return states[key] = std::make_shared<TSReplicatedStateEntry>();
+}
+
+TSReplicatedState::TSReplicatedState(std::shared_ptr<TSReplicatedStateEntry> entry)
+    : m_entry(entry)
+{}
+
+TSReplicatedState* TSReplicatedState::SetNumber(uint32 field, double value)
+{
+    std::scoped_lock lock(m_entry->m_lock);
+    m_entry->m_state.SetNumber(field, value);
+    return this;
+}
+
+TSReplicatedState* TSReplicatedState::SetString(uint32 field, std::string const& value)
+{
+    std::scoped_lock lock(m_entry->m_lock);
+    m_entry->m_state.SetString(field, value);
+    return this;
+}
+
+TSReplicatedState* TSReplicatedState::Remove(uint32 field)
+{
+    std::scoped_lock lock(m_entry->m_lock);
+    m_entry->m_state.Remove(field);
+    return this;
+}
+
+bool TSReplicatedState::Has(uint32 field)
+{
+    std::scoped_lock lock(m_entry->m_lock);
+    return m_entry->m_state.Has(field);
+}
+
+TSNumber<double> TSReplicatedState::GetNumber(uint32 field, double def)
+{
+    std::scoped_lock lock(m_entry->m_lock);
+    return m_entry->m_state.GetNumber(field, def);
+}
+
+std::string TSReplicatedState::GetString(uint32 field, std::string const& def)
+{
+    std::scoped_lock lock(m_entry->m_lock);
+    return m_entry->m_state.GetString(field, def);
+}
+
+TSReplicatedState GetPlayerState(TSPlayer player, uint32 channel)
+{
+    return TSReplicatedState(GetEntry({
+          CustomPacketStateOwner::PLAYER
+        , player.player->GetGUID().GetRawValue()
+        , channel
+    }));
+}
+
+TSReplicatedState GetMapState(TSMap map, uint32 channel)
+{
+    return TSReplicatedState(GetEntry({
+          CustomPacketStateOwner::MAP
+        , (uint64(map.map->GetId()) << 32) | map.map->GetInstanceId()
+        , channel
+    }));
+}
+
+void SetReplicatedStateInterval(uint32 interval)
+{
+    stateInterval = interval;
+}
+
+static void Send(Player* player, CustomPacketWrite& write)
+{
+    for (auto& chunk : write.buildMessages())
+    {
+        WorldPacket packet(SERVER_TO_CLIENT_OPCODE, chunk.FullSize());
+        packet.append((uint8_t*)chunk.Data(), chunk.FullSize());
+        player->SendDirectMessage(&packet);
+    }
+}
+
+// player guid, owner and channel of a state a player has a copy of
+using SyncKey = std::tuple<uint64, CustomPacketStateOwner, uint32>;
+
+static void SendToPlayers(
+      TSReplicatedStateEntry& entry
+    , CustomPacketStateOwner owner
+    , uint32 channel
+    , std::vector<Player*> const& players
+    , std::set<SyncKey>& synced
+    , std::set<SyncKey>& left
+) {
+    // the delta is only built if someone needs it
+    CustomPacketWrite delta(STATE_OPCODE, MAX_FRAGMENT_SIZE, 0);
+    bool deltaBuilt = false;
+    std::set<uint64> current;
+    for (Player* player : players)
+    {
+        uint64 guid = player->GetGUID().GetRawValue();
+        current.insert(guid);
+        synced.insert({ guid, owner, channel });
+        if (entry.m_synced.find(guid) == entry.m_synced.end())
+        {
+            CustomPacketWrite snapshot(STATE_OPCODE, MAX_FRAGMENT_SIZE, 0);
+            entry.m_state.WriteSnapshot(snapshot, owner, channel);
+            Send(player, snapshot);
+            snapshot.Destroy();
+        }
+        else if (entry.m_state.IsDirty())
+        {
+            if (!deltaBuilt)
+            {
+                entry.m_state.WriteDelta(delta, owner, channel);
+                deltaBuilt = true;
+            }
+            Send(player, delta);
+        }
+    }
+
+    delta.Destroy();
+    // players that left have to resync if they come back
+    for (uint64 guid : entry.m_synced)
+    {
+        if (current.find(guid) == current.end())
+        {
+            left.insert({ guid, owner, channel });
+        }
+    }
+    entry.m_synced.swap(current);
+    entry.m_state.ClearDirty();
+}
+
+// Clears the copies of players that no longer see a state. Skipped if
+// they got another state on the same channel in the same update, like
+// a player moving between two maps that both use it.
+static void SendClears(std::set<SyncKey> const& synced, std::set<SyncKey> const& left)
+{
+    for (SyncKey const& key : left)
+    {
+        if (synced.find(key) != synced.end())
+        {
+            continue;
+        }
+        auto [guid, owner, channel] = key;
+        if (Player* player = ObjectAccessor::FindConnectedPlayer(ObjectGuid(guid)))
+        {
+            CustomPacketWrite clear(STATE_OPCODE, MAX_FRAGMENT_SIZE, 0);
+            CustomPacketState::WriteClear(clear, owner, channel);
+            Send(player, clear);
+            clear.Destroy();
+        }
+    }
+}
+
+// Everyone who had a copy of a state that is about to be dropped
+static void LeaveAll(TSReplicatedStateEntry& entry, CustomPacketStateOwner owner, uint32 channel, std::set<SyncKey>& left)
+{
+    std::scoped_lock entryLock(entry.m_lock);
+    for (uint64 guid : entry.m_synced)
+    {
+        left.insert({ guid, owner, channel });
+    }
+}
+
+void UpdateReplicatedStates(uint32 diff)
+{
+    stateTimer += diff;
+    if (stateTimer < stateInterval)
+    {
+        return;
+    }
+    stateTimer = 0;
+
+    std::set<SyncKey> synced;
+    std::set<SyncKey> left;
+    std::scoped_lock lock(statesLock);
+    for (auto itr = states.begin(); itr != states.end();)
+    {
+        auto [owner, key, channel] = itr->first;
+        std::vector<Player*> players;
+        switch (owner)
+        {
+        case CustomPacketStateOwner::PLAYER:
+            if (Player* player = ObjectAccessor::FindConnectedPlayer(ObjectGuid(key)))
+            {
+                players.push_back(player);
+            }
+            else
+            {
+                // its owner was the only one with a copy
+                itr = states.erase(itr);
+                continue;
+            }
+            break;
+        case CustomPacketStateOwner::MAP:
+            if (Map* map = sMapMgr->FindMap(uint32(key >> 32), uint32(key)))
+            {
+                for (auto const& ref : map->GetPlayers())
+                {
+                    players.push_back(ref.GetSource());
+                }
+            }
+            else
+            {
+                LeaveAll(*itr->second, owner, channel, left);
+                itr = states.erase(itr);
+                continue;
+            }
+            break;
+        }
+        TSReplicatedStateEntry& entry = *itr->second;
+        std::scoped_lock entryLock(entry.m_lock);
+        SendToPlayers(entry, owner, channel, players, synced, left);
+        ++itr;
+    }
+    SendClears(synced, left);
+}
+
+void RemovePlayerStates(TSPlayer player)
+{
+    uint64 guid = player.player->GetGUID().GetRawValue();
+    std::scoped_lock lock(statesLock);
+    for (auto itr = states.begin(); itr != states.end();)
+    {
+        if (std::get<0>(itr->first) == CustomPacketStateOwner::PLAYER && std::get<1>(itr->first) == guid)
+        {
+            itr = states.erase(itr);
+            continue;
+        }
+        std::scoped_lock entryLock(itr->second->m_lock);
+        itr->second->m_synced.erase(guid);
+        ++itr;
+    }
+}
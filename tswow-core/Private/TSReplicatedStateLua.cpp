@@ -0,0 +1,18 @@
+#include "TSLua.h"
+#include "TSLuaVarargs.h"
+#include "TSReplicatedState.h"
+#include "TSPlayer.h"
+#include "TSMap.h"
+
+void TSLua::load_replicated_state_methods(sol::state& state)
+{
+    auto ts_replicatedstate = state.new_usertype<TSReplicatedState>("TSReplicatedState");
+    LUA_FIELD(ts_replicatedstate, TSReplicatedState, SetNumber);
+    LUA_FIELD(ts_replicatedstate, TSReplicatedState, SetString);
+    LUA_FIELD(ts_replicatedstate, TSReplicatedState, Remove);
+    LUA_FIELD(ts_replicatedstate, TSReplicatedState, Has);
+    LUA_FIELD_OVERLOAD_RET_1_1(ts_replicatedstate, TSReplicatedState, GetNumber, uint32, double);
+    LUA_FIELD_OVERLOAD_RET_1_1(ts_replicatedstate, TSReplicatedState, GetString, uint32, std::string const&);
+    state.set_function("GetPlayerState", GetPlayerState);
+    state.set_function("GetMapState", GetMapState);
+}
@@ -31,6 +31,8 @@
 #include "TSSpellInfo.h"
 #include "TSGroup.h"
 #include "TSGuild.h"
+#include "TSAsync.h"
+#include "TSDatabase.h"
 
 #include "ItemTemplate.h"
 #include "QuestDef.h"
@@ -48,11 +50,64 @@
 #endif
 #include "Config.h"
 #include "BattlegroundMgr.h"
+#include "TSCustomPacket.h"
+#include "TSReplicatedState.h"
+#include "TSPacketRecorder.h"
+#include "TSWorldPacket.h"
+#include "WorldSession.h"
+#include "TSLineOfSight.h"
+#include "TSWatchdog.h"
+#include "TSMapMailbox.h"
+#include "TSMapEntryIndex.h"
+#include "TSGameObject.h"
+
+static void LoadTSConfig()
+{
+    SetCustomPacketBatching(
+          sConfigMgr->GetBoolDefault("TSWoW.CustomPacketBatching", false)
+        , totalSize_t(sConfigMgr->GetIntDefault("TSWoW.CustomPacketBatchThreshold", 1024))
+    );
+    SetDefaultCustomPacketRateLimit(
+          sConfigMgr->GetFloatDefault("TSWoW.CustomPacketRateLimit", 0)
+        , sConfigMgr->GetFloatDefault("TSWoW.CustomPacketRateBurst", 20)
+    );
+    SetReplicatedStateInterval(
+        uint32(sConfigMgr->GetIntDefault("TSWoW.ReplicatedStateInterval", 100))
+    );
+    SetWorkerThreads(
+        uint32(sConfigMgr->GetIntDefault("TSWoW.WorkerThreads", 0))
+    );
+    SetLuaCallbackBudget(
+          uint32(sConfigMgr->GetIntDefault("TSWoW.LuaCallbackBudgetMs", 0))
+        , uint32(sConfigMgr->GetIntDefault("TSWoW.LuaCallbackBudgetInstructions", 0))
+        , uint32(sConfigMgr->GetIntDefault("TSWoW.LuaCallbackMaxViolations", 0))
+    );
+    SetWatchdogThreshold(
+        uint32(sConfigMgr->GetIntDefault("TSWoW.WatchdogThresholdMs", 0))
+    );
+    SetCallbackTiming(
+        sConfigMgr->GetBoolDefault("TSWoW.CallbackTiming", false)
+    );
+    TSLua::SetGCBudget(
+        uint32(sConfigMgr->GetIntDefault("TSWoW.LuaGCBudgetUs", 0))
+    );
+    SetLuaArenaDebug(
+        sConfigMgr->GetBoolDefault("TSWoW.LuaArenaDebug", false)
+    );
+}
 
 class TSServerScript : public ServerScript
 {
 public:
     TSServerScript() : ServerScript("TSServerScript"){}
+    void OnPacketReceive(WorldSession* session, WorldPacket& packet) override
+    {
+        FireWorldPacketReceive(&packet, session->GetPlayer());
+    }
+    void OnPacketSend(WorldSession* session, WorldPacket& packet) override
+    {
+        FireWorldPacketSend(&packet, session->GetPlayer());
+    }
 };
 
 class TSWorldScript : public WorldScript
@@ -60,13 +115,42 @@ class TSWorldScript : public WorldScript
 public:
     TSWorldScript() : WorldScript("TSWorldScript"){}
     void OnOpenStateChange(bool open) FIRE(World,OnOpenStateChange,open)
-    void OnConfigLoad(bool reload) FIRE(World,OnConfigLoad,reload)
-    void OnStartup() FIRE(World,OnStartup)
-    void OnShutdown() FIRE(World,OnShutdown)
+    void OnConfigLoad(bool reload)
+    {
+        LoadTSConfig();
+        FIRE(World,OnConfigLoad,reload)
+    }
+    void OnStartup()
+    {
+        LoadTSConfig();
+        FIRE(World,OnStartup)
+    }
+    void OnShutdown()
+    {
+        // the world stops ticking from here on
+        SetWatchdogThreshold(0);
+        FIRE(World,OnShutdown)
+    }
     void OnShutdownCancel() FIRE(World,OnShutdownCancel)
     void OnMotdChange(std::string& newMotd) FIRE(World,OnMotdChange,newMotd)
     void OnShutdownInitiate(ShutdownExitCode code,ShutdownMask mask) FIRE(World,OnShutdownInitiate,code,mask)
-    void OnUpdate(uint32 diff) FIRE(World,OnUpdate,diff, TSMainThreadContext())
+    void OnUpdate(uint32 diff)
+    {
+        TSWatchdogHeartbeat();
+        CaptureTick(diff);
+        FIRE(World,OnUpdate,diff, TSMainThreadContext())
+        // PostToWorld callbacks, including tasks waiting in AwaitWorld/AwaitMap
+        TSWorldMailboxDrain();
+        UpdateReplicatedStates(diff);
+        // query callbacks complete the waits the tick resumes
+        TSProcessAsyncQueries();
+        TSAsyncTick();
+        // before stepping the gc, so it can collect userdata of destroyed entities
+        TSLuaUserdata::ReleaseRefs();
+        TSLua::GCTick();
+        // last, so packets sent by OnUpdate listeners go out this tick
+        FlushCustomPacketBatches();
+    }
 };
 
 class TSUnitScript : public UnitScript
@@ -162,9 +246,18 @@ public:
     void OnTextEmote(Player* player,uint32 textEmote,uint32 emoteNum,ObjectGuid guid) FIRE(Player,OnTextEmote,TSPlayer(player),textEmote,emoteNum,guid.GetRawValue())
     void OnSpellCast(Player* player,Spell* spell,bool skipCheck) FIRE(Player,OnSpellCast,TSPlayer(player),TSSpell(spell),skipCheck)
 #if TRINITY
-    void OnLogin(Player* player,bool firstLogin) FIRE(Player,OnLogin,TSPlayer(player),firstLogin)
+    void OnLogin(Player* player,bool firstLogin)
+    {
+        CaptureEvent("Player.OnLogin", player->GetGUID().GetRawValue());
+        FIRE(Player,OnLogin,TSPlayer(player),firstLogin)
+    }
 #endif
-    void OnLogout(Player* player) FIRE(Player,OnLogout,TSPlayer(player))
+    void OnLogout(Player* player)
+    {
+        CaptureEvent("Player.OnLogout", player->GetGUID().GetRawValue());
+        FIRE(Player,OnLogout,TSPlayer(player))
+        RemovePlayerStates(TSPlayer(player));
+    }
     void OnCreate(Player* player) FIRE(Player,OnCreate,TSPlayer(player))
     void OnDelete(ObjectGuid guid,uint32 accountId) FIRE(Player,OnDelete,guid.GetRawValue(),accountId)
     void OnFailedDelete(ObjectGuid guid,uint32 accountId) FIRE(Player,OnFailedDelete,guid.GetRawValue(),accountId)
@@ -229,6 +322,27 @@ public:
     void OnDisband(Group* group) FIRE(Group,OnDisband,TSGroup(group))
 };
 
+void TSLoadBuiltinEvents()
+{
+    TSSetEventModule("tswow");
+    ts_events.Map.OnCreate([](TSMap map) { TSMapMailboxOpen(map.map); });
+    ts_events.Map.OnUpdate([](TSMap map, TSNumber<uint32>) { TSMapMailboxDrain(map.map); });
+    ts_events.Map.OnCreatureCreate([](TSMap, TSCreature creature, TSMutable<bool,bool>) {
+        TSMapEntryIndexAddCreature(creature.creature);
+    });
+    ts_events.Map.OnCreatureRemove([](TSMap, TSCreature creature) {
+        TSMapEntryIndexRemoveCreature(creature.creature);
+    });
+    ts_events.Map.OnGameObjectCreate([](TSMap, TSGameObject go, TSMutable<bool,bool>) {
+        TSMapEntryIndexAddGameObject(go.go);
+    });
+    ts_events.Map.OnGameObjectRemove([](TSMap, TSGameObject go) {
+        TSMapEntryIndexRemoveGameObject(go.go);
+    });
+    TSEnableMapEntryIndex();
+    TSSetEventModule("");
+}
+
 void AddSC_tswow_commandscript();
 void TSLoadScriptMgrEvents()
 {
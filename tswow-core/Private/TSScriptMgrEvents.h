@@ -1,3 +1,6 @@
 #pragma once
 
-void TSLoadScriptMgrEvents();
\ No newline at end of file
+void TSLoadScriptMgrEvents();
+// Listeners tswow itself needs, registered again after every reload
+// since reloading clears all callbacks.
+void TSLoadBuiltinEvents();
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "TSSpatialQuery.h"
+#include "TSRangeCheck.h"
+#include "TSMap.h"
+#include "TSGUID.h"
+
+#include "Map.h"
+#include "Object.h"
+#include "Cell.h"
+#include "CellImpl.h"
+#include "GridNotifiers.h"
+#include "GameTime.h"
+
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+
+TSSpatialQuery::TSSpatialQuery()
+    : m_data(std::make_shared<TSSpatialQueryData>())
+{}
+
+TSNumber<uint32> TSSpatialQuery::Add(TSWorldObject source, float range, uint32 typeMask, uint32 entry, uint32 hostile, uint32 dead)
+{
+    m_data->m_searches.push_back({ source.obj ? source.obj->GetGUID().GetRawValue() : 0, range, uint16(typeMask), entry, hostile, dead });
+    m_data->m_offsets.clear();
+    m_data->m_results.clear();
+    return uint32(m_data->m_searches.size() - 1);
+}
+
+void TSSpatialQuery::Clear()
+{
+    m_data->m_searches.clear();
+    m_data->m_offsets.clear();
+    m_data->m_results.clear();
+}
+
+TSNumber<uint32> TSSpatialQuery::GetSearchCount()
+{
+    return uint32(m_data->m_searches.size());
+}
+
+TSNumber<uint32> TSSpatialQuery::GetCount(uint32 search)
+{
+    return uint32(End(search) - Begin(search));
+}
+
+TSWorldObject TSSpatialQuery::Get(uint32 search, uint32 index)
+{
+    if (index >= GetCount(search))
+    {
+        return TSWorldObject(nullptr);
+    }
+    WorldObject* value = Begin(search)[index];
+    // may have left the world earlier this tick
+    return TSWorldObject(value->IsInWorld() ? value : nullptr);
+}
+
+static bool IsCurrent(TSSpatialQueryData const& data)
+{
+#if TRINITY
+    return data.m_tick == GameTime::GetGameTimeMS();
+#else
+    return true;
+#endif
+}
+
+WorldObject* const* TSSpatialQuery::Begin(uint32 search)
+{
+    if (search + 1 >= m_data->m_offsets.size() || !IsCurrent(*m_data))
+    {
+        return nullptr;
+    }
+    return m_data->m_results.data() + m_data->m_offsets[search];
+}
+
+WorldObject* const* TSSpatialQuery::End(uint32 search)
+{
+    if (search + 1 >= m_data->m_offsets.size() || !IsCurrent(*m_data))
+    {
+        return nullptr;
+    }
+    return m_data->m_results.data() + m_data->m_offsets[search + 1];
+}
+
+TSSpatialQuery CreateSpatialQuery()
+{
+    return TSSpatialQuery();
+}
+
+#if TRINITY
+namespace
+{
+    struct SpatialCell
+    {
+        CellCoord m_coord;
+        std::vector<uint32> m_searches;
+    };
+
+    // Tests every object in one cell against the searches overlapping it
+    class SpatialCellVisitor
+    {
+    public:
+        SpatialCellVisitor(std::vector<std::optional<WorldObjectInRangeCheck>>& checks, std::vector<std::pair<uint32, WorldObject*>>& hits)
+            : m_checks(checks), m_hits(hits)
+        {}
+
+        template <class T>
+        void Visit(GridRefManager<T>& m)
+        {
+            if constexpr (std::is_base_of<WorldObject, T>::value)
+            {
+                for (auto itr = m.begin(); itr != m.end(); ++itr)
+                {
+                    T* target = itr->GetSource();
+                    for (uint32 search : *m_searches)
+                    {
+                        if ((*m_checks[search])(target))
+                        {
+                            m_hits.push_back({ search, target });
+                        }
+                    }
+                }
+            }
+        }
+
+        std::vector<uint32> const* m_searches = nullptr;
+    private:
+        std::vector<std::optional<WorldObjectInRangeCheck>>& m_checks;
+        std::vector<std::pair<uint32, WorldObject*>>& m_hits;
+    };
+}
+#endif
+
+void RunSpatialQuery(Map* map, TSSpatialQueryData& data)
+{
+    uint32 searchCount = uint32(data.m_searches.size());
+    data.m_results.clear();
+    data.m_offsets.assign(searchCount + 1, 0);
+#if TRINITY
+    data.m_tick = GameTime::GetGameTimeMS();
+    std::vector<std::optional<WorldObjectInRangeCheck>> checks(searchCount);
+    std::vector<SpatialCell> cells;
+    std::unordered_map<uint32, uint32> cellIndices;
+    for (uint32 i = 0; i < searchCount; ++i)
+    {
+        TSSpatialSearch const& search = data.m_searches[i];
+        // sources that are not on this map get an empty span
+        WorldObject* source = TSMap(map).GetWorldObject(TSGUID(search.m_source)).obj;
+        if (!source || !source->IsInWorld())
+        {
+            continue;
+        }
+        checks[i].emplace(false, source, search.m_range, search.m_typeMask, search.m_entry, search.m_hostile, search.m_dead);
+
+        // same area Cell::VisitAllObjects would visit for this search
+        CellArea area = Cell::CalculateCellArea(
+              source->GetPositionX()
+            , source->GetPositionY()
+            , search.m_range + source->GetCombatReach()
+        );
+        for (uint32 x = area.low_bound.x_coord; x <= area.high_bound.x_coord; ++x)
+        {
+            for (uint32 y = area.low_bound.y_coord; y <= area.high_bound.y_coord; ++y)
+            {
+                CellCoord coord(x, y);
+                auto itr = cellIndices.find(coord.GetId());
+                if (itr == cellIndices.end())
+                {
+                    itr = cellIndices.emplace(coord.GetId(), uint32(cells.size())).first;
+                    cells.push_back({ coord, {} });
+                }
+                cells[itr->second].m_searches.push_back(i);
+            }
+        }
+    }
+
+    std::vector<std::pair<uint32, WorldObject*>> hits;
+    SpatialCellVisitor visitor(checks, hits);
+    TypeContainerVisitor<SpatialCellVisitor, GridTypeMapContainer> gridVisitor(visitor);
+    TypeContainerVisitor<SpatialCellVisitor, WorldTypeMapContainer> worldVisitor(visitor);
+    for (SpatialCell const& spatialCell : cells)
+    {
+        Cell cell(spatialCell.m_coord);
+        cell.SetNoCreate();
+        visitor.m_searches = &spatialCell.m_searches;
+        map->Visit(cell, gridVisitor);
+        map->Visit(cell, worldVisitor);
+    }
+
+    // counting sort the hits into one span per search
+    for (auto const& hit : hits)
+    {
+        ++data.m_offsets[hit.first + 1];
+    }
+    for (uint32 i = 0; i < searchCount; ++i)
+    {
+        data.m_offsets[i + 1] += data.m_offsets[i];
+    }
+    data.m_results.resize(hits.size());
+    std::vector<uint32> cursor(data.m_offsets.begin(), data.m_offsets.end() - 1);
+    for (auto const& hit : hits)
+    {
+        data.m_results[cursor[hit.first]++] = hit.second;
+    }
+#endif
+}
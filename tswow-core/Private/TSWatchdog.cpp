@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "TSWatchdog.h"
+#include "TSEventStats.h"
+#include "TSLua.h"
+#include "TSLuaAllocator.h"
+#include "TSLuaProfiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// lua instructions between time budget checks
+static constexpr uint32 BUDGET_CHECK_INTERVAL = 1000;
+
+static uint64_t NowNs()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count());
+}
+
+// The callback each thread is currently running, read by the watchdog thread.
+// Only written while the watchdog runs. Stats are never freed.
+struct CallbackSlot
+{
+    uint32 m_thread;
+    std::atomic<TSCallbackStats*> m_stats { nullptr };
+    std::atomic<uint64_t> m_startNs { 0 };
+};
+
+static std::mutex slotsLock;
+static std::vector<std::shared_ptr<CallbackSlot>> slots;
+static uint32 nextThread = 0;
+
+struct ThreadSlot
+{
+    ThreadSlot()
+    {
+        std::unique_lock<std::mutex> lock(slotsLock);
+        m_slot = std::make_shared<CallbackSlot>();
+        m_slot->m_thread = nextThread++;
+        slots.push_back(m_slot);
+    }
+
+    ~ThreadSlot()
+    {
+        std::unique_lock<std::mutex> lock(slotsLock);
+        slots.erase(std::remove(slots.begin(), slots.end(), m_slot), slots.end());
+    }
+
+    std::shared_ptr<CallbackSlot> m_slot;
+};
+
+static thread_local ThreadSlot threadSlot;
+static thread_local TSCallbackFrame* topFrame = nullptr;
+
+static std::atomic<bool> callbackTiming { false };
+static std::atomic<bool> watchdogRunning { false };
+static std::atomic<uint64_t> budgetNs { 0 };
+static std::atomic<uint64_t> budgetInstructions { 0 };
+static std::atomic<uint32> maxViolations { 0 };
+
+void TSEnterCallback(TSCallbackFrame* frame)
+{
+    bool watchdog = watchdogRunning.load(std::memory_order_relaxed);
+    frame->m_timed = frame->m_stats && callbackTiming.load(std::memory_order_relaxed);
+    if (frame->m_timed || watchdog || budgetNs.load(std::memory_order_relaxed) > 0)
+    {
+        frame->m_startNs = NowNs();
+    }
+    frame->m_prev = topFrame;
+    topFrame = frame;
+    TSLuaArena().Enter();
+    if (frame->m_stats && frame->m_stats->m_lua)
+    {
+        frame->m_prevLuaModule = TSLuaMemory::GetCurrentModule();
+        TSLuaMemory::SetCurrentModule(frame->m_stats->m_luaModule);
+    }
+    if (watchdog)
+    {
+        CallbackSlot* slot = threadSlot.m_slot.get();
+        slot->m_startNs.store(frame->m_startNs, std::memory_order_relaxed);
+        slot->m_stats.store(frame->m_stats, std::memory_order_release);
+    }
+}
+
+void TSLeaveCallback(TSCallbackFrame* frame)
+{
+    topFrame = frame->m_prev;
+    // lua temporaries made by the callback
+    TSLuaArena().Leave();
+    if (frame->m_stats && frame->m_stats->m_lua)
+    {
+        TSLuaMemory::SetCurrentModule(frame->m_prevLuaModule);
+    }
+    if (watchdogRunning.load(std::memory_order_relaxed))
+    {
+        CallbackSlot* slot = threadSlot.m_slot.get();
+        slot->m_stats.store(topFrame ? topFrame->m_stats : nullptr, std::memory_order_release);
+        slot->m_startNs.store(topFrame ? topFrame->m_startNs : 0, std::memory_order_relaxed);
+    }
+    if (!topFrame)
+    {
+        // nothing on this thread can still be using transient userdata
+        TSLuaUserdata::Recycle();
+    }
+
+    TSCallbackStats* stats = frame->m_stats;
+    if (frame->m_timed && frame->m_startNs > 0)
+    {
+        stats->Record(NowNs() - frame->m_startNs);
+    }
+    if (!frame->m_overran || !stats)
+    {
+        return;
+    }
+    uint32 violations = stats->m_violations.fetch_add(1, std::memory_order_relaxed) + 1;
+    uint32 max = maxViolations.load(std::memory_order_relaxed);
+    if (max > 0 && violations >= max && !stats->m_disabled.exchange(true))
+    {
+        TS_LOG_ERROR("tswow.lua", "{} exceeded its budget {} times and is disabled until scripts are reloaded"
+            , stats->m_zoneName.c_str()
+            , violations
+        );
+    }
+}
+
+bool TSCallbackFramesEnabled()
+{
+    return callbackTiming.load(std::memory_order_relaxed)
+        || watchdogRunning.load(std::memory_order_relaxed);
+}
+
+void SetCallbackTiming(bool enabled)
+{
+    callbackTiming.store(enabled, std::memory_order_relaxed);
+}
+
+bool GetCallbackTiming()
+{
+    return callbackTiming.load(std::memory_order_relaxed);
+}
+
+void SetLuaCallbackBudget(uint32 ms, uint32 instructions, uint32 violations)
+{
+    budgetNs.store(uint64_t(ms) * 1000000, std::memory_order_relaxed);
+    budgetInstructions.store(instructions, std::memory_order_relaxed);
+    maxViolations.store(violations, std::memory_order_relaxed);
+    TSLuaInstallHooks();
+}
+
+uint32 TSLuaBudgetInterval()
+{
+    uint64_t instructions = budgetInstructions.load(std::memory_order_relaxed);
+    if (instructions > 0)
+    {
+        return uint32(std::min<uint64_t>(instructions, BUDGET_CHECK_INTERVAL));
+    }
+    return budgetNs.load(std::memory_order_relaxed) > 0 ? BUDGET_CHECK_INTERVAL : 0;
+}
+
+static lua_CFunction GlobalCFunction(lua_State* L, char const* name)
+{
+    lua_getglobal(L, name);
+    lua_CFunction fn = lua_tocfunction(L, -1);
+    lua_pop(L, 1);
+    return fn;
+}
+
+// Whether raising a lua error here only unwinds lua frames and pcalls.
+// Other C frames can be sol bindings or core code with C++ objects
+// alive, that a longjmp through them would never destroy.
+static bool OnlyLuaFrames(lua_State* L)
+{
+    lua_CFunction pcall = GlobalCFunction(L, "pcall");
+    lua_CFunction xpcall = GlobalCFunction(L, "xpcall");
+    lua_Debug ar;
+    for (int level = 0; lua_getstack(L, level, &ar); ++level)
+    {
+        lua_getinfo(L, "Sf", &ar);
+        lua_CFunction fn = lua_tocfunction(L, -1);
+        lua_pop(L, 1);
+        if (ar.what[0] == 'C' && !(fn && (fn == pcall || fn == xpcall)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TSLuaBudgetCheck(lua_State* L, uint32 instructions)
+{
+    // lua runs outside of event callbacks too (timers, delayed calls),
+    // only the innermost lua callback is charged.
+    TSCallbackFrame* frame = topFrame;
+    while (frame && !(frame->m_stats && frame->m_stats->m_lua))
+    {
+        frame = frame->m_prev;
+    }
+    if (!frame)
+    {
+        return;
+    }
+
+    frame->m_instructions += instructions;
+    uint64_t maxInstructions = budgetInstructions.load(std::memory_order_relaxed);
+    uint64_t maxNs = budgetNs.load(std::memory_order_relaxed);
+    // no start time if the budget was set during the callback
+    uint64_t elapsedNs = frame->m_startNs > 0 ? NowNs() - frame->m_startNs : 0;
+    if (!frame->m_overran)
+    {
+        bool overInstructions = maxInstructions > 0 && frame->m_instructions >= maxInstructions;
+        if (!overInstructions && !(maxNs > 0 && elapsedNs >= maxNs))
+        {
+            return;
+        }
+        // counted as a violation when the callback returns, even if
+        // it returns before it could be aborted
+        frame->m_overran = true;
+    }
+
+    // Inside a binding (a lua function passed to C++) the callback is
+    // aborted once it is back in plain lua. Until it returns, this keeps
+    // raising in case the script catches it.
+    if (!OnlyLuaFrames(L))
+    {
+        return;
+    }
+    {
+        std::string message = frame->m_stats->m_zoneName + " exceeded its budget after "
+            + std::to_string(frame->m_instructions) + " instructions and "
+            + std::to_string(elapsedNs / 1000000) + "ms";
+        luaL_traceback(L, L, message.c_str(), 0);
+    }
+    // only lua frames, pcalls, this hook and the lua vm are unwound
+    lua_error(L);
+}
+
+static std::mutex watchdogLock;
+static std::condition_variable watchdogCondition;
+static std::thread watchdogThread;
+static uint64_t watchdogThresholdNs = 0;
+static std::atomic<uint64_t> lastHeartbeat { 0 };
+
+void TSWatchdogHeartbeat()
+{
+    lastHeartbeat.store(NowNs(), std::memory_order_relaxed);
+}
+
+static void ReportStall(uint64_t now, uint64_t stalledNs)
+{
+    TS_LOG_WARNING("tswow.watchdog", "World thread has not ticked for {}ms", stalledNs / 1000000);
+    bool any = false;
+    std::unique_lock<std::mutex> lock(slotsLock);
+    for (std::shared_ptr<CallbackSlot> const& slot : slots)
+    {
+        TSCallbackStats* stats = slot->m_stats.load(std::memory_order_acquire);
+        uint64_t start = slot->m_startNs.load(std::memory_order_relaxed);
+        if (!stats || start == 0)
+        {
+            continue;
+        }
+        any = true;
+        TS_LOG_WARNING("tswow.watchdog", "  thread {}: in {} for {}ms"
+            , slot->m_thread
+            , stats->m_zoneName.c_str()
+            , (now > start ? now - start : 0) / 1000000
+        );
+    }
+    if (!any)
+    {
+        TS_LOG_WARNING("tswow.watchdog", "  no script callback is running");
+    }
+}
+
+static void WatchdogLoop()
+{
+    std::unique_lock<std::mutex> lock(watchdogLock);
+    uint64_t reportedBeat = 0;
+    uint64_t lastReport = 0;
+    while (watchdogThresholdNs > 0)
+    {
+        uint64_t threshold = watchdogThresholdNs;
+        watchdogCondition.wait_for(lock, std::chrono::nanoseconds(std::max<uint64_t>(threshold / 4, 1000000)));
+        if (watchdogThresholdNs == 0)
+        {
+            break;
+        }
+
+        uint64_t beat = lastHeartbeat.load(std::memory_order_relaxed);
+        uint64_t now = NowNs();
+        if (beat == 0 || now - beat < threshold)
+        {
+            continue;
+        }
+        // once per threshold while the same tick is stuck
+        if (beat == reportedBeat && now - lastReport < threshold)
+        {
+            continue;
+        }
+        reportedBeat = beat;
+        lastReport = now;
+        ReportStall(now, now - beat);
+    }
+}
+
+struct WatchdogStopper
+{
+    ~WatchdogStopper() { SetWatchdogThreshold(0); }
+};
+static WatchdogStopper watchdogStopper;
+
+void SetWatchdogThreshold(uint32 ms)
+{
+    std::thread old;
+    {
+        std::unique_lock<std::mutex> lock(watchdogLock);
+        watchdogThresholdNs = uint64_t(ms) * 1000000;
+        watchdogRunning.store(ms > 0, std::memory_order_relaxed);
+        if (ms > 0)
+        {
+            // don't report the time spent before the first tick
+            lastHeartbeat.store(0, std::memory_order_relaxed);
+            {
+                // left over from when the watchdog last ran
+                std::unique_lock<std::mutex> slotLock(slotsLock);
+                for (std::shared_ptr<CallbackSlot> const& slot : slots)
+                {
+                    slot->m_stats.store(nullptr, std::memory_order_relaxed);
+                    slot->m_startNs.store(0, std::memory_order_relaxed);
+                }
+            }
+            if (!watchdogThread.joinable())
+            {
+                watchdogThread = std::thread(WatchdogLoop);
+            }
+            return;
+        }
+        std::swap(old, watchdogThread);
+    }
+    watchdogCondition.notify_all();
+    if (old.joinable())
+    {
+        old.join();
+    }
+}
@@ -7,10 +7,18 @@ void TSLua::load_worldentity_methods(sol::state & state)
     LUA_FIELD(ts_worldobjectgroup, TSWorldObjectGroup, Add);
     LUA_FIELD(ts_worldobjectgroup, TSWorldObjectGroup, Remove);
     LUA_FIELD(ts_worldobjectgroup, TSWorldObjectGroup, RemovedByObject);
+    LUA_FIELD(ts_worldobjectgroup, TSWorldObjectGroup, Contains);
     LUA_FIELD(ts_worldobjectgroup, TSWorldObjectGroup, Clear);
+    state.set_function("GetObjectGroupKey", GetObjectGroupKey);
 
     auto ts_worldobjectgroups = state.new_usertype<TSWorldObjectGroups>("TSWorldObjectGroups");
-    LUA_FIELD(ts_worldobjectgroups, TSWorldObjectGroups, GetGroup);
-    LUA_FIELD(ts_worldobjectgroups, TSWorldObjectGroups, RemoveGroup);
+    ts_worldobjectgroups.set_function("GetGroup", sol::overload(
+        [](TSWorldObjectGroups& groups, std::string const& key) { return groups.GetGroup(key); },
+        [](TSWorldObjectGroups& groups, uint32 key) { return groups.GetGroup(key); }
+    ));
+    ts_worldobjectgroups.set_function("RemoveGroup", sol::overload(
+        [](TSWorldObjectGroups& groups, std::string const& key) { groups.RemoveGroup(key); },
+        [](TSWorldObjectGroups& groups, uint32 key) { groups.RemoveGroup(key); }
+    ));
     LUA_FIELD(ts_worldobjectgroups, TSWorldObjectGroups, ClearGroups);
 }
@@ -8,8 +8,14 @@ template <typename C, typename T>
 void TSLua::load_world_entity_methods_t(sol::state & state, sol::usertype<T> & target, std::string const& name)
 {
     load_entity_methods_t(state, target, name);
-    LUA_FIELD(target, TSWorldEntityProvider<C>, GetEntityGroup);
-    LUA_FIELD(target, TSWorldEntityProvider<C>, RemoveEntityGroup);
+    target.set_function("GetEntityGroup", sol::overload(
+        [](T & prov, std::string const& key) { return prov.GetEntityGroup(key); },
+        [](T & prov, uint32 key) { return prov.GetEntityGroup(key); }
+    ));
+    target.set_function("RemoveEntityGroup", sol::overload(
+        [](T & prov, std::string const& key) { prov.RemoveEntityGroup(key); },
+        [](T & prov, uint32 key) { prov.RemoveEntityGroup(key); }
+    ));
     LUA_FIELD(target, TSWorldEntityProvider<C>, ClearEntityGroup);
         target.set_function("AddTimer", sol::overload(
             [=](T & prov, uint32_t time, int32_t loops, uint32_t flags, sol::protected_function callback) {
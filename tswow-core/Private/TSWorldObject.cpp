@@ -16,6 +16,10 @@
  */
 
 #include <memory.h>
+#include <atomic>
+#include <map>
+#include <tuple>
+#include <type_traits>
 #include "Object.h"
 #include "TSFactionTemplate.h"
 #include "TSIncludes.h"
@@ -39,6 +43,12 @@
 #include "TSItem.h"
 #include "TSMainThreadContext.h"
 #include "TSGUID.h"
+#include "TSCollisionGrid.h"
+#include "TSRangeCheck.h"
+#include "GameTime.h"
+#include "ObjectAccessor.h"
+#include "MapManager.h"
+#include "TSMapMailbox.h"
 
 TSWorldObject::TSWorldObject(WorldObject *objIn)
     : TSObject(objIn)
@@ -652,27 +662,6 @@ void TSWorldObject::PlayDistanceSound(uint32 soundId,TSPlayer _player)
         obj->PlayDistanceSound(soundId);
 }
 
-// (From ElunaUtil.h/cpp)
-// Doesn't get self
-class WorldObjectInRangeCheck
-{
-public:
-    WorldObjectInRangeCheck(bool nearest, WorldObject const* obj, float range,
-        uint16 typeMask = 0, uint32 entry = 0, uint32 hostile = 0, uint32 dead = 0);
-    WorldObject const& GetFocusObject() const;
-    bool operator()(WorldObject* u);
-
-    WorldObject const* const i_obj;
-    Unit const* i_obj_unit;
-    FactionTemplateEntry const* i_obj_fact;
-    uint32 const i_hostile; // 0 both, 1 hostile, 2 friendly
-    uint32 const i_entry;
-    float i_range;
-    uint16 const i_typeMask;
-    uint32 const i_dead; // 0 both, 1 alive, 2 dead
-    bool const i_nearest;
-};
-
 WorldObjectInRangeCheck::WorldObjectInRangeCheck(bool nearest, WorldObject const* obj, float range,
     uint16 typeMask, uint32 entry, uint32 hostile, uint32 dead) :
     i_obj(obj), i_obj_unit(nullptr), i_obj_fact(nullptr), i_hostile(hostile), i_entry(entry), i_range(range), i_typeMask(typeMask), i_dead(dead), i_nearest(nearest)
@@ -739,68 +728,343 @@ bool WorldObjectInRangeCheck::operator()(WorldObject* u)
     return true;
 }
 
-TSArray<TSCreature> TSWorldObject::GetCreaturesInRange(float range, uint32 entry, uint32 hostile, uint32 dead)
-{
-    TSArray<TSCreature> arr;
 #if TRINITY
-    std::list<Creature*> list;
-    WorldObjectInRangeCheck checker(false, obj, range, TYPEMASK_UNIT, entry, hostile, dead);
-    Trinity::CreatureListSearcher<WorldObjectInRangeCheck> searcher(obj, list, checker);
+static const std::string QUERY_CACHE_KEY = "__tswow_query_cache";
+static std::atomic<uint64> queryCacheHits(0);
+static std::atomic<uint64> queryCacheMisses(0);
+
+enum class TSQueryType : uint32
+{
+    CREATURES,
+    PLAYERS,
+    UNITS,
+    GAMEOBJECTS
+};
+
+/**
+ * Get*InRange results of a single object, dropped as soon as
+ * the game time changes so they never outlive one map update.
+ *
+ * Stored as guids and resolved when read, since objects found
+ * earlier in the tick can leave the world before that.
+ */
+struct TSQueryCache
+{
+    uint32 m_tick = 0;
+    // shared so lua iterators over a result keep it alive
+    std::map<std::tuple<uint32, float, uint32, uint32, uint32>, std::shared_ptr<std::vector<ObjectGuid>>> m_results;
+};
+
+static TSQueryCache* FindQueryCache(WorldObject* obj)
+{
+    if (!obj->m_tsEntity.m_compiledClasses.HasObject(QUERY_CACHE_KEY))
+    {
+        return nullptr;
+    }
+    return obj->m_tsEntity.m_compiledClasses.GetObject<TSQueryCache>(QUERY_CACHE_KEY).get();
+}
+
+template <typename T, typename Searcher>
+static std::list<T*> SearchGrid(WorldObject* obj, float range, uint16 typeMask, uint32 entry, uint32 hostile, uint32 dead)
+{
+    std::list<T*> list;
+    WorldObjectInRangeCheck checker(false, obj, range, typeMask, entry, hostile, dead);
+    Searcher searcher(obj, list, checker);
     Cell::VisitAllObjects(obj, searcher, range);
-    for (std::list<Creature*>::const_iterator it = list.begin(); it != list.end(); ++it)
+    return list;
+}
+
+/**
+ * The guids of the objects found by a range query,
+ * from the objects query cache if it has one.
+ */
+template <typename T, typename Searcher>
+static std::shared_ptr<std::vector<ObjectGuid>> SearchInRangeGuids(WorldObject* obj, TSQueryType type, float range, uint16 typeMask, uint32 entry, uint32 hostile, uint32 dead)
+{
+    auto search = [&]() {
+        auto guids = std::make_shared<std::vector<ObjectGuid>>();
+        for (T* value : SearchGrid<T, Searcher>(obj, range, typeMask, entry, hostile, dead))
+        {
+            guids->push_back(value->GetGUID());
+        }
+        return guids;
+    };
+
+    TSQueryCache* cache = FindQueryCache(obj);
+    if (!cache)
     {
-        arr.push(TSCreature(*it));
+        return search();
+    }
+
+    uint32 tick = GameTime::GetGameTimeMS();
+    if (cache->m_tick != tick)
+    {
+        cache->m_results.clear();
+        cache->m_tick = tick;
+    }
+
+    auto key = std::make_tuple(uint32(type), range, entry, hostile, dead);
+    auto itr = cache->m_results.find(key);
+    if (itr == cache->m_results.end())
+    {
+        ++queryCacheMisses;
+        itr = cache->m_results.emplace(key, search()).first;
+    }
+    else
+    {
+        ++queryCacheHits;
+    }
+    return itr->second;
+}
+
+template <typename R, typename T, typename Searcher>
+static TSArray<R> SearchInRange(WorldObject* obj, TSQueryType type, float range, uint16 typeMask, uint32 entry, uint32 hostile, uint32 dead)
+{
+    TSArray<R> arr;
+    if (!FindQueryCache(obj))
+    {
+        for (T* value : SearchGrid<T, Searcher>(obj, range, typeMask, entry, hostile, dead))
+        {
+            arr.push(R(value));
+        }
+        return arr;
+    }
+
+    // the caller owns the array, so a copy is returned
+    std::shared_ptr<std::vector<ObjectGuid>> results = SearchInRangeGuids<T, Searcher>(obj, type, range, typeMask, entry, hostile, dead);
+    arr.vec->reserve(results->size());
+    for (ObjectGuid const& guid : *results)
+    {
+        // may have left the world earlier this tick
+        if (WorldObject* value = ObjectAccessor::GetWorldObject(*obj, guid))
+        {
+            arr.push(R(static_cast<T*>(value)));
+        }
     }
-#endif
     return arr;
 }
 
+/**
+ * Walks a range query from lua without copying it to an array or table.
+ */
+template <typename R, typename T, typename Searcher>
+static TSLua::Iterator<R> IterateInRange(WorldObject* obj, TSQueryType type, float range, uint16 typeMask, uint32 entry, uint32 hostile, uint32 dead)
+{
+    std::shared_ptr<std::vector<ObjectGuid>> results = SearchInRangeGuids<T, Searcher>(obj, type, range, typeMask, entry, hostile, dead);
+    // obj can be gone once the callback returns
+    return TSLua::CallbackIterator<R>([obj, results, index = size_t(0)]() mutable -> sol::optional<R> {
+        while (index < results->size())
+        {
+            if (WorldObject* value = ObjectAccessor::GetWorldObject(*obj, (*results)[index++]))
+            {
+                return R(static_cast<T*>(value));
+            }
+        }
+        return sol::nullopt;
+    });
+}
+#endif
+
+TSArray<TSCreature> TSWorldObject::GetCreaturesInRange(float range, uint32 entry, uint32 hostile, uint32 dead)
+{
+#if TRINITY
+    return SearchInRange<TSCreature, Creature, Trinity::CreatureListSearcher<WorldObjectInRangeCheck>>(obj, TSQueryType::CREATURES, range, TYPEMASK_UNIT, entry, hostile, dead);
+#else
+    return TSArray<TSCreature>();
+#endif
+}
+
 TSArray<TSUnit> TSWorldObject::GetUnitsInRange(float range, uint32 hostile, uint32 dead)
 {
-    TSArray<TSUnit> arr;
 #if TRINITY
-    std::list<Unit*> list;
-    WorldObjectInRangeCheck checker(false, obj, range, TYPEMASK_UNIT, 0, hostile, dead);
-    Trinity::UnitListSearcher<WorldObjectInRangeCheck> searcher(obj, list, checker);
-    Cell::VisitAllObjects(obj, searcher, range);
-    for (std::list<Unit*>::const_iterator it = list.begin(); it != list.end(); ++it)
-    {
-        arr.push(TSUnit(*it));
-    }
+    return SearchInRange<TSUnit, Unit, Trinity::UnitListSearcher<WorldObjectInRangeCheck>>(obj, TSQueryType::UNITS, range, TYPEMASK_UNIT, 0, hostile, dead);
+#else
+    return TSArray<TSUnit>();
 #endif
-    return arr;
 }
 
 TSArray<TSPlayer> TSWorldObject::GetPlayersInRange(float range, uint32 hostile, uint32 dead)
 {
-    TSArray<TSPlayer> arr;
 #if TRINITY
-    std::list<Player*> list;
-    WorldObjectInRangeCheck checker(false, obj, range, TYPEMASK_PLAYER, 0, hostile, dead);
-    Trinity::PlayerListSearcher<WorldObjectInRangeCheck> searcher(obj, list, checker);
-    Cell::VisitAllObjects(obj, searcher, range);
-    for (std::list<Player*>::const_iterator it = list.begin(); it != list.end(); ++it)
+    return SearchInRange<TSPlayer, Player, Trinity::PlayerListSearcher<WorldObjectInRangeCheck>>(obj, TSQueryType::PLAYERS, range, TYPEMASK_PLAYER, 0, hostile, dead);
+#else
+    return TSArray<TSPlayer>();
+#endif
+}
+
+TSArray<TSGameObject> TSWorldObject::GetGameObjectsInRange(float range, uint32 entry, uint32 hostile)
+{
+#if TRINITY
+    return SearchInRange<TSGameObject, GameObject, Trinity::GameObjectListSearcher<WorldObjectInRangeCheck>>(obj, TSQueryType::GAMEOBJECTS, range, TYPEMASK_GAMEOBJECT, entry, hostile, 0);
+#else
+    return TSArray<TSGameObject>();
+#endif
+}
+
+void TSWorldObject::SetQueryCache(bool enabled)
+{
+#if TRINITY
+    if (enabled == HasQueryCache())
     {
-        arr.push(TSPlayer(*it));
+        return;
     }
+    obj->m_tsEntity.m_compiledClasses.SetObject(QUERY_CACHE_KEY, enabled ? std::make_shared<TSQueryCache>() : std::shared_ptr<TSQueryCache>());
 #endif
-    return arr;
 }
 
-TSArray<TSGameObject> TSWorldObject::GetGameObjectsInRange(float range, uint32 entry, uint32 hostile)
+bool TSWorldObject::HasQueryCache()
 {
-    TSArray<TSGameObject> arr;
 #if TRINITY
-    std::list<GameObject*> list;
-    WorldObjectInRangeCheck checker(false, obj, range, TYPEMASK_GAMEOBJECT, entry, hostile);
-    Trinity::GameObjectListSearcher<WorldObjectInRangeCheck> searcher(obj, list, checker);
+    return FindQueryCache(obj) != nullptr;
+#else
+    return false;
+#endif
+}
+
+TSNumber<uint64> GetQueryCacheHits()
+{
+#if TRINITY
+    return uint64(queryCacheHits);
+#else
+    return 0;
+#endif
+}
+
+TSNumber<uint64> GetQueryCacheMisses()
+{
+#if TRINITY
+    return uint64(queryCacheMisses);
+#else
+    return 0;
+#endif
+}
+
+void ResetQueryCacheStats()
+{
+#if TRINITY
+    queryCacheHits = 0;
+    queryCacheMisses = 0;
+#endif
+}
+
+#if TRINITY
+/**
+ * Grid visitor that collects the guids of matching objects into a reused
+ * buffer instead of a TSArray. Stops once `limit` objects were found.
+ */
+template <class R>
+class TSVisitSearcher
+{
+public:
+    TSVisitSearcher(WorldObjectInRangeCheck& check, std::vector<ObjectGuid>& out, uint32 limit)
+        : i_check(check), i_out(out), i_limit(limit)
+    {}
+
+    template <class T>
+    void Visit(GridRefManager<T>& m)
+    {
+        if constexpr (std::is_base_of<R, T>::value)
+        {
+            for (auto itr = m.begin(); itr != m.end() && !IsFull(); ++itr)
+            {
+                T* source = itr->GetSource();
+                if (!i_check.i_obj->InSamePhase(source) || !i_check(source))
+                    continue;
+                i_out.push_back(source->GetGUID());
+            }
+        }
+    }
+private:
+    bool IsFull() const { return i_limit && i_out.size() >= i_limit; }
+
+    WorldObjectInRangeCheck& i_check;
+    std::vector<ObjectGuid>& i_out;
+    uint32 const i_limit;
+};
+
+// Free buffers for VisitInRange, a walk takes one out so a callback
+// can start another walk without clobbering it
+static thread_local std::vector<std::vector<ObjectGuid>> visitBuffers;
+
+/**
+ * Runs `callback` on every object the grid walk found, after the walk
+ * has finished so callbacks are free to spawn, despawn or move objects.
+ * Objects that left the map during an earlier callback are skipped.
+ */
+template <class R, class F>
+static uint32 VisitInRange(WorldObject* obj, WorldObjectInRangeCheck& check, float range, uint32 limit, F callback)
+{
+    std::vector<ObjectGuid> guids;
+    if (!visitBuffers.empty())
+    {
+        guids = std::move(visitBuffers.back());
+        visitBuffers.pop_back();
+    }
+
+    TSVisitSearcher<R> searcher(check, guids, limit);
     Cell::VisitAllObjects(obj, searcher, range);
-    for (std::list<GameObject*>::const_iterator it = list.begin(); it != list.end(); ++it)
+
+    // obj can be gone once a callback returns
+    TSMap map(obj->GetMap());
+    uint32 count = 0;
+    for (ObjectGuid const& guid : guids)
     {
-        arr.push(TSGameObject(*it));
+        WorldObject* value = map.GetWorldObject(TSGUID(guid.GetRawValue())).obj;
+        if (!value)
+        {
+            continue;
+        }
+        ++count;
+        if (!callback(static_cast<R*>(value)))
+        {
+            break;
+        }
     }
+
+    guids.clear();
+    visitBuffers.push_back(std::move(guids));
+    return count;
+}
+#endif
+
+uint32 TSWorldObject::ForEachCreatureInRange(float range, uint32 entry, uint32 hostile, uint32 dead, std::function<bool(TSCreature)> callback, uint32 limit)
+{
+#if TRINITY
+    WorldObjectInRangeCheck checker(false, obj, range, TYPEMASK_UNIT, entry, hostile, dead);
+    return VisitInRange<Creature>(obj, checker, range, limit, [&](Creature* c) { return callback(TSCreature(c)); });
+#else
+    return 0;
+#endif
+}
+
+uint32 TSWorldObject::ForEachUnitInRange(float range, uint32 hostile, uint32 dead, std::function<bool(TSUnit)> callback, uint32 limit)
+{
+#if TRINITY
+    WorldObjectInRangeCheck checker(false, obj, range, TYPEMASK_UNIT, 0, hostile, dead);
+    return VisitInRange<Unit>(obj, checker, range, limit, [&](Unit* u) { return callback(TSUnit(u)); });
+#else
+    return 0;
+#endif
+}
+
+uint32 TSWorldObject::ForEachPlayerInRange(float range, uint32 hostile, uint32 dead, std::function<bool(TSPlayer)> callback, uint32 limit)
+{
+#if TRINITY
+    WorldObjectInRangeCheck checker(false, obj, range, TYPEMASK_PLAYER, 0, hostile, dead);
+    return VisitInRange<Player>(obj, checker, range, limit, [&](Player* p) { return callback(TSPlayer(p)); });
+#else
+    return 0;
+#endif
+}
+
+uint32 TSWorldObject::ForEachGameObjectInRange(float range, uint32 entry, uint32 hostile, std::function<bool(TSGameObject)> callback, uint32 limit)
+{
+#if TRINITY
+    WorldObjectInRangeCheck checker(false, obj, range, TYPEMASK_GAMEOBJECT, entry, hostile);
+    return VisitInRange<GameObject>(obj, checker, range, limit, [&](GameObject* g) { return callback(TSGameObject(g)); });
+#else
+    return 0;
 #endif
-    return arr;
 }
 
 TSPlayer TSWorldObject::GetNearestPlayer(float range, uint32 hostile, uint32 dead)
@@ -949,6 +1213,135 @@ TSCollisionEntry::TSCollisionEntry(std::string const& name, float range, uint32_
     this->minDelay = minDelay;
 }
 
+#if TRINITY
+// Width of the areas whose collision owners share one grid search
+static constexpr float COLLISION_CLUSTER_SIZE = 64.0f;
+// Range searched around each area by default, grown on demand for larger collisions
+static constexpr float COLLISION_MIN_SEARCH_RANGE = 40.0f;
+// Extra range for units that moved after the grid was filled this tick.
+// Normal movement stays well below this within one map update, units
+// that jump further (charges, blinks, teleports) are only found by
+// collisions ticked before the grid was filled, or on the next tick.
+static constexpr float COLLISION_MOVE_MARGIN = 5.0f;
+static const std::string COLLISION_BROADPHASE_KEY = "__tswow_collision_broadphase";
+
+/**
+ * Per-map broadphase for collision entries.
+ *
+ * Collision owners are grouped into COLLISION_CLUSTER_SIZE areas. The
+ * first owner in an area each tick does a single grid search for all
+ * units around it and puts them in a TSCollisionGrid, every other
+ * owner in the same area queries that instead of searching the map.
+ *
+ * Positions are those at the time the grid was filled, so unlike a
+ * search per owner, a unit that moved more than COLLISION_MOVE_MARGIN
+ * since then can be missed for one tick. The grid is refilled when
+ * the game time changes, which is once per world update, before any
+ * of the maps objects are removed.
+ */
+class TSCollisionBroadphase
+{
+    struct Cluster
+    {
+        // guids, units can leave the map before the cluster is rebuilt
+        TSCollisionGrid<ObjectGuid> grid;
+        float searchRange = 0;
+        float maxReach = 0;
+    };
+
+    class UnitCollector
+    {
+    public:
+        UnitCollector(Cluster& cluster)
+            : m_cluster(cluster)
+        {}
+
+        template <class T>
+        void Visit(GridRefManager<T>& m)
+        {
+            if constexpr (std::is_base_of<Unit, T>::value)
+            {
+                for (auto itr = m.begin(); itr != m.end(); ++itr)
+                {
+                    T* unit = itr->GetSource();
+                    m_cluster.grid.Insert(unit->GetGUID(), unit->GetPositionX(), unit->GetPositionY(), unit->GetPositionZ());
+                    m_cluster.maxReach = std::max(m_cluster.maxReach, unit->GetCombatReach());
+                }
+            }
+        }
+    private:
+        Cluster& m_cluster;
+    };
+
+    uint32 m_tick = 0;
+    std::unordered_map<uint64, Cluster> m_clusters;
+
+    static int32 ClusterCoord(float value)
+    {
+        return int32(std::floor(value / COLLISION_CLUSTER_SIZE));
+    }
+public:
+    static TSCollisionBroadphase* Get(Map* map)
+    {
+        return map->m_tsEntity.m_compiledClasses.GetObject<TSCollisionBroadphase>(COLLISION_BROADPHASE_KEY, []() {
+            return std::make_shared<TSCollisionBroadphase>();
+        }).get();
+    }
+
+    /**
+     * Calls callback(unit) for every unit other than owner that
+     * owner->IsWithinDistInMap(unit, range) would accept.
+     */
+    template <typename F>
+    void Query(WorldObject* owner, float range, F callback)
+    {
+        uint32 tick = GameTime::GetGameTimeMS();
+        if (tick != m_tick)
+        {
+            m_clusters.clear();
+            m_tick = tick;
+        }
+
+        int32 cx = ClusterCoord(owner->GetPositionX());
+        int32 cy = ClusterCoord(owner->GetPositionY());
+        float centerX = (cx + 0.5f) * COLLISION_CLUSTER_SIZE;
+        float centerY = (cy + 0.5f) * COLLISION_CLUSTER_SIZE;
+        Cluster& cluster = m_clusters[(uint64(uint32(cx)) << 32) | uint32(cy)];
+
+        // owners are at most half a diagonal from the center, anything
+        // they can reach is within that plus their range and reach.
+        float needed = COLLISION_CLUSTER_SIZE * 0.7072f + range + owner->GetCombatReach() + cluster.maxReach + COLLISION_MOVE_MARGIN;
+        if (cluster.searchRange < needed)
+        {
+            cluster.grid.Clear();
+            cluster.maxReach = 0;
+            cluster.searchRange = std::max(needed + 10.0f, COLLISION_MIN_SEARCH_RANGE);
+            UnitCollector collector(cluster);
+            Cell::VisitAllObjects(centerX, centerY, owner->GetMap(), collector, cluster.searchRange);
+        }
+
+        cluster.grid.Query(
+              owner->GetPositionX()
+            , owner->GetPositionY()
+            , owner->GetPositionZ()
+            , range + owner->GetCombatReach() + cluster.maxReach + COLLISION_MOVE_MARGIN
+            , [&](ObjectGuid const& guid) {
+                if (guid == owner->GetGUID())
+                {
+                    return;
+                }
+                // skips units that left the map since the cluster was built
+                Unit* unit = ObjectAccessor::GetUnit(*owner, guid);
+                if (unit && unit->IsInWorld() && unit->GetMap() == owner->GetMap() && owner->IsWithinDistInMap(unit, range))
+                {
+                    callback(unit);
+                }
+            }
+        );
+    }
+};
+#endif
+
 bool TSCollisionEntry::Tick(TSWorldObject value, bool force)
 {
     uint64_t now = std::chrono::duration_cast<std::chrono::milliseconds>
@@ -963,24 +1356,41 @@ bool TSCollisionEntry::Tick(TSWorldObject value, bool force)
         lastHit = now;
     }
 
-    auto units = value->GetUnitsInRange(this->range,0,0);
+    std::vector<Unit*> units;
+#if TRINITY
+    if (!value->obj->FindMap())
+    {
+        return false;
+    }
+    TSCollisionBroadphase::Get(value->obj->GetMap())->Query(value->obj, range, [&](Unit* unit) {
+        units.push_back(unit);
+    });
+#endif
+
+    hitTracker.Prune(now, hitExpiry, maxTrackedHits, [&](uint64 guid) {
+        hitmap._map->erase(guid);
+    });
 
     uint32_t cancelMode = 0;
-    for(auto &unit: *(units.vec))
+    for(Unit* unitPtr: units)
     {
+        TSUnit unit(unitPtr);
+        uint64 guid = unit->GetGUID().asGUID();
         uint32_t hits = 0;
         if(maxHits == 0)
         {
 
         }
-        else if(!hitmap.contains(unit->GetGUID().asGUID()))
+        else if(!hitmap.contains(guid))
         {
-            hitmap.set(unit->GetGUID().asGUID(), 1);
+            hitmap.set(guid, 1);
+            hitTracker.Touch(guid, now);
         }
         else
         {
-            hits = hitmap.get(unit->GetGUID().asGUID());
-            hitmap.set(unit->GetGUID().asGUID(), hits + 1);
+            hits = hitmap.get(guid);
+            hitmap.set(guid, hits + 1);
+            hitTracker.Touch(guid, now);
         }
 
         if(maxHits == 0 || hits < maxHits)
@@ -997,6 +1407,7 @@ bool TSCollisionEntry::Tick(TSWorldObject value, bool force)
             }
         }
     }
+
     return cancelMode == 1;
 }
 
@@ -1196,18 +1607,31 @@ TSNumber<uint32> TSWorldObject::CastCustomSpell(
 void TSWorldObject::DoDelayed(std::function<void(TSWorldObject, TSMainThreadContext)> callback)
 {
 #if TRINITY
-    obj->m_delayedCallbacks.push_back(callback);
-    obj->GetMap()->m_delayedGuids.insert(obj->GetGUID());
+    uint32 mapId = obj->GetMapId();
+    uint32 instanceId = obj->GetInstanceId();
+    TSGUID guid(obj->GetGUID().GetRawValue());
+    PostToWorld([=](TSMainThreadContext ctx) {
+        // the object can leave the map before the world drains its mailbox
+        Map* map = sMapMgr->FindMap(mapId, instanceId);
+        if (!map)
+        {
+            return;
+        }
+        TSWorldObject target = TSMap(map).GetWorldObject(guid);
+        if (target.obj)
+        {
+            callback(target, ctx);
+        }
+    });
 #endif
 }
 
-
 void TSWorldObject::LDoDelayed(sol::protected_function callback)
 {
-#if TRINITY
-    obj->m_delayedLuaCallbacks.push_back(callback);
-    obj->GetMap()->m_delayedGuids.insert(obj->GetGUID());
-#endif
+    DoDelayed([callback](TSWorldObject obj, TSMainThreadContext ctx) {
+        TSArenaScope scope(TSLuaArena());
+        TSLua::handle_error(callback(obj, ctx));
+    });
 }
 
 TS_CLASS_DEFINITION(TSMutableWorldObject, WorldObject, m_obj)
@@ -1297,6 +1721,58 @@ TSLua::Array<TSPlayer> TSWorldObject::LGetPlayersInRange(float range, uint32 hos
     return sol::as_table(*GetPlayersInRange(range,hostile,dead).vec);
 }
 
+TSLua::Iterator<TSUnit> TSWorldObject::LIterateUnitsInRange(float range, uint32 hostile, uint32 dead)
+{
+#if TRINITY
+    return IterateInRange<TSUnit, Unit, Trinity::UnitListSearcher<WorldObjectInRangeCheck>>(obj, TSQueryType::UNITS, range, TYPEMASK_UNIT, 0, hostile, dead);
+#else
+    return []() -> sol::optional<TSUnit> { return sol::nullopt; };
+#endif
+}
+
+TSLua::Iterator<TSPlayer> TSWorldObject::LIteratePlayersInRange(float range, uint32 hostile, uint32 dead)
+{
+#if TRINITY
+    return IterateInRange<TSPlayer, Player, Trinity::PlayerListSearcher<WorldObjectInRangeCheck>>(obj, TSQueryType::PLAYERS, range, TYPEMASK_PLAYER, 0, hostile, dead);
+#else
+    return []() -> sol::optional<TSPlayer> { return sol::nullopt; };
+#endif
+}
+
+// Lua callbacks only stop the walk when they explicitly return false,
+// so plain functions without a return value visit everything.
+template <class T>
+static bool LVisitCallback(sol::protected_function const& callback, T value)
+{
+    sol::protected_function_result res = callback(value);
+    if (!res.valid())
+    {
+        TSLua::handle_error(res);
+        return false;
+    }
+    return !(res.get_type() == sol::type::boolean && !res.get<bool>());
+}
+
+uint32 TSWorldObject::LForEachCreatureInRange(float range, uint32 entry, uint32 hostile, uint32 dead, sol::protected_function callback, uint32 limit)
+{
+    return ForEachCreatureInRange(range, entry, hostile, dead, [&](TSCreature c) { return LVisitCallback(callback, c); }, limit);
+}
+
+uint32 TSWorldObject::LForEachUnitInRange(float range, uint32 hostile, uint32 dead, sol::protected_function callback, uint32 limit)
+{
+    return ForEachUnitInRange(range, hostile, dead, [&](TSUnit u) { return LVisitCallback(callback, u); }, limit);
+}
+
+uint32 TSWorldObject::LForEachPlayerInRange(float range, uint32 hostile, uint32 dead, sol::protected_function callback, uint32 limit)
+{
+    return ForEachPlayerInRange(range, hostile, dead, [&](TSPlayer p) { return LVisitCallback(callback, p); }, limit);
+}
+
+uint32 TSWorldObject::LForEachGameObjectInRange(float range, uint32 entry, uint32 hostile, sol::protected_function callback, uint32 limit)
+{
+    return ForEachGameObjectInRange(range, entry, hostile, [&](TSGameObject g) { return LVisitCallback(callback, g); }, limit);
+}
+
 TSGameObject TSWorldObject::LGetGameObject0(TSGUID guid)
 {
     return GetGameObject(guid);
@@ -1,102 +1,179 @@
 #include "TSWorldObjectGroup.h"
+#include "TSWorldObject.h"
+#include "Object.h"
 
-TSWorldObjectGroup::~TSWorldObjectGroup()
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+
+static uint64 GroupHandle(TSWorldObject const& obj)
+{
+    return obj.obj ? obj.obj->GetGUID().GetRawValue() : 0;
+}
+
+TSWorldObjectGroup::iterator::iterator(TSWorldObjectGroup* group, size_t slot, bool guard)
+    : m_group(group)
+    , m_slot(slot)
+    , m_guard(guard ? std::make_shared<TSDenseHandleSet<WorldObject*>::IterationGuard>(group->entries) : nullptr)
 {
-    for (auto entry : entries)
+    Skip();
+}
+
+void TSWorldObjectGroup::iterator::Skip()
+{
+    while (m_slot < m_group->entries.SlotCount() && m_group->entries.HandleAt(m_slot) == 0)
     {
-        entry.RemovedByGroup(this);
+        ++m_slot;
     }
 }
 
+TSWorldObject TSWorldObjectGroup::iterator::operator*() const
+{
+    return TSWorldObject(m_group->entries.ValueAt(m_slot));
+}
+
+TSWorldObjectGroup::iterator& TSWorldObjectGroup::iterator::operator++()
+{
+    ++m_slot;
+    Skip();
+    return *this;
+}
+
+TSWorldObjectGroup::iterator TSWorldObjectGroup::iterator::operator++(int)
+{
+    iterator old = *this;
+    ++(*this);
+    return old;
+}
+
+size_t TSWorldObjectGroup::iterator::Position() const
+{
+    // clamped to the live size so members removed inside
+    // a loop body can never move the cursor out of bounds
+    return std::min(m_slot, m_group->entries.SlotCount());
+}
+
+bool TSWorldObjectGroup::iterator::operator==(iterator const& rhs) const
+{
+    return m_group == rhs.m_group && Position() == rhs.Position();
+}
+
+bool TSWorldObjectGroup::iterator::operator!=(iterator const& rhs) const
+{
+    return !(*this == rhs);
+}
+
+TSWorldObjectGroup::~TSWorldObjectGroup()
+{
+    Clear();
+}
+
 void TSWorldObjectGroup::Add(TSWorldObject obj)
 {
-    entries.insert(obj);
-    obj.AddedByGroup(this);
+    if (entries.Add(GroupHandle(obj), obj.obj))
+    {
+        obj.AddedByGroup(this);
+    }
 }
 
 void TSWorldObjectGroup::Remove(TSWorldObject obj)
 {
-    entries.erase(obj);
-    obj.RemovedByGroup(this);
+    if (entries.Remove(GroupHandle(obj)))
+    {
+        obj.RemovedByGroup(this);
+    }
 }
 
 void TSWorldObjectGroup::RemovedByObject(TSWorldObject obj)
 {
-    entries.erase(obj);
+    entries.Remove(GroupHandle(obj));
 }
 
-std::set<TSWorldObject>::iterator TSWorldObjectGroup::begin()
+bool TSWorldObjectGroup::Contains(TSWorldObject obj)
 {
-    return entries.begin();
+    return entries.Contains(GroupHandle(obj));
 }
 
-std::set<TSWorldObject>::iterator TSWorldObjectGroup::end()
+TSWorldObjectGroup::iterator TSWorldObjectGroup::begin()
 {
-    return entries.end();
+    return iterator(this, 0, true);
+}
+
+TSWorldObjectGroup::iterator TSWorldObjectGroup::end()
+{
+    // past any slot, so members added inside a loop are still visited
+    return iterator(this, SIZE_MAX, false);
 }
 
 TSNumber<uint32> TSWorldObjectGroup::get_length()
 {
-    return entries.size();
+    return uint32(entries.Size());
 }
 
 void TSWorldObjectGroup::forEach(std::function<void(TSWorldObject)> callback)
 {
-    for (auto& entry : entries)
-    {
-        callback(entry);
-    }
+    entries.ForEach([&](uint64, WorldObject* obj) {
+        callback(TSWorldObject(obj));
+    });
 }
 
 void TSWorldObjectGroup::filterInPlace(std::function<bool(TSWorldObject)> callback)
 {
-    std::set<TSWorldObject>::iterator it = entries.begin();
-    while (it != entries.end())
-    {
-        if (!callback(*it))
-        {
-            it = entries.erase(it);
-        }
-        else
+    entries.Filter([&](uint64, WorldObject* obj) {
+        TSWorldObject entry(obj);
+        if (callback(entry))
         {
-            ++it;
+            return true;
         }
-    }
+        entry.RemovedByGroup(this);
+        return false;
+    });
 }
 
 void TSWorldObjectGroup::Clear()
 {
-    for (auto entry : entries)
-    {
-        entry.RemovedByGroup(this);
-    }
-    entries.clear();
+    entries.ForEach([&](uint64, WorldObject* obj) {
+        TSWorldObject(obj).RemovedByGroup(this);
+    });
+    entries.Clear();
+}
+
+static uint32 InternGroupKey(std::string const& name)
+{
+    // groups live on maps that update in parallel
+    static std::mutex mutex;
+    static std::unordered_map<std::string, uint32> keys;
+    std::lock_guard<std::mutex> lock(mutex);
+    return keys.emplace(name, uint32(keys.size())).first->second;
+}
+
+TSNumber<uint32> GetObjectGroupKey(std::string const& name)
+{
+    return InternGroupKey(name);
 }
 
 TSWorldObjectGroup* TSWorldObjectGroups::GetGroup(std::string const& key)
 {
-    if (groups.find(key) == groups.end())
-    {
-        groups[key] = TSWorldObjectGroup();
-    }
+    return GetGroup(InternGroupKey(key));
+}
+
+TSWorldObjectGroup* TSWorldObjectGroups::GetGroup(uint32 key)
+{
     return &groups[key];
 }
 
 void TSWorldObjectGroups::RemoveGroup(std::string const& key)
 {
-    if (groups.find(key) == groups.end())
-    {
-        return;
-    }
-    groups[key].Clear();
+    RemoveGroup(InternGroupKey(key));
+}
+
+void TSWorldObjectGroups::RemoveGroup(uint32 key)
+{
+    // the destructor detaches all members
     groups.erase(key);
 }
 
 void TSWorldObjectGroups::ClearGroups()
 {
-    for (auto& group : groups)
-    {
-        group.second.Clear();
-    }
     groups.clear();
-}
\ No newline at end of file
+}
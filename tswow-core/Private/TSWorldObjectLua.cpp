@@ -16,7 +16,34 @@ void TSLua::load_world_object_methods(sol::state& state)
     ts_worldobject.set_function("GetCreaturesInRange", &TSWorldObject::LGetCreaturesInRange);
     ts_worldobject.set_function("GetPlayersInRange", &TSWorldObject::LGetPlayersInRange);
     ts_worldobject.set_function("GetUnitsInRange", &TSWorldObject::LGetUnitsInRange);
+    ts_worldobject.set_function("IteratePlayersInRange", &TSWorldObject::LIteratePlayersInRange);
+    ts_worldobject.set_function("IterateUnitsInRange", &TSWorldObject::LIterateUnitsInRange);
     ts_worldobject.set_function("GetGameObjectsInRange", &TSWorldObject::LGetGameObjectsInRange);
+    LUA_FIELD(ts_worldobject, TSWorldObject, SetQueryCache);
+    LUA_FIELD(ts_worldobject, TSWorldObject, HasQueryCache);
+    state.set_function("GetQueryCacheHits", GetQueryCacheHits);
+    state.set_function("GetQueryCacheMisses", GetQueryCacheMisses);
+    state.set_function("ResetQueryCacheStats", ResetQueryCacheStats);
+    ts_worldobject.set_function("ForEachCreatureInRange", sol::overload
+    (
+        [](TSWorldObject& obj, float range, uint32 entry, uint32 hostile, uint32 dead, sol::protected_function cb, uint32 limit) { return obj.LForEachCreatureInRange(range, entry, hostile, dead, cb, limit); },
+        [](TSWorldObject& obj, float range, uint32 entry, uint32 hostile, uint32 dead, sol::protected_function cb) { return obj.LForEachCreatureInRange(range, entry, hostile, dead, cb, 0); }
+    ));
+    ts_worldobject.set_function("ForEachPlayerInRange", sol::overload
+    (
+        [](TSWorldObject& obj, float range, uint32 hostile, uint32 dead, sol::protected_function cb, uint32 limit) { return obj.LForEachPlayerInRange(range, hostile, dead, cb, limit); },
+        [](TSWorldObject& obj, float range, uint32 hostile, uint32 dead, sol::protected_function cb) { return obj.LForEachPlayerInRange(range, hostile, dead, cb, 0); }
+    ));
+    ts_worldobject.set_function("ForEachUnitInRange", sol::overload
+    (
+        [](TSWorldObject& obj, float range, uint32 hostile, uint32 dead, sol::protected_function cb, uint32 limit) { return obj.LForEachUnitInRange(range, hostile, dead, cb, limit); },
+        [](TSWorldObject& obj, float range, uint32 hostile, uint32 dead, sol::protected_function cb) { return obj.LForEachUnitInRange(range, hostile, dead, cb, 0); }
+    ));
+    ts_worldobject.set_function("ForEachGameObjectInRange", sol::overload
+    (
+        [](TSWorldObject& obj, float range, uint32 entry, uint32 hostile, sol::protected_function cb, uint32 limit) { return obj.LForEachGameObjectInRange(range, entry, hostile, cb, limit); },
+        [](TSWorldObject& obj, float range, uint32 entry, uint32 hostile, sol::protected_function cb) { return obj.LForEachGameObjectInRange(range, entry, hostile, cb, 0); }
+    ));
 
     LUA_FIELD_OVERLOAD_RET_0_3(ts_worldobject, TSWorldObject, GetNearestPlayer, float, uint32, uint32);
     LUA_FIELD_OVERLOAD_RET_0_3(ts_worldobject, TSWorldObject, GetNearestGameObject, float, uint32, uint32);
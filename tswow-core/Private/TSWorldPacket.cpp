@@ -21,6 +21,9 @@
 
 #include "TSIncludes.h"
 #include "TSWorldPacket.h"
+#include "TSEvents.h"
+#include "TSPlayer.h"
+#include "TSPacketRecorder.h"
 
 TSWorldPacket::TSWorldPacket(WorldPacket *packet)
 {
@@ -416,4 +419,113 @@ void TSWorldPacket::Seek(size_t ofs)
 size_t TSWorldPacket::Tell() const
 {
     return packet->rpos();
-}
\ No newline at end of file
+}
+
+TSWorldPacketView::TSWorldPacketView(WorldPacket const* packet)
+    : m_data(packet ? packet->contents() : nullptr)
+    , m_size(packet ? uint32(packet->size()) : 0)
+    , m_opcode(packet ? uint16(packet->GetOpcode()) : 0)
+{}
+
+std::string TSWorldPacketView::ReadString(uint32 index)
+{
+    if (index >= m_size)
+    {
+        return "";
+    }
+    char const* start = (char const*)(m_data + index);
+    return std::string(start, strnlen(start, m_size - index));
+}
+
+std::string TSWorldPacketView::ReadString()
+{
+    std::string value = ReadString(m_pos);
+    // skip the terminator too
+    m_pos += uint32(value.size()) + 1;
+    return value;
+}
+
+template <typename E>
+static bool HasListeners(E& evt, uint16 opcode)
+{
+    return evt.has_non_id_entries()
+        || (opcode < evt.m_id_cxx_callbacks.size() && evt.m_id_cxx_callbacks[opcode].size() > 0)
+        || (opcode < evt.m_id_lua_callbacks.size() && evt.m_id_lua_callbacks[opcode].size() > 0);
+}
+
+// Like FIRE_ID, but only copies the callback being called instead of
+// the whole lists for every packet. Listeners may register or unregister
+// callbacks, so the lists are indexed and only walked up to their size
+// when firing started.
+template <typename E, typename... Args>
+static void FireView(E& evt, uint16 opcode, Args... args)
+{
+    size_t cxxCount = evt.m_cxx_callbacks.size();
+    for (size_t i = 0; i < cxxCount && i < evt.m_cxx_callbacks.size(); ++i)
+    {
+        auto cb = evt.m_cxx_callbacks[i];
+        TS_CALLBACK_ZONE(evt.stats_at(evt.m_cxx_stats, i))
+        cb(args...);
+    }
+
+    size_t luaCount = evt.m_lua_callbacks.size();
+    for (size_t i = 0; i < luaCount && i < evt.m_lua_callbacks.size(); ++i)
+    {
+        auto cb = evt.m_lua_callbacks[i];
+        TSCallbackStats* stats = evt.stats_at(evt.m_lua_stats, i);
+        TS_SKIP_DISABLED(stats)
+        TS_CALLBACK_ZONE(stats)
+        TSLua::handle_error(cb(args...));
+    }
+
+    size_t idCxxCount = opcode < evt.m_id_cxx_callbacks.size()
+        ? evt.m_id_cxx_callbacks[opcode].size()
+        : 0;
+    for (size_t i = 0; i < idCxxCount && i < evt.m_id_cxx_callbacks[opcode].size(); ++i)
+    {
+        auto cb = evt.m_id_cxx_callbacks[opcode][i];
+        TS_CALLBACK_ZONE(evt.id_stats_at(evt.m_id_cxx_stats, opcode, i))
+        cb(args...);
+    }
+
+    size_t idLuaCount = opcode < evt.m_id_lua_callbacks.size()
+        ? evt.m_id_lua_callbacks[opcode].size()
+        : 0;
+    for (size_t i = 0; i < idLuaCount && i < evt.m_id_lua_callbacks[opcode].size(); ++i)
+    {
+        auto cb = evt.m_id_lua_callbacks[opcode][i];
+        TSCallbackStats* stats = evt.id_stats_at(evt.m_id_lua_stats, opcode, i);
+        TS_SKIP_DISABLED(stats)
+        TS_CALLBACK_ZONE(stats)
+        TSLua::handle_error(cb(args...));
+    }
+}
+
+bool HasWorldPacketListeners(uint16 opcode, bool send)
+{
+    auto& events = ts_events.WorldPacket;
+    return send
+        ? HasListeners(events.OnSend_callbacks, opcode) || HasListeners(events.OnSendView_callbacks, opcode)
+        : HasListeners(events.OnReceive_callbacks, opcode) || HasListeners(events.OnReceiveView_callbacks, opcode);
+}
+
+void FireWorldPacketReceive(WorldPacket* packet, Player* player)
+{
+    CaptureWorldPacket(packet, player);
+    uint16 opcode = uint16(packet->GetOpcode());
+    auto& events = ts_events.WorldPacket;
+    if (HasListeners(events.OnReceiveView_callbacks, opcode))
+    {
+        FireView(events.OnReceiveView_callbacks, opcode, TSNumber<uint32>(opcode), TSWorldPacketView(packet), TSPlayer(player));
+    }
+}
+
+void FireWorldPacketSend(WorldPacket* packet, Player* player)
+{
+    uint16 opcode = uint16(packet->GetOpcode());
+    auto& events = ts_events.WorldPacket;
+    if (HasListeners(events.OnSendView_callbacks, opcode))
+    {
+        FireView(events.OnSendView_callbacks, opcode, TSWorldPacketView(packet), TSPlayer(player));
+    }
+}
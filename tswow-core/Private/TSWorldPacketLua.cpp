@@ -120,6 +120,23 @@ void TSLua::load_world_packet_methods(sol::state & state)
     ));
     state.set_function("CreateWorldPacket", sol::overload(LCreateWorldPacket0, LCreateWorldPacket1));
 
+    auto ts_world_packet_view = state.new_usertype<TSWorldPacketView>("TSWorldPacketView");
+    LUA_FIELD(ts_world_packet_view, TSWorldPacketView, GetOpcode);
+    LUA_FIELD(ts_world_packet_view, TSWorldPacketView, GetSize);
+    LUA_FIELD(ts_world_packet_view, TSWorldPacketView, Seek);
+    LUA_FIELD(ts_world_packet_view, TSWorldPacketView, Tell);
+    LUA_FIELD_OVERLOAD_RET_0_1(ts_world_packet_view, TSWorldPacketView, ReadInt8, uint32);
+    LUA_FIELD_OVERLOAD_RET_0_1(ts_world_packet_view, TSWorldPacketView, ReadUInt8, uint32);
+    LUA_FIELD_OVERLOAD_RET_0_1(ts_world_packet_view, TSWorldPacketView, ReadInt16, uint32);
+    LUA_FIELD_OVERLOAD_RET_0_1(ts_world_packet_view, TSWorldPacketView, ReadUInt16, uint32);
+    LUA_FIELD_OVERLOAD_RET_0_1(ts_world_packet_view, TSWorldPacketView, ReadInt32, uint32);
+    LUA_FIELD_OVERLOAD_RET_0_1(ts_world_packet_view, TSWorldPacketView, ReadUInt32, uint32);
+    LUA_FIELD_OVERLOAD_RET_0_1(ts_world_packet_view, TSWorldPacketView, ReadInt64, uint32);
+    LUA_FIELD_OVERLOAD_RET_0_1(ts_world_packet_view, TSWorldPacketView, ReadUInt64, uint32);
+    LUA_FIELD_OVERLOAD_RET_0_1(ts_world_packet_view, TSWorldPacketView, ReadFloat, uint32);
+    LUA_FIELD_OVERLOAD_RET_0_1(ts_world_packet_view, TSWorldPacketView, ReadDouble, uint32);
+    LUA_FIELD_OVERLOAD_RET_0_1(ts_world_packet_view, TSWorldPacketView, ReadString, uint32);
+
     auto ts_world_state_packet = state.new_usertype<TSWorldStatePacket>("TSWorldStatePacket");
     LUA_FIELD(ts_world_state_packet, TSWorldStatePacket, push);
     LUA_FIELD(ts_world_state_packet, TSWorldStatePacket, length);
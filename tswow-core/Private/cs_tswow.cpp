@@ -3,10 +3,22 @@
 #include <vector>
 #include <fstream>
 #include <string>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <memory>
 #include "Map.h"
 #include "Player.h"
+#include "Creature.h"
 #include "ChatCommand.h"
 #include "TSTests.h"
+#include "TSCustomPacket.h"
+#include "TSPacketRecorder.h"
+#include "TSMapEntryIndex.h"
+#include "TSEventStats.h"
+#include "TSLuaProfiler.h"
+#include "TSLuaAllocator.h"
+#include "TSPlayer.h"
 #include <boost/filesystem.hpp>
 
 #if TRINITY
@@ -36,26 +48,72 @@ static std::pair<std::string, std::string> parseSessionWArgs(std::string const&
     }
 }
 
-boost::filesystem::path findPositionsFile()
+boost::filesystem::path findCoredataDir()
 {
-    constexpr char const* positions_txt = "positions.txt";
     boost::filesystem::path cur_path = boost::filesystem::current_path();
     while (true)
     {
         boost::filesystem::path coredata = cur_path / "coredata";
         if (boost::filesystem::exists(coredata))
         {
-            return coredata / positions_txt;
+            return coredata;
         }
 
         if (!cur_path.has_parent_path())
         {
-            return boost::filesystem::current_path() / positions_txt;
+            return boost::filesystem::current_path();
         }
         cur_path = cur_path.parent_path();
     }
 }
 
+boost::filesystem::path findPositionsFile()
+{
+    return findCoredataDir() / "positions.txt";
+}
+
+// Returns coredata/<dir>/<name>, creating the directory. "name" must be
+// a plain file name, returns an empty path otherwise.
+static boost::filesystem::path findCoredataFile(std::string const& dir, std::string const& name)
+{
+    boost::filesystem::path file(name);
+    if (name.empty()
+        || file.filename().string() != name
+        || name == "."
+        || name == ".."
+        || name.find_first_of("/\\:") != std::string::npos)
+    {
+        return boost::filesystem::path();
+    }
+    boost::filesystem::path path = findCoredataDir() / dir;
+    boost::system::error_code error;
+    boost::filesystem::create_directories(path, error);
+    return path / file;
+}
+
+// Packet logs are only read from and written to coredata/packetlogs
+static boost::filesystem::path findPacketLogFile(std::string const& name)
+{
+    return findCoredataFile("packetlogs", name);
+}
+
+// Lua profiles are only written to coredata/luaprofiles
+static boost::filesystem::path findLuaProfileFile(std::string const& name)
+{
+    return findCoredataFile("luaprofiles", name);
+}
+
+// tswow permissions, created by sql/auth/tswow_rbac.sql
+#if TRINITY
+static constexpr rbac::RBACPermissions RBAC_PERM_TS_PACKETS = rbac::RBACPermissions(17692);
+static constexpr rbac::RBACPermissions RBAC_PERM_TS_ENTRYINDEX = rbac::RBACPermissions(17693);
+static constexpr rbac::RBACPermissions RBAC_PERM_TS_PERF = rbac::RBACPermissions(17694);
+static constexpr rbac::RBACPermissions RBAC_PERM_TS_LUAMEM = rbac::RBACPermissions(17695);
+static constexpr rbac::RBACPermissions RBAC_PERM_TS_LUAPROF = rbac::RBACPermissions(17696);
+static constexpr rbac::RBACPermissions RBAC_PERM_TS_PACKETLOG = rbac::RBACPermissions(17697);
+static constexpr rbac::RBACPermissions RBAC_PERM_TS_PACKETLOG_REPLAY = rbac::RBACPermissions(17698);
+#endif
+
 class wp_tswow : public CommandScript
 {
 public:
@@ -73,11 +131,31 @@ public:
 #endif
 
 #if TRINITY
+        static std::vector<ChatCommand> packetLogTable = {
+            { "start", HandlePacketLogStartCommand, RBAC_PERM_TS_PACKETLOG, Console::Yes},
+            { "stop", HandlePacketLogStopCommand, RBAC_PERM_TS_PACKETLOG, Console::Yes},
+            { "replay", HandlePacketLogReplayCommand, RBAC_PERM_TS_PACKETLOG_REPLAY, Console::No}
+        };
+#endif
+
+#if TRINITY
+        static std::vector<ChatCommand> luaProfilerTable = {
+            { "start", HandleLuaProfilerStartCommand, RBAC_PERM_TS_LUAPROF, Console::Yes},
+            { "stop", HandleLuaProfilerStopCommand, RBAC_PERM_TS_LUAPROF, Console::Yes},
+            { "status", HandleLuaProfilerStatusCommand, RBAC_PERM_TS_LUAPROF, Console::Yes}
+        };
+
         static std::vector<ChatCommand> commandTable = {
             { "at", At, rbac::RBAC_PERM_AT, Console::No},
             { "clearat", ClearAt, rbac::RBAC_PERM_CLEAR_AT, Console::No},
             { "id", Id, rbac::RBAC_PERM_ID, Console::No},
-            { "test", testTable}
+            { "packets", Packets, RBAC_PERM_TS_PACKETS, Console::No},
+            { "entryindex", EntryIndex, RBAC_PERM_TS_ENTRYINDEX, Console::No},
+            { "perf", Perf, RBAC_PERM_TS_PERF, Console::Yes},
+            { "luamem", LuaMem, RBAC_PERM_TS_LUAMEM, Console::Yes},
+            { "luaprof", luaProfilerTable},
+            { "test", testTable},
+            { "packetlog", packetLogTable}
         };
 #endif
         return commandTable;
@@ -120,6 +198,65 @@ public:
         return true;
     }
 
+    static bool HandlePacketLogStartCommand(ChatHandler* handler, char const* args)
+    {
+        std::string name(args);
+        if (name.size() == 0)
+        {
+            handler->SendSysMessage("[PacketLog]: Need to specify a file to record to.");
+            return true;
+        }
+        boost::filesystem::path file = findPacketLogFile(name);
+        if (file.empty())
+        {
+            handler->SendSysMessage("[PacketLog]: Need a plain file name, logs are always written to coredata/packetlogs.");
+            return true;
+        }
+        if (!StartPacketCapture(file.string()))
+        {
+            handler->PSendSysMessage("[PacketLog]: Could not open %s.", file.string().c_str());
+            return true;
+        }
+        handler->PSendSysMessage("[PacketLog]: Recording to %s.", file.string().c_str());
+        return true;
+    }
+
+    static bool HandlePacketLogStopCommand(ChatHandler* handler, char const* args)
+    {
+        StopPacketCapture();
+        handler->SendSysMessage("[PacketLog]: Stopped recording.");
+        return true;
+    }
+
+    static bool HandlePacketLogReplayCommand(ChatHandler* handler, char const* args)
+    {
+        std::string name(args);
+        if (name.size() == 0)
+        {
+            handler->SendSysMessage("[PacketLog]: Need to specify a file to replay.");
+            return true;
+        }
+        boost::filesystem::path file = findPacketLogFile(name);
+        if (file.empty())
+        {
+            handler->SendSysMessage("[PacketLog]: Need a plain file name, logs are always read from coredata/packetlogs.");
+            return true;
+        }
+        std::string report = ReplayPacketCapture(file.string(), TSPlayer(handler->GetPlayer()));
+        if (report.size() == 0)
+        {
+            handler->PSendSysMessage("[PacketLog]: %s is not a packet log.", file.string().c_str());
+            return true;
+        }
+        std::stringstream stream(report);
+        std::string line;
+        while (std::getline(stream, line))
+        {
+            handler->SendSysMessage(line.c_str());
+        }
+        return true;
+    }
+
     static bool HandleTestInfoCommand(ChatHandler* handler, char const* args)
     {
         std::string session(args);
@@ -153,6 +290,262 @@ public:
         return false;
     }
 
+    // Shows custom packet counters for the selected player, or yourself
+    static bool Packets(ChatHandler* handler, char const* args)
+    {
+        Player* target = handler->getSelectedPlayerOrSelf();
+        if (!target)
+        {
+            handler->SendSysMessage(LANG_NO_CHAR_SELECTED);
+            handler->SetSentErrorMessage(true);
+            return false;
+        }
+
+        std::map<opcode_t, TSCustomPacketOpcodeStats> stats;
+        if (!GetCustomPacketStats(target->GetGUID().GetRawValue(), stats))
+        {
+            handler->PSendSysMessage("%s has not sent any custom packets.", target->GetName().c_str());
+            return true;
+        }
+
+        handler->PSendSysMessage("Custom packets from %s (opcode: packets / bytes / dropped / handler ms):", target->GetName().c_str());
+        for (auto const& [opcode, opcodeStats] : stats)
+        {
+            handler->PSendSysMessage("%u: %llu / %llu / %llu / %.3f"
+                , uint32(opcode)
+                , (unsigned long long)opcodeStats.m_packets
+                , (unsigned long long)opcodeStats.m_bytes
+                , (unsigned long long)opcodeStats.m_dropped
+                , opcodeStats.m_handlerMicroseconds / 1000.0
+            );
+        }
+        return true;
+    }
+
+    // Samples the lua stack every [interval] instructions (default 1000)
+    static bool HandleLuaProfilerStartCommand(ChatHandler* handler, char const* args)
+    {
+        std::string arg(args ? args : "");
+        uint32 interval = arg.size() > 0 ? uint32(std::strtoul(arg.c_str(), nullptr, 10)) : 1000;
+        if (!StartLuaProfiler(interval))
+        {
+            handler->SendSysMessage("[LuaProfiler]: Already running.");
+            return true;
+        }
+        handler->PSendSysMessage("[LuaProfiler]: Sampling every %u instructions.", interval);
+        return true;
+    }
+
+    // Writes collapsed stacks for flamegraph tools to coredata/luaprofiles/[file]
+    // (default lua-profile.folded)
+    static bool HandleLuaProfilerStopCommand(ChatHandler* handler, char const* args)
+    {
+        std::string name(args ? args : "");
+        if (name.size() == 0)
+        {
+            name = "lua-profile.folded";
+        }
+        if (!IsLuaProfilerRunning())
+        {
+            handler->SendSysMessage("[LuaProfiler]: Not running.");
+            return true;
+        }
+        boost::filesystem::path file = findLuaProfileFile(name);
+        if (file.empty())
+        {
+            handler->SendSysMessage("[LuaProfiler]: Need a plain file name, profiles are always written to coredata/luaprofiles.");
+            return true;
+        }
+        uint64 samples = GetLuaProfilerSamples();
+        if (!StopLuaProfiler(file.string()))
+        {
+            handler->PSendSysMessage("[LuaProfiler]: Could not write %s.", file.string().c_str());
+            return true;
+        }
+        handler->PSendSysMessage("[LuaProfiler]: Wrote %llu samples to %s.", (unsigned long long)samples, file.string().c_str());
+        return true;
+    }
+
+    static bool HandleLuaProfilerStatusCommand(ChatHandler* handler, char const* /*args*/)
+    {
+        if (!IsLuaProfilerRunning())
+        {
+            handler->SendSysMessage("[LuaProfiler]: Not running.");
+            return true;
+        }
+        handler->PSendSysMessage("[LuaProfiler]: Running, %llu samples.", (unsigned long long)GetLuaProfilerSamples());
+        return true;
+    }
+
+    // Shows the event callbacks that took the most time since
+    // scripts were loaded: .tswow perf [count], .tswow perf reset
+    // or .tswow perf on/off to start or stop timing callbacks
+    static bool Perf(ChatHandler* handler, char const* args)
+    {
+        std::string arg(args ? args : "");
+        if (arg == "on" || arg == "off")
+        {
+            SetCallbackTiming(arg == "on");
+            handler->PSendSysMessage("[Perf]: Callback timing %s.", arg == "on" ? "started" : "stopped");
+            return true;
+        }
+        if (arg == "reset")
+        {
+            TSResetCallbackStats();
+            handler->SendSysMessage("[Perf]: Callback counters reset.");
+            return true;
+        }
+        uint32 count = arg.size() > 0 ? uint32(std::strtoul(arg.c_str(), nullptr, 10)) : 20;
+
+        std::vector<TSCallbackStats*> stats = TSGetAllCallbackStats();
+        // violations are counted even while timing is off
+        stats.erase(std::remove_if(stats.begin(), stats.end(), [](TSCallbackStats* s) {
+            return s->m_calls.load(std::memory_order_relaxed) == 0
+                && s->m_violations.load(std::memory_order_relaxed) == 0;
+        }), stats.end());
+        std::sort(stats.begin(), stats.end(), [](TSCallbackStats* a, TSCallbackStats* b) {
+            return a->m_totalNs.load(std::memory_order_relaxed) > b->m_totalNs.load(std::memory_order_relaxed);
+        });
+        if (stats.size() == 0)
+        {
+            handler->SendSysMessage(GetCallbackTiming()
+                ? "[Perf]: No callbacks have been called."
+                : "[Perf]: Callback timing is off, start it with .tswow perf on."
+            );
+            return true;
+        }
+
+        handler->SendSysMessage("[Perf]: event [module]: calls / total ms / avg us / max us");
+        for (size_t i = 0; i < stats.size() && i < count; ++i)
+        {
+            TSCallbackStats* s = stats[i];
+            uint64 calls = s->m_calls.load(std::memory_order_relaxed);
+            uint64 totalNs = s->m_totalNs.load(std::memory_order_relaxed);
+            handler->PSendSysMessage("%s: %llu / %.3f / %.3f / %.3f"
+                , s->m_zoneName.c_str()
+                , (unsigned long long)calls
+                , totalNs / 1000000.0
+                , calls > 0 ? totalNs / 1000.0 / calls : 0.0
+                , s->m_maxNs.load(std::memory_order_relaxed) / 1000.0
+            );
+            if (uint32 violations = s->m_violations.load(std::memory_order_relaxed))
+            {
+                handler->PSendSysMessage("    over budget %u times%s"
+                    , violations
+                    , s->m_disabled.load(std::memory_order_relaxed) ? ", disabled" : ""
+                );
+            }
+        }
+        return true;
+    }
+
+    // Shows lua memory per module, rates are since the last .tswow luamem
+    static bool LuaMem(ChatHandler* handler, char const* /*args*/)
+    {
+        static std::vector<uint64> lastAllocated;
+        static std::chrono::steady_clock::time_point lastTime;
+        auto now = std::chrono::steady_clock::now();
+        double seconds = lastAllocated.size() > 0
+            ? std::chrono::duration<double>(now - lastTime).count()
+            : 0;
+        lastTime = now;
+
+        uint32 count = TSLuaMemory::ModuleCount();
+        lastAllocated.resize(count, 0);
+        handler->SendSysMessage("[LuaMem]: module: live kb / peak kb / allocated kb/s / allocations");
+        for (uint32 i = 0; i < count; ++i)
+        {
+            TSLuaModuleMemory& module = TSLuaMemory::Module(i);
+            uint64 allocated = module.m_allocated.load(std::memory_order_relaxed);
+            if (allocated == 0)
+            {
+                continue;
+            }
+            double rate = seconds > 0 ? (allocated - lastAllocated[i]) / 1024.0 / seconds : 0;
+            lastAllocated[i] = allocated;
+            handler->PSendSysMessage("%s: %.1f / %.1f / %.1f / %llu"
+                , i == 0 ? "<other>" : module.m_name.c_str()
+                , module.m_live.load(std::memory_order_relaxed) / 1024.0
+                , module.m_peak.load(std::memory_order_relaxed) / 1024.0
+                , rate
+                , (unsigned long long)module.m_allocations.load(std::memory_order_relaxed)
+            );
+        }
+        return true;
+    }
+
+    // Compares entry-filtered creature lookups through the spawn id store
+    // and the entry index on the current map: .tswow entryindex [entry] [iterations]
+    // Uses the selected creatures entry if none is given.
+    static bool EntryIndex(ChatHandler* handler, char const* args)
+    {
+        Player* player = handler->GetPlayer();
+        if (!player)
+        {
+            return false;
+        }
+
+        std::stringstream stream(args ? args : "");
+        uint32 entry = 0;
+        uint32 iterations = 100;
+        stream >> entry >> iterations;
+        if (entry == 0)
+        {
+            if (Creature* target = handler->getSelectedCreature())
+            {
+                entry = target->GetEntry();
+            }
+        }
+        if (entry == 0 || iterations == 0)
+        {
+            handler->SendSysMessage("Usage: .tswow entryindex [entry] [iterations], or select a creature.");
+            return true;
+        }
+
+        Map* map = player->GetMap();
+        auto start = std::chrono::steady_clock::now();
+        TSMapEntryIndex* index = GetMapEntryIndex(map);
+        auto built = std::chrono::steady_clock::now();
+
+        size_t scanMatches = 0;
+        for (uint32 i = 0; i < iterations; ++i)
+        {
+            scanMatches = 0;
+            for (auto& val : map->GetCreatureBySpawnIdStore())
+            {
+                if (val.second->GetEntry() == entry)
+                {
+                    ++scanMatches;
+                }
+            }
+        }
+        auto scanned = std::chrono::steady_clock::now();
+
+        size_t indexMatches = 0;
+        std::vector<Creature*> matches;
+        for (uint32 i = 0; i < iterations; ++i)
+        {
+            matches.clear();
+            index->GetCreatures(entry, matches);
+            indexMatches = matches.size();
+        }
+        auto indexed = std::chrono::steady_clock::now();
+
+        auto micros = [](auto a, auto b) {
+            return double(std::chrono::duration_cast<std::chrono::nanoseconds>(b - a).count()) / 1000.0;
+        };
+        handler->PSendSysMessage("Map %u: %u spawned creatures, entry %u, %u iterations"
+            , map->GetId()
+            , uint32(map->GetCreatureBySpawnIdStore().size())
+            , entry
+            , iterations
+        );
+        handler->PSendSysMessage("index build/lookup: %.1f us", micros(start, built));
+        handler->PSendSysMessage("spawn store scan: %u matches, %.2f us/query", uint32(scanMatches), micros(built, scanned) / iterations);
+        handler->PSendSysMessage("entry index: %u matches, %.2f us/query", uint32(indexMatches), micros(scanned, indexed) / iterations);
+        return true;
+    }
+
     static bool ClearAt(ChatHandler* handler, char const* args)
     {
         std::ofstream outfile;
@@ -71,4 +71,8 @@
 #include "TSNumber.h"
 #include "TSFactionTemplate.h"
 #include "TSGUID.h"
-#include "TSWeather.h"
\ No newline at end of file
+#include "TSWeather.h"
+#include "TSReplicatedState.h"
+#include "TSSpatialQuery.h"
+#include "TSLineOfSight.h"
+#include "TSMapMailbox.h"
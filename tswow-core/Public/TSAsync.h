@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "TSMain.h"
+#include "TSLua.h"
+
+/**
+ * Async lua tasks, run as coroutines that wait without nesting callbacks:
+ *
+ *   Async(fn, ...)                 runs fn(...) as a task
+ *   Sleep(ms[, owner])             resumes on the world thread after ms,
+ *                                  the task ends instead if `owner` is
+ *                                  destroyed or leaves the world meanwhile
+ *   AwaitWorld()                   resumes on the world thread, returns the TSMainThreadContext
+ *   AwaitMap(mapId[, instanceId])  resumes where that map can be used and returns it: on the
+ *                                  thread updating it, or on the world thread between map
+ *                                  updates if the core does not drain map mailboxes.
+ *                                  Returns nil without waiting if it is not loaded
+ *   AwaitQueryWorld(sql)           resumes on the world thread with the TSDatabaseResult,
+ *   AwaitQueryCharacters(sql)      the query runs on the database workers meanwhile
+ *   AwaitQueryAuth(sql)
+ *
+ * Waiting tasks only keep their coroutine, entities are never kept alive
+ * by a wait. Entity userdata held in locals becomes null once the entity
+ * is destroyed (see TSLuaUserdata.h), so check objects after waiting.
+ */
+
+// Called by the world thread every update
+TC_GAME_API void TSAsyncTick();
+// Ends every waiting task, before scripts are reloaded
+TC_GAME_API void TSClearAsync();
+TC_GAME_API TSNumber<uint32> GetAsyncTaskCount();
+
+TC_GAME_API int LAsync(lua_State* L);
+TC_GAME_API int LSleep(lua_State* L);
+TC_GAME_API int LAwaitWorld(lua_State* L);
+TC_GAME_API int LAwaitMap(lua_State* L);
+TC_GAME_API int LAwaitQueryWorld(lua_State* L);
+TC_GAME_API int LAwaitQueryCharacters(lua_State* L);
+TC_GAME_API int LAwaitQueryAuth(lua_State* L);
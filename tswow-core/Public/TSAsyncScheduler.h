@@ -0,0 +1,214 @@
+/*
+ * This file is part of tswow (https://github.com/tswow/).
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+// This header does not depend on the core so it can be tested headless.
+
+#include "TSMPSCQueue.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * Wakes up suspended async tasks (lua coroutines).
+ *
+ * A task either sleeps until a point in time, or is suspended until
+ * something completes it (like a database query), from any thread.
+ * Everything is resumed from Tick on the thread owning the scheduler.
+ *
+ * Waits can have an owner, and are cancelled instead of resumed if the
+ * owner is gone by then, so a task never wakes up to a destroyed object.
+ */
+class TSAsyncScheduler
+{
+public:
+    // true if the wait was cancelled instead of completed
+    using Resume = std::function<void(bool cancelled)>;
+
+    /**
+     * Resumes at `now + delay`, in the first Tick at or after that time.
+     * Tasks waking at the same time are resumed in the order they slept.
+     */
+    uint64_t Sleep(uint64_t now, uint64_t delay, Resume resume)
+    {
+        return AddSleep(now + delay, Wait{ std::move(resume), {}, false });
+    }
+
+    uint64_t Sleep(uint64_t now, uint64_t delay, Resume resume, std::weak_ptr<void> owner)
+    {
+        return AddSleep(now + delay, Wait{ std::move(resume), std::move(owner), true });
+    }
+
+    /** Resumes in the first Tick after Complete(id) */
+    uint64_t Suspend(Resume resume)
+    {
+        uint64_t id = m_nextId++;
+        m_suspended.emplace(id, Wait{ std::move(resume), {}, false });
+        return id;
+    }
+
+    uint64_t Suspend(Resume resume, std::weak_ptr<void> owner)
+    {
+        uint64_t id = m_nextId++;
+        m_suspended.emplace(id, Wait{ std::move(resume), std::move(owner), true });
+        return id;
+    }
+
+    /** Can be called from any thread, unknown and cancelled ids are ignored */
+    void Complete(uint64_t id)
+    {
+        m_completed.Push(id);
+    }
+
+    /** Resumes a wait as cancelled right away, false if it is not waiting */
+    bool Cancel(uint64_t id)
+    {
+        Wait wait;
+        if (!Take(id, wait))
+        {
+            return false;
+        }
+        wait.m_resume(true);
+        return true;
+    }
+
+    /**
+     * Resumes everything completed before the tick started,
+     * then every sleep due at `now`. Waits added by resumed
+     * tasks are never resumed by the same tick.
+     * @returns the number of waits resumed or cancelled
+     */
+    size_t Tick(uint64_t now)
+    {
+        uint64_t firstNew = m_nextId;
+        size_t resumed = 0;
+        m_completed.Drain([&](uint64_t id) {
+            Wait wait;
+            if (Take(id, wait))
+            {
+                Run(wait);
+                ++resumed;
+            }
+        }, m_completed.Size());
+
+        while (!m_sleeping.empty())
+        {
+            auto itr = m_sleeping.begin();
+            if (itr->first.first > now || itr->first.second >= firstNew)
+            {
+                break;
+            }
+            Wait wait = std::move(itr->second);
+            m_wakeTimes.erase(itr->first.second);
+            m_sleeping.erase(itr);
+            Run(wait);
+            ++resumed;
+        }
+        return resumed;
+    }
+
+    /** Cancels every wait, like when scripts are reloaded */
+    void Clear()
+    {
+        std::vector<Wait> waits;
+        waits.reserve(m_sleeping.size() + m_suspended.size());
+        for (auto& [_, wait] : m_sleeping)
+        {
+            waits.push_back(std::move(wait));
+        }
+        for (auto& [_, wait] : m_suspended)
+        {
+            waits.push_back(std::move(wait));
+        }
+        m_sleeping.clear();
+        m_wakeTimes.clear();
+        m_suspended.clear();
+        m_completed.Drain([](uint64_t) {});
+        for (Wait& wait : waits)
+        {
+            wait.m_resume(true);
+        }
+    }
+
+    size_t GetSleeping() const { return m_sleeping.size(); }
+    size_t GetSuspended() const { return m_suspended.size(); }
+
+    /** When the next sleep is due, if any */
+    bool GetNextWake(uint64_t& out) const
+    {
+        if (m_sleeping.empty())
+        {
+            return false;
+        }
+        out = m_sleeping.begin()->first.first;
+        return true;
+    }
+private:
+    struct Wait
+    {
+        Resume m_resume;
+        std::weak_ptr<void> m_owner;
+        bool m_owned = false;
+    };
+
+    uint64_t AddSleep(uint64_t wake, Wait wait)
+    {
+        uint64_t id = m_nextId++;
+        m_sleeping.emplace(std::make_pair(wake, id), std::move(wait));
+        m_wakeTimes.emplace(id, wake);
+        return id;
+    }
+
+    bool Take(uint64_t id, Wait& out)
+    {
+        auto suspended = m_suspended.find(id);
+        if (suspended != m_suspended.end())
+        {
+            out = std::move(suspended->second);
+            m_suspended.erase(suspended);
+            return true;
+        }
+        auto wake = m_wakeTimes.find(id);
+        if (wake != m_wakeTimes.end())
+        {
+            auto sleeping = m_sleeping.find(std::make_pair(wake->second, id));
+            out = std::move(sleeping->second);
+            m_sleeping.erase(sleeping);
+            m_wakeTimes.erase(wake);
+            return true;
+        }
+        return false;
+    }
+
+    static void Run(Wait& wait)
+    {
+        wait.m_resume(wait.m_owned && wait.m_owner.expired());
+    }
+
+    uint64_t m_nextId = 1;
+    // ordered by (wake time, id)
+    std::map<std::pair<uint64_t, uint64_t>, Wait> m_sleeping;
+    std::unordered_map<uint64_t, uint64_t> m_wakeTimes;
+    std::unordered_map<uint64_t, Wait> m_suspended;
+    TSMPSCQueue<uint64_t> m_completed;
+};
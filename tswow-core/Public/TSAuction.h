@@ -82,6 +82,7 @@ struct TC_GAME_API TSAuctionHouseObject {
     void AddAuction(TSAuctionEntry entry);
 private:
     TSLua::Array<TSNumber<uint32>> LGetKeys();
+    TSLua::Iterator<TSNumber<uint32>> LIterateKeys();
     friend class TSLua;
 };
 
@@ -119,5 +119,5 @@ class TC_GAME_API TSProcEventInfo
 
 LUA_PTR_TYPE(TSAuraEffect)
 LUA_PTR_TYPE(TSAuraApplication)
-LUA_PTR_TYPE(TSAura)
+LUA_CACHED_PTR_TYPE(TSAura)
 LUA_PTR_TYPE(TSProcEventInfo)
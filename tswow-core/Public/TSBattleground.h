@@ -184,6 +184,7 @@ public:
 private:
     TSBattlegroundPlayer LGetBGPlayer0(TSGUID guid);
     TSBattlegroundPlayer LGetBGPlayer1(TSNumber<uint32> guid);
+    TSLua::Iterator<TSBattlegroundPlayer> LIterateBGPlayers();
 
     TSBattlegroundScore LGetScore0(TSGUID guid);
     TSBattlegroundScore LGetScore1(TSNumber<uint32> guid);
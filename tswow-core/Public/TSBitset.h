@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+// This header does not depend on the core so it can be benchmarked headless.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Fixed size set of bits, shared between copies like TSArray.
+ */
+class TSBitset
+{
+    std::shared_ptr<std::vector<uint64_t>> m_words;
+    uint32_t m_size = 0;
+public:
+    TSBitset()
+        : m_words(std::make_shared<std::vector<uint64_t>>())
+    {}
+
+    explicit TSBitset(uint32_t size)
+        : m_words(std::make_shared<std::vector<uint64_t>>((size + 63) / 64, 0))
+        , m_size(size)
+    {}
+
+    TSBitset* operator->() { return this; }
+
+    bool Get(uint32_t index) const
+    {
+        return index < m_size && ((*m_words)[index / 64] >> (index % 64)) & 1;
+    }
+
+    void Set(uint32_t index, bool value)
+    {
+        if (index >= m_size)
+        {
+            return;
+        }
+        uint64_t mask = uint64_t(1) << (index % 64);
+        if (value)
+        {
+            (*m_words)[index / 64] |= mask;
+        }
+        else
+        {
+            (*m_words)[index / 64] &= ~mask;
+        }
+    }
+
+    uint32_t GetSize() const { return m_size; }
+
+    /** Number of set bits */
+    uint32_t Count() const
+    {
+        uint32_t count = 0;
+        for (uint64_t word : *m_words)
+        {
+            for (; word; word &= word - 1)
+            {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    // 64 bits per word, bit i is bit (i % 64) of word (i / 64)
+    std::vector<uint64_t>& GetWords() { return *m_words; }
+};
@@ -0,0 +1,181 @@
+/*
+ * This file is part of tswow (https://github.com/tswow/).
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+// This header does not depend on the core so it can be tested headless.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * Uniform grid over points, used as the broadphase for collisions.
+ *
+ * Filled once per tick with every unit near a group of collision
+ * owners, after which each owner only looks at the grid cells
+ * overlapping its own range.
+ */
+template <typename T>
+class TSCollisionGrid
+{
+public:
+    explicit TSCollisionGrid(float cellSize = 8.0f)
+        : m_cellSize(cellSize)
+    {}
+
+    void Clear()
+    {
+        m_items.clear();
+        m_cells.clear();
+    }
+
+    void Insert(T value, float x, float y, float z)
+    {
+        m_cells[Key(Coord(x), Coord(y))].push_back(uint32_t(m_items.size()));
+        m_items.push_back({ value, x, y, z });
+    }
+
+    size_t Size() const { return m_items.size(); }
+
+    /**
+     * Calls callback(value) for every value within 3d distance
+     * `range` of (x, y, z), in insertion order per cell.
+     */
+    template <typename F>
+    void Query(float x, float y, float z, float range, F callback) const
+    {
+        int32_t minX = Coord(x - range);
+        int32_t maxX = Coord(x + range);
+        int32_t minY = Coord(y - range);
+        int32_t maxY = Coord(y + range);
+        float range2 = range * range;
+        for (int32_t cx = minX; cx <= maxX; ++cx)
+        {
+            for (int32_t cy = minY; cy <= maxY; ++cy)
+            {
+                auto itr = m_cells.find(Key(cx, cy));
+                if (itr == m_cells.end())
+                {
+                    continue;
+                }
+                for (uint32_t index : itr->second)
+                {
+                    Item const& item = m_items[index];
+                    float dx = item.x - x;
+                    float dy = item.y - y;
+                    float dz = item.z - z;
+                    if (dx * dx + dy * dy + dz * dz <= range2)
+                    {
+                        callback(item.value);
+                    }
+                }
+            }
+        }
+    }
+private:
+    struct Item
+    {
+        T value;
+        float x;
+        float y;
+        float z;
+    };
+
+    int32_t Coord(float value) const
+    {
+        return int32_t(std::floor(value / m_cellSize));
+    }
+
+    static uint64_t Key(int32_t x, int32_t y)
+    {
+        return (uint64_t(uint32_t(x)) << 32) | uint32_t(y);
+    }
+
+    float m_cellSize;
+    std::vector<Item> m_items;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> m_cells;
+};
+
+/**
+ * Remembers when each key was last seen, and forgets keys that have
+ * not been seen for `expiry` ms (0 = never) as well as the least
+ * recently seen keys once more than `cap` keys (0 = unlimited) are tracked.
+ * The cap is enforced by dropping down to three quarters of it.
+ */
+class TSCollisionHitTracker
+{
+public:
+    void Touch(uint64_t key, uint64_t now)
+    {
+        m_lastSeen[key] = now;
+    }
+
+    size_t Size() const { return m_lastSeen.size(); }
+
+    /**
+     * Calls onDrop(key) for every key that is forgotten.
+     * Keys seen at the same time are dropped lowest key first,
+     * so pruning is deterministic.
+     */
+    template <typename F>
+    void Prune(uint64_t now, uint64_t expiry, size_t cap, F onDrop)
+    {
+        if (expiry > 0)
+        {
+            for (auto itr = m_lastSeen.begin(); itr != m_lastSeen.end();)
+            {
+                if (now - itr->second > expiry)
+                {
+                    onDrop(itr->first);
+                    itr = m_lastSeen.erase(itr);
+                }
+                else
+                {
+                    ++itr;
+                }
+            }
+        }
+
+        if (cap == 0 || m_lastSeen.size() <= cap)
+        {
+            return;
+        }
+
+        std::vector<std::pair<uint64_t, uint64_t>> entries;
+        entries.reserve(m_lastSeen.size());
+        for (auto const& [key, lastSeen] : m_lastSeen)
+        {
+            entries.push_back({ lastSeen, key });
+        }
+        // drop a quarter below the cap so a full tracker
+        // is not sorted again for every new key
+        size_t drop = entries.size() - (cap - cap / 4);
+        std::nth_element(entries.begin(), entries.begin() + drop - 1, entries.end());
+        std::sort(entries.begin(), entries.begin() + drop);
+        for (size_t i = 0; i < drop; ++i)
+        {
+            onDrop(entries[i].second);
+            m_lastSeen.erase(entries[i].second);
+        }
+    }
+private:
+    std::unordered_map<uint64_t, uint64_t> m_lastSeen;
+};
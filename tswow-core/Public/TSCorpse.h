@@ -39,4 +39,4 @@ public:
     void SaveToDB();
 };
 
-LUA_PTR_TYPE(TSCorpse)
+LUA_CACHED_PTR_TYPE(TSCorpse)
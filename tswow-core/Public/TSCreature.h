@@ -151,4 +151,4 @@ private:
     friend class TSLua;
 };
 
-LUA_PTR_TYPE(TSCreature)
+LUA_CACHED_PTR_TYPE(TSCreature)
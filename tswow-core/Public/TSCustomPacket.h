@@ -7,6 +7,11 @@
 #include "CustomPacketWrite.h"
 #include "CustomPacketBuffer.h"
 
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
 class TSWorldObject;
 class TSPlayer;
 class TSMap;
@@ -92,13 +97,51 @@ public:
 	totalSize_t Size() { return read->Size(); }
 };
 
+struct TSCustomPacketOpcodeStats
+{
+	uint64 m_packets = 0;
+	uint64 m_bytes = 0;
+	uint64 m_dropped = 0;
+	uint64 m_invalid = 0;
+	uint64 m_handlerMicroseconds = 0;
+
+	// token bucket, filled on the first packet
+	double m_tokens = -1;
+	uint32 m_lastRefill = 0;
+};
+
+struct TSCustomPacketSessionStats
+{
+	std::mutex m_lock;
+	std::map<opcode_t, TSCustomPacketOpcodeStats> m_opcodes;
+};
+
+/**
+ * Receives custom packets from a single player. Messages are validated
+ * and dispatched to CustomPacket.OnReceive as soon as they are reassembled.
+ *
+ * Replay buffers (see ReplayPacketCapture) keep their stats to themselves,
+ * are not captured and don't kick the player on errors.
+ */
 class TSServerBuffer : public CustomPacketBuffer
 {
 public:
-	TSServerBuffer(TSPlayer player);
+	TSServerBuffer(TSPlayer player, bool replay = false);
+	~TSServerBuffer();
 	TSPlayer m_player = nullptr;
 	virtual void OnPacket(CustomPacketRead* value) override final;
 	virtual void OnError(CustomPacketResult error) override final;
+	// adds this buffers counters to "out"
+	void CopyStats(std::map<opcode_t, TSCustomPacketOpcodeStats>& out);
+private:
+	void Dispatch(CustomPacketRead* value);
+	void Kick(CustomPacketResult error);
+	bool Validate(CustomPacketRead* value);
+	// returns false if the packet should be dropped
+	bool Account(opcode_t opcode, totalSize_t size);
+	std::shared_ptr<TSCustomPacketSessionStats> m_stats;
+	uint64 m_guid = 0;
+	bool m_replay = false;
 };
 
 TC_GAME_API TSPacketWrite CreateCustomPacket(
@@ -106,5 +149,35 @@ TC_GAME_API TSPacketWrite CreateCustomPacket(
 	, totalSize_t size
 );
 
+// Send batching: when enabled, single-fragment packets of at most
+// "threshold" bytes sent with SendToPlayer/BroadcastMap are queued per player
+// and packed into BATCH_OPCODE containers by FlushCustomPacketBatches,
+// which runs once at the end of every world tick.
+// Requires client extensions that understand BATCH_OPCODE.
+TC_GAME_API void SetCustomPacketBatching(bool enabled, totalSize_t threshold);
+TC_GAME_API bool IsCustomPacketBatching();
+TC_GAME_API void FlushCustomPacketBatches();
+
+// Incoming rate limits: "rate" packets per second with bursts of up to
+// "burst" packets, per player and opcode. A rate of 0 disables the limit.
+// Packets over the limit fire CustomPacket.OnRateLimited and are dropped
+// unless a listener says otherwise.
+TC_GAME_API void SetCustomPacketRateLimit(opcode_t opcode, float rate, float burst);
+
+// Incoming messages outside [minSize, maxSize] are dropped before dispatch.
+// A maxSize of 0 removes the schema.
+TC_GAME_API void SetCustomPacketSchema(opcode_t opcode, totalSize_t minSize, totalSize_t maxSize);
+// Extra validation for incoming messages, return false to drop the message.
+// Runs before any listener, it must not touch Lua.
+TC_GAME_API void SetCustomPacketValidator(opcode_t opcode, std::function<bool(CustomPacketRead*)> validator);
+TC_GAME_API void SetDefaultCustomPacketRateLimit(float rate, float burst);
+
+// Copies the traffic counters of a connected player,
+// returns false if they have not sent any custom packets.
+TC_GAME_API bool GetCustomPacketStats(
+	  uint64 playerGuid
+	, std::map<opcode_t, TSCustomPacketOpcodeStats>& out
+);
+
 LUA_PTR_TYPE(TSPacketWrite)
 LUA_PTR_TYPE(TSPacketRead)
@@ -211,6 +211,16 @@ TC_GAME_API void QueryWorldAsync(std::string const& query);
 TC_GAME_API void QueryCharactersAsync(std::string const& query);
 TC_GAME_API void QueryAuthAsync(std::string const& query);
 
+// callback runs on the world thread once the result is ready
+TC_GAME_API void QueryWorldAsync(std::string const& query, std::function<void(std::shared_ptr<TSDatabaseResult>)> callback);
+TC_GAME_API void QueryCharactersAsync(std::string const& query, std::function<void(std::shared_ptr<TSDatabaseResult>)> callback);
+TC_GAME_API void QueryAuthAsync(std::string const& query, std::function<void(std::shared_ptr<TSDatabaseResult>)> callback);
+
+// Called by the world thread every update
+TC_GAME_API void TSProcessAsyncQueries();
+// Drops the callbacks of queries still running, before scripts are reloaded
+TC_GAME_API void TSClearAsyncQueries();
+
 TC_GAME_API std::shared_ptr<TSDatabaseConnectionInfo> WorldDatabaseInfo();
 TC_GAME_API std::shared_ptr<TSDatabaseConnectionInfo> CharactersDatabaseInfo();
 TC_GAME_API std::shared_ptr<TSDatabaseConnectionInfo> AuthDatabaseInfo();
@@ -0,0 +1,220 @@
+/*
+ * This file is part of tswow (https://github.com/tswow/).
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+// This header does not depend on the core so it can be tested headless.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * Set of values keyed by a non-zero 64-bit handle (usually a raw guid),
+ * stored contiguously so iteration is a linear walk over a vector.
+ *
+ * Removal swaps the last entry into the freed slot. While a ForEach/Filter
+ * is running, removals only clear the handle and the set is compacted
+ * once the outermost iteration returns, so callbacks may freely add
+ * and remove entries. Entries added during an iteration are not visited by it.
+ */
+template <typename V>
+class TSDenseHandleSet
+{
+public:
+    bool Add(uint64_t handle, V value)
+    {
+        if (handle == 0 || m_index.find(handle) != m_index.end())
+        {
+            return false;
+        }
+        m_index[handle] = uint32_t(m_handles.size());
+        m_handles.push_back(handle);
+        m_values.push_back(value);
+        return true;
+    }
+
+    bool Remove(uint64_t handle)
+    {
+        auto itr = m_index.find(handle);
+        if (itr == m_index.end())
+        {
+            return false;
+        }
+        uint32_t index = itr->second;
+        m_index.erase(itr);
+        if (m_iterating > 0)
+        {
+            m_handles[index] = 0;
+            m_holes = true;
+        }
+        else
+        {
+            SwapRemove(index);
+        }
+        return true;
+    }
+
+    bool Contains(uint64_t handle) const
+    {
+        return m_index.find(handle) != m_index.end();
+    }
+
+    size_t Size() const { return m_index.size(); }
+
+    void Clear()
+    {
+        m_index.clear();
+        if (m_iterating > 0)
+        {
+            std::fill(m_handles.begin(), m_handles.end(), 0);
+            m_holes = true;
+        }
+        else
+        {
+            m_handles.clear();
+            m_values.clear();
+        }
+    }
+
+    /** Calls callback(handle, value) for every entry */
+    template <typename F>
+    void ForEach(F callback)
+    {
+        Iterate([&](uint64_t handle, V const& value) {
+            callback(handle, value);
+        });
+    }
+
+    /** Removes every entry for which keep(handle, value) returns false */
+    template <typename F>
+    void Filter(F keep)
+    {
+        Iterate([&](uint64_t handle, V const& value) {
+            if (!keep(handle, value))
+            {
+                Remove(handle);
+            }
+        });
+    }
+
+    /**
+     * Held by external iterators for as long as they walk the slots.
+     * Removals only clear the handle meanwhile, the set is compacted
+     * once the last guard (or ForEach) is done.
+     */
+    class IterationGuard
+    {
+    public:
+        explicit IterationGuard(TSDenseHandleSet& set)
+            : m_set(set)
+        {
+            ++m_set.m_iterating;
+        }
+
+        ~IterationGuard()
+        {
+            m_set.EndIteration();
+        }
+
+        IterationGuard(IterationGuard const&) = delete;
+        IterationGuard& operator=(IterationGuard const&) = delete;
+    private:
+        TSDenseHandleSet& m_set;
+    };
+
+    /**
+     * Raw slot access for external iterators, which must hold an
+     * IterationGuard. Slots with a zero handle are removed entries
+     * that have not been compacted yet.
+     */
+    size_t SlotCount() const { return m_handles.size(); }
+    uint64_t HandleAt(size_t slot) const { return m_handles[slot]; }
+    V const& ValueAt(size_t slot) const { return m_values[slot]; }
+private:
+    template <typename F>
+    void Iterate(F callback)
+    {
+        ++m_iterating;
+        size_t count = m_handles.size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint64_t handle = m_handles[i];
+            if (handle != 0)
+            {
+                // copied, the callback may grow the vectors
+                V value = m_values[i];
+                callback(handle, value);
+            }
+        }
+        EndIteration();
+    }
+
+    void EndIteration()
+    {
+        if (--m_iterating == 0 && m_holes)
+        {
+            Compact();
+        }
+    }
+
+    void SwapRemove(uint32_t index)
+    {
+        uint32_t last = uint32_t(m_handles.size() - 1);
+        if (index != last)
+        {
+            m_handles[index] = m_handles[last];
+            m_values[index] = std::move(m_values[last]);
+            m_index[m_handles[index]] = index;
+        }
+        m_handles.pop_back();
+        m_values.pop_back();
+    }
+
+    void Compact()
+    {
+        m_holes = false;
+        size_t i = 0;
+        while (i < m_handles.size())
+        {
+            if (m_handles[i] != 0)
+            {
+                ++i;
+                continue;
+            }
+            // trailing holes are popped without touching the index
+            while (!m_handles.empty() && m_handles.back() == 0)
+            {
+                m_handles.pop_back();
+                m_values.pop_back();
+            }
+            if (i < m_handles.size())
+            {
+                SwapRemove(uint32_t(i));
+                ++i;
+            }
+        }
+    }
+
+    std::vector<uint64_t> m_handles;
+    std::vector<V> m_values;
+    std::unordered_map<uint64_t, uint32_t> m_index;
+    uint32_t m_iterating = 0;
+    bool m_holes = false;
+};
@@ -28,6 +28,7 @@
 #include <functional>
 #include <set>
 #include <mutex>
+#include <vector>
 
 struct TC_GAME_API TSCompiledClass {
     std::shared_ptr<void> ptr;
@@ -69,12 +70,63 @@ struct ModTable
     sol::table table;
 };
 
+/**
+ * The userdata lua sees for an entity, one per wrapper type, so events
+ * don't create new userdata for the same object every time (see TSLuaUserdata.h).
+ * Cached userdata is nulled when the entity is destroyed.
+ */
+class TC_GAME_API TSLuaUserdataCache {
+public:
+    TSLuaUserdataCache() = default;
+    // copies of an entity get their own userdata
+    TSLuaUserdataCache(TSLuaUserdataCache const&) {}
+    TSLuaUserdataCache& operator=(TSLuaUserdataCache const&) { return *this; }
+    ~TSLuaUserdataCache();
+private:
+    struct Entry
+    {
+        void const* m_type;
+        int m_ref;
+        // the wrapper stored in the userdata
+        void* m_value;
+        void (*m_invalidate)(void*);
+    };
+    std::vector<Entry> m_entries;
+    // lua state the refs belong to, refs of older states are dropped
+    uint32_t m_generation = 0;
+    friend struct TSLuaUserdata;
+};
+
+/**
+ * Expires when the entity is destroyed, for things that must not
+ * keep a destroyed entity around (like async lua tasks waiting on it).
+ */
+class TC_GAME_API TSEntityLifetime {
+public:
+    TSEntityLifetime() = default;
+    // copies of an entity have their own lifetime
+    TSEntityLifetime(TSEntityLifetime const&) {}
+    TSEntityLifetime& operator=(TSEntityLifetime const&) { return *this; }
+    std::weak_ptr<void> Get()
+    {
+        if (!m_token)
+        {
+            m_token = std::make_shared<char>();
+        }
+        return m_token;
+    }
+private:
+    std::shared_ptr<char> m_token;
+};
+
 // todo: change these values to pointers that can be activated on demand
 class TC_GAME_API TSEntity {
 public:
     TSCompiledClasses m_compiledClasses;
     TSJsonObject m_json;
     std::map<std::string, ModTable> m_lua_tables;
+    TSLuaUserdataCache m_lua_userdata;
+    TSEntityLifetime m_lifetime;
     TSEntity * operator->(){return this;}
 };
 
@@ -167,4 +219,5 @@ public:
     }
 
     friend class TSLua;
+    friend struct TSLuaUserdata;
 };
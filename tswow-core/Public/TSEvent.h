@@ -18,6 +18,8 @@
 
 #include "sol/sol.hpp"
 #include "TSLua.h"
+#include "TSEventStats.h"
+#include "Tracy.hpp"
 
 #include <vector>
 #include <functional>
@@ -45,11 +47,44 @@ struct TSEvent
 		cxx_id_callbacks m_id_cxx_callbacks;
 		lua_id_callbacks m_id_lua_callbacks;
 
+		// parallel to the callback vectors, these don't depend on C
+		// so ts_clear_events can clear them through TSEvent<void*>
+		using stats = std::vector<TSCallbackStats*>;
+		stats m_cxx_stats;
+		stats m_lua_stats;
+		std::vector<stats> m_id_cxx_stats;
+		std::vector<stats> m_id_lua_stats;
+
+		static TSCallbackStats* stats_at(stats const& vec, size_t index)
+		{
+				return index < vec.size() ? vec[index] : nullptr;
+		}
+
+		static TSCallbackStats* id_stats_at(std::vector<stats> const& vec, size_t id, size_t index)
+		{
+				return id < vec.size() ? stats_at(vec[id], index) : nullptr;
+		}
+
+		static void add_id_stats(std::vector<stats>& vec, uint32_t id, TSCallbackStats* value)
+		{
+				if(id >= vec.size())
+				{
+						vec.resize(uint64_t(id) + 1);
+				}
+				vec[id].push_back(value);
+		}
+
 		bool has_non_id_entries()
 		{
 				return m_cxx_callbacks.size() > 0 || m_lua_callbacks.size() > 0;
 		}
 
+		bool has_id_entries(size_t id)
+		{
+				return (id < m_id_cxx_callbacks.size() && m_id_cxx_callbacks[id].size() > 0)
+						|| (id < m_id_lua_callbacks.size() && m_id_lua_callbacks[id].size() > 0);
+		}
+
 		void clear()
 		{
 				m_cxx_callbacks.clear();
@@ -62,6 +97,10 @@ struct TSEvent
 				{
 						cb.clear();
 				}
+				m_cxx_stats.clear();
+				m_lua_stats.clear();
+				m_id_cxx_stats.clear();
+				m_id_lua_stats.clear();
 		}
 };
 
@@ -107,11 +146,13 @@ private:
 		TSEvent<name##__type> name##_callbacks;\
 		void name(name##__type cb) {\
 				name##_callbacks.m_cxx_callbacks.push_back(cb);\
+				name##_callbacks.m_cxx_stats.push_back(TSGetCallbackStats(__category, #name, false));\
 				if(is_fn) fn_cxx(cb);\
 		}\
 		void L##name(sol::protected_function cb)\
 		{\
 				name##_callbacks.m_lua_callbacks.push_back(cb);\
+				name##_callbacks.m_lua_stats.push_back(TSGetCallbackStats(__category, #name, true));\
 				if(is_fn) fn_lua(cb);\
 		}\
 
@@ -126,6 +167,7 @@ private:
 						cbs.resize(uint64_t(reg_id) + 1);\
 				}\
 				cbs[reg_id].push_back(cb);\
+				name##_callbacks.add_id_stats(name##_callbacks.m_id_cxx_stats, reg_id, TSGetCallbackStats(__category, #name, false));\
 				if (is_fn) fn_mapped_cxx(cb,id);\
 		}\
 		void name(TSArray<uint32_t> ids, name##__type cb) {\
@@ -143,6 +185,7 @@ private:
 						cbs.resize(uint64_t(reg_id) + 1);\
 				}\
 				cbs[reg_id].push_back(cb);\
+				name##_callbacks.add_id_stats(name##_callbacks.m_id_lua_stats, reg_id, TSGetCallbackStats(__category, #name, true));\
 				if (is_fn) fn_mapped_lua(cb,id);\
 		}\
 		void Lid##name(sol::object obj, sol::protected_function cb)\
@@ -174,38 +217,87 @@ private:
 #define ID_EVENT(name,...)\
 		ID_EVENT_ROOT(name,false,[](name##__type){},[](sol::protected_function){},[](name##__type,uint32_t){},[](sol::protected_function,uint32_t){},__VA_ARGS__);
 
-#define FIRE(category,name,...)\
+// Records a firing into a running packet capture (see TSPacketRecorder.h),
+// only fired events with listeners are recorded
+TC_GAME_API void CaptureEventFired(char const* name, uint32_t id);
+
+// Runs one callback in a callback frame (see TSCallbackTimer)
+// and gives it a tracy zone named after the event and module
+#define TS_CALLBACK_ZONE(stats)\
+		TSCallbackTimer __ts_callback_timer(stats);\
+		ZoneScopedN("TSCallback");\
+		if(__ts_callback_timer.m_stats)\
+		{\
+				ZoneName(__ts_callback_timer.m_stats->m_zoneName.c_str(), __ts_callback_timer.m_stats->m_zoneName.size());\
+		}\
+
+// lua callbacks that kept running over their budget (see TSWatchdog.h)
+#define TS_SKIP_DISABLED(stats)\
+		if((stats) && (stats)->m_disabled.load(std::memory_order_relaxed))\
 		{\
-				for(auto cb : ts_events.category.name##_callbacks.m_cxx_callbacks)\
+				continue;\
+		}\
+
+#define FIRE_CALLBACKS(category,name,...)\
+		{\
+				auto& __evt = ts_events.category.name##_callbacks;\
+				for(size_t __i = 0; __i < __evt.m_cxx_callbacks.size(); ++__i)\
 				{\
+						auto cb = __evt.m_cxx_callbacks[__i];\
+						TS_CALLBACK_ZONE(__evt.stats_at(__evt.m_cxx_stats, __i))\
 						cb(__VA_ARGS__);\
 				}\
 				\
-				for(auto cb : ts_events.category.name##_callbacks.m_lua_callbacks)\
+				for(size_t __i = 0; __i < __evt.m_lua_callbacks.size(); ++__i)\
 				{\
+						auto cb = __evt.m_lua_callbacks[__i];\
+						TSCallbackStats* __stats = __evt.stats_at(__evt.m_lua_stats, __i);\
+						TS_SKIP_DISABLED(__stats)\
+						TS_CALLBACK_ZONE(__stats)\
 						TSLua::handle_error(cb(__VA_ARGS__));\
 				}\
 		}\
 
+#define FIRE(category,name,...)\
+		{\
+				ZoneScopedN(#category "." #name);\
+				if(ts_events.category.name##_callbacks.has_non_id_entries())\
+				{\
+						CaptureEventFired(#category "." #name, 0);\
+				}\
+				FIRE_CALLBACKS(category,name,__VA_ARGS__)\
+		}\
+
 #define FIRE_ID(ref,category,name,...)\
 		{\
-				FIRE(category,name,__VA_ARGS__)\
-				auto cxx_cbs = ts_events.category.name##_callbacks.m_id_cxx_callbacks;\
-				if(ref < cxx_cbs.size())\
+				ZoneScopedN(#category "." #name);\
+				if(ts_events.category.name##_callbacks.has_non_id_entries()\
+						|| ts_events.category.name##_callbacks.has_id_entries(ref))\
+				{\
+						CaptureEventFired(#category "." #name, ref);\
+				}\
+				FIRE_CALLBACKS(category,name,__VA_ARGS__)\
+				auto& __id_evt = ts_events.category.name##_callbacks;\
+				if(ref < __id_evt.m_id_cxx_callbacks.size())\
 				{\
-						for(auto cb: cxx_cbs[ref])\
+						auto cxx_cbs = __id_evt.m_id_cxx_callbacks[ref];\
+						for(size_t __i = 0; __i < cxx_cbs.size(); ++__i)\
 						{\
-								cb(__VA_ARGS__);\
+								TS_CALLBACK_ZONE(__id_evt.id_stats_at(__id_evt.m_id_cxx_stats, ref, __i))\
+								cxx_cbs[__i](__VA_ARGS__);\
 						}\
 				}\
-				auto lua_cbs = ts_events.category.name##_callbacks.m_id_lua_callbacks;\
-				if(ref < lua_cbs.size())\
+				if(ref < __id_evt.m_id_lua_callbacks.size())\
 				{\
-						for(auto cb: lua_cbs[ref])\
+						auto lua_cbs = __id_evt.m_id_lua_callbacks[ref];\
+						for(size_t __i = 0; __i < lua_cbs.size(); ++__i)\
 						{\
+								TSCallbackStats* __stats = __id_evt.id_stats_at(__id_evt.m_id_lua_stats, ref, __i);\
+								TS_SKIP_DISABLED(__stats)\
+								TS_CALLBACK_ZONE(__stats)\
 								try\
 								{\
-										TSLua::handle_error(cb(__VA_ARGS__));\
+										TSLua::handle_error(lua_cbs[__i](__VA_ARGS__));\
 								}\
 								catch (std::exception const& e)\
 								{\
@@ -220,4 +312,5 @@ private:
 		}
 
 #define EVENTS_HEADER(type)\
+		static constexpr char const* __category = #type;\
 		type* operator->() { return this; }
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "TSMain.h"
+#include "TSWatchdog.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Counters for all callbacks one module registered for one event,
+ * either from C++ or Lua. Shown by ".tswow perf", only counted while
+ * callback timing is on (see SetCallbackTiming).
+ *
+ * Never freed, so callbacks still running during a reload can keep
+ * writing to them. A reload only hides them until the same module
+ * registers for the same event again.
+ */
+struct TC_GAME_API TSCallbackStats
+{
+    std::string m_category;
+    std::string m_event;
+    std::string m_module;
+    bool m_lua;
+    // runs lua code, so it needs a callback frame even without timing
+    bool m_runsLua;
+    // "Player.OnUpdate [module]", used as the tracy zone name
+    std::string m_zoneName;
+    // lua memory allocated by lua callbacks is attributed to this (TSLuaAllocator.h)
+    uint32_t m_luaModule = 0;
+
+    std::atomic<uint64_t> m_calls { 0 };
+    std::atomic<uint64_t> m_totalNs { 0 };
+    std::atomic<uint64_t> m_maxNs { 0 };
+    // lua callbacks aborted for running over their budget
+    std::atomic<uint32_t> m_violations { 0 };
+    // skipped by the FIRE macros until scripts are reloaded
+    std::atomic<bool> m_disabled { false };
+    // registration generation, see TSClearCallbackStats
+    uint32_t m_generation = 0;
+
+    void Record(uint64_t ns)
+    {
+        m_calls.fetch_add(1, std::memory_order_relaxed);
+        m_totalNs.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t max = m_maxNs.load(std::memory_order_relaxed);
+        while (ns > max && !m_maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+    }
+};
+
+/**
+ * Runs one callback invocation in a callback frame: times it into its
+ * stats, marks it as running for the watchdog and the lua budget, and
+ * scopes its lua temporaries.
+ *
+ * C++ callbacks skip the frame unless timing or the watchdog are on.
+ */
+class TSCallbackTimer
+{
+public:
+    explicit TSCallbackTimer(TSCallbackStats* stats)
+        : m_stats(stats)
+        , m_entered((stats && stats->m_runsLua) || TSCallbackFramesEnabled())
+    {
+        if (m_entered)
+        {
+            m_frame.m_stats = stats;
+            TSEnterCallback(&m_frame);
+        }
+    }
+
+    ~TSCallbackTimer()
+    {
+        if (m_entered)
+        {
+            TSLeaveCallback(&m_frame);
+        }
+    }
+
+    TSCallbackTimer(TSCallbackTimer const&) = delete;
+    TSCallbackTimer& operator=(TSCallbackTimer const&) = delete;
+
+    TSCallbackStats* m_stats;
+private:
+    bool m_entered;
+    TSCallbackFrame m_frame;
+};
+
+/**
+ * Returns the stats for callbacks registered to `category`.`event`
+ * by the module currently being loaded.
+ * @param category the events struct name, i.e "PlayerEvents"
+ */
+TC_GAME_API TSCallbackStats* TSGetCallbackStats(char const* category, char const* event, bool lua);
+
+/**
+ * Stats for lua work tswow itself does every tick, like "Lua.GC [tswow]".
+ * Hidden on reload like callback stats, so look them up every time.
+ */
+TC_GAME_API TSCallbackStats* TSGetSystemStats(char const* category, char const* name);
+
+/** Module that callbacks registered from now on belong to, empty after loading. */
+TC_GAME_API void TSSetEventModule(std::string const& module);
+
+TC_GAME_API std::vector<TSCallbackStats*> TSGetAllCallbackStats();
+/** Zeroes all counters, registered callbacks keep their stats. */
+TC_GAME_API void TSResetCallbackStats();
+/**
+ * Hides all stats, when every callback is unregistered on reload.
+ * They stay allocated for callbacks still running, and are zeroed
+ * and shown again once registered again.
+ */
+TC_GAME_API void TSClearCallbackStats();
@@ -861,12 +861,16 @@ struct TSEvents
     struct CustomPacketEvents : public TSMappedEventsDirect {
         EVENTS_HEADER(CustomPacketEvents)
         ID_EVENT(OnReceive, TSNumber<uint32> opcode, TSPacketRead, TSPlayer)
+        ID_EVENT(OnRateLimited, TSNumber<uint32> opcode, TSPlayer, TSMutable<bool,bool> drop)
     } CustomPacket;
 
     struct WorldPacketEvents : public TSMappedEventsDirect {
         EVENTS_HEADER(WorldPacketEvents)
         ID_EVENT(OnReceive, TSNumber<uint32> opcode, TSWorldPacket, TSPlayer)
         ID_EVENT(OnSend, TSWorldPacket, TSPlayer)
+        // read-only, register these per opcode to avoid slowing down other packets
+        ID_EVENT(OnReceiveView, TSNumber<uint32> opcode, TSWorldPacketView, TSPlayer)
+        ID_EVENT(OnSendView, TSWorldPacketView, TSPlayer)
     } WorldPacket;
 #if TRINITY
     struct TestEvents {
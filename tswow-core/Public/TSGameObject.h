@@ -55,4 +55,4 @@ public:
     TSGameObjectTemplate GetTemplate();
 };
 
-LUA_PTR_TYPE(TSGameObject)
+LUA_CACHED_PTR_TYPE(TSGameObject)
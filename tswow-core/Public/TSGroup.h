@@ -72,6 +72,7 @@ public:
 private:
     friend class TSLua;
     TSLua::Array<TSPlayer> LGetMembers();
+    TSLua::Iterator<TSPlayer> LIterateMembers();
 
     bool LIsLeader0(TSGUID guid);
     bool LIsLeader1(TSNumber<uint32> guid);
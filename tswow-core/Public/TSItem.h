@@ -93,4 +93,4 @@ public:
 };
 
 TC_GAME_API TSItem CreateItem(uint32 entry = 0, uint32 count = 0);
-LUA_PTR_TYPE(TSItem)
+LUA_CACHED_PTR_TYPE(TSItem)
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "TSMain.h"
+#include "TSBitset.h"
+#include "TSWorkerPool.h"
+
+#include <memory>
+#include <vector>
+
+class TSWorldObject;
+
+struct TSLineOfSightRay
+{
+    float x1;
+    float y1;
+    float z1;
+    float x2;
+    float y2;
+    float z2;
+    // rays between objects that are not on the same map are never in sight
+    bool m_valid;
+};
+
+/**
+ * A list of rays checked together by TSMap::IsInLineOfSightBatch.
+ */
+class TC_GAME_API TSLineOfSightBatch
+{
+    std::shared_ptr<std::vector<TSLineOfSightRay>> m_rays;
+public:
+    TSLineOfSightBatch();
+    TSLineOfSightBatch* operator->() { return this; }
+
+    /** @returns the index of the ray */
+    TSNumber<uint32> Add(float x1, float y1, float z1, float x2, float y2, float z2);
+    /**
+     * Adds a ray between two objects, at the same points
+     * TSWorldObject::IsWithinLoS would use.
+     * @returns the index of the ray
+     */
+    TSNumber<uint32> AddObjects(TSWorldObject from, TSWorldObject to);
+    void Clear();
+    TSNumber<uint32> GetSize();
+
+    std::vector<TSLineOfSightRay> const& GetRays() const { return *m_rays; }
+};
+
+TC_GAME_API TSLineOfSightBatch CreateLineOfSightBatch();
+
+/**
+ * Worker threads shared by batched map queries ("TSWoW.WorkerThreads").
+ */
+TC_GAME_API std::shared_ptr<TSWorkerPool> GetWorkerPool();
+TC_GAME_API void SetWorkerThreads(uint32 threads);
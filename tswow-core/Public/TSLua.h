@@ -1,22 +1,28 @@
 #pragma once
 
 #include "TSMain.h"
+#include "TSScopedArena.h"
+#include "TSLuaUserdata.h"
 
 #include <sol/sol.hpp>
 
+#include <functional>
+#include <new>
 #include <vector>
 #include <filesystem>
+#include <memory>
+
+class TSSourceMap;
 
 #define LUA_FIELD(target,cls,fn) target.set_function(#fn,&cls::fn)
 
-#define LUA_PTR_TYPE_CON(type_in,con_in)\
+// push_in pushes a non-null value
+#define LUA_PTR_TYPE_PUSH(type_in,con_in,push_in)\
 inline int sol_lua_push(lua_State* L, const type_in& value) {\
     int amount;\
     if (value)\
     {\
-       	using Tu = sol::meta::unqualified_t<type_in>;\
-        sol::stack::unqualified_pusher<type_in> p{};\
-        amount = p.push(L, value);\
+        amount = push_in;\
     }\
     else\
     {\
@@ -53,10 +59,8 @@ inline type_in& sol_lua_get(sol::types<type_in> types, lua_State* L, int index,
     if (v == sol::type::nil)\
     {\
         tracking.use(1);\
-        void* c = add_lua_garbage(sizeof(type_in));\
-        type_in* ptr = reinterpret_cast<type_in*>(c);\
-        *ptr = con_in;\
-        return *ptr;\
+        void* c = TSLuaArena().Allocate(sizeof(type_in), alignof(type_in));\
+        return *new (c) type_in(con_in);\
     }\
     else\
     {\
@@ -69,8 +73,14 @@ inline type_in& sol_lua_get(sol::types<type_in> types, lua_State* L, int index,
     }\
 }\
 
+#define LUA_PTR_TYPE_CON(type_in,con_in) LUA_PTR_TYPE_PUSH(type_in,con_in,(sol::stack::unqualified_pusher<type_in>{}.push(L, value)))
+
 #define LUA_PTR_TYPE(type_in) LUA_PTR_TYPE_CON(type_in,type_in(nullptr))
 
+// Like LUA_PTR_TYPE, but the userdata is reused for the same entity (TSLuaUserdata.h)
+#define LUA_CACHED_PTR_TYPE(type_in) LUA_PTR_TYPE_PUSH(type_in,type_in(nullptr),\
+    (TSLuaUserdata::PushCached<type_in>(L, value, [](void* stored) { *static_cast<type_in*>(stored) = type_in(nullptr); })))
+
 class TC_GAME_API TSLua
 {
 public:
@@ -80,6 +90,25 @@ public:
     template <typename K, typename V>
     using Dictionary = sol::as_table_t<std::map<K, V>>;
 
+    // For `for ... in` loops, walks a collection without copying it to a table.
+    // Returns nil once done, and is only valid during the current callback.
+    template <typename T>
+    using Iterator = std::function<sol::optional<T>()>;
+
+    // An Iterator calling `next` until the callback it was created in
+    // returns (see TSLuaUserdata::Epoch), and nil after that.
+    template <typename T, typename F>
+    static Iterator<T> CallbackIterator(F next)
+    {
+        return [next = std::move(next), epoch = TSLuaUserdata::Epoch()]() mutable -> sol::optional<T> {
+            if (epoch != TSLuaUserdata::Epoch())
+            {
+                return sol::nullopt;
+            }
+            return next();
+        };
+    }
+
     static void load_bindings(sol::state& state);
     static void handle_error(sol::protected_function_result const& what);
     static void execute_file(std::filesystem::path file);
@@ -88,6 +117,18 @@ public:
     static sol::state& GetState();
     static std::filesystem::path LuaRoot();
     static std::filesystem::path FindLuaModule(std::string target);
+    /**
+     * Returns the parsed <file>.map next to a generated lua file,
+     * or nullptr if there is none. Maps are read once per load.
+     */
+    static std::shared_ptr<TSSourceMap> GetSourceMap(std::filesystem::path const& luaFile);
+    /**
+     * Stops automatic garbage collection and instead collects for up to
+     * `us` microseconds every world tick ("TSWoW.LuaGCBudgetUs", 0 = automatic).
+     */
+    static void SetGCBudget(uint32 us);
+    // Called at the end of every world tick
+    static void GCTick();
 private:
     static void load_worldentity_methods(sol::state & state);
     static void load_creature_methods(sol::state & state);
@@ -108,6 +149,7 @@ private:
     static void load_corpse_methods(sol::state & state);
     static void load_packet_methods(sol::state & state);
     static void load_world_packet_methods(sol::state & state);
+    static void load_replicated_state_methods(sol::state & state);
     static void load_damage_metods(sol::state & state);
     static void load_group_methods(sol::state & state);
     static void load_guild_methods(sol::state & state);
@@ -134,6 +176,7 @@ private:
     static void load_mutex_functions(sol::state& state);
     static void load_lua_libraries(sol::state& state);
     static void load_main_thread_context_methods(sol::state& state);
+    static void load_async_functions(sol::state& state);
 
     template <typename C, typename T>
     static void load_json_methods_t(sol::state & state, sol::usertype<T> & target, std::string const& name);
@@ -145,8 +188,14 @@ private:
     static void load_world_entity_methods_t(sol::state & state, sol::usertype<T> & target, std::string const& name);
 };
 
-// used by the pointer system to get class references even when we have to fake them
-TC_GAME_API void* add_lua_garbage(size_t size);
-TC_GAME_API void clear_lua_garbage();
+/**
+ * Temporaries of this thread that lua getters hand out by reference,
+ * like the empty entity made when a script passes nil.
+ * Callbacks, timers and delayed calls open a scope that frees them on return,
+ * so they must not be kept past the call that received them.
+ */
+TC_GAME_API TSScopedArena& TSLuaArena();
+// Checks arenas for memory written after it was freed ("TSWoW.LuaArenaDebug")
+TC_GAME_API void SetLuaArenaDebug(bool debug);
 TC_GAME_API size_t GetLuaGarbageCur();
 TC_GAME_API size_t GetLuaGarbageTotal();
@@ -0,0 +1,288 @@
+/*
+ * This file is part of tswow (https://github.com/tswow/).
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+// This header does not depend on the core so it can be tested headless.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Lua memory of one module, for all lua states.
+ */
+struct TSLuaModuleMemory
+{
+    std::string m_name;
+    std::atomic<int64_t> m_live { 0 };
+    std::atomic<int64_t> m_peak { 0 };
+    // bytes ever allocated, for allocation rates
+    std::atomic<uint64_t> m_allocated { 0 };
+    std::atomic<uint64_t> m_allocations { 0 };
+
+    void Add(int64_t bytes)
+    {
+        int64_t live = m_live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        if (bytes <= 0)
+        {
+            return;
+        }
+        m_allocated.fetch_add(uint64_t(bytes), std::memory_order_relaxed);
+        m_allocations.fetch_add(1, std::memory_order_relaxed);
+        int64_t peak = m_peak.load(std::memory_order_relaxed);
+        while (live > peak && !m_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    }
+};
+
+/**
+ * Attributes lua allocations to the module whose code is running.
+ * Module 0 (with an empty name) is everything that runs
+ * outside of a module, like lualib and timers.
+ */
+class TSLuaMemory
+{
+public:
+    // modules past this share module 0
+    static constexpr uint32_t MAX_MODULES = 256;
+
+    static uint32_t ModuleId(std::string const& name)
+    {
+        if (name.size() == 0)
+        {
+            return 0;
+        }
+        std::unique_lock<std::mutex> lock(s_namesLock);
+        for (uint32_t i = 1; i < s_count; ++i)
+        {
+            if (s_modules[i].m_name == name)
+            {
+                return i;
+            }
+        }
+        if (s_count == MAX_MODULES)
+        {
+            return 0;
+        }
+        s_modules[s_count].m_name = name;
+        // published after the name so readers never see a half written one
+        s_count.fetch_add(1, std::memory_order_release);
+        return s_count - 1;
+    }
+
+    static TSLuaModuleMemory& Module(uint32_t id) { return s_modules[id]; }
+    static uint32_t ModuleCount() { return s_count.load(std::memory_order_acquire); }
+
+    // bytes ever allocated by all modules
+    static uint64_t TotalAllocated()
+    {
+        uint64_t total = 0;
+        for (uint32_t i = 0; i < ModuleCount(); ++i)
+        {
+            total += s_modules[i].m_allocated.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    static uint32_t GetCurrentModule() { return s_current; }
+    static void SetCurrentModule(uint32_t id) { s_current = id; }
+private:
+    static inline std::mutex s_namesLock;
+    static inline std::array<TSLuaModuleMemory, MAX_MODULES> s_modules;
+    static inline std::atomic<uint32_t> s_count { 1 };
+    static inline thread_local uint32_t s_current = 0;
+};
+
+/**
+ * lua_Alloc for one lua state that records which module owns every
+ * block, optionally serving small blocks from per size class free lists.
+ * Pooled blocks are only given back to the system when the state closes.
+ */
+class TSLuaAllocator
+{
+public:
+    explicit TSLuaAllocator(bool pooled)
+        : m_pooled(pooled)
+    {}
+
+    TSLuaAllocator(TSLuaAllocator const&) = delete;
+    TSLuaAllocator& operator=(TSLuaAllocator const&) = delete;
+
+    ~TSLuaAllocator()
+    {
+        for (char* slab : m_slabs)
+        {
+            std::free(slab);
+        }
+    }
+
+    // lua_Alloc, `ud` is the allocator
+    static void* Alloc(void* ud, void* ptr, size_t osize, size_t nsize)
+    {
+        TSLuaAllocator* allocator = static_cast<TSLuaAllocator*>(ud);
+        // for new blocks osize is the type of object being created
+        if (!ptr)
+        {
+            osize = 0;
+        }
+
+        uint32_t module = TSLuaMemory::GetCurrentModule();
+        if (ptr)
+        {
+            // the last module to resize a block owns all of it
+            Header* header = HeaderOf(ptr);
+            TSLuaMemory::Module(header->m_module).Add(-int64_t(osize));
+        }
+
+        if (nsize == 0)
+        {
+            if (ptr)
+            {
+                allocator->Free(HeaderOf(ptr), osize);
+            }
+            return nullptr;
+        }
+
+        Header* header = ptr
+            ? allocator->Resize(HeaderOf(ptr), osize, nsize)
+            : allocator->Allocate(nsize);
+        if (!header)
+        {
+            // lua keeps the old block when growing fails
+            if (ptr)
+            {
+                TSLuaMemory::Module(HeaderOf(ptr)->m_module).Add(int64_t(osize));
+            }
+            return nullptr;
+        }
+        header->m_module = module;
+        TSLuaMemory::Module(module).Add(int64_t(nsize));
+        return header + 1;
+    }
+
+    size_t GetSlabBytes() const { return m_slabs.size() * SLAB_SIZE; }
+private:
+    // keeps blocks aligned for any lua type
+    struct alignas(16) Header
+    {
+        uint32_t m_module;
+    };
+
+    static constexpr size_t CLASS_SIZE = 16;
+    static constexpr size_t CLASS_COUNT = 32;
+    // blocks up to this size, header included, are pooled
+    static constexpr size_t MAX_POOLED = CLASS_SIZE * CLASS_COUNT;
+    static constexpr size_t SLAB_SIZE = 64 * 1024;
+
+    struct FreeBlock
+    {
+        FreeBlock* m_next;
+    };
+
+    static Header* HeaderOf(void* ptr)
+    {
+        return static_cast<Header*>(ptr) - 1;
+    }
+
+    // 0 if the block is not pooled
+    size_t ClassOf(size_t size) const
+    {
+        size_t total = size + sizeof(Header);
+        return m_pooled && total <= MAX_POOLED ? (total + CLASS_SIZE - 1) / CLASS_SIZE : 0;
+    }
+
+    Header* Allocate(size_t size)
+    {
+        size_t cls = ClassOf(size);
+        if (cls == 0)
+        {
+            return static_cast<Header*>(std::malloc(size + sizeof(Header)));
+        }
+        FreeBlock*& head = m_free[cls - 1];
+        if (!head && !Refill(cls))
+        {
+            return nullptr;
+        }
+        FreeBlock* block = head;
+        head = block->m_next;
+        return reinterpret_cast<Header*>(block);
+    }
+
+    void Free(Header* header, size_t size)
+    {
+        size_t cls = ClassOf(size);
+        if (cls == 0)
+        {
+            std::free(header);
+            return;
+        }
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(header);
+        block->m_next = m_free[cls - 1];
+        m_free[cls - 1] = block;
+    }
+
+    Header* Resize(Header* header, size_t osize, size_t nsize)
+    {
+        size_t oldClass = ClassOf(osize);
+        size_t newClass = ClassOf(nsize);
+        if (oldClass == 0 && newClass == 0)
+        {
+            return static_cast<Header*>(std::realloc(header, nsize + sizeof(Header)));
+        }
+        if (oldClass == newClass)
+        {
+            return header;
+        }
+        Header* moved = Allocate(nsize);
+        if (!moved)
+        {
+            return nullptr;
+        }
+        std::memcpy(moved, header, sizeof(Header) + std::min(osize, nsize));
+        Free(header, osize);
+        return moved;
+    }
+
+    bool Refill(size_t cls)
+    {
+        char* slab = static_cast<char*>(std::malloc(SLAB_SIZE));
+        if (!slab)
+        {
+            return false;
+        }
+        m_slabs.push_back(slab);
+        size_t blockSize = cls * CLASS_SIZE;
+        FreeBlock*& head = m_free[cls - 1];
+        for (size_t offset = 0; offset + blockSize <= SLAB_SIZE; offset += blockSize)
+        {
+            FreeBlock* block = reinterpret_cast<FreeBlock*>(slab + offset);
+            block->m_next = head;
+            head = block;
+        }
+        return true;
+    }
+
+    bool m_pooled;
+    std::array<FreeBlock*, CLASS_COUNT> m_free {};
+    std::vector<char*> m_slabs;
+};
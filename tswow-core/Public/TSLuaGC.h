@@ -0,0 +1,118 @@
+/*
+ * This file is part of tswow (https://github.com/tswow/).
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+// This header does not depend on the core so it can be tested headless.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Runs the lua garbage collector in small steps once per tick
+ * instead of letting allocations trigger it inside event handlers.
+ *
+ * Every tick the collector is asked to catch up with twice the memory
+ * allocated since the last tick, in chunks sized from how long earlier
+ * chunks took, until the time budget runs out. Work that did not fit is
+ * carried over to the next tick.
+ */
+class TSLuaGCStepper
+{
+public:
+    struct TickResult
+    {
+        uint32_t m_steps = 0;
+        uint64_t m_stepKb = 0;
+        bool m_finishedCycle = false;
+        uint64_t m_ns = 0;
+    };
+
+    /**
+     * @param allocatedKb kb allocated since the last tick
+     * @param step performs lua_gc(L, LUA_GCSTEP, kb) for an int kb,
+     *             returns true if a collection cycle finished
+     */
+    template <typename Step>
+    TickResult Tick(uint64_t budgetNs, uint64_t allocatedKb, Step step)
+    {
+        TickResult result;
+        m_debtKb += allocatedKb * WORK_PER_KB;
+        // a cycle that was started still needs to finish when nothing is allocated
+        m_debtKb = std::max<uint64_t>(m_debtKb, MIN_STEP_KB);
+
+        uint64_t start = NowNs();
+        while (m_debtKb > 0)
+        {
+            uint64_t chunk = std::min(m_debtKb, ChunkKb(budgetNs));
+            uint64_t chunkStart = NowNs();
+            bool finished = step(int(chunk));
+            uint64_t chunkNs = NowNs() - chunkStart;
+
+            // moving average, new chunks weigh a quarter
+            double nsPerKb = double(chunkNs) / double(chunk);
+            m_nsPerKb = m_nsPerKb > 0 ? m_nsPerKb * 0.75 + nsPerKb * 0.25 : nsPerKb;
+
+            m_debtKb -= chunk;
+            ++result.m_steps;
+            result.m_stepKb += chunk;
+            if (finished)
+            {
+                // nothing left to collect until more is allocated
+                result.m_finishedCycle = true;
+                m_debtKb = 0;
+                break;
+            }
+            if (NowNs() - start >= budgetNs)
+            {
+                break;
+            }
+        }
+        result.m_ns = NowNs() - start;
+        return result;
+    }
+
+    uint64_t GetDebtKb() const { return m_debtKb; }
+    double GetNsPerKb() const { return m_nsPerKb; }
+private:
+    // collector work requested per kb allocated, so it outpaces allocation
+    static constexpr uint64_t WORK_PER_KB = 2;
+    static constexpr uint64_t MIN_STEP_KB = 1;
+    static constexpr uint64_t MAX_STEP_KB = 1 << 20;
+    // chunks aim at this fraction of the budget so the clock is checked often enough
+    static constexpr uint64_t CHUNKS_PER_BUDGET = 4;
+
+    static uint64_t NowNs()
+    {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count());
+    }
+
+    uint64_t ChunkKb(uint64_t budgetNs) const
+    {
+        if (m_nsPerKb <= 0)
+        {
+            return MIN_STEP_KB;
+        }
+        uint64_t kb = uint64_t(double(budgetNs / CHUNKS_PER_BUDGET) / m_nsPerKb);
+        return std::clamp<uint64_t>(kb, MIN_STEP_KB, MAX_STEP_KB);
+    }
+
+    uint64_t m_debtKb = 0;
+    double m_nsPerKb = 0;
+};
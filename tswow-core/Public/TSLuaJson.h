@@ -0,0 +1,899 @@
+/*
+ * This file is part of tswow (https://github.com/tswow/).
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+// This header does not depend on the core so it can be tested headless.
+// It only uses the lua C api, include lua.h (or sol) before it.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * Streaming json reader, calls the handler for every token
+ * instead of building a document:
+ *
+ *   BeginObject() Key(str, len) <value> ... EndObject()
+ *   BeginArray() <value> ... EndArray()
+ *   Null() Bool(b) Integer(i) Number(d) String(str, len)
+ *
+ * Numbers without fraction or exponent that fit 64 bits are integers.
+ * Strings without escapes point straight into the input, and are only
+ * valid during the call. Handlers return false to stop reading.
+ */
+template <typename Handler>
+class TSJsonReader
+{
+public:
+    static constexpr uint32_t MaxDepth = 256;
+
+    TSJsonReader(Handler& handler, char const* text, size_t length)
+        : m_handler(handler)
+        , m_cur(text)
+        , m_begin(text)
+        , m_end(text + length)
+    {}
+
+    // Reads exactly one value, surrounded by optional whitespace
+    bool Read()
+    {
+        SkipWhitespace();
+        if (!ReadValue(0))
+        {
+            return false;
+        }
+        SkipWhitespace();
+        return m_cur == m_end || Fail("unexpected trailing characters");
+    }
+
+    std::string const& GetError() const { return m_error; }
+private:
+    bool Fail(char const* message)
+    {
+        if (m_error.empty())
+        {
+            m_error = std::string(message) + " at offset " + std::to_string(m_cur - m_begin);
+        }
+        return false;
+    }
+
+    bool Stopped()
+    {
+        return Fail("stopped by handler");
+    }
+
+    void SkipWhitespace()
+    {
+        while (m_cur < m_end && (*m_cur == ' ' || *m_cur == '\n' || *m_cur == '\r' || *m_cur == '\t'))
+        {
+            ++m_cur;
+        }
+    }
+
+    bool Literal(char const* literal, size_t length)
+    {
+        if (size_t(m_end - m_cur) < length || memcmp(m_cur, literal, length) != 0)
+        {
+            return Fail("invalid literal");
+        }
+        m_cur += length;
+        return true;
+    }
+
+    bool ReadValue(uint32_t depth)
+    {
+        if (m_cur == m_end)
+        {
+            return Fail("unexpected end of input");
+        }
+        switch (*m_cur)
+        {
+        case '{':
+            return ReadObject(depth + 1);
+        case '[':
+            return ReadArray(depth + 1);
+        case '"':
+        {
+            char const* str;
+            size_t length;
+            if (!ReadString(str, length))
+            {
+                return false;
+            }
+            return m_handler.String(str, length) || Stopped();
+        }
+        case 't':
+            return Literal("true", 4) && (m_handler.Bool(true) || Stopped());
+        case 'f':
+            return Literal("false", 5) && (m_handler.Bool(false) || Stopped());
+        case 'n':
+            return Literal("null", 4) && (m_handler.Null() || Stopped());
+        default:
+            return ReadNumber();
+        }
+    }
+
+    bool ReadObject(uint32_t depth)
+    {
+        if (depth > MaxDepth)
+        {
+            return Fail("nested too deeply");
+        }
+        ++m_cur;
+        if (!m_handler.BeginObject())
+        {
+            return Stopped();
+        }
+        SkipWhitespace();
+        if (m_cur < m_end && *m_cur == '}')
+        {
+            ++m_cur;
+            return m_handler.EndObject() || Stopped();
+        }
+        for (;;)
+        {
+            if (m_cur == m_end || *m_cur != '"')
+            {
+                return Fail("expected string key");
+            }
+            char const* key;
+            size_t length;
+            if (!ReadString(key, length))
+            {
+                return false;
+            }
+            if (!m_handler.Key(key, length))
+            {
+                return Stopped();
+            }
+            SkipWhitespace();
+            if (m_cur == m_end || *m_cur != ':')
+            {
+                return Fail("expected ':'");
+            }
+            ++m_cur;
+            SkipWhitespace();
+            if (!ReadValue(depth))
+            {
+                return false;
+            }
+            SkipWhitespace();
+            if (m_cur < m_end && *m_cur == ',')
+            {
+                ++m_cur;
+                SkipWhitespace();
+                continue;
+            }
+            if (m_cur < m_end && *m_cur == '}')
+            {
+                ++m_cur;
+                return m_handler.EndObject() || Stopped();
+            }
+            return Fail("expected ',' or '}'");
+        }
+    }
+
+    bool ReadArray(uint32_t depth)
+    {
+        if (depth > MaxDepth)
+        {
+            return Fail("nested too deeply");
+        }
+        ++m_cur;
+        if (!m_handler.BeginArray())
+        {
+            return Stopped();
+        }
+        SkipWhitespace();
+        if (m_cur < m_end && *m_cur == ']')
+        {
+            ++m_cur;
+            return m_handler.EndArray() || Stopped();
+        }
+        for (;;)
+        {
+            if (!ReadValue(depth))
+            {
+                return false;
+            }
+            SkipWhitespace();
+            if (m_cur < m_end && *m_cur == ',')
+            {
+                ++m_cur;
+                SkipWhitespace();
+                continue;
+            }
+            if (m_cur < m_end && *m_cur == ']')
+            {
+                ++m_cur;
+                return m_handler.EndArray() || Stopped();
+            }
+            return Fail("expected ',' or ']'");
+        }
+    }
+
+    bool ReadNumber()
+    {
+        char const* start = m_cur;
+        bool negative = m_cur < m_end && *m_cur == '-';
+        if (negative)
+        {
+            ++m_cur;
+        }
+        char const* digits = m_cur;
+        if (m_cur == m_end || *m_cur < '0' || *m_cur > '9')
+        {
+            return Fail("unexpected character");
+        }
+        if (*m_cur == '0')
+        {
+            ++m_cur;
+        }
+        else
+        {
+            while (m_cur < m_end && *m_cur >= '0' && *m_cur <= '9') ++m_cur;
+        }
+        size_t intDigits = size_t(m_cur - digits);
+        bool integral = true;
+        if (m_cur < m_end && *m_cur == '.')
+        {
+            integral = false;
+            ++m_cur;
+            if (m_cur == m_end || *m_cur < '0' || *m_cur > '9')
+            {
+                return Fail("expected digit");
+            }
+            while (m_cur < m_end && *m_cur >= '0' && *m_cur <= '9') ++m_cur;
+        }
+        if (m_cur < m_end && (*m_cur == 'e' || *m_cur == 'E'))
+        {
+            integral = false;
+            ++m_cur;
+            if (m_cur < m_end && (*m_cur == '+' || *m_cur == '-')) ++m_cur;
+            if (m_cur == m_end || *m_cur < '0' || *m_cur > '9')
+            {
+                return Fail("expected digit");
+            }
+            while (m_cur < m_end && *m_cur >= '0' && *m_cur <= '9') ++m_cur;
+        }
+
+        // 18 digits always fit in an int64
+        if (integral && intDigits <= 18)
+        {
+            int64_t value = 0;
+            for (char const* c = digits; c < m_cur; ++c)
+            {
+                value = value * 10 + (*c - '0');
+            }
+            return m_handler.Integer(negative ? -value : value) || Stopped();
+        }
+
+        // strtod needs a terminated copy, the input might continue with digits
+        char buffer[64];
+        size_t length = size_t(m_cur - start);
+        double value;
+        if (length < sizeof(buffer))
+        {
+            memcpy(buffer, start, length);
+            buffer[length] = '\0';
+            value = strtod(buffer, nullptr);
+        }
+        else
+        {
+            value = strtod(std::string(start, length).c_str(), nullptr);
+        }
+        return m_handler.Number(value) || Stopped();
+    }
+
+    static int Hex(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    bool ReadHex4(uint32_t& out)
+    {
+        if (m_end - m_cur < 4)
+        {
+            return Fail("invalid unicode escape");
+        }
+        out = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            int digit = Hex(m_cur[i]);
+            if (digit < 0)
+            {
+                return Fail("invalid unicode escape");
+            }
+            out = (out << 4) | uint32_t(digit);
+        }
+        m_cur += 4;
+        return true;
+    }
+
+    void AppendUtf8(uint32_t cp)
+    {
+        if (cp < 0x80)
+        {
+            m_scratch += char(cp);
+        }
+        else if (cp < 0x800)
+        {
+            m_scratch += char(0xC0 | (cp >> 6));
+            m_scratch += char(0x80 | (cp & 0x3F));
+        }
+        else if (cp < 0x10000)
+        {
+            m_scratch += char(0xE0 | (cp >> 12));
+            m_scratch += char(0x80 | ((cp >> 6) & 0x3F));
+            m_scratch += char(0x80 | (cp & 0x3F));
+        }
+        else
+        {
+            m_scratch += char(0xF0 | (cp >> 18));
+            m_scratch += char(0x80 | ((cp >> 12) & 0x3F));
+            m_scratch += char(0x80 | ((cp >> 6) & 0x3F));
+            m_scratch += char(0x80 | (cp & 0x3F));
+        }
+    }
+
+    // m_cur is at the opening quote
+    bool ReadString(char const*& out, size_t& length)
+    {
+        char const* start = ++m_cur;
+        while (m_cur < m_end && *m_cur != '"' && *m_cur != '\\')
+        {
+            if (uint8_t(*m_cur) < 0x20)
+            {
+                return Fail("control character in string");
+            }
+            ++m_cur;
+        }
+        if (m_cur == m_end)
+        {
+            return Fail("unterminated string");
+        }
+        if (*m_cur == '"')
+        {
+            out = start;
+            length = size_t(m_cur - start);
+            ++m_cur;
+            return true;
+        }
+
+        // has escapes, unescape everything into the scratch buffer
+        m_scratch.assign(start, m_cur);
+        while (m_cur < m_end && *m_cur != '"')
+        {
+            char c = *m_cur++;
+            if (c != '\\')
+            {
+                if (uint8_t(c) < 0x20)
+                {
+                    return Fail("control character in string");
+                }
+                m_scratch += c;
+                continue;
+            }
+            if (m_cur == m_end)
+            {
+                break;
+            }
+            switch (*m_cur++)
+            {
+            case '"': m_scratch += '"'; break;
+            case '\\': m_scratch += '\\'; break;
+            case '/': m_scratch += '/'; break;
+            case 'b': m_scratch += '\b'; break;
+            case 'f': m_scratch += '\f'; break;
+            case 'n': m_scratch += '\n'; break;
+            case 'r': m_scratch += '\r'; break;
+            case 't': m_scratch += '\t'; break;
+            case 'u':
+            {
+                uint32_t cp = 0;
+                if (!ReadHex4(cp))
+                {
+                    return false;
+                }
+                if (cp >= 0xD800 && cp < 0xDC00)
+                {
+                    uint32_t low = 0;
+                    if (m_end - m_cur < 2 || m_cur[0] != '\\' || m_cur[1] != 'u')
+                    {
+                        return Fail("unpaired surrogate");
+                    }
+                    m_cur += 2;
+                    if (!ReadHex4(low))
+                    {
+                        return false;
+                    }
+                    if (low < 0xDC00 || low > 0xDFFF)
+                    {
+                        return Fail("unpaired surrogate");
+                    }
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                }
+                else if (cp >= 0xDC00 && cp <= 0xDFFF)
+                {
+                    return Fail("unpaired surrogate");
+                }
+                AppendUtf8(cp);
+                break;
+            }
+            default:
+                return Fail("invalid escape");
+            }
+        }
+        if (m_cur == m_end)
+        {
+            return Fail("unterminated string");
+        }
+        ++m_cur;
+        out = m_scratch.data();
+        length = m_scratch.size();
+        return true;
+    }
+
+    Handler& m_handler;
+    char const* m_cur;
+    char const* m_begin;
+    char const* m_end;
+    std::string m_scratch;
+    std::string m_error;
+};
+
+/**
+ * Converts between json text and lua values directly, without
+ * building an intermediate document on either side.
+ *
+ * Objects and arrays both become tables (arrays 1-based). null
+ * becomes nil, so it is dropped from objects and leaves a hole
+ * in arrays.
+ *
+ * Tables are written as arrays if their keys are exactly 1..n,
+ * otherwise as objects with string, number or boolean keys.
+ * Empty tables are written as {}. Functions, userdata and threads
+ * are skipped in objects and written as null in arrays.
+ */
+class TSLuaJson
+{
+public:
+    /**
+     * Pushes the value in `text`. On failure pushes nothing,
+     * and `error` holds the reason.
+     */
+    static bool Decode(lua_State* L, char const* text, size_t length, std::string& error)
+    {
+        int top = lua_gettop(L);
+        LuaHandler handler(L);
+        TSJsonReader<LuaHandler> reader(handler, text, length);
+        if (!reader.Read())
+        {
+            error = handler.m_error.empty() ? reader.GetError() : handler.m_error;
+            lua_settop(L, top);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Appends the value at `index` to `out`. On failure `out`
+     * is left unchanged and `error` holds the reason.
+     */
+    static bool Encode(lua_State* L, int index, std::string& out, std::string& error)
+    {
+        if (index < 0 && index > LUA_REGISTRYINDEX)
+        {
+            index = lua_gettop(L) + index + 1;
+        }
+        size_t start = out.size();
+        int top = lua_gettop(L);
+        if (!EncodeValue(L, index, out, error, 0))
+        {
+            out.resize(start);
+            lua_settop(L, top);
+            return false;
+        }
+        return true;
+    }
+private:
+    static constexpr uint32_t MaxEncodeDepth = 128;
+
+    static size_t Length(lua_State* L, int index)
+    {
+#if LUA_VERSION_NUM >= 502
+        return lua_rawlen(L, index);
+#else
+        return lua_objlen(L, index);
+#endif
+    }
+
+    class LuaHandler
+    {
+    public:
+        explicit LuaHandler(lua_State* L)
+            : L(L)
+        {}
+
+        bool Null()
+        {
+            if (!m_frames.empty())
+            {
+                if (m_frames.back().m_array)
+                {
+                    ++m_frames.back().m_index;
+                }
+                else
+                {
+                    // pop the key, objects can't hold nil
+                    lua_pop(L, 1);
+                }
+                return true;
+            }
+            lua_pushnil(L);
+            return true;
+        }
+
+        bool Bool(bool value)
+        {
+            lua_pushboolean(L, value);
+            return Store();
+        }
+
+        bool Integer(int64_t value)
+        {
+#if LUA_VERSION_NUM >= 503
+            lua_pushinteger(L, lua_Integer(value));
+#else
+            lua_pushnumber(L, lua_Number(value));
+#endif
+            return Store();
+        }
+
+        bool Number(double value)
+        {
+            lua_pushnumber(L, value);
+            return Store();
+        }
+
+        bool String(char const* str, size_t length)
+        {
+            lua_pushlstring(L, str, length);
+            return Store();
+        }
+
+        bool Key(char const* str, size_t length)
+        {
+            lua_pushlstring(L, str, length);
+            return true;
+        }
+
+        bool BeginObject()
+        {
+            return Begin(false);
+        }
+
+        bool BeginArray()
+        {
+            return Begin(true);
+        }
+
+        bool EndObject()
+        {
+            m_frames.pop_back();
+            return Store();
+        }
+
+        bool EndArray()
+        {
+            m_frames.pop_back();
+            return Store();
+        }
+
+        std::string m_error;
+    private:
+        struct Frame
+        {
+            bool m_array;
+            int m_index;
+        };
+
+        bool Begin(bool array)
+        {
+            // table, key and value for every level
+            if (!lua_checkstack(L, 3))
+            {
+                m_error = "lua stack overflow";
+                return false;
+            }
+            lua_newtable(L);
+            m_frames.push_back({ array, 0 });
+            return true;
+        }
+
+        // moves the value on top of the stack into the table being read
+        bool Store()
+        {
+            if (m_frames.empty())
+            {
+                return true;
+            }
+            Frame& frame = m_frames.back();
+            if (frame.m_array)
+            {
+                lua_rawseti(L, -2, ++frame.m_index);
+            }
+            else
+            {
+                lua_rawset(L, -3);
+            }
+            return true;
+        }
+
+        lua_State* L;
+        std::vector<Frame> m_frames;
+    };
+
+    static void AppendInteger(std::string& out, int64_t value)
+    {
+        char buffer[24];
+        char* end = buffer + sizeof(buffer);
+        char* cur = end;
+        uint64_t magnitude = value < 0 ? 0 - uint64_t(value) : uint64_t(value);
+        do
+        {
+            *--cur = char('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude);
+        if (value < 0)
+        {
+            *--cur = '-';
+        }
+        out.append(cur, end);
+    }
+
+    static bool IsIntegral(lua_State* L, int index, int64_t& value)
+    {
+#if LUA_VERSION_NUM >= 503
+        if (lua_isinteger(L, index))
+        {
+            value = int64_t(lua_tointeger(L, index));
+            return true;
+        }
+#endif
+        double number = lua_tonumber(L, index);
+        // 2^63, above it the cast is undefined
+        if (std::floor(number) == number && std::fabs(number) < 9223372036854775808.0)
+        {
+            value = int64_t(number);
+            return true;
+        }
+        return false;
+    }
+
+    static bool AppendNumber(lua_State* L, int index, std::string& out, std::string& error)
+    {
+        int64_t integer;
+        if (IsIntegral(L, index, integer))
+        {
+            AppendInteger(out, integer);
+            return true;
+        }
+        double number = lua_tonumber(L, index);
+        if (std::isnan(number) || std::isinf(number))
+        {
+            error = "cannot encode nan or inf";
+            return false;
+        }
+        char buffer[32];
+        int length = snprintf(buffer, sizeof(buffer), "%.17g", number);
+        out.append(buffer, size_t(length));
+        return true;
+    }
+
+    static void AppendString(std::string& out, char const* str, size_t length)
+    {
+        static char const hex[] = "0123456789abcdef";
+        out += '"';
+        char const* run = str;
+        char const* end = str + length;
+        for (char const* c = str; c < end; ++c)
+        {
+            uint8_t ch = uint8_t(*c);
+            if (ch >= 0x20 && ch != '"' && ch != '\\')
+            {
+                continue;
+            }
+            out.append(run, c);
+            run = c + 1;
+            switch (ch)
+            {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            default:
+                out += "\\u00";
+                out += hex[ch >> 4];
+                out += hex[ch & 0xF];
+            }
+        }
+        out.append(run, end);
+        out += '"';
+    }
+
+    static bool IsSkipped(int type)
+    {
+        return type == LUA_TFUNCTION || type == LUA_TUSERDATA
+            || type == LUA_TLIGHTUSERDATA || type == LUA_TTHREAD;
+    }
+
+    static bool EncodeValue(lua_State* L, int index, std::string& out, std::string& error, uint32_t depth)
+    {
+        switch (lua_type(L, index))
+        {
+        case LUA_TBOOLEAN:
+            out += lua_toboolean(L, index) ? "true" : "false";
+            return true;
+        case LUA_TNUMBER:
+            return AppendNumber(L, index, out, error);
+        case LUA_TSTRING:
+        {
+            size_t length;
+            char const* str = lua_tolstring(L, index, &length);
+            AppendString(out, str, length);
+            return true;
+        }
+        case LUA_TTABLE:
+            return EncodeTable(L, index, out, error, depth + 1);
+        default:
+            out += "null";
+            return true;
+        }
+    }
+
+    // true if the keys are exactly 1..n for some n > 0
+    static bool IsArray(lua_State* L, int index, size_t& count)
+    {
+        count = Length(L, index);
+        if (count == 0)
+        {
+            return false;
+        }
+        size_t keys = 0;
+        lua_pushnil(L);
+        while (lua_next(L, index))
+        {
+            lua_pop(L, 1);
+            int64_t key;
+            if (lua_type(L, -1) != LUA_TNUMBER
+                || !IsIntegral(L, -1, key)
+                || key < 1
+                || uint64_t(key) > count)
+            {
+                lua_pop(L, 1);
+                return false;
+            }
+            ++keys;
+        }
+        return keys == count;
+    }
+
+    static bool EncodeTable(lua_State* L, int index, std::string& out, std::string& error, uint32_t depth)
+    {
+        if (depth > MaxEncodeDepth)
+        {
+            error = "table nested too deeply (or contains a cycle)";
+            return false;
+        }
+        // key and value for this level
+        if (!lua_checkstack(L, 2))
+        {
+            error = "lua stack overflow";
+            return false;
+        }
+
+        size_t count;
+        if (IsArray(L, index, count))
+        {
+            out += '[';
+            for (size_t i = 1; i <= count; ++i)
+            {
+                if (i > 1)
+                {
+                    out += ',';
+                }
+                lua_rawgeti(L, index, int(i));
+                int value = lua_gettop(L);
+                if (IsSkipped(lua_type(L, value)))
+                {
+                    out += "null";
+                }
+                else if (!EncodeValue(L, value, out, error, depth))
+                {
+                    return false;
+                }
+                lua_pop(L, 1);
+            }
+            out += ']';
+            return true;
+        }
+
+        out += '{';
+        bool first = true;
+        lua_pushnil(L);
+        while (lua_next(L, index))
+        {
+            int value = lua_gettop(L);
+            int key = value - 1;
+            if (IsSkipped(lua_type(L, value)))
+            {
+                lua_pop(L, 1);
+                continue;
+            }
+            if (!first)
+            {
+                out += ',';
+            }
+            first = false;
+
+            // never lua_tostring the key, it would confuse lua_next
+            switch (lua_type(L, key))
+            {
+            case LUA_TSTRING:
+            {
+                size_t length;
+                char const* str = lua_tolstring(L, key, &length);
+                AppendString(out, str, length);
+                break;
+            }
+            case LUA_TNUMBER:
+                out += '"';
+                if (!AppendNumber(L, key, out, error))
+                {
+                    return false;
+                }
+                out += '"';
+                break;
+            case LUA_TBOOLEAN:
+                out += lua_toboolean(L, key) ? "\"true\"" : "\"false\"";
+                break;
+            default:
+                error = "unsupported table key type";
+                return false;
+            }
+            out += ':';
+            if (!EncodeValue(L, value, out, error, depth))
+            {
+                return false;
+            }
+            lua_pop(L, 1);
+        }
+        out += '}';
+        return true;
+    }
+};
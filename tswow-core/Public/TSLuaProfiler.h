@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "TSMain.h"
+
+#include <string>
+
+/**
+ * Sampling profiler for Lua scripts. Every `interval` Lua instructions
+ * the running stack is recorded, and on stop the samples are written
+ * as collapsed stacks, with lines mapped back to TypeScript.
+ */
+
+/** @returns false if the profiler is already running */
+TC_GAME_API bool StartLuaProfiler(uint32 interval);
+/**
+ * Stops the profiler and writes the samples to `file`.
+ * @returns false if the profiler was not running or the file could not be written
+ */
+TC_GAME_API bool StopLuaProfiler(std::string const& file);
+TC_GAME_API bool IsLuaProfilerRunning();
+TC_GAME_API uint64 GetLuaProfilerSamples();
+// Installs the instruction hook for the profiler and the
+// callback budget (TSWatchdog.h), on load and when either changes
+void TSLuaInstallHooks();
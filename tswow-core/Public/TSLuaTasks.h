@@ -0,0 +1,249 @@
+/*
+ * This file is part of tswow (https://github.com/tswow/).
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+// This header does not depend on the core so it can be tested headless.
+// It only uses the lua C api, include lua.h (or sol) before it.
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+/**
+ * Lua coroutines that wait without blocking their thread,
+ * what Async, Sleep and the Await functions are built on.
+ *
+ * A C function called by a task waits by creating a TSTaskWake for it
+ * and returning Yield. Whatever ends the wait later calls Resume on the
+ * wake, from the thread the task should continue on. A wake destroyed
+ * without resuming ends the task instead, so a wait dropped with a
+ * queue never leaks its coroutine.
+ *
+ * Clear is called before the lua state is replaced. Tasks and wakes
+ * from before that are never touched again.
+ */
+class TSLuaTasks
+{
+public:
+    struct Task
+    {
+        // keeps the coroutine alive while it waits
+        int m_ref;
+        lua_State* m_thread;
+        // value of m_generation when the task started
+        uint32_t m_generation;
+        // set by the function the task yields through
+        bool m_waiting = false;
+    };
+
+    virtual ~TSLuaTasks() = default;
+
+    /**
+     * Runs the function at stack index 1 as a task,
+     * with the values above it as arguments.
+     */
+    void Start(lua_State* L)
+    {
+        luaL_checktype(L, 1, LUA_TFUNCTION);
+        int nargs = lua_gettop(L) - 1;
+        lua_State* co = lua_newthread(L);
+        int ref = luaL_ref(L, LUA_REGISTRYINDEX);
+        // the function and its arguments
+        lua_xmove(L, co, nargs + 1);
+        auto task = std::make_shared<Task>(Task{ ref, co, m_generation });
+        {
+            std::scoped_lock lock(m_lock);
+            m_tasks[co] = task;
+        }
+        Resume(task, nargs);
+    }
+
+    std::shared_ptr<Task> Find(lua_State* L)
+    {
+        std::scoped_lock lock(m_lock);
+        auto itr = m_tasks.find(L);
+        return itr == m_tasks.end() ? nullptr : itr->second;
+    }
+
+    /**
+     * Checks the current coroutine may wait, and returns its task.
+     * Raises a lua error otherwise, so nothing with a destructor
+     * can be alive in the caller when calling this.
+     */
+    Task* BeginWait(lua_State* L, char const* fn)
+    {
+        Task* task = Find(L).get();
+        if (!task)
+        {
+            luaL_error(L, "%s can only be called inside Async", fn);
+        }
+#if LUA_VERSION_NUM >= 503
+        if (!lua_isyieldable(L))
+        {
+            luaL_error(L, "%s can't be called from a callback inside an Async task", fn);
+        }
+#endif
+        return task;
+    }
+
+    // lua_yield never returns to its caller in a C function, so the setup
+    // of a wait has to be done (and its locals destroyed) before yielding.
+    static int Yield(lua_State* L, Task* task)
+    {
+        task->m_waiting = true;
+        return lua_yield(L, 0);
+    }
+
+    /**
+     * Resumes a task with the `nargs` values on top of its stack
+     * as the results of the function it waited in.
+     */
+    virtual void Resume(std::shared_ptr<Task> const& task, int nargs)
+    {
+        lua_State* co = task->m_thread;
+        task->m_waiting = false;
+#if LUA_VERSION_NUM >= 504
+        int results = 0;
+        int status = lua_resume(co, nullptr, nargs, &results);
+#elif LUA_VERSION_NUM >= 502
+        int status = lua_resume(co, nullptr, nargs);
+        int results = lua_gettop(co);
+#else
+        int status = lua_resume(co, nargs);
+        int results = lua_gettop(co);
+#endif
+        if (status == LUA_YIELD)
+        {
+            lua_pop(co, results);
+            if (task->m_waiting)
+            {
+                return;
+            }
+            OnError(co, status);
+        }
+        else if (status != 0)
+        {
+            OnError(co, status);
+        }
+        Drop(task);
+    }
+
+    void Drop(std::shared_ptr<Task> const& task)
+    {
+        {
+            std::scoped_lock lock(m_lock);
+            auto itr = m_tasks.find(task->m_thread);
+            if (itr != m_tasks.end() && itr->second == task)
+            {
+                m_tasks.erase(itr);
+            }
+        }
+        if (IsCurrent(*task))
+        {
+            // threads share the registry of their state
+            luaL_unref(task->m_thread, LUA_REGISTRYINDEX, task->m_ref);
+        }
+    }
+
+    bool IsCurrent(Task const& task) const
+    {
+        return task.m_generation == m_generation;
+    }
+
+    /** Forgets every task, before their lua state is closed */
+    void Clear()
+    {
+        std::scoped_lock lock(m_lock);
+        m_tasks.clear();
+        ++m_generation;
+    }
+
+    uint32_t Count()
+    {
+        std::scoped_lock lock(m_lock);
+        return uint32_t(m_tasks.size());
+    }
+protected:
+    /**
+     * Called before a task is ended by an error, with the error
+     * on top of its stack, or with LUA_YIELD if it yielded
+     * without going through a function that waits.
+     */
+    virtual void OnError(lua_State*, int) {}
+private:
+    // waits can be started and resumed on map threads
+    std::mutex m_lock;
+    std::unordered_map<lua_State*, std::shared_ptr<Task>> m_tasks;
+    // only changed while no task runs
+    uint32_t m_generation = 0;
+};
+
+/**
+ * Resumes a task at most once, and ends it if nothing
+ * ever does (like a map callback dropped with the map).
+ */
+class TSTaskWake
+{
+public:
+    TSTaskWake(TSLuaTasks& tasks, std::shared_ptr<TSLuaTasks::Task> task)
+        : m_tasks(tasks)
+        , m_task(std::move(task))
+    {}
+
+    TSTaskWake(TSTaskWake const&) = delete;
+    TSTaskWake& operator=(TSTaskWake const&) = delete;
+
+    ~TSTaskWake()
+    {
+        if (!m_done)
+        {
+            m_tasks.Drop(m_task);
+        }
+    }
+
+    /**
+     * Resumes the task with the values push(thread) leaves on its stack,
+     * push returns how many values it pushed.
+     */
+    template <typename F>
+    void Resume(F push)
+    {
+        m_done = true;
+        if (!m_tasks.IsCurrent(*m_task))
+        {
+            return;
+        }
+        int count = push(m_task->m_thread);
+        m_tasks.Resume(m_task, count);
+    }
+
+    void Resume()
+    {
+        Resume([](lua_State*) { return 0; });
+    }
+
+    /** The wait never started, the task keeps running without yielding */
+    void Cancel()
+    {
+        m_done = true;
+    }
+private:
+    TSLuaTasks& m_tasks;
+    std::shared_ptr<TSLuaTasks::Task> m_task;
+    bool m_done = false;
+};
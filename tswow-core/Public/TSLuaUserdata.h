@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "TSMain.h"
+#include "TSEntity.h"
+#include "TSMutable.h"
+
+#include <sol/sol.hpp>
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Reuses lua userdata instead of creating new userdata
+ * every time a wrapper is passed to lua.
+ *
+ * - Entity wrappers (LUA_CACHED_PTR_TYPE) get one userdata per entity and
+ *   type, kept in the entity until it is destroyed.
+ * - Transient wrappers (TSMutable) take userdata from a per thread pool that
+ *   is refilled when the outermost event callback on the thread returns,
+ *   so scripts must not keep them past the callback.
+ */
+struct TC_GAME_API TSLuaUserdata
+{
+    // Changes every time lua is loaded, refs from older states are invalid
+    static uint32 Generation();
+    // Called when lua is loaded
+    static void OnLoad();
+    // Unrefs userdata of destroyed entities, called by the world thread every tick
+    static void ReleaseRefs();
+    // Returns transient userdata to the pool, called when the outermost callback returns
+    static void Recycle();
+    // Changes every time Recycle runs on this thread, and is never the same
+    // on two threads. Whatever was handed to lua with the current epoch
+    // may point at core objects that are gone once it changed.
+    static uint32 Epoch();
+
+    template <typename T>
+    static int PushCached(lua_State* L, T const& value, void (*invalidate)(void*))
+    {
+        TSEntity* entity = nullptr;
+        if constexpr (std::is_base_of_v<TSEntityProvider, T>)
+        {
+            entity = const_cast<T&>(value).getData();
+        }
+        if (!entity)
+        {
+            return sol::stack::unqualified_pusher<T>{}.push(L, value);
+        }
+
+        TSLuaUserdataCache& cache = entity->m_lua_userdata;
+        if (cache.m_generation != Generation())
+        {
+            // the old state and everything in it is gone
+            cache.m_entries.clear();
+            cache.m_generation = Generation();
+        }
+        for (TSLuaUserdataCache::Entry const& entry : cache.m_entries)
+        {
+            if (entry.m_type == TypeKey<T>())
+            {
+                lua_rawgeti(L, LUA_REGISTRYINDEX, entry.m_ref);
+                return 1;
+            }
+        }
+
+        int amount = sol::stack::unqualified_pusher<T>{}.push(L, value);
+        lua_pushvalue(L, -1);
+        int ref = luaL_ref(L, LUA_REGISTRYINDEX);
+        cache.m_entries.push_back({ TypeKey<T>(), ref, Stored<T>(L, -1), invalidate });
+        return amount;
+    }
+
+    template <typename T>
+    static int PushRecycled(lua_State* L, T const& value)
+    {
+        static thread_local Pool<T> pool;
+        if (pool.m_generation != Generation())
+        {
+            pool.m_free.clear();
+            pool.m_used.clear();
+            pool.m_generation = Generation();
+        }
+        if (!pool.m_registered)
+        {
+            pool.m_registered = true;
+            AddRecycler([]() {
+                pool.m_free.insert(pool.m_free.end(), pool.m_used.begin(), pool.m_used.end());
+                pool.m_used.clear();
+            });
+        }
+
+        if (pool.m_free.size() > 0)
+        {
+            std::pair<int, T*> entry = pool.m_free.back();
+            pool.m_free.pop_back();
+            *entry.second = value;
+            pool.m_used.push_back(entry);
+            lua_rawgeti(L, LUA_REGISTRYINDEX, entry.first);
+            return 1;
+        }
+
+        int amount = sol::stack::unqualified_pusher<T>{}.push(L, value);
+        lua_pushvalue(L, -1);
+        int ref = luaL_ref(L, LUA_REGISTRYINDEX);
+        pool.m_used.push_back({ ref, Stored<T>(L, -1) });
+        return amount;
+    }
+
+    // Called by ~TSLuaUserdataCache
+    static void Invalidate(TSLuaUserdataCache& cache);
+private:
+    template <typename T>
+    struct Pool
+    {
+        std::vector<std::pair<int, T*>> m_free;
+        std::vector<std::pair<int, T*>> m_used;
+        uint32 m_generation = 0;
+        bool m_registered = false;
+    };
+
+    template <typename T>
+    static void const* TypeKey()
+    {
+        static char key;
+        return &key;
+    }
+
+    // the wrapper inside a value usertype, laid out like sol_lua_get in TSLua.h expects
+    template <typename T>
+    static T* Stored(lua_State* L, int index)
+    {
+        void* raw = sol::detail::align_usertype_pointer(lua_touserdata(L, index));
+        return *static_cast<T**>(raw);
+    }
+
+    static void AddRecycler(void (*recycle)());
+};
+
+template <typename T, typename R>
+int sol_lua_push(sol::types<TSMutable<T, R>>, lua_State* L, TSMutable<T, R> const& value)
+{
+    return TSLuaUserdata::PushRecycled(L, value);
+}
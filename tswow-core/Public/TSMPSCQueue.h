@@ -0,0 +1,160 @@
+/*
+ * This file is part of tswow (https://github.com/tswow/).
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+// This header does not depend on the core so it can be tested headless.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+
+/**
+ * Unbounded multi-producer single-consumer queue.
+ *
+ * Push is wait-free: one atomic exchange plus one store. Pop and Drain
+ * must only ever be called by one thread at a time (the consumer).
+ * A message whose Push has not returned yet may be missed by a
+ * concurrent Drain, it is then picked up by the next one.
+ */
+template <typename T>
+class TSMPSCQueue
+{
+public:
+    TSMPSCQueue()
+        : m_head(new Node())
+        , m_tail(m_head.load(std::memory_order_relaxed))
+    {}
+
+    ~TSMPSCQueue()
+    {
+        T value;
+        while (Pop(value)) {}
+        delete m_tail;
+    }
+
+    TSMPSCQueue(TSMPSCQueue const&) = delete;
+    TSMPSCQueue& operator=(TSMPSCQueue const&) = delete;
+
+    void Push(T value)
+    {
+        Node* node = new Node();
+        node->m_value.emplace(std::move(value));
+        Node* prev = m_head.exchange(node, std::memory_order_acq_rel);
+        prev->m_next.store(node, std::memory_order_release);
+        m_pushed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool Pop(T& out)
+    {
+        Node* tail = m_tail;
+        Node* next = tail->m_next.load(std::memory_order_acquire);
+        if (next == nullptr)
+        {
+            return false;
+        }
+        // next becomes the new stub node
+        out = std::move(*next->m_value);
+        next->m_value.reset();
+        m_tail = next;
+        delete tail;
+        // only the consumer writes this
+        m_popped.store(m_popped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * Pops and calls callback(value) until the queue is empty
+     * or `limit` (0 = unlimited) messages were handled.
+     */
+    template <typename F>
+    size_t Drain(F callback, size_t limit = 0)
+    {
+        size_t count = 0;
+        T value;
+        while ((limit == 0 || count < limit) && Pop(value))
+        {
+            callback(std::move(value));
+            ++count;
+        }
+        return count;
+    }
+
+    /** Approximate, only exact when no thread is pushing */
+    size_t Size() const
+    {
+        return size_t(
+              m_pushed.load(std::memory_order_relaxed)
+            - m_popped.load(std::memory_order_relaxed)
+        );
+    }
+private:
+    struct Node
+    {
+        std::atomic<Node*> m_next { nullptr };
+        std::optional<T> m_value;
+    };
+
+    alignas(64) std::atomic<Node*> m_head;
+    alignas(64) Node* m_tail;
+    alignas(64) std::atomic<uint64_t> m_pushed { 0 };
+    std::atomic<uint64_t> m_popped { 0 };
+};
+
+/**
+ * Callbacks posted from any thread and run by the one thread owning
+ * the mailbox. A drain only runs what was posted before it started,
+ * callbacks posted by the callbacks themselves wait for the next one.
+ */
+template <typename... Args>
+class TSMailbox
+{
+public:
+    using Callback = std::function<void(Args...)>;
+
+    void Post(Callback callback)
+    {
+        m_queue.Push(std::move(callback));
+    }
+
+    size_t Drain(Args... args)
+    {
+        size_t count = m_queue.Size();
+        if (count == 0)
+        {
+            return 0;
+        }
+        return m_queue.Drain([&](Callback&& callback) {
+            callback(args...);
+        }, count);
+    }
+
+    /** Drops everything posted without running it */
+    void Clear()
+    {
+        m_queue.Drain([](Callback&&) {});
+    }
+
+    size_t Size() const
+    {
+        return m_queue.Size();
+    }
+private:
+    TSMPSCQueue<Callback> m_queue;
+};
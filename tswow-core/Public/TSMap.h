@@ -23,6 +23,7 @@
 #include "TSWorldEntity.h"
 #include "TSLua.h"
 #include "TSWeather.h"
+#include "TSBitset.h"
 
 #include <sol/sol.hpp>
 
@@ -32,6 +33,8 @@ class TSGUID;
 class TSBattleground;
 class TSInstance;
 class TSMainThreadContext;
+class TSSpatialQuery;
+class TSLineOfSightBatch;
 
 class TC_GAME_API TSMap: public TSEntityProvider, public TSWorldEntityProvider<TSMap> {
 public:
@@ -74,6 +77,8 @@ public:
     TSPlayer GetPlayer(TSNumber<uint32> guid);
 
     bool IsInLineOfSight(float x1, float y1, float z1, float x2, float y2, float z2, uint32 phasemask, uint32 checks, uint32 ignoreFlags);
+    void QueryInRange(TSSpatialQuery query);
+    TSBitset IsInLineOfSightBatch(TSLineOfSightBatch batch, uint32 phasemask, uint32 checks, uint32 ignoreFlags);
     TSCreature GetCreatureByDBGUID(uint32 dbguid);
     TSGameObject GetGameObjectByDBGUID(uint32 dbguid);
     TSCreature SpawnCreature(uint32 entry, float x, float y, float z, float o, uint32 despawnTimer = 0, uint32 phase = 1);
@@ -88,6 +93,8 @@ private:
 
     TSLua::Array<TSPlayer> LGetPlayers0(uint32 team);
     TSLua::Array<TSPlayer> LGetPlayers1();
+    TSLua::Iterator<TSPlayer> LIteratePlayers0(uint32 team);
+    TSLua::Iterator<TSPlayer> LIteratePlayers1();
 
     TSLua::Array<TSUnit> LGetUnits();
 
@@ -0,0 +1,132 @@
+/*
+ * This file is part of tswow (https://github.com/tswow/).
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "TSMain.h"
+#include "ObjectGuid.h"
+
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Map;
+class Creature;
+class GameObject;
+
+/**
+ * entry -> values buckets with O(1) add/remove.
+ *
+ * The entry a value was added with is remembered,
+ * so values can be removed even after their entry changed.
+ */
+template <typename T>
+class TSEntryBuckets
+{
+public:
+    void Add(T value, uint32 entry)
+    {
+        if (m_positions.find(value) != m_positions.end())
+        {
+            return;
+        }
+        std::vector<T>& bucket = m_buckets[entry];
+        m_positions[value] = std::make_pair(entry, bucket.size());
+        bucket.push_back(value);
+    }
+
+    void Remove(T value)
+    {
+        auto itr = m_positions.find(value);
+        if (itr == m_positions.end())
+        {
+            return;
+        }
+        uint32 entry = itr->second.first;
+        size_t index = itr->second.second;
+        m_positions.erase(itr);
+
+        std::vector<T>& bucket = m_buckets[entry];
+        T last = bucket.back();
+        bucket.pop_back();
+        if (last != value)
+        {
+            bucket[index] = last;
+            m_positions[last].second = index;
+        }
+        if (bucket.empty())
+        {
+            m_buckets.erase(entry);
+        }
+    }
+
+    std::vector<T> const* Get(uint32 entry) const
+    {
+        auto itr = m_buckets.find(entry);
+        return itr == m_buckets.end() ? nullptr : &itr->second;
+    }
+
+    size_t Size() const { return m_positions.size(); }
+private:
+    std::unordered_map<uint32, std::vector<T>> m_buckets;
+    std::unordered_map<T, std::pair<uint32, size_t>> m_positions;
+};
+
+/**
+ * Per-map index of spawned creatures and gameobjects by entry,
+ * used for entry-filtered lookups such as TSMap::GetCreatures(entry).
+ *
+ * Holds the spawn ids of the maps spawn id stores, lookups resolve
+ * them through those stores, so an object the index missed the removal
+ * of is never returned. It is built from the stores the first time a
+ * map is queried and is then kept up to date by the map events
+ * (see TSLoadBuiltinEvents), so maps that never do filtered lookups
+ * pay nothing for it.
+ *
+ * Lookups also check the entry, so creatures that changed their entry
+ * are only found under their new one once they respawn.
+ */
+class TC_GAME_API TSMapEntryIndex
+{
+public:
+    TSMapEntryIndex(Map* map);
+    void AddCreature(Creature* creature);
+    void RemoveCreature(Creature* creature);
+    void AddGameObject(GameObject* go);
+    void RemoveGameObject(GameObject* go);
+
+    // Appends the spawned objects of this entry to "out"
+    void GetCreatures(uint32 entry, std::vector<Creature*>& out) const;
+    void GetGameObjects(uint32 entry, std::vector<GameObject*>& out) const;
+private:
+    Map* m_map;
+    TSEntryBuckets<ObjectGuid::LowType> m_creatures;
+    TSEntryBuckets<ObjectGuid::LowType> m_gameObjects;
+};
+
+TC_GAME_API TSMapEntryIndex* GetMapEntryIndex(Map* map);
+
+// Called once the listeners maintaining the index are registered.
+TC_GAME_API void TSEnableMapEntryIndex();
+TC_GAME_API bool IsMapEntryIndexEnabled();
+
+// Registered on Map.OnCreatureCreate/OnCreatureRemove and
+// Map.OnGameObjectCreate/OnGameObjectRemove by TSLoadBuiltinEvents.
+TC_GAME_API void TSMapEntryIndexAddCreature(Creature* creature);
+TC_GAME_API void TSMapEntryIndexRemoveCreature(Creature* creature);
+TC_GAME_API void TSMapEntryIndexAddGameObject(GameObject* go);
+TC_GAME_API void TSMapEntryIndexRemoveGameObject(GameObject* go);
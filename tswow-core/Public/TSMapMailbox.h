@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "TSMain.h"
+#include "TSLua.h"
+
+#include <functional>
+#include <string>
+
+class TSMap;
+class TSJsonObject;
+class TSMainThreadContext;
+class Map;
+
+/**
+ * Cross-thread messaging between maps and the world thread.
+ *
+ * Every loaded map and the world thread own a lock-free MPSC queue.
+ * Any thread can post to them, the owner runs everything posted
+ * at the start of its next update.
+ */
+
+/**
+ * Runs `callback` on the thread updating the map, with that map.
+ * @returns false if no map with this id/instance has an open mailbox
+ */
+TC_GAME_API bool PostToMap(uint32 mapId, uint32 instanceId, std::function<void(TSMap)> callback);
+
+/** Runs `callback` on the world thread, between map updates */
+TC_GAME_API void PostToWorld(std::function<void(TSMainThreadContext)> callback);
+
+/**
+ * Sends a typed message to a map, handled by OnMapMessage handlers for `type`
+ * on the thread updating the map. The payload is copied when posted.
+ * @returns false if no map with this id/instance has an open mailbox
+ */
+TC_GAME_API bool PostMapMessage(uint32 mapId, uint32 instanceId, uint32 type, TSJsonObject data);
+
+/** Registers a handler for messages sent with PostMapMessage. Cleared on reload. */
+TC_GAME_API void OnMapMessage(uint32 type, std::function<void(TSMap, TSJsonObject)> callback);
+
+/** Messages posted but not yet handled by a map, 0 if it is not loaded */
+TC_GAME_API TSNumber<uint32> GetMapMailboxSize(uint32 mapId, uint32 instanceId);
+
+// Map.OnCreate opens the mailbox of a map and Map.OnUpdate drains it
+// (see TSLoadBuiltinEvents). The map owns its mailbox, so it closes
+// when the map unloads.
+// TSWorldMailboxDrain is called every world update from TSWorldScript.
+TC_GAME_API void TSMapMailboxOpen(Map* map);
+TC_GAME_API void TSMapMailboxDrain(Map* map);
+TC_GAME_API void TSWorldMailboxDrain();
+// Drops everything still queued, before scripts are reloaded
+TC_GAME_API void TSClearMailboxes();
+
+TC_GAME_API bool LPostToMap(uint32 mapId, uint32 instanceId, sol::protected_function callback);
+TC_GAME_API void LPostToWorld(sol::protected_function callback);
+TC_GAME_API void LOnMapMessage(uint32 type, sol::protected_function callback);
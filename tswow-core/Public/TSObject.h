@@ -108,4 +108,4 @@ TC_GAME_API TSPlayer ToPlayer(TSObject);
 TC_GAME_API TSGameObject ToGameObject(TSObject);
 TC_GAME_API TSCorpse ToCorpse(TSObject);
 
-LUA_PTR_TYPE(TSObject)
+LUA_CACHED_PTR_TYPE(TSObject)
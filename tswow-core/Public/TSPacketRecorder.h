@@ -0,0 +1,41 @@
+#pragma once
+
+#include "TSMain.h"
+#include "TSClasses.h"
+#include "TSCustomPacket.h"
+
+#include <string>
+
+class TSPlayer;
+
+// Records world packets, custom packets and world ticks into a compact
+// binary log (see CustomPacketLog.h) so load-dependent script bugs can be
+// reproduced. Logs can be replayed against a test world with
+// ReplayPacketCapture, or headless with the "packet-replay" tool.
+//
+// Every firing of an event with listeners is recorded by name (see FIRE),
+// session markers (Player.OnLogin and Player.OnLogout) carry the session
+// through CaptureEvent. The headless tool only checks custom packet
+// reassembly, handlers need a running server.
+
+TC_GAME_API bool StartPacketCapture(std::string const& file);
+TC_GAME_API void StopPacketCapture();
+TC_GAME_API bool IsPacketCapturing();
+
+// Hooks, these do nothing unless a capture is running
+TC_GAME_API void CaptureTick(uint32 diff);
+TC_GAME_API void CaptureWorldPacket(WorldPacket const* packet, Player* player);
+TC_GAME_API void CaptureCustomPacket(CustomPacketRead* packet, uint64 session);
+TC_GAME_API void CaptureEvent(std::string const& name, uint64 session);
+
+/**
+ * Feeds a capture back through the event system. Custom and world packets
+ * from every recorded session are dispatched as if "target" sent them,
+ * ticks fire World.OnUpdate with the recorded diff. Custom packets go
+ * through a replay TSServerBuffer per session, so they are reassembled,
+ * validated and rate limited. Recorded events are only counted.
+ *
+ * Returns a report with the time spent in every handler, or an empty
+ * string if the file could not be read.
+ */
+TC_GAME_API std::string ReplayPacketCapture(std::string const& file, TSPlayer target);
@@ -379,4 +379,4 @@ private:
 		friend class TSLua;
 };
 
-LUA_PTR_TYPE(TSPlayer)
+LUA_CACHED_PTR_TYPE(TSPlayer)
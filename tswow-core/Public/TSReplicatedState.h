@@ -0,0 +1,50 @@
+#pragma once
+
+#include "TSMain.h"
+#include "TSLua.h"
+#include "TSCustomPacket.h"
+
+#include <memory>
+
+class TSPlayer;
+class TSMap;
+struct TSReplicatedStateEntry;
+
+/**
+ * A set of numbered fields that are mirrored to clients over STATE_OPCODE.
+ *
+ * Changes are collected and sent as deltas every
+ * "TSWoW.ReplicatedStateInterval" milliseconds, players that have not
+ * seen the channel yet receive a full snapshot instead.
+ *
+ * Player states are sent to a single player,
+ * map states to every player currently on the map.
+ */
+class TC_GAME_API TSReplicatedState
+{
+    std::shared_ptr<TSReplicatedStateEntry> m_entry;
+public:
+    TSReplicatedState(std::shared_ptr<TSReplicatedStateEntry> entry);
+    TSReplicatedState* operator->() { return this; }
+    operator bool() const { return m_entry != nullptr; }
+    bool operator==(TSReplicatedState const& rhs) { return m_entry == rhs.m_entry; }
+
+    TSReplicatedState* SetNumber(uint32 field, double value);
+    TSReplicatedState* SetString(uint32 field, std::string const& value);
+    TSReplicatedState* Remove(uint32 field);
+
+    bool Has(uint32 field);
+    TSNumber<double> GetNumber(uint32 field, double def = 0);
+    std::string GetString(uint32 field, std::string const& def = "");
+};
+
+TC_GAME_API TSReplicatedState GetPlayerState(TSPlayer player, uint32 channel);
+TC_GAME_API TSReplicatedState GetMapState(TSMap map, uint32 channel);
+
+TC_GAME_API void SetReplicatedStateInterval(uint32 interval);
+// Sends pending deltas/snapshots, called once every world tick
+TC_GAME_API void UpdateReplicatedStates(uint32 diff);
+// Drops states owned by a player and forgets what they have been sent
+TC_GAME_API void RemovePlayerStates(TSPlayer player);
+
+LUA_PTR_TYPE(TSReplicatedState)
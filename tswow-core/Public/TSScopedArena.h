@@ -0,0 +1,298 @@
+/*
+ * This file is part of tswow (https://github.com/tswow/).
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+// This header does not depend on the core so it can be tested headless.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#if defined(__SANITIZE_ADDRESS__)
+#define TS_ARENA_ASAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define TS_ARENA_ASAN 1
+#endif
+#endif
+
+#ifdef TS_ARENA_ASAN
+#include <sanitizer/asan_interface.h>
+#define TS_ARENA_POISON(ptr, size) ASAN_POISON_MEMORY_REGION(ptr, size)
+#define TS_ARENA_UNPOISON(ptr, size) ASAN_UNPOISON_MEMORY_REGION(ptr, size)
+#else
+#define TS_ARENA_POISON(ptr, size)
+#define TS_ARENA_UNPOISON(ptr, size)
+#endif
+
+/**
+ * Bump allocator for temporaries that only live while a scope is open.
+ *
+ * Leaving a scope frees everything allocated since it was entered, so
+ * nested scopes only free their own memory. Pages are kept for reuse,
+ * so memory stays at the high water mark of one scope.
+ *
+ * In debug mode freed pages are filled with POISON and checked before
+ * they are handed out again, which catches writes through pointers that
+ * escaped their scope (reads find the poison, which crashes as a pointer).
+ * Under AddressSanitizer freed memory is also poisoned for it.
+ */
+class TSScopedArena
+{
+public:
+    static constexpr unsigned char POISON = 0xDD;
+
+    explicit TSScopedArena(size_t pageSize = 8192)
+        : m_pageSize(pageSize)
+    {}
+
+    TSScopedArena(TSScopedArena const&) = delete;
+    TSScopedArena& operator=(TSScopedArena const&) = delete;
+
+    ~TSScopedArena()
+    {
+#ifdef TS_ARENA_ASAN
+        for (auto& page : m_pages)
+        {
+            TS_ARENA_UNPOISON(page.get(), m_pageSize);
+        }
+#endif
+    }
+
+    void* Allocate(size_t size, size_t align = alignof(std::max_align_t))
+    {
+        size = std::max<size_t>(size, 1);
+        m_total += size;
+        if (size + align > m_pageSize)
+        {
+            return AllocateLarge(size);
+        }
+
+        size_t offset = (m_offset + align - 1) & ~(align - 1);
+        if (m_page == m_pages.size() || offset + size > m_pageSize)
+        {
+            // the rest of a full page is skipped
+            if (m_page < m_pages.size())
+            {
+                ++m_page;
+            }
+            if (m_page == m_pages.size())
+            {
+                m_pages.push_back(std::make_unique<char[]>(m_pageSize));
+                if (m_debug)
+                {
+                    std::memset(m_pages.back().get(), POISON, m_pageSize);
+                }
+                TS_ARENA_POISON(m_pages.back().get(), m_pageSize);
+            }
+            offset = 0;
+        }
+
+        char* ptr = m_pages[m_page].get() + offset;
+        TS_ARENA_UNPOISON(ptr, size);
+        if (m_debug)
+        {
+            CheckPoison(ptr, size);
+        }
+        m_offset = offset + size;
+        return ptr;
+    }
+
+    void Enter()
+    {
+        m_marks.push_back(Mark());
+    }
+
+    // frees what was allocated since the matching Enter
+    void Leave()
+    {
+        Rewind(m_marks.back());
+        m_marks.pop_back();
+        if (m_marks.size() == 0 && m_debug != m_wantDebug && GetUsed() == 0)
+        {
+            ApplyDebug();
+        }
+    }
+
+    // frees everything, also outside of scopes
+    void Clear()
+    {
+        Rewind({ 0, 0, 0 });
+        m_marks.clear();
+        ApplyDebug();
+    }
+
+    /**
+     * Switched when the arena is next empty, since only memory
+     * that was poisoned while free can be checked.
+     */
+    void SetDebug(bool debug)
+    {
+        m_wantDebug = debug;
+        if (m_marks.size() == 0 && GetUsed() == 0)
+        {
+            ApplyDebug();
+        }
+    }
+
+    // called with the address and size of memory written after it was freed
+    void SetEscapeHandler(std::function<void(void*, size_t)> handler)
+    {
+        m_onEscape = std::move(handler);
+    }
+
+    bool IsDebug() const { return m_debug; }
+    size_t GetDepth() const { return m_marks.size(); }
+    // bytes between the start of the arena and the current position
+    size_t GetUsed() const
+    {
+        return (m_page < m_pages.size() ? m_page * m_pageSize + m_offset : m_pages.size() * m_pageSize)
+            + m_largeBytes;
+    }
+    size_t GetReserved() const { return m_pages.size() * m_pageSize + m_largeBytes; }
+    // bytes ever allocated
+    uint64_t GetTotal() const { return m_total; }
+    uint64_t GetEscapes() const { return m_escapes; }
+private:
+    struct Position
+    {
+        size_t m_page;
+        size_t m_offset;
+        size_t m_large;
+    };
+
+    struct Large
+    {
+        std::unique_ptr<char[]> m_data;
+        size_t m_size;
+    };
+
+    Position Mark() const
+    {
+        return { m_page, m_offset, m_large.size() };
+    }
+
+    void* AllocateLarge(size_t size)
+    {
+        m_large.push_back({ std::make_unique<char[]>(size), size });
+        m_largeBytes += size;
+        return m_large.back().m_data.get();
+    }
+
+    void Rewind(Position to)
+    {
+        while (m_large.size() > to.m_large)
+        {
+            m_largeBytes -= m_large.back().m_size;
+            m_large.pop_back();
+        }
+
+        // freed range is [to, current) across pages
+        for (size_t page = to.m_page; page < m_pages.size() && page <= m_page; ++page)
+        {
+            size_t begin = page == to.m_page ? to.m_offset : 0;
+            size_t end = page == m_page ? m_offset : m_pageSize;
+            if (end > begin)
+            {
+                char* ptr = m_pages[page].get() + begin;
+                if (m_debug)
+                {
+                    std::memset(ptr, POISON, end - begin);
+                }
+                TS_ARENA_POISON(ptr, end - begin);
+            }
+        }
+        m_page = to.m_page;
+        m_offset = to.m_offset;
+    }
+
+    void CheckPoison(char* ptr, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            if (static_cast<unsigned char>(ptr[i]) != POISON)
+            {
+                ++m_escapes;
+                if (m_onEscape)
+                {
+                    m_onEscape(ptr, size);
+                }
+                return;
+            }
+        }
+    }
+
+    void ApplyDebug()
+    {
+        if (m_debug == m_wantDebug)
+        {
+            return;
+        }
+        m_debug = m_wantDebug;
+        if (m_debug)
+        {
+            for (auto& page : m_pages)
+            {
+                TS_ARENA_UNPOISON(page.get(), m_pageSize);
+                std::memset(page.get(), POISON, m_pageSize);
+                TS_ARENA_POISON(page.get(), m_pageSize);
+            }
+        }
+    }
+
+    size_t m_pageSize;
+    std::vector<std::unique_ptr<char[]>> m_pages;
+    // current page and offset into it, m_page == m_pages.size() before the first page
+    size_t m_page = 0;
+    size_t m_offset = 0;
+    std::vector<Large> m_large;
+    size_t m_largeBytes = 0;
+    std::vector<Position> m_marks;
+    uint64_t m_total = 0;
+    uint64_t m_escapes = 0;
+    bool m_debug = false;
+    bool m_wantDebug = false;
+    std::function<void(void*, size_t)> m_onEscape;
+};
+
+/**
+ * Frees everything allocated from `arena` while it is alive.
+ */
+class TSArenaScope
+{
+public:
+    explicit TSArenaScope(TSScopedArena& arena)
+        : m_arena(arena)
+    {
+        m_arena.Enter();
+    }
+
+    ~TSArenaScope()
+    {
+        m_arena.Leave();
+    }
+
+    TSArenaScope(TSArenaScope const&) = delete;
+    TSArenaScope& operator=(TSArenaScope const&) = delete;
+private:
+    TSScopedArena& m_arena;
+};
@@ -0,0 +1,214 @@
+/*
+ * This file is part of tswow (https://github.com/tswow/).
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+// This header does not depend on the core so it can be tested headless.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Line-level reader for version 3 source maps, as written by
+ * TypeScriptToLua next to every generated .lua file.
+ *
+ * Only "sources" and "mappings" are read. Each generated line maps to
+ * the original position of its first segment that has one.
+ */
+class TSSourceMap
+{
+public:
+    /** @returns false if the document has no mappings */
+    bool Parse(std::string const& json)
+    {
+        m_sources.clear();
+        m_lines.clear();
+
+        size_t sources = FindValue(json, "sources");
+        if (sources != std::string::npos && json[sources] == '[')
+        {
+            size_t i = sources + 1;
+            while (i < json.size() && json[i] != ']')
+            {
+                if (json[i] == '"')
+                {
+                    m_sources.push_back(ReadString(json, i));
+                }
+                else
+                {
+                    ++i;
+                }
+            }
+        }
+
+        size_t mappings = FindValue(json, "mappings");
+        if (mappings == std::string::npos || json[mappings] != '"')
+        {
+            return false;
+        }
+        size_t pos = mappings;
+        DecodeMappings(ReadString(json, pos));
+        return true;
+    }
+
+    /**
+     * @param line 1-based line in the generated file
+     * @param originalLine set to the 1-based line in the original file
+     * @returns false if the line has no mapping
+     */
+    bool Lookup(uint32_t line, std::string& source, uint32_t& originalLine) const
+    {
+        if (line == 0 || line > m_lines.size())
+        {
+            return false;
+        }
+        Line const& mapped = m_lines[line - 1];
+        if (mapped.m_source < 0 || size_t(mapped.m_source) >= m_sources.size())
+        {
+            return false;
+        }
+        source = m_sources[mapped.m_source];
+        originalLine = mapped.m_line + 1;
+        return true;
+    }
+
+    size_t GetLineCount() const { return m_lines.size(); }
+    std::vector<std::string> const& GetSources() const { return m_sources; }
+private:
+    struct Line
+    {
+        int32_t m_source = -1;
+        uint32_t m_line = 0;
+    };
+
+    // position of the first character of the value for "key", or npos
+    static size_t FindValue(std::string const& json, char const* key)
+    {
+        std::string quoted = std::string("\"") + key + "\"";
+        size_t pos = json.find(quoted);
+        if (pos == std::string::npos)
+        {
+            return pos;
+        }
+        pos = json.find(':', pos + quoted.size());
+        if (pos == std::string::npos)
+        {
+            return pos;
+        }
+        pos = json.find_first_not_of(" \t\r\n", pos + 1);
+        return pos;
+    }
+
+    // reads the string starting at the quote at `pos`, leaves `pos` after it
+    static std::string ReadString(std::string const& json, size_t& pos)
+    {
+        std::string out;
+        ++pos;
+        while (pos < json.size() && json[pos] != '"')
+        {
+            if (json[pos] == '\\' && pos + 1 < json.size())
+            {
+                ++pos;
+                char c = json[pos];
+                out += c == 'n' ? '\n' : c == 't' ? '\t' : c;
+            }
+            else
+            {
+                out += json[pos];
+            }
+            ++pos;
+        }
+        ++pos;
+        return out;
+    }
+
+    static int32_t Base64(char c)
+    {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+        if (c >= '0' && c <= '9') return c - '0' + 52;
+        if (c == '+') return 62;
+        if (c == '/') return 63;
+        return -1;
+    }
+
+    void DecodeMappings(std::string const& mappings)
+    {
+        // source, line and column are relative to the previous segment
+        // across the whole document, the generated column resets per line
+        int32_t source = 0;
+        int32_t line = 0;
+        int32_t column = 0;
+        m_lines.emplace_back();
+
+        int32_t fields[5];
+        size_t fieldCount = 0;
+        int32_t value = 0;
+        int32_t shift = 0;
+
+        auto endSegment = [&]() {
+            if (fieldCount >= 4)
+            {
+                source += fields[1];
+                line += fields[2];
+                column += fields[3];
+                Line& current = m_lines.back();
+                if (current.m_source < 0)
+                {
+                    current.m_source = source;
+                    current.m_line = uint32_t(line < 0 ? 0 : line);
+                }
+            }
+            fieldCount = 0;
+        };
+
+        for (char c : mappings)
+        {
+            if (c == ',' || c == ';')
+            {
+                endSegment();
+                if (c == ';')
+                {
+                    m_lines.emplace_back();
+                }
+                continue;
+            }
+            int32_t digit = Base64(c);
+            if (digit < 0)
+            {
+                continue;
+            }
+            value += (digit & 31) << shift;
+            if (digit & 32)
+            {
+                shift += 5;
+                continue;
+            }
+            if (fieldCount < 5)
+            {
+                fields[fieldCount++] = (value & 1) ? -(value >> 1) : (value >> 1);
+            }
+            value = 0;
+            shift = 0;
+        }
+        endSegment();
+    }
+
+    std::vector<std::string> m_sources;
+    std::vector<Line> m_lines;
+};
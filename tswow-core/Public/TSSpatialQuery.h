@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "TSMain.h"
+#include "TSLua.h"
+#include "TSWorldObject.h"
+
+#include <memory>
+#include <vector>
+
+class Map;
+class WorldObject;
+
+struct TSSpatialSearch
+{
+    // resolved on the queried map when the query runs
+    uint64 m_source;
+    float m_range;
+    uint16 m_typeMask;
+    uint32 m_entry;
+    uint32 m_hostile;
+    uint32 m_dead;
+};
+
+struct TSSpatialQueryData
+{
+    std::vector<TSSpatialSearch> m_searches;
+    // results of all searches, search i owns [m_offsets[i], m_offsets[i+1])
+    std::vector<WorldObject*> m_results;
+    std::vector<uint32> m_offsets;
+    // game time of the run, results are only read during it
+    uint32 m_tick = 0;
+};
+
+/**
+ * Many range searches that are answered together by TSMap::QueryInRange.
+ *
+ * Every grid cell touched by any search is visited once, and each object in
+ * it is tested against the searches overlapping that cell. Results for all
+ * searches are stored in one buffer, with one span per search.
+ *
+ * Results are only valid until the game time changes (the next world
+ * update), after that every search reads as empty until the query runs
+ * again. Objects that left the world earlier in the same update are
+ * skipped by Get.
+ *
+ * Filters work like GetUnitsInRange/GetCreaturesInRange:
+ * typeMask 0 = any type, entry 0 = any entry,
+ * hostile 0 = both, 1 = hostile, 2 = friendly,
+ * dead 0 = both, 1 = alive, 2 = dead.
+ */
+class TC_GAME_API TSSpatialQuery
+{
+    std::shared_ptr<TSSpatialQueryData> m_data;
+public:
+    TSSpatialQuery();
+    TSSpatialQuery* operator->() { return this; }
+
+    /** @returns the index of the new search */
+    TSNumber<uint32> Add(TSWorldObject source, float range, uint32 typeMask = 0, uint32 entry = 0, uint32 hostile = 0, uint32 dead = 0);
+    /** Removes all searches and results */
+    void Clear();
+
+    TSNumber<uint32> GetSearchCount();
+    TSNumber<uint32> GetCount(uint32 search);
+    TSWorldObject Get(uint32 search, uint32 index);
+
+    // Direct access to the span of a search for C++ callers,
+    // check IsInWorld on the objects like Get does
+    WorldObject* const* Begin(uint32 search);
+    WorldObject* const* End(uint32 search);
+
+    TSSpatialQueryData* GetData() { return m_data.get(); }
+};
+
+TC_GAME_API TSSpatialQuery CreateSpatialQuery();
+TC_GAME_API void RunSpatialQuery(Map* map, TSSpatialQueryData& data);
@@ -151,7 +151,7 @@ private:
     bool m_disabled;
 };
 
-LUA_PTR_TYPE(TSSpell)
+LUA_CACHED_PTR_TYPE(TSSpell)
 LUA_PTR_TYPE(TSSpellModifier)
 LUA_PTR_TYPE(TSSpellDestination)
 LUA_PTR_TYPE(TSSpellImplicitTargetInfo)
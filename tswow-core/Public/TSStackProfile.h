@@ -0,0 +1,126 @@
+/*
+ * This file is part of tswow (https://github.com/tswow/).
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+// This header does not depend on the core so it can be tested headless.
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Aggregates sampled call stacks and writes them in the collapsed
+ * format read by flamegraph.pl, speedscope and similar tools:
+ *
+ *   root;caller;leaf <samples>
+ *
+ * Frames are an interned source name and a line.
+ */
+class TSStackProfile
+{
+public:
+    struct Frame
+    {
+        uint32_t m_source;
+        int32_t m_line;
+
+        bool operator<(Frame const& rhs) const
+        {
+            return m_source != rhs.m_source ? m_source < rhs.m_source : m_line < rhs.m_line;
+        }
+    };
+
+    uint32_t InternSource(char const* source)
+    {
+        auto itr = m_sourceIds.find(source);
+        if (itr != m_sourceIds.end())
+        {
+            return itr->second;
+        }
+        uint32_t id = uint32_t(m_sources.size());
+        m_sources.push_back(source);
+        m_sourceIds[source] = id;
+        return id;
+    }
+
+    /** @param frames leaf first, as a stack is walked */
+    void AddSample(std::vector<Frame> const& frames)
+    {
+        ++m_stacks[frames];
+        ++m_samples;
+    }
+
+    uint64_t GetSampleCount() const { return m_samples; }
+    size_t GetStackCount() const { return m_stacks.size(); }
+    std::string const& GetSource(uint32_t id) const { return m_sources[id]; }
+
+    void Clear()
+    {
+        m_stacks.clear();
+        m_samples = 0;
+        m_sourceIds.clear();
+        m_sources.clear();
+    }
+
+    /**
+     * @param name called once per distinct frame as name(source, line),
+     *             returns the text written for it
+     */
+    template <typename F>
+    void WriteCollapsed(std::ostream& out, F name) const
+    {
+        std::map<Frame, std::string> names;
+        auto frameName = [&](Frame const& frame) -> std::string const& {
+            auto itr = names.find(frame);
+            if (itr == names.end())
+            {
+                std::string text = name(m_sources[frame.m_source], frame.m_line);
+                // ';' separates frames and ' ' the count
+                for (char& c : text)
+                {
+                    if (c == ';' || c == ' ')
+                    {
+                        c = '_';
+                    }
+                }
+                itr = names.emplace(frame, text).first;
+            }
+            return itr->second;
+        };
+
+        for (auto const& [frames, count] : m_stacks)
+        {
+            for (size_t i = frames.size(); i > 0; --i)
+            {
+                out << frameName(frames[i - 1]);
+                if (i > 1)
+                {
+                    out << ';';
+                }
+            }
+            out << ' ' << count << '\n';
+        }
+    }
+private:
+    std::map<std::vector<Frame>, uint64_t> m_stacks;
+    uint64_t m_samples = 0;
+    std::unordered_map<std::string, uint32_t> m_sourceIds;
+    std::vector<std::string> m_sources;
+};
@@ -131,6 +131,7 @@ public:
             }
             else
             {
+                TSArenaScope scope(TSLuaArena());
                 TSLua::handle_error(m_lua_callback(ctx, this));
             }
 
@@ -233,4 +233,4 @@ private:
     friend class TSLua;
 };
 
-LUA_PTR_TYPE(TSUnit)
+LUA_CACHED_PTR_TYPE(TSUnit)
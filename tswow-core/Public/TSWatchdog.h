@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "TSMain.h"
+
+#include <cstdint>
+
+struct lua_State;
+struct TSCallbackStats;
+
+/**
+ * One event callback running on the current thread.
+ * Lives on the stack of the FIRE macros (see TSCallbackTimer).
+ */
+struct TSCallbackFrame
+{
+    TSCallbackStats* m_stats = nullptr;
+    // steady clock, 0 if nothing needed the start time
+    uint64_t m_startNs = 0;
+    // recorded into m_stats when the callback returns
+    bool m_timed = false;
+    // lua instructions executed so far, counted by the budget hook
+    uint64_t m_instructions = 0;
+    // set when the budget hook aborted this callback
+    bool m_overran = false;
+    // lua memory module of the code that was running before this callback
+    uint32_t m_prevLuaModule = 0;
+    TSCallbackFrame* m_prev = nullptr;
+};
+
+TC_GAME_API void TSEnterCallback(TSCallbackFrame* frame);
+TC_GAME_API void TSLeaveCallback(TSCallbackFrame* frame);
+// Whether C++ callbacks need a frame, only for timing or the watchdog
+TC_GAME_API bool TSCallbackFramesEnabled();
+
+/**
+ * Times every callback into its stats for ".tswow perf"
+ * ("TSWoW.CallbackTiming", or ".tswow perf on/off").
+ * Off, callbacks don't read the clock unless the lua budget or
+ * the watchdog need it.
+ */
+TC_GAME_API void SetCallbackTiming(bool enabled);
+TC_GAME_API bool GetCallbackTiming();
+
+/**
+ * Limits how long a single lua event callback may run
+ * ("TSWoW.LuaCallbackBudgetMs" and "TSWoW.LuaCallbackBudgetInstructions", 0 = unlimited).
+ * Callbacks that overrun are aborted with a traceback, and are disabled
+ * after `maxViolations` overruns ("TSWoW.LuaCallbackMaxViolations", 0 = never).
+ * A callback running lua from inside a C++ call (like a function passed
+ * to a binding) is only aborted once it is back in plain lua.
+ */
+TC_GAME_API void SetLuaCallbackBudget(uint32 ms, uint32 instructions, uint32 maxViolations);
+
+/**
+ * Reports which script callbacks are running when the world thread
+ * has not started a new tick for `ms` milliseconds ("TSWoW.WatchdogThresholdMs", 0 = off).
+ */
+TC_GAME_API void SetWatchdogThreshold(uint32 ms);
+// Called at the start of every world tick
+void TSWatchdogHeartbeat();
+
+// Lua instructions between budget checks, 0 if there is no budget
+uint32 TSLuaBudgetInterval();
+// Called from the lua instruction hook every `instructions` instructions,
+// raises a lua error only when no C++ frames would be unwound by it.
+void TSLuaBudgetCheck(lua_State* L, uint32 instructions);
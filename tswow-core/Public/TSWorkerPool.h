@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2020 tswow <https://github.com/tswow/>
+ * Copyright (C) 2010 - 2016 Eluna Lua Engine <http://emudevs.com/>
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+// This header does not depend on the core so it can be benchmarked headless.
+
+#include "TSBitset.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of threads for fork/join work started from a map thread.
+ *
+ * ParallelFor splits a range into chunks that the workers and the
+ * calling thread take turns on, and only returns once every chunk is
+ * done. The caller is therefore blocked for the whole job, so map state
+ * it owns can be read by the workers without extra locking.
+ *
+ * One job runs at a time. Callers that find the pool busy run their
+ * job on their own thread instead of waiting.
+ */
+class TSWorkerPool
+{
+    struct Job
+    {
+        std::function<void(size_t, size_t)> const* m_fn;
+        size_t m_count;
+        size_t m_chunk;
+        size_t m_chunks;
+        std::atomic<size_t> m_next{ 0 };
+        std::atomic<size_t> m_done{ 0 };
+    };
+public:
+    explicit TSWorkerPool(uint32_t threads)
+    {
+        for (uint32_t i = 0; i < threads; ++i)
+        {
+            m_threads.emplace_back([this]() { Work(); });
+        }
+    }
+
+    ~TSWorkerPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (std::thread& thread : m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    TSWorkerPool(TSWorkerPool const&) = delete;
+    TSWorkerPool& operator=(TSWorkerPool const&) = delete;
+
+    uint32_t GetThreadCount() const { return uint32_t(m_threads.size()); }
+
+    void ParallelFor(size_t count, size_t chunk, std::function<void(size_t, size_t)> const& fn)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        chunk = std::max<size_t>(chunk, 1);
+        std::unique_lock<std::mutex> jobLock(m_jobMutex, std::try_to_lock);
+        if (m_threads.empty() || count <= chunk || !jobLock)
+        {
+            fn(0, count);
+            return;
+        }
+
+        Job job;
+        job.m_fn = &fn;
+        job.m_count = count;
+        job.m_chunk = chunk;
+        job.m_chunks = (count + chunk - 1) / chunk;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_job = &job;
+            ++m_generation;
+        }
+        m_wake.notify_all();
+
+        Run(job);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_finished.wait(lock, [&]() {
+            return job.m_done == job.m_chunks && m_active == 0;
+        });
+        m_job = nullptr;
+    }
+private:
+    static void Run(Job& job)
+    {
+        size_t index;
+        while ((index = job.m_next++) < job.m_chunks)
+        {
+            size_t begin = index * job.m_chunk;
+            (*job.m_fn)(begin, std::min(begin + job.m_chunk, job.m_count));
+            ++job.m_done;
+        }
+    }
+
+    void Work()
+    {
+        uint64_t seen = 0;
+        while (true)
+        {
+            Job* job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [&]() { return m_stop || m_generation != seen; });
+                if (m_stop)
+                {
+                    return;
+                }
+                seen = m_generation;
+                job = m_job;
+                if (!job)
+                {
+                    continue;
+                }
+                ++m_active;
+            }
+
+            Run(*job);
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                --m_active;
+            }
+            m_finished.notify_all();
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_jobMutex;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_finished;
+    Job* m_job = nullptr;
+    uint64_t m_generation = 0;
+    uint32_t m_active = 0;
+    bool m_stop = false;
+};
+
+/**
+ * Evaluates predicate(i) for every i in [0, count) on the pool.
+ * Chunks are whole 64 bit words so no two threads write the same word.
+ */
+template <typename F>
+TSBitset ParallelBitset(TSWorkerPool& pool, uint32_t count, F const& predicate, size_t chunkWords = 2)
+{
+    TSBitset bits(count);
+    std::vector<uint64_t>& words = bits.GetWords();
+    pool.ParallelFor(words.size(), chunkWords, [&](size_t begin, size_t end) {
+        for (size_t word = begin; word < end; ++word)
+        {
+            uint64_t value = 0;
+            uint32_t first = uint32_t(word * 64);
+            uint32_t last = std::min<uint32_t>(first + 64, count);
+            for (uint32_t i = first; i < last; ++i)
+            {
+                if (predicate(i))
+                {
+                    value |= uint64_t(1) << (i - first);
+                }
+            }
+            words[word] = value;
+        }
+    });
+    return bits;
+}
@@ -92,11 +92,21 @@ public:
         return m_entity->m_groups.GetGroup(key);
     }
 
+    TSWorldObjectGroup * GetEntityGroup(uint32 key)
+    {
+        return m_entity->m_groups.GetGroup(key);
+    }
+
     void RemoveEntityGroup(std::string const& key)
     {
         m_entity->m_groups.RemoveGroup(key);
     }
 
+    void RemoveEntityGroup(uint32 key)
+    {
+        m_entity->m_groups.RemoveGroup(key);
+    }
+
     void ClearEntityGroup()
     {
         m_entity->m_groups.ClearGroups();
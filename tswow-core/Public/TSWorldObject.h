@@ -25,6 +25,7 @@
 #include "TSWorldEntity.h"
 #include "TSItem.h"
 #include "TSLua.h"
+#include "TSCollisionGrid.h"
 #include <chrono>
 #include <vector>
 #include <list>
@@ -58,6 +59,12 @@ public:
     TSArray<TSPlayer> GetPlayersInRange(float range, uint32 hostile, uint32 dead);
     TSArray<TSUnit> GetUnitsInRange(float range, uint32 hostile, uint32 dead);
     TSArray<TSGameObject> GetGameObjectsInRange(float range, uint32 entry, uint32 hostile);
+    uint32 ForEachCreatureInRange(float range, uint32 entry, uint32 hostile, uint32 dead, std::function<bool(TSCreature)> callback, uint32 limit = 0);
+    uint32 ForEachPlayerInRange(float range, uint32 hostile, uint32 dead, std::function<bool(TSPlayer)> callback, uint32 limit = 0);
+    uint32 ForEachUnitInRange(float range, uint32 hostile, uint32 dead, std::function<bool(TSUnit)> callback, uint32 limit = 0);
+    uint32 ForEachGameObjectInRange(float range, uint32 entry, uint32 hostile, std::function<bool(TSGameObject)> callback, uint32 limit = 0);
+    void SetQueryCache(bool enabled);
+    bool HasQueryCache();
 
     TSPlayer GetNearestPlayer(float range = 533.33333, uint32 hostile = 0, uint32 dead = 1);
     TSGameObject GetNearestGameObject(float range = 533.33333, uint32 entry = 0, uint32 hostile = 0);
@@ -175,6 +182,12 @@ private:
     TSLua::Array<TSUnit> LGetUnitsInRange(float range, uint32 hostile, uint32 dead);
     TSLua::Array<TSGameObject> LGetGameObjectsInRange(float range, uint32 entry, uint32 hostile);
     TSLua::Array<TSPlayer> LGetPlayersInRange(float range, uint32 hostile, uint32 dead);
+    TSLua::Iterator<TSUnit> LIterateUnitsInRange(float range, uint32 hostile, uint32 dead);
+    TSLua::Iterator<TSPlayer> LIteratePlayersInRange(float range, uint32 hostile, uint32 dead);
+    uint32 LForEachCreatureInRange(float range, uint32 entry, uint32 hostile, uint32 dead, sol::protected_function callback, uint32 limit);
+    uint32 LForEachUnitInRange(float range, uint32 hostile, uint32 dead, sol::protected_function callback, uint32 limit);
+    uint32 LForEachPlayerInRange(float range, uint32 hostile, uint32 dead, sol::protected_function callback, uint32 limit);
+    uint32 LForEachGameObjectInRange(float range, uint32 entry, uint32 hostile, sol::protected_function callback, uint32 limit);
 
     TSGameObject LGetGameObject0(TSGUID guid);
     TSGameObject LGetGameObject1(TSNumber<uint32> lowGuid);
@@ -196,6 +209,11 @@ public:
     float range;
     uint64_t minDelay;
     uint64_t lastHit = 0;
+    // units not in range for this many ms are removed from the hitmap (0 = never)
+    uint64_t hitExpiry = 0;
+    // max units in the hitmap, the least recently in range are removed first (0 = unlimited)
+    uint32_t maxTrackedHits = 1024;
+    TSCollisionHitTracker hitTracker;
 
     TSCollisionEntry(std::string const& name, float range, uint32_t minDelay,uint32_t maxHits, CollisionCallback callback);
     bool Tick(TSWorldObject value, bool force = true);
@@ -227,6 +245,10 @@ class TC_GAME_API TSWorldObjectCollection
     TSWorldObject get(uint32 index);
 };
 
+TC_GAME_API TSNumber<uint64> GetQueryCacheHits();
+TC_GAME_API TSNumber<uint64> GetQueryCacheMisses();
+TC_GAME_API void ResetQueryCacheStats();
+
 #define BROADCAST_PHASE_ID 0xffffff
 
-LUA_PTR_TYPE(TSWorldObject)
+LUA_CACHED_PTR_TYPE(TSWorldObject)
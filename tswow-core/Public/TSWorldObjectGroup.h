@@ -1,35 +1,81 @@
 #pragma once
 
 #include "TSMain.h"
+#include "TSDenseHandleSet.h"
 
-#include <map>
-#include <set>
+#include <unordered_map>
 #include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
 
 class TSWorldObject;
+class WorldObject;
+
+/**
+ * Group members are stored densely by guid. The core calls
+ * RemovedByObject for every group an object is in when it is destroyed,
+ * and members may be added/removed from inside forEach/filterInPlace
+ * and for..of loops.
+ */
 class TC_GAME_API TSWorldObjectGroup {
-    std::set<TSWorldObject> entries;
+    TSDenseHandleSet<WorldObject*> entries;
 public:
+    // begin() holds off compaction until its last copy is gone,
+    // so members removed inside a for..of loop don't move others
+    class iterator {
+        TSWorldObjectGroup* m_group;
+        size_t m_slot;
+        std::shared_ptr<TSDenseHandleSet<WorldObject*>::IterationGuard> m_guard;
+        void Skip();
+        size_t Position() const;
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = TSWorldObject;
+        using difference_type = std::ptrdiff_t;
+        using pointer = TSWorldObject*;
+        using reference = TSWorldObject;
+
+        iterator(TSWorldObjectGroup* group, size_t slot, bool guard);
+        TSWorldObject operator*() const;
+        iterator& operator++();
+        iterator operator++(int);
+        bool operator==(iterator const& rhs) const;
+        bool operator!=(iterator const& rhs) const;
+    };
+
+    TSWorldObjectGroup() = default;
+    TSWorldObjectGroup(TSWorldObjectGroup const&) = delete;
+    TSWorldObjectGroup& operator=(TSWorldObjectGroup const&) = delete;
     ~TSWorldObjectGroup();
     TSWorldObjectGroup* operator->() { return this; }
 
     void Add(TSWorldObject obj);
     void Remove(TSWorldObject obj);
     void RemovedByObject(TSWorldObject obj);
+    bool Contains(TSWorldObject obj);
     void Clear();
 
-    std::set<TSWorldObject>::iterator begin();
-    std::set<TSWorldObject>::iterator end();
+    iterator begin();
+    iterator end();
     TSNumber<uint32> get_length();
 
     void forEach(std::function<void(TSWorldObject)> callback);
     void filterInPlace(std::function<bool(TSWorldObject)> callback);
 };
 
+/**
+ * Returns the interned id of a group name. Ids are shared by all
+ * entities and stay the same until the server restarts.
+ */
+TC_GAME_API TSNumber<uint32> GetObjectGroupKey(std::string const& name);
+
 class TC_GAME_API TSWorldObjectGroups {
-    std::map<std::string, TSWorldObjectGroup> groups;
+    std::unordered_map<uint32, TSWorldObjectGroup> groups;
 public:
     TSWorldObjectGroup* GetGroup(std::string const& key);
+    TSWorldObjectGroup* GetGroup(uint32 key);
     void RemoveGroup(std::string const& key);
+    void RemoveGroup(uint32 key);
     void ClearGroups();
-};
\ No newline at end of file
+};
@@ -21,6 +21,8 @@
 #include "TSLua.h"
 #include "TSArray.h"
 
+#include <cstring>
+
 class TC_GAME_API TSWorldPacket {
 public:
     WorldPacket *packet;
@@ -111,6 +113,82 @@ public:
     size_t Tell() const;
 };
 
+/**
+ * Read-only view of a WorldPacket passed to OnReceiveView/OnSendView.
+ *
+ * Reads go straight to the packet buffer and never move the packet's own
+ * read position. Out of range reads return 0 (or an empty string).
+ * Only valid for the duration of the callback.
+ */
+class TC_GAME_API TSWorldPacketView {
+    uint8 const* m_data;
+    uint32 m_size;
+    uint32 m_pos = 0;
+    uint16 m_opcode;
+
+    template <typename T>
+    T Read(uint32 index)
+    {
+        T value = T();
+        if (uint64(index) + sizeof(T) <= m_size)
+        {
+            memcpy(&value, m_data + index, sizeof(T));
+        }
+        return value;
+    }
+
+    template <typename T>
+    T Read()
+    {
+        T value = Read<T>(m_pos);
+        m_pos += sizeof(T);
+        return value;
+    }
+public:
+    TSWorldPacketView(WorldPacket const* packet);
+    TSWorldPacketView* operator->() { return this;}
+    operator bool() const { return m_data != nullptr; }
+    bool operator==(TSWorldPacketView const& rhs) { return m_data == rhs.m_data; }
+
+    TSNumber<uint16> GetOpcode() { return m_opcode; }
+    TSNumber<uint32> GetSize() { return m_size; }
+
+    TSNumber<int8> ReadInt8(uint32 index) { return Read<int8>(index); }
+    TSNumber<int8> ReadInt8() { return Read<int8>(); }
+    TSNumber<uint8> ReadUInt8(uint32 index) { return Read<uint8>(index); }
+    TSNumber<uint8> ReadUInt8() { return Read<uint8>(); }
+    TSNumber<int16> ReadInt16(uint32 index) { return Read<int16>(index); }
+    TSNumber<int16> ReadInt16() { return Read<int16>(); }
+    TSNumber<uint16> ReadUInt16(uint32 index) { return Read<uint16>(index); }
+    TSNumber<uint16> ReadUInt16() { return Read<uint16>(); }
+    TSNumber<int32> ReadInt32(uint32 index) { return Read<int32>(index); }
+    TSNumber<int32> ReadInt32() { return Read<int32>(); }
+    TSNumber<uint32> ReadUInt32(uint32 index) { return Read<uint32>(index); }
+    TSNumber<uint32> ReadUInt32() { return Read<uint32>(); }
+    TSNumber<int64> ReadInt64(uint32 index) { return Read<int64>(index); }
+    TSNumber<int64> ReadInt64() { return Read<int64>(); }
+    TSNumber<uint64> ReadUInt64(uint32 index) { return Read<uint64>(index); }
+    TSNumber<uint64> ReadUInt64() { return Read<uint64>(); }
+    TSNumber<float> ReadFloat(uint32 index) { return Read<float>(index); }
+    TSNumber<float> ReadFloat() { return Read<float>(); }
+    TSNumber<double> ReadDouble(uint32 index) { return Read<double>(index); }
+    TSNumber<double> ReadDouble() { return Read<double>(); }
+
+    std::string ReadString(uint32 index);
+    std::string ReadString();
+
+    void Seek(uint32 ofs) { m_pos = ofs; }
+    TSNumber<uint32> Tell() const { return m_pos; }
+};
+
+// Whether OnReceive/OnSend or their view events listen to an opcode
+TC_GAME_API bool HasWorldPacketListeners(uint16 opcode, bool send);
+// Fire OnReceiveView/OnSendView (and capture received packets) from the
+// ServerScript packet hooks. OnReceive/OnSend are still fired by the core.
+// Views are only created if the opcode has listeners and never copy the packet.
+TC_GAME_API void FireWorldPacketReceive(WorldPacket* packet, Player* player);
+TC_GAME_API void FireWorldPacketSend(WorldPacket* packet, Player* player);
+
 namespace WorldPackets {
     namespace WorldState {
         class InitWorldStates;
@@ -133,5 +211,6 @@ public:
 
 #define CreateWorldPacket TSWorldPacket
 
+LUA_PTR_TYPE(TSWorldPacketView)
 //LUA_PTR_TYPE(TSWorldPacket)
 //LUA_PTR_TYPE(TSWorldStatePacket)
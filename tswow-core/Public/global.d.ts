@@ -196,6 +196,10 @@ declare const enum VMapModelIgnoreFlags { } /** ModelIgnoreFlags.h:ModelIgnoreFl
 
 declare const enum Opcodes { } /** Opcodes.h:Opcodes */
 
+/**
+ * Only valid during the event it was passed to,
+ * in lua the same object is reused by later events.
+ */
 declare interface TSMutable<T,R> {
     constructor(field: R);
     get() : R;
@@ -271,6 +275,80 @@ declare class TSPosition {
 }
 declare function CreatePosition(map: uint32, x: float, y: float, z: float, o: float): TSPosition
 
+/**
+ * Many range searches answered together by TSMap.QueryInRange,
+ * with the results of every search stored in one buffer.
+ *
+ * Results are only kept until the next world update,
+ * after that every search is empty until the query runs again.
+ */
+declare interface TSSpatialQuery {
+    /**
+     * @param typeMask 0 = any type
+     * @param entry 0 = any entry
+     * @param hostile 0 = both, 1 = hostile, 2 = friendly
+     * @param dead 0 = both, 1 = alive, 2 = dead
+     * @returns index of the new search
+     */
+    Add(source: TSWorldObject, range: float, typeMask?: uint32, entry?: uint32, hostile?: uint32, dead?: uint32): TSNumber<uint32>
+    /** Removes all searches and results */
+    Clear(): void
+    GetSearchCount(): TSNumber<uint32>
+    GetCount(search: uint32): TSNumber<uint32>
+    Get(search: uint32, index: uint32): TSWorldObject
+}
+declare function CreateSpatialQuery(): TSSpatialQuery
+
+/** Returns the interned id of an entity group name, see TSWorldEntityProvider.GetEntityGroup */
+declare function GetObjectGroupKey(name: string): TSNumber<uint32>
+
+/** Get*InRange calls answered from a query cache, see TSWorldObject.SetQueryCache */
+declare function GetQueryCacheHits(): TSNumber<uint64>
+/** Get*InRange calls on objects with a query cache that had to search the grid */
+declare function GetQueryCacheMisses(): TSNumber<uint64>
+declare function ResetQueryCacheStats(): void
+
+declare interface TSLineOfSightBatch {
+    /** @returns index of the ray */
+    Add(x1: float, y1: float, z1: float, x2: float, y2: float, z2: float): TSNumber<uint32>
+    /**
+     * Adds a ray between the same points TSWorldObject.IsWithinLoS would use.
+     * Objects on different maps are never in line of sight.
+     * @returns index of the ray
+     */
+    AddObjects(from: TSWorldObject, to: TSWorldObject): TSNumber<uint32>
+    Clear(): void
+    GetSize(): TSNumber<uint32>
+}
+declare function CreateLineOfSightBatch(): TSLineOfSightBatch
+
+declare interface TSBitset {
+    Get(index: uint32): bool
+    Set(index: uint32, value: bool): void
+    GetSize(): uint32
+    /** Number of set bits */
+    Count(): uint32
+}
+
+/**
+ * Runs a callback on the thread updating a map, at the start of its next update.
+ * Safe to call from any map or the world thread.
+ * @returns false if the map is not loaded
+ */
+declare function PostToMap(mapId: uint32, instanceId: uint32, callback: (map: TSMap)=>void): bool
+/** Runs a callback on the world thread after the next map updates */
+declare function PostToWorld(callback: (ctx: TSMainThreadContext)=>void): void
+/**
+ * Sends a message to the OnMapMessage handlers of another map.
+ * The data is copied, changing it afterwards does not affect the message.
+ * @returns false if the map is not loaded
+ */
+declare function PostMapMessage(mapId: uint32, instanceId: uint32, type: uint32, data: TSJsonObject): bool
+/** Handles messages sent to any map with PostMapMessage */
+declare function OnMapMessage(type: uint32, callback: (map: TSMap, data: TSJsonObject)=>void): void
+/** Messages posted to a map that it has not handled yet */
+declare function GetMapMailboxSize(mapId: uint32, instanceId: uint32): TSNumber<uint32>
+
 interface Array<T> {
     get(index: number): T;
     set(index: number, value: T);
@@ -2444,13 +2522,21 @@ declare interface TSWorldEntityProvider<T> {
 
     RemoveTimer(name: string);
     GetEntityGroup(name: string): TSObjectGroup;
+    /** @param key from GetObjectGroupKey, avoids hashing the name on every call */
+    GetEntityGroup(key: uint32): TSObjectGroup;
     RemoveEntityGroup(name: string);
+    RemoveEntityGroup(key: uint32);
     ClearEntityGroups(name: string);
 }
 
+/**
+ * Members are removed automatically when they leave the world,
+ * and may be added/removed while the group is being iterated.
+ */
 declare class TSObjectGroup {
     Add(obj: TSWorldObject): void;
     Remove(obj: TSWorldObject): void;
+    Contains(obj: TSWorldObject): bool;
     Clear();
     get length(): TSNumber<uint32>
     forEach(callback: (obj: TSWorldObject)=>void): void;
@@ -3670,6 +3756,15 @@ declare interface TSGroup {
      */
     GetMembers() : TSArray<TSPlayer>
 
+    /**
+     * Iterates the [Player]s in this [Group] without building a table,
+     * e.g. `for player in group:IterateMembers() do`. The iterator ends once
+     * the callback it was created in returns.
+     *
+     * @lua_only - This method is not available in livescripts.
+     */
+    IterateMembers() : () => TSPlayer | undefined
+
     /**
      * Returns [Group] leader GUID
      *
@@ -3865,6 +3960,31 @@ declare class TSWorldPacket {
     Tell(): uint64
 }
 
+/**
+ * Read-only view of a world packet, see WorldPacket.OnReceiveView/OnSendView.
+ * Reads never move the packet's own read position,
+ * out of range reads return 0.
+ */
+declare class TSWorldPacketView {
+    GetOpcode(): TSNumber<uint16>
+    GetSize(): TSNumber<uint32>
+
+    ReadInt8(index?: uint32): TSNumber<int8>
+    ReadUInt8(index?: uint32): TSNumber<uint8>
+    ReadInt16(index?: uint32): TSNumber<int16>
+    ReadUInt16(index?: uint32): TSNumber<uint16>
+    ReadInt32(index?: uint32): TSNumber<int32>
+    ReadUInt32(index?: uint32): TSNumber<uint32>
+    ReadInt64(index?: uint32): TSNumber<int64>
+    ReadUInt64(index?: uint32): TSNumber<uint64>
+    ReadFloat(index?: uint32): TSNumber<float>
+    ReadDouble(index?: uint32): TSNumber<double>
+    ReadString(index?: uint32): string
+
+    Seek(offset: uint32): void
+    Tell(): TSNumber<uint32>
+}
+
 declare interface TSWorldStatePacket {
     push(worldstate: uint32, value: int32): void
     length(): TSNumber<uint32>
@@ -4010,6 +4130,10 @@ declare interface TSMap extends TSEntityProvider, TSWorldEntityProvider<TSMap> {
     HasInstanceScript(): bool
     GetInstanceScript(): TSInstance | undefined
     GetUnits(): TSArray<TSWorldObject>
+    /**
+     * Runs `callback` on the world thread after the current map updates.
+     * Skipped if the map unloads first.
+     */
     DoDelayed(callback: (map: TSMap, mgr: TSMainThreadContext)=>void): void;
     /**
      * @param entry only return gameobjects of this entry.
@@ -4064,6 +4188,18 @@ declare interface TSMap extends TSEntityProvider, TSWorldEntityProvider<TSMap> {
      */
     IsInLineOfSight(x1: double, y1: double, z1: double, x2: double, y2: double, z2: double, phasemask: uint32, checks: LineOfSightChecks, ignoreFlags: VMapModelIgnoreFlags )
 
+    /**
+     * Answers all searches in a spatial query together,
+     * visiting each grid cell at most once.
+     */
+    QueryInRange(query: TSSpatialQuery): void
+
+    /**
+     * Checks many rays at once on the worker threads ("TSWoW.WorkerThreads").
+     * @returns a bitset where bit i is set if ray i is in line of sight
+     */
+    IsInLineOfSightBatch(batch: TSLineOfSightBatch, phasemask: uint32, checks: LineOfSightChecks, ignoreFlags: VMapModelIgnoreFlags): TSBitset
+
     /**
      * Returns `true` if the [Map] is an arena [BattleGround], `false` otherwise.
      *
@@ -4183,6 +4319,15 @@ declare interface TSMap extends TSEntityProvider, TSWorldEntityProvider<TSMap> {
     */
     GetPlayers(team? : TeamId) : TSArray<TSPlayer>
 
+    /**
+     * Like GetPlayers, but returns a lua iterator instead of a table:
+     * `for player in map:IteratePlayers() do`. Only valid during the callback
+     * it was created in.
+     *
+     * @lua_only - This method is not available in livescripts.
+     */
+    IteratePlayers(team? : TeamId) : () => TSPlayer | undefined
+
     /**
      * Returns the area ID of the [Map] at the specified X, Y, and Z coordinates.
      *
@@ -4769,6 +4914,14 @@ declare interface TSBattleground extends TSMap {
     GetScore(guid: TSNumber<uint32> | TSGUID): TSBattlegroundScore | undefined
     GetBGPlayer(guid: TSNumber<uint32> | TSGUID): TSBattlegroundPlayer | undefined
     GetBGPlayers(): TSArray<TSBattlegroundPlayer>;
+
+    /**
+     * Lua iterator over the same players as GetBGPlayers, valid until
+     * the current callback returns.
+     *
+     * @lua_only - This method is not available in livescripts.
+     */
+    IterateBGPlayers(): () => TSBattlegroundPlayer | undefined;
     SetStartPosition(teamId: uint32, x: float, y: float, z: float, o: float): void;
     GetStartX(teamid: TeamId): TSNumber<float>
     GetStartY(teamid: TeamId): TSNumber<float>
@@ -5306,6 +5459,10 @@ declare interface TSCollisionEntry {
     range: float;
     minDelay: TSNumber<uint64>
     hitmap: TSDictionary<uint64,uint32>
+    /** Units that have not been in range for this many milliseconds are removed from the hitmap (0 = never) */
+    hitExpiry: TSNumber<uint64>
+    /** Max units kept in the hitmap, the least recently in range are removed first (0 = unlimited, default 1024) */
+    maxTrackedHits: uint32
     Tick(value: TSWorldObject, force?: boolean)
 }
 
@@ -5323,8 +5480,44 @@ declare interface TSWorldObject extends TSObject, TSWorldEntityProvider<TSWorldO
     GetCreaturesInRange(range : float,entry : uint32,hostile : uint32,dead : uint32) : TSArray<TSCreature>
     GetUnitsInRange(range : float,hostile : uint32,dead : uint32) : TSArray<TSUnit>
     GetPlayersInRange(range : float,hostile : uint32,dead : uint32) : TSArray<TSPlayer>
+
+    /**
+     * Lua iterator version of GetUnitsInRange, valid until the current callback returns.
+     *
+     * @lua_only - This method is not available in livescripts.
+     */
+    IterateUnitsInRange(range : float,hostile : uint32,dead : uint32) : () => TSUnit | undefined
+
+    /**
+     * Lua iterator version of GetPlayersInRange.
+     *
+     * @lua_only - This method is not available in livescripts.
+     */
+    IteratePlayersInRange(range : float,hostile : uint32,dead : uint32) : () => TSPlayer | undefined
+
     GetGameObjectsInRange(range : float,entry : uint32,hostile : uint32) : TSArray<TSGameObject>
 
+    /**
+     * Calls `callback` for every matching object in range without building an array.
+     * Returning false from the callback stops early. Callbacks run after the
+     * search, so they may spawn or despawn objects; objects that despawn
+     * before their turn are skipped.
+     * @param limit maximum number of objects to visit, 0 for no limit
+     * @returns number of objects visited
+     */
+    ForEachCreatureInRange(range: float, entry: uint32, hostile: uint32, dead: uint32, callback: (creature: TSCreature)=>boolean, limit?: uint32): uint32
+    ForEachUnitInRange(range: float, hostile: uint32, dead: uint32, callback: (unit: TSUnit)=>boolean, limit?: uint32): uint32
+    ForEachPlayerInRange(range: float, hostile: uint32, dead: uint32, callback: (player: TSPlayer)=>boolean, limit?: uint32): uint32
+    ForEachGameObjectInRange(range: float, entry: uint32, hostile: uint32, callback: (go: TSGameObject)=>boolean, limit?: uint32): uint32
+
+    /**
+     * Caches the results of Get*InRange on this object until the next map update,
+     * so repeated calls with the same range and filters skip the grid search.
+     * Off by default.
+     */
+    SetQueryCache(enabled: bool): void
+    HasQueryCache(): bool
+
     IsBehind(obj: TSWorldObject): bool
 
     IsOutdoors(): bool
@@ -5339,6 +5532,10 @@ declare interface TSWorldObject extends TSObject, TSWorldEntityProvider<TSWorldO
     IsFriendlyToPlayers(): bool
     IsHostileToPlayers(): bool
     IsNeutralToAll(): bool
+    /**
+     * Runs `callback` on the world thread after the current map updates.
+     * Skipped if the object leaves its map first.
+     */
     DoDelayed(callback: (obj: TSWorldObject, mgr: TSMainThreadContext)=>void): void
 
     /**
@@ -9066,6 +9263,23 @@ declare namespace _hidden {
             , player: TSPlayer
             ) => void
         )
+
+        /**
+         * Called when a player sends an opcode faster than its rate limit,
+         * the packet is dropped unless "drop" is set to false.
+         */
+        OnRateLimited(callback: (
+              opcode: TSNumber<uint32>
+            , player: TSPlayer
+            , drop: TSMutable<boolean,boolean>
+            ) => void
+        )
+        OnRateLimited(id: EventID, callback: (
+              opcode: TSNumber<uint32>
+            , player: TSPlayer
+            , drop: TSMutable<boolean,boolean>
+            ) => void
+        )
     }
 
     export class WorldPacket {
@@ -9074,6 +9288,16 @@ declare namespace _hidden {
 
         OnSend(callback: (packet: TSWorldPacket, player: TSPlayer)=>void);
         OnSend(id: EventID, callback: (packet: TSWorldPacket, player: TSPlayer)=>void);
+
+        /**
+         * Read-only and much cheaper than OnReceive,
+         * register by opcode so other packets are not affected.
+         */
+        OnReceiveView(callback: (opcode: TSNumber<uint32>, packet: TSWorldPacketView, player: TSPlayer)=>void);
+        OnReceiveView(id: EventID, callback: (opcode: TSNumber<uint32>, packet: TSWorldPacketView, player: TSPlayer)=>void);
+
+        OnSendView(callback: (packet: TSWorldPacketView, player: TSPlayer)=>void);
+        OnSendView(id: EventID, callback: (packet: TSWorldPacketView, player: TSPlayer)=>void);
     }
 
     export class GameEvent<T> {
@@ -9472,6 +9696,14 @@ declare interface TSAuctionEntry {
 
 declare interface TSAuctionHouseObject {
     GetKeys() : TSArray<uint32>
+
+    /**
+     * Lua iterator version of GetKeys, valid until the current callback returns.
+     *
+     * @lua_only - This method is not available in livescripts.
+     */
+    IterateKeys() : () => TSNumber<uint32> | undefined
+
     GetEntry(key: uint32): TSAuctionEntry
     RemoveAuction(key: uint32|TSAuctionEntry): bool
     GetCount(): TSNumber<uint32>
@@ -9655,6 +9887,68 @@ declare interface TSDBJsonProvider {
     ClearDBJson(): void;
 }
 
+/**
+ * Parses json text into lua values. Objects and arrays become tables,
+ * null becomes undefined.
+ * @lua_only - This function is not available in livescripts.
+ * @returns the value, or undefined and the error as a second return value
+ */
+declare function JsonDecode(text: string): any
+/**
+ * Writes a lua value as json text. Tables with the keys 1..n become arrays,
+ * functions, userdata and threads are skipped.
+ * @lua_only - This function is not available in livescripts.
+ * @returns the json text, or undefined and the error as a second return value
+ */
+declare function JsonEncode(value: any): string
+
+/**
+ * Runs `fn(...args)` as an async task, a coroutine that can call the
+ * Sleep/Await functions below. Waiting tasks never keep entities alive,
+ * so check objects held in locals again after each wait.
+ * @lua_only - This function is not available in livescripts.
+ */
+declare function Async<T extends any[]>(fn: (...args: T) => void, ...args: T): void
+/**
+ * Resumes the current task on the world thread after `ms` milliseconds.
+ * If `owner` is destroyed or leaves the world meanwhile, the task ends instead.
+ * @lua_only - This function is not available in livescripts.
+ */
+declare function Sleep(ms: uint32, owner?: TSWorldObject): void
+/**
+ * Resumes the current task on the world thread.
+ * @lua_only - This function is not available in livescripts.
+ */
+declare function AwaitWorld(): TSMainThreadContext
+/**
+ * Resumes the current task where the map can be used: on the thread
+ * updating it, or on the world thread between map updates.
+ * @lua_only - This function is not available in livescripts.
+ * @returns the map, or undefined without waiting if it is not loaded
+ */
+declare function AwaitMap(mapId: uint32, instanceId?: uint32): TSMap | undefined
+/**
+ * Runs `sql` on the database workers and resumes the current task on the
+ * world thread with its result.
+ * @lua_only - This function is not available in livescripts.
+ */
+declare function AwaitQueryWorld(sql: string): TSDatabaseResult
+/**
+ * Same as AwaitQueryWorld, for the characters database.
+ * @lua_only - This function is not available in livescripts.
+ */
+declare function AwaitQueryCharacters(sql: string): TSDatabaseResult
+/**
+ * Same as AwaitQueryWorld, for the auth database.
+ * @lua_only - This function is not available in livescripts.
+ */
+declare function AwaitQueryAuth(sql: string): TSDatabaseResult
+/**
+ * @lua_only - This function is not available in livescripts.
+ * @returns the number of async tasks that have not finished yet
+ */
+declare function GetAsyncTaskCount(): TSNumber<uint32>
+
 // Global.h
 declare function GetCurrTime(): TSNumber<uint32>
 declare function GetUnixTime(): TSNumber<uint64>
@@ -9665,7 +9959,12 @@ declare function IsHolidayActive(holiday: uint16): boolean
 declare function GetActiveGameEvents(): TSArray<uint16>
 declare function StartGameEvent(event_id: uint16): void
 declare function StopGameEvent(event_id: uint16): void
+/**
+ * Bytes of lua temporaries currently alive on this thread,
+ * they are freed when the running callback returns.
+ */
 declare function GetLuaGarbageCur(): TSNumber<uint64>
+/** Bytes of lua temporaries ever made on this thread */
 declare function GetLuaGarbageTotal(): TSNumber<uint64>
 
 /**
@@ -9896,6 +10195,11 @@ declare function QueryWorldAsync(query: string): void;
 declare function QueryCharactersAsync(query: string): void;
 declare function QueryAuthAsync(query: string): void;
 
+/** callback runs on the world thread once the result is ready */
+declare function QueryWorldAsync(query: string, callback: (result: TSDatabaseResult) => void): void;
+declare function QueryCharactersAsync(query: string, callback: (result: TSDatabaseResult) => void): void;
+declare function QueryAuthAsync(query: string, callback: (result: TSDatabaseResult) => void): void;
+
 declare function PrepareWorldQuery(query: string): TSPreparedStatementWorld
 declare function PrepareCharactersQuery(query: string): TSPreparedStatementCharacters
 declare function PrepareAuthQuery(query: string): TSPreparedStatementAuth
@@ -10058,6 +10362,41 @@ declare function MsgStringArray(arrSize: number, stringSize: number): (field: an
 
 declare function CreateCustomPacket(opcode: uint32, size: uint32): TSPacketWrite;
 
+/**
+ * Limits how often players may send an opcode to "rate" packets per second,
+ * with bursts of up to "burst" packets. A rate of 0 removes the limit.
+ */
+declare function SetCustomPacketRateLimit(opcode: uint32, rate: float, burst: float): void;
+
+/**
+ * Drops incoming messages with this opcode that are smaller than "minSize"
+ * or larger than "maxSize" bytes before they reach any listener.
+ * A maxSize of 0 removes the limit.
+ */
+declare function SetCustomPacketSchema(opcode: uint32, minSize: uint32, maxSize: uint32): void;
+
+/**
+ * Numbered fields mirrored to clients. Only changed fields are sent,
+ * every "TSWoW.ReplicatedStateInterval" milliseconds.
+ *
+ * Read on the client with GetReplicatedState(channel, owner)/OnReplicatedState(channel, cb),
+ * a channel can have both a player state and a map state. Players leaving
+ * a map have their copy of its states cleared.
+ */
+declare class TSReplicatedState {
+    SetNumber(field: uint32, value: double): TSReplicatedState;
+    SetString(field: uint32, value: string): TSReplicatedState;
+    Remove(field: uint32): TSReplicatedState;
+    Has(field: uint32): bool;
+    GetNumber(field: uint32, def?: double): TSNumber<double>;
+    GetString(field: uint32, def?: string): string;
+}
+
+/** State only replicated to this player */
+declare function GetPlayerState(player: TSPlayer, channel: uint32): TSReplicatedState;
+/** State replicated to every player on this map */
+declare function GetMapState(map: TSMap, channel: uint32): TSReplicatedState;
+
 // Null values
 declare function NULL_UNIT(): TSUnit | undefined;
 declare function NULL_PLAYER(): TSPlayer | undefined;
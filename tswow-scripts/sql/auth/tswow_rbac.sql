@@ -3,9 +3,23 @@ INSERT INTO `rbac_permissions` VALUES(17688,"Command: at");
 INSERT INTO `rbac_permissions` VALUES(17689,"Command: clearat");
 INSERT INTO `rbac_permissions` VALUES(17690,"Command: id");
 INSERT INTO `rbac_permissions` VALUES(17691,"Command: test");
+INSERT INTO `rbac_permissions` VALUES(17692,"Command: tswow packets");
+INSERT INTO `rbac_permissions` VALUES(17693,"Command: tswow entryindex");
+INSERT INTO `rbac_permissions` VALUES(17694,"Command: tswow perf");
+INSERT INTO `rbac_permissions` VALUES(17695,"Command: tswow luamem");
+INSERT INTO `rbac_permissions` VALUES(17696,"Command: tswow luaprof");
+INSERT INTO `rbac_permissions` VALUES(17697,"Command: tswow packetlog");
+INSERT INTO `rbac_permissions` VALUES(17698,"Command: tswow packetlog replay");
 
 -- Makes these commands available to administrators
 INSERT INTO `rbac_linked_permissions` VALUES(192,17688);
 INSERT INTO `rbac_linked_permissions` VALUES(192,17689);
 INSERT INTO `rbac_linked_permissions` VALUES(192,17690);
-INSERT INTO `rbac_linked_permissions` VALUES(192,17691);
\ No newline at end of file
+INSERT INTO `rbac_linked_permissions` VALUES(192,17691);
+INSERT INTO `rbac_linked_permissions` VALUES(192,17692);
+INSERT INTO `rbac_linked_permissions` VALUES(192,17693);
+INSERT INTO `rbac_linked_permissions` VALUES(192,17694);
+INSERT INTO `rbac_linked_permissions` VALUES(192,17695);
+INSERT INTO `rbac_linked_permissions` VALUES(192,17696);
+INSERT INTO `rbac_linked_permissions` VALUES(192,17697);
+INSERT INTO `rbac_linked_permissions` VALUES(192,17698);